@@ -30,7 +30,7 @@ AUDIO_FILES = $(wildcard $(AUDIO_DIR)/*.cpp)
 SDL2_FILES = $(wildcard $(SDL2_DIR)/*.c) 
 SDL2_CPP_FILES = $(wildcard $(SDL2_DIR)/*.cpp) 
 SDL2_AUDIO_FILES = $(wildcard $(SDL2_AUDIO_DIR)/*.cpp)
-SDL2_UI_FILES = $(wildcard $(SDL2_UI_DIR)/menu.c)
+SDL2_UI_FILES = $(wildcard $(SDL2_UI_DIR)/menu.c $(SDL2_UI_DIR)/rom_library.c)
 EXTRA_FILES = $(wildcard $(SHARED_DIR)/*.c)
 
 GB_FILES = $(MAIN_FILES) $(CORE_FILES) $(MMU_FILES) $(AUDIO_FILES) $(SDL2_FILES) $(SDL2_CPP_FILES) $(SDL2_AUDIO_FILES) $(SDL2_UI_FILES) $(EXTRA_FILES)
@@ -0,0 +1,393 @@
+#include "breakpoints.h"
+#include "mmu/memory.h"
+#include "mmu/mbc.h"
+
+#include "../non_core/logger.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_BANKS 0x200 // MBC5
+#define BANKED_START 0x4000
+#define BANKED_END 0x8000
+#define MAX_ACCESSES 2
+
+#define BITMAP_SET(map, i) ((map)[(i) >> 3] |= 1 << ((i) & 7))
+#define BITMAP_TEST(map, i) ((map)[(i) >> 3] & (1 << ((i) & 7)))
+
+typedef struct {
+    uint16_t addr;
+    int flags;
+} Access;
+
+int breakpoints_armed = 0;
+
+static Break_Hit last_hit;
+static int have_hit = 0;
+
+static Breakpoint *breakpoints = NULL;
+static unsigned breakpoint_count = 0;
+static unsigned breakpoint_capacity = 0;
+
+static Watchpoint *watchpoints = NULL;
+static unsigned watchpoint_count = 0;
+static unsigned watchpoint_capacity = 0;
+
+static uint8_t exec_map[0x10000 / 8];     // Any breakpoint at the address
+static uint8_t any_bank_map[0x10000 / 8]; // Breakpoints for every bank
+static uint8_t *bank_maps[MAX_BANKS];     // Breakpoints for one bank, from 0x4000
+static uint8_t read_map[0x10000 / 8];
+static uint8_t write_map[0x10000 / 8];
+
+
+/* Grow array to hold one more element of the given size.
+ * returns 1 if successful, 0 otherwise */
+static int reserve(void **array, unsigned count, unsigned *capacity, size_t size) {
+
+    if (count < *capacity) {
+        return 1;
+    }
+
+    unsigned new_capacity = *capacity ? *capacity * 2 : 16;
+    void *grown = realloc(*array, new_capacity * size);
+    if (grown == NULL) {
+        log_message(LOG_ERROR, "Unable to allocate memory for breakpoints\n");
+        return 0;
+    }
+    *array = grown;
+    *capacity = new_capacity;
+    return 1;
+}
+
+
+static void rebuild_maps() {
+
+    memset(exec_map, 0, sizeof(exec_map));
+    memset(any_bank_map, 0, sizeof(any_bank_map));
+    for (unsigned bank = 0; bank < MAX_BANKS; bank++) {
+        if (bank_maps[bank]) {
+            memset(bank_maps[bank], 0, (BANKED_END - BANKED_START) / 8);
+        }
+    }
+    for (unsigned i = 0; i < breakpoint_count; i++) {
+        Breakpoint const *bp = &breakpoints[i];
+        BITMAP_SET(exec_map, bp->addr);
+        if (bp->bank == ANY_BANK) {
+            BITMAP_SET(any_bank_map, bp->addr);
+        } else {
+            BITMAP_SET(bank_maps[bp->bank], bp->addr - BANKED_START);
+        }
+    }
+
+    memset(read_map, 0, sizeof(read_map));
+    memset(write_map, 0, sizeof(write_map));
+    for (unsigned i = 0; i < watchpoint_count; i++) {
+        Watchpoint const *wp = &watchpoints[i];
+        for (unsigned addr = wp->start; addr <= wp->end; addr++) {
+            if (wp->flags & WATCH_READ) {
+                BITMAP_SET(read_map, addr);
+            }
+            if (wp->flags & WATCH_WRITE) {
+                BITMAP_SET(write_map, addr);
+            }
+        }
+    }
+
+    breakpoints_armed = breakpoint_count > 0 || watchpoint_count > 0;
+}
+
+
+int add_breakpoint(uint16_t addr, int bank, Break_Condition const *condition) {
+
+    // Only switchable ROM has banks to tell apart
+    if (addr < BANKED_START || addr >= BANKED_END) {
+        bank = ANY_BANK;
+    }
+    if (bank != ANY_BANK && (bank < 0 || bank >= MAX_BANKS)) {
+        return 0;
+    }
+
+    if (bank != ANY_BANK && bank_maps[bank] == NULL &&
+            !(bank_maps[bank] = calloc((BANKED_END - BANKED_START) / 8, 1))) {
+        log_message(LOG_ERROR, "Unable to allocate memory for breakpoints\n");
+        return 0;
+    }
+
+    if (!reserve((void **)&breakpoints, breakpoint_count, &breakpoint_capacity, sizeof(Breakpoint))) {
+        return 0;
+    }
+
+    Breakpoint *bp = &breakpoints[breakpoint_count++];
+    bp->addr = addr;
+    bp->bank = bank;
+    bp->condition.op = COND_NONE;
+    if (condition) {
+        bp->condition = *condition;
+    }
+    rebuild_maps();
+    return 1;
+}
+
+
+int remove_breakpoints(uint16_t addr, int bank) {
+
+    unsigned kept = 0;
+    for (unsigned i = 0; i < breakpoint_count; i++) {
+        Breakpoint const *bp = &breakpoints[i];
+        if (bp->addr != addr || (bank != ANY_BANK && bp->bank != bank)) {
+            breakpoints[kept++] = *bp;
+        }
+    }
+
+    int removed = breakpoint_count - kept;
+    breakpoint_count = kept;
+    rebuild_maps();
+    return removed;
+}
+
+
+int add_watchpoint(uint16_t start, uint16_t end, int flags) {
+
+    if (end < start || !(flags & (WATCH_READ | WATCH_WRITE))) {
+        return 0;
+    }
+    if (!reserve((void **)&watchpoints, watchpoint_count, &watchpoint_capacity, sizeof(Watchpoint))) {
+        return 0;
+    }
+
+    Watchpoint *wp = &watchpoints[watchpoint_count++];
+    wp->start = start;
+    wp->end = end;
+    wp->flags = flags;
+    rebuild_maps();
+    return 1;
+}
+
+
+int remove_watchpoints(uint16_t start, int flags) {
+
+    unsigned kept = 0;
+    for (unsigned i = 0; i < watchpoint_count; i++) {
+        Watchpoint const *wp = &watchpoints[i];
+        if (wp->start != start || !(wp->flags & flags)) {
+            watchpoints[kept++] = *wp;
+        }
+    }
+
+    int removed = watchpoint_count - kept;
+    watchpoint_count = kept;
+    rebuild_maps();
+    return removed;
+}
+
+
+int remove_watchpoint(uint16_t start, uint16_t end, int flags) {
+
+    for (unsigned i = 0; i < watchpoint_count; i++) {
+        Watchpoint const *wp = &watchpoints[i];
+        if (wp->start == start && wp->end == end && wp->flags == flags) {
+            memmove(&watchpoints[i], &watchpoints[i + 1], (watchpoint_count - i - 1) * sizeof(Watchpoint));
+            watchpoint_count--;
+            rebuild_maps();
+            return 1;
+        }
+    }
+    return 0;
+}
+
+
+void clear_breakpoints() {
+
+    free(breakpoints);
+    free(watchpoints);
+    breakpoints = NULL;
+    watchpoints = NULL;
+    breakpoint_count = breakpoint_capacity = 0;
+    watchpoint_count = watchpoint_capacity = 0;
+
+    for (unsigned bank = 0; bank < MAX_BANKS; bank++) {
+        free(bank_maps[bank]);
+        bank_maps[bank] = NULL;
+    }
+    rebuild_maps();
+}
+
+
+Breakpoint const *get_breakpoints(unsigned *count) {
+    *count = breakpoint_count;
+    return breakpoints;
+}
+
+
+Watchpoint const *get_watchpoints(unsigned *count) {
+    *count = watchpoint_count;
+    return watchpoints;
+}
+
+
+static int condition_met(Break_Condition const *condition) {
+
+    uint16_t val = get_register(condition->reg);
+    switch (condition->op) {
+        case COND_NONE: return 1;
+        case COND_EQ: return val == condition->value;
+        case COND_NE: return val != condition->value;
+        case COND_LT: return val < condition->value;
+        case COND_GT: return val > condition->value;
+        case COND_LE: return val <= condition->value;
+        case COND_GE: return val >= condition->value;
+    }
+    return 0;
+}
+
+
+// Condition codes of conditional calls and returns, NZ Z NC C
+static int jump_taken(uint8_t opcode) {
+
+    uint8_t flags = get_register(REG_F);
+    switch ((opcode >> 3) & 0x3) {
+        case 0: return !(flags & 0x80);
+        case 1: return flags & 0x80;
+        case 2: return !(flags & 0x10);
+        default: return flags & 0x10;
+    }
+}
+
+
+/* Memory the instruction at pc will read or write, other than
+ * fetching the instruction itself. returns the number of accesses */
+static int get_accesses(uint16_t pc, Access accesses[MAX_ACCESSES]) {
+
+    uint8_t opcode = peek_mem(pc);
+    uint16_t hl = get_register(REG_HL);
+    uint16_t sp = get_register(REG_SP);
+    uint16_t imm_16 = peek_mem(pc + 1) | (peek_mem(pc + 2) << 8);
+    int count = 0;
+
+#define ACCESS(a, f) (accesses[count].addr = (a), accesses[count].flags = (f), count++)
+#define PUSH() (ACCESS(sp - 1, WATCH_WRITE), ACCESS(sp - 2, WATCH_WRITE))
+#define POP() (ACCESS(sp, WATCH_READ), ACCESS(sp + 1, WATCH_READ))
+
+    // Bit operations on (HL), BIT only reads
+    if (opcode == 0xCB) {
+        uint8_t ext = peek_mem(pc + 1);
+        if ((ext & 0x7) == 0x6) {
+            ACCESS(hl, ext >= 0x40 && ext < 0x80 ? WATCH_READ : WATCH_READ | WATCH_WRITE);
+        }
+        return count;
+    }
+
+    // LD r,(HL) LD (HL),r and ALU operations on (HL)
+    if (opcode >= 0x40 && opcode < 0xC0 && opcode != 0x76) {
+        if ((opcode & 0x7) == 0x6) {
+            ACCESS(hl, WATCH_READ);
+        } else if ((opcode & 0xF8) == 0x70) {
+            ACCESS(hl, WATCH_WRITE);
+        }
+        return count;
+    }
+
+    switch (opcode) {
+        case 0x02: ACCESS(get_register(REG_BC), WATCH_WRITE); break;
+        case 0x0A: ACCESS(get_register(REG_BC), WATCH_READ); break;
+        case 0x12: ACCESS(get_register(REG_DE), WATCH_WRITE); break;
+        case 0x1A: ACCESS(get_register(REG_DE), WATCH_READ); break;
+        case 0x22: case 0x32: ACCESS(hl, WATCH_WRITE); break;
+        case 0x2A: case 0x3A: ACCESS(hl, WATCH_READ); break;
+        case 0x34: case 0x35: ACCESS(hl, WATCH_READ | WATCH_WRITE); break;
+        case 0x36: ACCESS(hl, WATCH_WRITE); break;
+        case 0x08: ACCESS(imm_16, WATCH_WRITE); ACCESS(imm_16 + 1, WATCH_WRITE); break;
+        case 0xE0: ACCESS(0xFF00 | (imm_16 & 0xFF), WATCH_WRITE); break;
+        case 0xF0: ACCESS(0xFF00 | (imm_16 & 0xFF), WATCH_READ); break;
+        case 0xE2: ACCESS(0xFF00 | get_register(REG_C), WATCH_WRITE); break;
+        case 0xF2: ACCESS(0xFF00 | get_register(REG_C), WATCH_READ); break;
+        case 0xEA: ACCESS(imm_16, WATCH_WRITE); break;
+        case 0xFA: ACCESS(imm_16, WATCH_READ); break;
+
+        case 0xC5: case 0xD5: case 0xE5: case 0xF5: // PUSH
+        case 0xCD: // CALL
+        case 0xC7: case 0xCF: case 0xD7: case 0xDF: // RST
+        case 0xE7: case 0xEF: case 0xF7: case 0xFF:
+            PUSH();
+            break;
+        case 0xC4: case 0xCC: case 0xD4: case 0xDC: // CALL cc
+            if (jump_taken(opcode)) {
+                PUSH();
+            }
+            break;
+
+        case 0xC1: case 0xD1: case 0xE1: case 0xF1: // POP
+        case 0xC9: case 0xD9: // RET, RETI
+            POP();
+            break;
+        case 0xC0: case 0xC8: case 0xD0: case 0xD8: // RET cc
+            if (jump_taken(opcode)) {
+                POP();
+            }
+            break;
+    }
+
+#undef ACCESS
+#undef PUSH
+#undef POP
+    return count;
+}
+
+
+int check_breakpoints(uint16_t pc, Break_Hit *hit) {
+
+    if (BITMAP_TEST(exec_map, pc)) {
+        int bank = pc >= BANKED_START && pc < BANKED_END ? mapped_rom_bank(pc) : ANY_BANK;
+        int in_bank = bank >= 0 && bank < MAX_BANKS && bank_maps[bank] &&
+                      BITMAP_TEST(bank_maps[bank], pc - BANKED_START);
+
+        for (unsigned i = 0; (in_bank || BITMAP_TEST(any_bank_map, pc)) && i < breakpoint_count; i++) {
+            Breakpoint const *bp = &breakpoints[i];
+            if (bp->addr == pc && (bp->bank == ANY_BANK || bp->bank == bank) &&
+                    condition_met(&bp->condition)) {
+                hit->addr = pc;
+                hit->bank = bank;
+                hit->flags = 0;
+                last_hit = *hit;
+                have_hit = 1;
+                return 1;
+            }
+        }
+    }
+
+    if (watchpoint_count == 0) {
+        return 0;
+    }
+
+    Access accesses[MAX_ACCESSES];
+    int count = get_accesses(pc, accesses);
+    for (int i = 0; i < count; i++) {
+        int flags = 0;
+        if ((accesses[i].flags & WATCH_READ) && BITMAP_TEST(read_map, accesses[i].addr)) {
+            flags |= WATCH_READ;
+        }
+        if ((accesses[i].flags & WATCH_WRITE) && BITMAP_TEST(write_map, accesses[i].addr)) {
+            flags |= WATCH_WRITE;
+        }
+        if (flags) {
+            hit->addr = accesses[i].addr;
+            hit->bank = ANY_BANK;
+            hit->flags = flags;
+            last_hit = *hit;
+            have_hit = 1;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+
+int take_break_hit(Break_Hit *hit) {
+
+    if (!have_hit) {
+        return 0;
+    }
+    *hit = last_hit;
+    have_hit = 0;
+    return 1;
+}
@@ -0,0 +1,92 @@
+#ifndef BREAKPOINTS_H
+#define BREAKPOINTS_H
+
+#include <stdint.h>
+
+#include "cpu.h"
+
+/* Execution breakpoints and memory watchpoints for the debugger.
+ *
+ * Breakpoints are marked in a bitmap of all 64K addresses, with a
+ * bitmap per ROM bank for those only in one bank of 0x4000 - 0x7FFF,
+ * so the check for each instruction is a bit test. Any number can be
+ * set, each optionally conditional on a register value.
+ *
+ * Watchpoints cover ranges of addresses and are checked by working out
+ * which addresses the next instruction reads and writes, so memory
+ * accesses themselves are never slowed down. Pushes made when
+ * interrupts are dispatched and DMA aren't caught.
+ *
+ * While nothing is set the emulator runs its normal loop, which has
+ * no debugging checks at all. */
+
+#define ANY_BANK -1
+
+typedef enum {WATCH_READ = 0x1, WATCH_WRITE = 0x2} Watch_Flag;
+
+typedef enum {COND_NONE, COND_EQ, COND_NE, COND_LT, COND_GT, COND_LE, COND_GE} Condition_Op;
+
+// Break only if reg op value holds
+typedef struct {
+    Condition_Op op;
+    CPU_Register reg;
+    uint16_t value;
+} Break_Condition;
+
+typedef struct {
+    uint16_t addr;
+    int bank; // ROM bank for 0x4000 - 0x7FFF, or ANY_BANK
+    Break_Condition condition;
+} Breakpoint;
+
+typedef struct {
+    uint16_t start;
+    uint16_t end; // inclusive
+    int flags; // Watch_Flag
+} Watchpoint;
+
+// What caused the last break
+typedef struct {
+    uint16_t addr;
+    int bank;
+    int flags; // 0 for a breakpoint, otherwise the Watch_Flag of the access
+} Break_Hit;
+
+/* Add a breakpoint, condition may be NULL.
+ * returns 1 if successful, 0 otherwise */
+int add_breakpoint(uint16_t addr, int bank, Break_Condition const *condition);
+
+/* Remove all breakpoints at addr in the given bank,
+ * or in any bank if ANY_BANK. returns the number removed */
+int remove_breakpoints(uint16_t addr, int bank);
+
+/* Watch accesses to start - end inclusive.
+ * returns 1 if successful, 0 otherwise */
+int add_watchpoint(uint16_t start, uint16_t end, int flags);
+
+/* Remove watchpoints starting at start with any of the given flags,
+ * returns the number removed */
+int remove_watchpoints(uint16_t start, int flags);
+
+/* Remove one watchpoint covering exactly start - end with exactly
+ * the given flags. returns 1 if one was removed, 0 otherwise */
+int remove_watchpoint(uint16_t start, uint16_t end, int flags);
+
+void clear_breakpoints();
+
+// Set breakpoints and watchpoints, count returned
+Breakpoint const *get_breakpoints(unsigned *count);
+Watchpoint const *get_watchpoints(unsigned *count);
+
+// 1 if any breakpoints or watchpoints are set
+extern int breakpoints_armed;
+
+/* Check the instruction about to run at pc for breakpoints and
+ * watched accesses. returns 1 and fills in hit if it should break */
+int check_breakpoints(uint16_t pc, Break_Hit *hit);
+
+/* Get the hit which caused the last break, if there's been one
+ * since last called. returns 1 if there was, 0 otherwise */
+int take_break_hit(Break_Hit *hit);
+
+#endif /* BREAKPOINTS_H */
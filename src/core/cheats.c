@@ -0,0 +1,245 @@
+#include "cheats.h"
+#include "mmu/mbc.h"
+#include "mmu/memory.h"
+
+#include "../non_core/logger.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define ROM_PAGES (0x8000 >> MBC_PAGE_SHIFT)
+#define PAGE_SIZE (1 << MBC_PAGE_SHIFT)
+#define PAGE_OFFSET(page) ((page) << MBC_PAGE_SHIFT)
+#define SHADOWS_PER_PAGE 8 // Banks kept patched for each page
+
+typedef struct {
+    uint16_t addr;
+    uint8_t value;
+    uint8_t compare;
+    int has_compare;
+} Game_Genie_Code;
+
+typedef struct {
+    uint8_t type; // 0x01 current bank, 0x8X/0x9X WRAM bank X
+    uint8_t value;
+    uint16_t addr;
+} GameShark_Code;
+
+typedef struct {
+    uint8_t const *source; // Page the copy was made from, NULL if stale
+    uint8_t *data;
+} Cheat_Shadow;
+
+uint16_t cheat_pages = 0;
+
+static Game_Genie_Code genie_codes[MAX_CHEATS];
+static int genie_count = 0;
+static GameShark_Code shark_codes[MAX_CHEATS];
+static int shark_count = 0;
+
+static Cheat_Shadow shadows[ROM_PAGES][SHADOWS_PER_PAGE]; // Patched copies of each page
+static unsigned next_shadow[ROM_PAGES];   // Copy replaced when none match
+static uint8_t *shadow_source[ROM_PAGES]; // Base the mapped copy was made from
+static uint8_t *shadow_mapped[ROM_PAGES]; // What was put in MBC_page_map for it
+
+
+static int hex_digit(char c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    return -1;
+}
+
+
+/* Read up to max hex digits of code into digits, skipping dashes.
+ * returns the number read, or -1 if the code is invalid */
+static int parse_digits(char const *code, int *digits, int max) {
+
+    int count = 0;
+    for (; *code != '\0'; code++) {
+        if (*code == '-') {
+            continue;
+        }
+        int digit = hex_digit(*code);
+        if (digit < 0 || count == max) {
+            return -1;
+        }
+        digits[count++] = digit;
+    }
+    return count;
+}
+
+
+/* Patched copy of the page at src, reusing one made earlier so switching
+ * between banks doesn't copy them again. returns NULL if out of memory */
+static uint8_t *find_shadow(unsigned page, uint8_t const *src) {
+
+    Cheat_Shadow *slots = shadows[page];
+
+    // Paged ROM can reuse the same memory for another bank, so always copy
+    if (!ROM_paged) {
+        for (int i = 0; i < SHADOWS_PER_PAGE; i++) {
+            if (slots[i].source == src) {
+                return slots[i].data;
+            }
+        }
+    }
+
+    Cheat_Shadow *shadow = &slots[ROM_paged ? 0 : next_shadow[page]];
+    next_shadow[page] = (next_shadow[page] + 1) % SHADOWS_PER_PAGE;
+    if (shadow->data == NULL && !(shadow->data = malloc(PAGE_SIZE))) {
+        log_message(LOG_ERROR, "Unable to allocate memory for cheats\n");
+        return NULL;
+    }
+
+    memcpy(shadow->data, src, PAGE_SIZE);
+    for (int i = 0; i < genie_count; i++) {
+        Game_Genie_Code const *code = &genie_codes[i];
+        unsigned offset = code->addr & (PAGE_SIZE - 1);
+        if ((code->addr >> MBC_PAGE_SHIFT) == page &&
+                (!code->has_compare || src[offset] == code->compare)) {
+            shadow->data[offset] = code->value;
+        }
+    }
+    shadow->source = src;
+    return shadow->data;
+}
+
+
+uint8_t *shadow_cheat_page(unsigned page, uint8_t *base) {
+
+    if (base == NULL || page >= ROM_PAGES) {
+        return base;
+    }
+
+    uint8_t *shadow = find_shadow(page, base + PAGE_OFFSET(page));
+    if (shadow == NULL) {
+        return base;
+    }
+
+    shadow_source[page] = base;
+    shadow_mapped[page] = shadow - PAGE_OFFSET(page);
+    return shadow_mapped[page];
+}
+
+
+uint8_t *cheat_page_source(unsigned page, uint8_t *mapped) {
+    return page < ROM_PAGES && mapped != NULL && mapped == shadow_mapped[page] ?
+        shadow_source[page] : mapped;
+}
+
+
+// Remap ROM pages after patches have changed
+static void refresh_pages() {
+
+    cheat_pages = 0;
+    for (int i = 0; i < genie_count; i++) {
+        cheat_pages |= 1 << (genie_codes[i].addr >> MBC_PAGE_SHIFT);
+    }
+
+    for (unsigned page = 0; page < ROM_PAGES; page++) {
+        uint8_t *base = cheat_page_source(page, MBC_page_map[page]);
+        for (int i = 0; i < SHADOWS_PER_PAGE; i++) {
+            shadows[page][i].source = NULL;
+        }
+        shadow_source[page] = NULL;
+        shadow_mapped[page] = NULL;
+        map_MBC_read(PAGE_OFFSET(page), PAGE_SIZE, base);
+    }
+}
+
+
+/* ABC-DEF-GHI, AB is the new value, FCDE the address xor 0xF000
+ * and GI the compare value xor 0xBA, rotated left by 2 */
+static int add_game_genie(int const *digits, int count) {
+
+    Game_Genie_Code code;
+    code.value = (digits[0] << 4) | digits[1];
+    code.addr = ((digits[5] ^ 0xF) << 12) | (digits[2] << 8) | (digits[3] << 4) | digits[4];
+    code.has_compare = count == 9;
+    if (code.has_compare) {
+        uint8_t compare = (digits[6] << 4) | digits[8];
+        code.compare = ((compare >> 2) | (compare << 6)) ^ 0xBA;
+    }
+
+    if (code.addr >= 0x8000) {
+        return 0;
+    }
+
+    genie_codes[genie_count++] = code;
+    refresh_pages();
+    return 1;
+}
+
+
+/* ttvvaaaa, type tt, value vv and address aaaa stored little endian */
+static int add_gameshark(int const *digits) {
+
+    GameShark_Code code;
+    code.type = (digits[0] << 4) | digits[1];
+    code.value = (digits[2] << 4) | digits[3];
+    code.addr = (digits[6] << 12) | (digits[7] << 8) | (digits[4] << 4) | digits[5];
+
+    int valid_type = code.type <= 0x01 || (code.type & 0xE8) == 0x80;
+    if (!valid_type || code.addr < 0xA000 || code.addr >= 0xE000) {
+        return 0;
+    }
+
+    shark_codes[shark_count++] = code;
+    return 1;
+}
+
+
+int add_cheat(char const *code) {
+
+    int digits[9];
+    int count = parse_digits(code, digits, 9);
+
+    int added = 0;
+    if ((count == 6 || count == 9) && genie_count < MAX_CHEATS) {
+        added = add_game_genie(digits, count);
+    } else if (count == 8 && strchr(code, '-') == NULL && shark_count < MAX_CHEATS) {
+        added = add_gameshark(digits);
+    }
+
+    if (!added) {
+        log_message(LOG_WARN, "Unable to add cheat %s\n", code);
+        return 0;
+    }
+    log_message(LOG_INFO, "Added cheat %s\n", code);
+    return 1;
+}
+
+
+void clear_cheats() {
+
+    genie_count = 0;
+    shark_count = 0;
+    refresh_pages();
+
+    for (unsigned page = 0; page < ROM_PAGES; page++) {
+        for (int i = 0; i < SHADOWS_PER_PAGE; i++) {
+            free(shadows[page][i].data);
+            shadows[page][i].data = NULL;
+        }
+    }
+}
+
+
+void apply_gameshark_codes() {
+
+    for (int i = 0; i < shark_count; i++) {
+        GameShark_Code const *code = &shark_codes[i];
+        if (code->type >= 0x80 && code->addr >= 0xD000) {
+            set_wram_bank_mem(code->type & 0x7, code->addr, code->value);
+        } else {
+            set_mem(code->addr, code->value);
+        }
+    }
+}
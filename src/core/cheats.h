@@ -0,0 +1,42 @@
+#ifndef CHEATS_H
+#define CHEATS_H
+
+#include <stdint.h>
+
+/* Game Genie ROM patches and GameShark RAM writes.
+ *
+ * Game Genie codes (ABC-DEF or ABC-DEF-GHI) replace a byte of ROM, only
+ * if it holds the compare value when one is given. Each 4KB ROM page of
+ * MBC_read_map with a patch is pointed at a shadow copy of the bank it
+ * would read, with the patches applied, so reads stay direct and pages
+ * without patches are untouched. Copies of the last few banks mapped at
+ * each page are kept, so switching between them doesn't copy again.
+ *
+ * GameShark codes (ttvvaaaa) write a value to RAM once every frame. */
+
+#define MAX_CHEATS 32
+
+/* Bit n set if page n of MBC_read_map has Game Genie patches,
+ * checked by map_MBC_read when publishing banks */
+extern uint16_t cheat_pages;
+
+/* Add a Game Genie or GameShark code, should be called once the ROM is
+ * loaded. returns 1 if successful, 0 if the code is invalid or there's
+ * no room for it */
+int add_cheat(char const *code);
+
+// Remove all codes and free the shadow pages
+void clear_cheats();
+
+/* Copy of the 4KB page starting at base[page << MBC_PAGE_SHIFT],
+ * with patches applied. Returns base if no shadow can be made */
+uint8_t *shadow_cheat_page(unsigned page, uint8_t *base);
+
+/* What a page of MBC_read_map would hold without patches,
+ * given what it currently holds */
+uint8_t *cheat_page_source(unsigned page, uint8_t *mapped);
+
+// Perform GameShark writes, called once per frame
+void apply_gameshark_codes();
+
+#endif /* CHEATS_H */
@@ -0,0 +1,249 @@
+#include "code_logger.h"
+#include "cpu.h"
+#include "mmu/mbc.h"
+
+#include "../non_core/logger.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_FILE_NAME 512
+#define ROM_BANK_PAGES (ROM_BANK_SIZE / CDL_HEATMAP_PAGE)
+
+int code_logging = 0;
+
+static read_MBC_ptr unlogged_read_MBC;
+static write_MBC_ptr unlogged_write_MBC;
+static int dma_active = 0;
+
+static unsigned rom_bank_total;
+static unsigned long ram_size;
+static uint8_t **rom_flags = NULL; // Flags of each ROM bank, allocated on first access
+static uint8_t *ram_flags = NULL;
+static uint32_t *rom_counts = NULL;
+static uint32_t *ram_counts = NULL;
+static int out_of_memory;
+
+
+static void log_rom(unsigned bank, unsigned offset, uint8_t flag) {
+
+    uint8_t *flags = rom_flags[bank];
+    if (flags == NULL) {
+        if (!(flags = rom_flags[bank] = calloc(ROM_BANK_SIZE, 1))) {
+            if (!out_of_memory) {
+                log_message(LOG_WARN, "Unable to allocate code log of ROM bank %u\n", bank);
+                out_of_memory = 1;
+            }
+            return;
+        }
+    }
+    flags[offset] |= flag;
+    rom_counts[bank * ROM_BANK_PAGES + offset / CDL_HEATMAP_PAGE]++;
+}
+
+
+// Tag the byte at addr, read from base[addr]
+static void log_access(uint16_t addr, uint8_t const *base, uint8_t flag) {
+
+    if (addr < 0x8000) {
+        int bank = mapped_rom_bank(addr);
+        if (bank >= 0 && (unsigned)bank < rom_bank_total) {
+            log_rom(bank, addr & (ROM_BANK_SIZE - 1), flag);
+        }
+        return;
+    }
+
+    uint8_t const *byte = base + addr;
+    if (RAM_banks != NULL && byte >= RAM_banks && byte < RAM_banks + ram_size) {
+        unsigned long offset = byte - RAM_banks;
+        ram_flags[offset] |= flag;
+        ram_counts[offset / CDL_HEATMAP_PAGE]++;
+    }
+}
+
+
+/* Opcodes are fetched from PC, and operands read back from behind it
+ * once it's been moved past the instruction */
+static inline uint8_t read_flag(uint16_t addr) {
+    if (dma_active) {
+        return CDL_DMA;
+    }
+    return (uint16_t)(get_register(REG_PC) - addr) <= 2 ? CDL_EXECUTED : CDL_READ;
+}
+
+
+static uint8_t logged_read_MBC(uint16_t addr) {
+
+    uint8_t *base = MBC_page_map[addr >> MBC_PAGE_SHIFT];
+    if (base == NULL) {
+        return unlogged_read_MBC(addr);
+    }
+    log_access(addr, base, read_flag(addr));
+    return base[addr];
+}
+
+
+static void logged_write_MBC(uint16_t addr, uint8_t val) {
+
+    // Writes to ROM are to the MBC's registers
+    if (addr >= 0xA000) {
+        uint8_t *base = MBC_page_map[addr >> MBC_PAGE_SHIFT];
+        if (base != NULL) {
+            log_access(addr, base, CDL_WRITTEN);
+        }
+    }
+    unlogged_write_MBC(addr, val);
+}
+
+
+void log_DMA(int active) {
+    dma_active = active;
+}
+
+
+static void free_logs() {
+
+    if (rom_flags) {
+        for (unsigned bank = 0; bank < rom_bank_total; bank++) {
+            free(rom_flags[bank]);
+        }
+    }
+    free(rom_flags);
+    free(ram_flags);
+    free(rom_counts);
+    free(ram_counts);
+    rom_flags = NULL;
+    ram_flags = NULL;
+    rom_counts = NULL;
+    ram_counts = NULL;
+}
+
+
+int start_code_logging() {
+
+    if (code_logging) {
+        return 1;
+    }
+    if (read_MBC == NULL) {
+        log_message(LOG_ERROR, "Code logging needs a ROM loaded\n");
+        return 0;
+    }
+
+    rom_bank_total = ROM_bank_count;
+    ram_size = RAM_size;
+    rom_flags = calloc(rom_bank_total, sizeof(uint8_t *));
+    rom_counts = calloc((unsigned long)rom_bank_total * ROM_BANK_PAGES, sizeof(uint32_t));
+    ram_flags = calloc(ram_size + 1, 1);
+    ram_counts = calloc(ram_size / CDL_HEATMAP_PAGE + 1, sizeof(uint32_t));
+    if (!rom_flags || !rom_counts || !ram_flags || !ram_counts) {
+        log_message(LOG_ERROR, "Unable to allocate code log\n");
+        free_logs();
+        return 0;
+    }
+    out_of_memory = 0;
+    dma_active = 0;
+
+    unlogged_read_MBC = read_MBC;
+    unlogged_write_MBC = write_MBC;
+    read_MBC = logged_read_MBC;
+    write_MBC = logged_write_MBC;
+    memset(MBC_read_map, 0, sizeof(MBC_read_map));
+    code_logging = 1;
+    return 1;
+}
+
+
+static int write_cdl(char const *name) {
+
+    char file_name[MAX_FILE_NAME];
+    snprintf(file_name, MAX_FILE_NAME, "%s.cdl", name);
+    FILE *file;
+    if (!(file = fopen(file_name, "wb"))) {
+        log_message(LOG_ERROR, "Error opening code log %s\n", file_name);
+        return 0;
+    }
+
+    static uint8_t const untouched[ROM_BANK_SIZE];
+    for (unsigned bank = 0; bank < rom_bank_total; bank++) {
+        fwrite(rom_flags[bank] ? rom_flags[bank] : untouched, 1, ROM_BANK_SIZE, file);
+    }
+    fwrite(ram_flags, 1, ram_size, file);
+
+    if (ferror(file) | fclose(file)) {
+        log_message(LOG_ERROR, "Error writing code log %s\n", file_name);
+        return 0;
+    }
+    log_message(LOG_INFO, "Wrote code log to %s\n", file_name);
+    return 1;
+}
+
+
+static void write_counts(FILE *file, uint32_t const *counts, unsigned long count) {
+    for (unsigned long i = 0; i < count; i++) {
+        uint8_t bytes[4] = {counts[i], counts[i] >> 8, counts[i] >> 16, counts[i] >> 24};
+        fwrite(bytes, 1, sizeof(bytes), file);
+    }
+}
+
+
+static int write_heatmap(char const *name) {
+
+    char file_name[MAX_FILE_NAME];
+    snprintf(file_name, MAX_FILE_NAME, "%s.heatmap", name);
+    FILE *file;
+    if (!(file = fopen(file_name, "wb"))) {
+        log_message(LOG_ERROR, "Error opening heatmap %s\n", file_name);
+        return 0;
+    }
+
+    write_counts(file, rom_counts, (unsigned long)rom_bank_total * ROM_BANK_PAGES);
+    write_counts(file, ram_counts, ram_size / CDL_HEATMAP_PAGE);
+
+    if (ferror(file) | fclose(file)) {
+        log_message(LOG_ERROR, "Error writing heatmap %s\n", file_name);
+        return 0;
+    }
+    log_message(LOG_INFO, "Wrote heatmap to %s\n", file_name);
+    return 1;
+}
+
+
+// Log how much of the ROM has been seen being run or read
+static void log_coverage() {
+
+    unsigned long executed = 0, read = 0;
+    for (unsigned bank = 0; bank < rom_bank_total; bank++) {
+        if (rom_flags[bank] == NULL) {
+            continue;
+        }
+        for (unsigned i = 0; i < ROM_BANK_SIZE; i++) {
+            executed += (rom_flags[bank][i] & CDL_EXECUTED) != 0;
+            read += (rom_flags[bank][i] & (CDL_READ | CDL_DMA)) != 0;
+        }
+    }
+    double total = (double)rom_bank_total * ROM_BANK_SIZE / 100.0;
+    log_message(LOG_INFO, "Code log: %.1f%% of ROM executed, %.1f%% read as data\n",
+        executed / total, read / total);
+}
+
+
+int stop_code_logging(char const *name) {
+
+    if (!code_logging) {
+        return 1;
+    }
+    read_MBC = unlogged_read_MBC;
+    write_MBC = unlogged_write_MBC;
+    memcpy(MBC_read_map, MBC_page_map, sizeof(MBC_read_map));
+    code_logging = 0;
+    dma_active = 0;
+
+    int ok = 1;
+    if (name) {
+        log_coverage();
+        ok = write_cdl(name) & write_heatmap(name);
+    }
+    free_logs();
+    return ok;
+}
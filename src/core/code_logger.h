@@ -0,0 +1,46 @@
+#ifndef CODE_LOGGER_H
+#define CODE_LOGGER_H
+
+#include <stdint.h>
+
+/* Code/Data Logger for cartridge ROM and RAM.
+ *
+ * Every byte accessed is tagged as executed, read as data, written or
+ * read by OAM DMA/HDMA, with a shadow bitmap of flags for each ROM bank
+ * allocated as the bank is first accessed. Accesses are also counted
+ * per 256 byte page for a heatmap.
+ *
+ * Logging swaps read_MBC and write_MBC for logging versions and empties
+ * MBC_read_map so every cartridge access goes through them, the normal
+ * paths have no checks for it. Reads of the byte at PC and the two
+ * behind it are taken as executed, as those are where opcodes are
+ * fetched and operands read back from. Pages read through the MBC
+ * itself (RTC registers, MBC2 RAM, MBC6 flash, HuC3) aren't logged,
+ * nor are reads by the debugging tools, which use peek_mem.
+ *
+ * <name>.cdl holds a byte of flags for each byte of ROM, followed by
+ * one for each byte of cartridge RAM. <name>.heatmap holds a 32 bit
+ * little endian access count for each 256 byte page, in the same order. */
+
+#define CDL_EXECUTED 0x1
+#define CDL_READ 0x2
+#define CDL_WRITTEN 0x4
+#define CDL_DMA 0x8
+
+#define CDL_HEATMAP_PAGE 0x100
+
+// 1 while logging, checked by map_MBC_read and before calling log_DMA
+extern int code_logging;
+
+/* Start logging accesses to the loaded ROM.
+ * returns 1 if successful, 0 otherwise */
+int start_code_logging();
+
+/* Stop logging and write <name>.cdl and <name>.heatmap if name isn't NULL.
+ * returns 1 if successful, 0 otherwise */
+int stop_code_logging(char const *name);
+
+// 1 if reads are made by DMA, 0 once it's done
+void log_DMA(int active);
+
+#endif /* CODE_LOGGER_H */
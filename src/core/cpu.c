@@ -9,12 +9,15 @@
 #include "mmu/memory.h"
 #include "memory_layout.h"
 #include "cpu.h"
-#include "disasm.h"
+#include "disasm_memory.h"
 #include "timers.h"
 #include "lcd.h"
 #include "sound.h"
 #include "serial_io.h"
 #include "rom_info.h"
+#include "profiler.h"
+#include "trace.h"
+#include "instrument.h"
 
 #include "../non_core/logger.h"
 
@@ -85,6 +88,9 @@ void update_all_cycles(long cycles) {
 
 void invalid_op(){
     log_message(LOG_ERROR, "Error, unknown opcode: %x\n", opcode);
+    if (tracing) {
+        trigger_trace("unknown opcode");
+    }
 }
 
 
@@ -1273,6 +1279,9 @@ void invalid_op(){
 {
     PUSH(reg.PC);
     reg.PC = IMMEDIATE_16_BIT;
+    if (profiling) {
+        profile_call(reg.PC, reg.SP);
+    }
 }
 
 /*  Call if flag is set/unset */
@@ -1292,6 +1301,9 @@ void restart(uint8_t addr)
 {
     PUSH(reg.PC);
     reg.PC = addr;
+    if (profiling) {
+        profile_call(reg.PC, reg.SP);
+    }
 }
 
  static void RST_00() {restart(0x00);}
@@ -1307,7 +1319,12 @@ void restart(uint8_t addr)
 /**** Returns ****/
 
 /*  Pop two bytes from stack and jump to that addr */
- static void RET() { POP(&reg.PC);}
+ static void RET() {
+    if (profiling) {
+        profile_return(reg.SP);
+    }
+    POP(&reg.PC);
+}
 
 // Return if flags are set
  static void RET_NZ() { ins[0xC0].cycles = !reg.Z_FLAG ? (RET(), 20) : 8; } 
@@ -1582,6 +1599,45 @@ void print_regs() {
 #endif
 }
 
+uint16_t get_register(CPU_Register r) {
+    switch (r) {
+        case REG_A: return reg.A;
+        case REG_F: return reg.F;
+        case REG_B: return reg.B;
+        case REG_C: return reg.C;
+        case REG_D: return reg.D;
+        case REG_E: return reg.E;
+        case REG_H: return reg.H;
+        case REG_L: return reg.L;
+        case REG_AF: return reg.AF;
+        case REG_BC: return reg.BC;
+        case REG_DE: return reg.DE;
+        case REG_HL: return reg.HL;
+        case REG_SP: return reg.SP;
+        case REG_PC: return reg.PC;
+    }
+    return 0;
+}
+
+void set_register(CPU_Register r, uint16_t val) {
+    switch (r) {
+        case REG_A: reg.A = val; break;
+        case REG_F: reg.F = val & 0xF0; break;
+        case REG_B: reg.B = val; break;
+        case REG_C: reg.C = val; break;
+        case REG_D: reg.D = val; break;
+        case REG_E: reg.E = val; break;
+        case REG_H: reg.H = val; break;
+        case REG_L: reg.L = val; break;
+        case REG_AF: reg.AF = val & 0xFFF0; break;
+        case REG_BC: reg.BC = val; break;
+        case REG_DE: reg.DE = val; break;
+        case REG_HL: reg.HL = val; break;
+        case REG_SP: reg.SP = val; break;
+        case REG_PC: reg.PC = val; break;
+    }
+}
+
 /*  Executes the next processor instruction and returns
  *  the amount of cycles the instruction takes */
 int exec_opcode(int skip_bug) {
@@ -1600,7 +1656,9 @@ int exec_opcode(int skip_bug) {
     reg.PC += instructions.words[opcode]; /*  increment PC to next instruction */    
     if (opcode != 0xCB) {
          
+        ZONE_BEGIN(ZONE_CPU);
         instructions.instruction_set[opcode].operation();
+        ZONE_END(ZONE_CPU);
         int cycles = instructions.instruction_set[opcode].cycles;
         update_all_cycles(cycles - timer_cycles_passed);
         timer_cycles_passed = 0;
@@ -1611,7 +1669,9 @@ int exec_opcode(int skip_bug) {
     } else { /*  extended instruction */
 
         opcode = IMMEDIATE_8_BIT;
+        ZONE_BEGIN(ZONE_CPU);
         instructions.ext_instruction_set[opcode].operation();  
+        ZONE_END(ZONE_CPU);
         update_all_cycles(8);
         return instructions.ext_instruction_set[opcode].cycles;
     }
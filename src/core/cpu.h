@@ -7,6 +7,9 @@
 extern int halted;
 extern int stopped;
 
+typedef enum {REG_A, REG_F, REG_B, REG_C, REG_D, REG_E, REG_H, REG_L,
+              REG_AF, REG_BC, REG_DE, REG_HL, REG_SP, REG_PC} CPU_Register;
+
 /*  Call interrupt handler code */
 void restart(uint8_t addr);
 
@@ -29,5 +32,12 @@ int exec_opcode(int skip_bug);
 
 void print_regs();
 
+// Current value of the given register
+uint16_t get_register(CPU_Register r);
+
+/* Set the given register, only the lower 8 bits
+ * are used for 8 bit registers */
+void set_register(CPU_Register r, uint16_t val);
+
 
 #endif
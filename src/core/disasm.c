@@ -1,6 +1,7 @@
-#include <stdint.h>
+#include "disasm.h"
+
 #include <stdio.h>
-#include "mmu/memory.h"
+#include <string.h>
 
 static char const * const asm_instruction_set[UINT8_MAX+1] = { 
     "NOP", "LD BC,0x%X", "LD (BC),A", "INC BC", 
@@ -19,7 +20,7 @@ static char const * const asm_instruction_set[UINT8_MAX+1] = {
     "INC L", "DEC L", "LD L,0x%X", "CPL",
      
     "JR NC,0x%X", "LD SP,0x%X", "LD (HL-),A", "INC SP",
-    "INC (HL)", "DEC (HL)", "LD (HL),d8", "SCF",
+    "INC (HL)", "DEC (HL)", "LD (HL),0x%X", "SCF",
     "JR C,0x%X", "ADD HL,SP","LD A,(HL-)", "DEC SP",
     "INC A", "DEC A", "LD A,0x%X", "CCF",
 
@@ -73,14 +74,14 @@ static char const * const asm_instruction_set[UINT8_MAX+1] = {
     "RET C", "RETI", "JP C,0x%X", "NONE", 
     "CALL C,0x%X", "NONE", "SBC A,0x%X", "RST 18H",
 
-    "LDH (0x%X), A", "POP HL", "LD (C),A", "NONE",
+    "LDH (0x%X),A", "POP HL", "LD (C),A", "NONE",
     "NONE", "PUSH HL", "AND 0x%X", "RST 20H",
-    "ADD SP,0x%X", "JP (HL)", "LD (0x%X),A", "NONE",
+    "ADD SP,%X", "JP (HL)", "LD (0x%X),A", "NONE",
     "NONE", "NONE", "XOR 0x%X", "RST 28H",
     
     "LDH A,(0x%X)", "POP AF", "LD A,(C)", "DI",
     "NONE", "PUSH AF", "OR 0x%X", "RST 30H", 
-    "LD HL,SP+0x%X", "LD SP,HL", "LD A,(0x%X)", "EI",
+    "LD HL,SP%X", "LD SP,HL", "LD A,(0x%X)", "EI",
     "NONE", "NONE", "CP 0x%X", "RST 38H"
     
 };
@@ -88,7 +89,7 @@ static char const * const asm_instruction_set[UINT8_MAX+1] = {
 static char const * const asm_ext_instruction_set[UINT8_MAX+1] = {
 
     "RLC B", "RLC C", "RLC D", "RLC E", 
-    "RLC H", "RLD L", "RLC (HL)", "RLC A", 
+    "RLC H", "RLC L", "RLC (HL)", "RLC A", 
 
     "RRC B", "RRC C", "RRC D", "RRC E", 
     "RRC H", "RRC L", "RRC (HL)", "RRC A", 
@@ -170,7 +171,7 @@ static char const * const asm_ext_instruction_set[UINT8_MAX+1] = {
  *  All invallid instruction opcodes are given 1 word 
  *  All extended instructions are 2 bytes, 1 for 0xCB opcode
  *  and another for the specified extended opcode.*/
-static int ins_words[UINT8_MAX+1] = {
+static uint8_t const ins_words[UINT8_MAX+1] = {
 
     1,3,1,1,1,1,2,1,3,1,1,1,1,1,2,1,
     2,3,1,1,1,1,2,1,2,1,1,1,1,1,2,1,
@@ -191,26 +192,104 @@ static int ins_words[UINT8_MAX+1] = {
 };
 
 
-/* Send to specified stream the opcode of the instruction
- * at the specified memory location*/
-void dasm_instruction(uint16_t mem, FILE *stream) {
+unsigned instruction_length(uint8_t opcode) {
+    return ins_words[opcode];
+}
+
+
+// Where a jump, call or restart goes, DISASM_NO_TARGET for other instructions
+static int32_t branch_target(uint16_t addr, uint8_t const *bytes) {
+
+    uint8_t opcode = bytes[0];
+    switch (opcode) {
+        case 0x18: case 0x20: case 0x28: case 0x30: case 0x38:
+            return (uint16_t)(addr + 2 + (int8_t)bytes[1]);
+        case 0xC2: case 0xC3: case 0xCA: case 0xD2: case 0xDA:
+        case 0xC4: case 0xCC: case 0xCD: case 0xD4: case 0xDC:
+            return bytes[1] | (bytes[2] << 8);
+        case 0xC7: case 0xCF: case 0xD7: case 0xDF:
+        case 0xE7: case 0xEF: case 0xF7: case 0xFF:
+            return opcode & 0x38;
+        default:
+            return DISASM_NO_TARGET;
+    }
+}
 
-    uint8_t opcode = get_mem(mem);
-    
-    if (opcode == 0xCB) {
-        fprintf(stream,"%s",asm_ext_instruction_set[get_mem(mem+1)]);
 
+// Text of the operand value, with ?? for bytes that aren't known
+static void operand_value(uint8_t const *bytes, unsigned available,
+        unsigned length, int32_t target, char *value, size_t size) {
+
+    uint8_t opcode = bytes[0];
+    if (available < 2) {
+        snprintf(value, size, length == 3 ? "????" : "??");
+    } else if (target != DISASM_NO_TARGET && length == 2) {
+        snprintf(value, size, "%04X", (unsigned)target);
+    } else if (opcode == 0xE8 || opcode == 0xF8) {
+        int offset = (int8_t)bytes[1];
+        snprintf(value, size, "%c0x%02X", offset < 0 ? '-' : '+', (unsigned)(offset < 0 ? -offset : offset));
+    } else if (length == 2) {
+        snprintf(value, size, "%02X", bytes[1]);
+    } else if (available < 3) {
+        snprintf(value, size, "??%02X", bytes[1]);
     } else {
+        snprintf(value, size, "%04X", bytes[1] | (bytes[2] << 8));
+    }
+}
 
-        char const * const dasm_str = asm_instruction_set[opcode];
-        switch (ins_words[opcode]) {
-            case 1: fprintf(stream, dasm_str); break;
-            case 2: fprintf(stream, dasm_str, get_mem(mem+1)); break;
-            case 3: fprintf(stream, dasm_str, (get_mem(mem+2) << 8) 
-                | get_mem(mem+1)); break;
-            default: fprintf(stream, "error invalid opcode\n");
+
+void decode_instruction(uint16_t addr, uint8_t const *bytes, unsigned available, Disasm_Line *line) {
+
+    uint8_t opcode = bytes[0];
+    unsigned length = ins_words[opcode];
+
+    memset(line, 0, sizeof(Disasm_Line));
+    line->addr = addr;
+    line->bank = -1;
+    line->length = length;
+    memcpy(line->bytes, bytes, length < available ? length : available);
+    line->target = available >= length ? branch_target(addr, bytes) : DISASM_NO_TARGET;
+
+    char const *text = asm_instruction_set[opcode];
+    if (opcode == 0xCB) {
+        if (available < 2) {
+            snprintf(line->mnemonic, sizeof(line->mnemonic), "CB");
+            snprintf(line->operands, sizeof(line->operands), "??");
+            return;
         }
+        text = asm_ext_instruction_set[bytes[1]];
+    } else if (!strcmp(text, "NONE")) {
+        snprintf(line->mnemonic, sizeof(line->mnemonic), "DB");
+        snprintf(line->operands, sizeof(line->operands), "0x%02X", opcode);
+        return;
+    }
 
+    // Table entries are the mnemonic then the operands, with %X for the value
+    size_t mnemonic_length = strcspn(text, " ");
+    snprintf(line->mnemonic, sizeof(line->mnemonic), "%.*s", (int)mnemonic_length, text);
+    char const *operands = text + mnemonic_length + (text[mnemonic_length] == ' ');
+
+    char const *spec = strstr(operands, "%X");
+    if (spec == NULL) {
+        snprintf(line->operands, sizeof(line->operands), "%s", operands);
+        return;
     }
+    char value[16];
+    operand_value(bytes, available, length, line->target, value, sizeof(value));
+    snprintf(line->operands, sizeof(line->operands), "%.*s%s%s",
+        (int)(spec - operands), operands, value, spec + 2);
 }
 
+
+int format_instruction(Disasm_Line const *line, char *buf, size_t size) {
+
+    char const *space = line->operands[0] ? " " : "";
+    if (line->target_label == NULL) {
+        return snprintf(buf, size, "%s%s%s", line->mnemonic, space, line->operands);
+    }
+    if (line->target_offset) {
+        return snprintf(buf, size, "%s%s%s ; %s+0x%X", line->mnemonic, space, line->operands,
+            line->target_label, line->target_offset);
+    }
+    return snprintf(buf, size, "%s%s%s ; %s", line->mnemonic, space, line->operands, line->target_label);
+}
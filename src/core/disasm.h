@@ -1,10 +1,39 @@
 #ifndef DISASM_H
 #define DISASM_H
 
-#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
 
-/* Send to specified stream the opcode of the instruction
- * at the specified memory location*/
-void dasm_instruction(uint16_t mem, FILE const *stream);
+/* Decoding of single instructions from their bytes, independent of
+ * the emulator's memory so tools reading traces can use it too.
+ * disasm_memory.h disassembles what's in memory. */
 
-#endif //DISASM_H
+#define DISASM_NO_TARGET -1
+#define DISASM_MAX_LENGTH 3
+
+typedef struct {
+    uint16_t addr;
+    int bank;                      // ROM bank addr is in, or -1 outside of ROM
+    uint8_t length;                // Bytes the instruction takes
+    uint8_t bytes[DISASM_MAX_LENGTH];
+    char mnemonic[8];              // e.g. "LD", "DB" for invalid opcodes
+    char operands[24];             // e.g. "A,(0xFF44)", jump targets are absolute
+    int32_t target;                // Address jumped, called or restarted to, or DISASM_NO_TARGET
+    char const *label;             // Label at addr, or NULL
+    char const *target_label;      // Closest label at or before target, or NULL
+    uint16_t target_offset;        // How far target is past target_label
+} Disasm_Line;
+
+// Bytes taken by the instruction starting with the given opcode
+unsigned instruction_length(uint8_t opcode);
+
+/* Decode the instruction at addr from its bytes, of which available
+ * are known. Operand bytes not available are shown as ??.
+ * bank is set to -1 and labels to NULL for the caller to fill in */
+void decode_instruction(uint16_t addr, uint8_t const *bytes, unsigned available, Disasm_Line *line);
+
+/* Write the instruction as text, with the label of its target if it has one.
+ * returns the length of the text as snprintf does */
+int format_instruction(Disasm_Line const *line, char *buf, size_t size);
+
+#endif /* DISASM_H */
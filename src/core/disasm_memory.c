@@ -0,0 +1,241 @@
+#include "disasm_memory.h"
+#include "symbols.h"
+#include "mmu/memory.h"
+#include "mmu/mbc.h"
+#include "mmu/rom_cache.h"
+
+#include "../non_core/logger.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define REGION_SIZE 0x4000
+#define CACHE_REGIONS 4 // ~1MB each
+
+typedef struct {
+    int valid;
+    int bank;                 // ROM bank held, or -1
+    uint16_t start;
+    unsigned long last_used;
+    uint8_t bytes[REGION_SIZE + DISASM_MAX_LENGTH - 1]; // Bytes after the region end the last instruction
+    Disasm_Line *lines;       // Decoded from the start of the region
+    unsigned count;
+    uint16_t *line_at;        // Index + 1 of the line starting at each offset, 0 if none
+} Region;
+
+static Region regions[CACHE_REGIONS];
+static unsigned long use_count;
+
+// Read without side effects on IO registers
+static uint8_t peek(uint16_t addr) {
+    if (addr >= 0xFF00 && addr < 0xFF80) {
+        return 0xFF;
+    }
+    return peek_mem(addr);
+}
+
+
+// 1 if the given bank isn't the one mapped in at start
+static int unmapped(int bank, uint16_t start) {
+    return start < 0x8000 && bank != DISASM_CURRENT_BANK && bank != mapped_rom_bank(start);
+}
+
+
+/* Read what's at start into bytes, from ROM directly if the bank asked
+ * for isn't the one mapped in. returns 0 if it can't be read */
+static int read_region(int bank, uint16_t start, uint8_t *bytes) {
+
+    unsigned i = 0;
+    if (unmapped(bank, start)) {
+        // Fetching a bank through the cache could evict one mapped in
+        if (ROM_paged || ROM_banks == NULL || (unsigned)bank >= ROM_bank_count) {
+            return 0;
+        }
+        memcpy(bytes, ROM_banks + (unsigned long)bank * ROM_BANK_SIZE, ROM_BANK_SIZE);
+        i = REGION_SIZE;
+    }
+    for (; i < REGION_SIZE + DISASM_MAX_LENGTH - 1; i++) {
+        bytes[i] = peek(start + i);
+    }
+    return 1;
+}
+
+
+static void decode_region(Region *region) {
+
+    memset(region->line_at, 0, REGION_SIZE * sizeof(uint16_t));
+    region->count = 0;
+    for (unsigned offset = 0; offset < REGION_SIZE; ) {
+        Disasm_Line *line = &region->lines[region->count];
+        decode_instruction(region->start + offset, region->bytes + offset, DISASM_MAX_LENGTH, line);
+        line->bank = region->bank;
+        region->line_at[offset] = ++region->count;
+        offset += line->length;
+    }
+}
+
+
+static int alloc_region(Region *region) {
+
+    if (region->lines) {
+        return 1;
+    }
+    region->lines = malloc(REGION_SIZE * sizeof(Disasm_Line));
+    region->line_at = malloc(REGION_SIZE * sizeof(uint16_t));
+    if (!region->lines || !region->line_at) {
+        log_message(LOG_ERROR, "Unable to allocate disassembly cache\n");
+        free(region->lines);
+        free(region->line_at);
+        region->lines = NULL;
+        region->line_at = NULL;
+        return 0;
+    }
+    return 1;
+}
+
+
+/* Decoded region at start, from the cache if memory hasn't changed
+ * since, otherwise replacing the least recently used region */
+static Region *get_region(int bank, uint16_t start) {
+
+    static uint8_t bytes[REGION_SIZE + DISASM_MAX_LENGTH - 1];
+    if (!read_region(bank, start, bytes)) {
+        return NULL;
+    }
+    if (bank == DISASM_CURRENT_BANK || start >= 0x8000) {
+        bank = start < 0x8000 ? mapped_rom_bank(start) : -1;
+    }
+
+    Region *region = &regions[0];
+    for (int i = 0; i < CACHE_REGIONS; i++) {
+        if (regions[i].valid && regions[i].start == start && regions[i].bank == bank) {
+            region = &regions[i];
+            break;
+        }
+        if (!regions[i].valid || regions[i].last_used < region->last_used) {
+            region = &regions[i];
+        }
+    }
+    region->last_used = ++use_count;
+
+    if (region->valid && region->start == start && region->bank == bank &&
+            !memcmp(region->bytes, bytes, sizeof(bytes))) {
+        return region;
+    }
+    if (!alloc_region(region)) {
+        return NULL;
+    }
+    memcpy(region->bytes, bytes, sizeof(bytes));
+    region->start = start;
+    region->bank = bank;
+    region->valid = 1;
+    decode_region(region);
+    return region;
+}
+
+
+// Bank a target address is in, seen from the line jumping to it
+static int target_bank(Disasm_Line const *line) {
+
+    uint16_t target = line->target;
+    if (target < 0x4000) {
+        return 0;
+    }
+    if (target < 0x8000) {
+        return line->addr >= 0x4000 && line->addr < 0x8000 ? line->bank : mapped_rom_bank(target);
+    }
+    return 0;
+}
+
+
+static void add_labels(Disasm_Line *line) {
+
+    uint16_t offset;
+    char const *label = find_symbol(line->bank < 0 ? 0 : line->bank, line->addr, &offset);
+    line->label = label && offset == 0 ? label : NULL;
+
+    line->target_label = NULL;
+    line->target_offset = 0;
+    if (line->target != DISASM_NO_TARGET) {
+        int bank = target_bank(line);
+        line->target_label = find_symbol(bank < 0 ? 0 : bank, line->target, &line->target_offset);
+    }
+}
+
+
+unsigned disassemble(int bank, uint16_t addr, unsigned count, Disasm_Line *lines) {
+
+    unsigned done = 0;
+    unsigned long next = addr;
+    while (done < count && next <= 0xFFFF) {
+        uint16_t start = next & ~(REGION_SIZE - 1);
+        int region_bank = start == 0x4000 ? bank : DISASM_CURRENT_BANK;
+        Region *region = get_region(region_bank, start);
+        if (region == NULL) {
+            break;
+        }
+
+        unsigned offset = next - start;
+        for (; done < count && offset < REGION_SIZE; done++) {
+            Disasm_Line *line = &lines[done];
+            unsigned index = region->line_at[offset];
+            if (index) {
+                *line = region->lines[index - 1];
+            } else {
+                decode_instruction(start + offset, region->bytes + offset, DISASM_MAX_LENGTH, line);
+                line->bank = region->bank;
+            }
+            add_labels(line);
+            offset += line->length;
+        }
+        next = start + offset;
+
+        // Carrying on past a bank not mapped in would show the wrong bytes
+        if (unmapped(region_bank, start)) {
+            break;
+        }
+    }
+    return done;
+}
+
+
+unsigned disassemble_bank(unsigned bank, Disasm_Line *lines) {
+
+    Region *region = get_region(bank, bank == 0 ? 0x0000 : 0x4000);
+    if (region == NULL) {
+        return 0;
+    }
+    memcpy(lines, region->lines, region->count * sizeof(Disasm_Line));
+    for (unsigned i = 0; i < region->count; i++) {
+        add_labels(&lines[i]);
+    }
+    return region->count;
+}
+
+
+void clear_disasm_cache() {
+
+    for (int i = 0; i < CACHE_REGIONS; i++) {
+        free(regions[i].lines);
+        free(regions[i].line_at);
+    }
+    memset(regions, 0, sizeof(regions));
+    use_count = 0;
+}
+
+
+/* Send to specified stream the opcode of the instruction
+ * at the specified memory location*/
+void dasm_instruction(uint16_t mem, FILE *stream) {
+
+    uint8_t bytes[DISASM_MAX_LENGTH];
+    for (unsigned i = 0; i < DISASM_MAX_LENGTH; i++) {
+        bytes[i] = peek(mem + i);
+    }
+    Disasm_Line line;
+    decode_instruction(mem, bytes, DISASM_MAX_LENGTH, &line);
+
+    char text[64];
+    format_instruction(&line, text, sizeof(text));
+    fprintf(stream, "%s", text);
+}
@@ -0,0 +1,41 @@
+#ifndef DISASM_MEMORY_H
+#define DISASM_MEMORY_H
+
+#include "disasm.h"
+
+#include <stdint.h>
+#include <stdio.h>
+
+/* Disassembly of the emulator's memory in bulk.
+ *
+ * Each 16KB region of the address space, per ROM bank for 0x4000 -
+ * 0x7FFF, is decoded once from its start and the lines kept in a small
+ * cache. Cached regions are compared against memory before use and
+ * decoded again if anything has changed, so code written to RAM and
+ * cheats show up without the emulator having to track writes. Ranges
+ * starting partway through an instruction of the decoded region are
+ * decoded as given until they line up with it again.
+ *
+ * Labels are looked up from the loaded symbols as lines are returned.
+ * IO registers 0xFF00 - 0xFF7F aren't read, they're shown as 0xFF. */
+
+#define DISASM_CURRENT_BANK -1 // Whichever bank is mapped in
+
+/* Disassemble count instructions from addr, in the given ROM bank if addr
+ * is in 0x4000 - 0x7FFF. Stops at the end of the address space, or the
+ * end of the bank if it isn't mapped in.
+ * returns the number of lines written to lines */
+unsigned disassemble(int bank, uint16_t addr, unsigned count, Disasm_Line *lines);
+
+/* Disassemble the whole of the given ROM bank, lines must hold
+ * ROM_BANK_SIZE lines. returns the number written */
+unsigned disassemble_bank(unsigned bank, Disasm_Line *lines);
+
+// Free the cache, memory contents are no longer valid after this
+void clear_disasm_cache();
+
+/* Send to specified stream the opcode of the instruction
+ * at the specified memory location*/
+void dasm_instruction(uint16_t mem, FILE *stream);
+
+#endif /* DISASM_MEMORY_H */
@@ -9,7 +9,17 @@
 #include "sound.h"
 #include "emu.h"
 #include "serial_io.h"
+#include "rom_archive.h"
+#include "cheats.h"
+#include "breakpoints.h"
+#include "profiler.h"
+#include "trace.h"
+#include "instrument.h"
+#include "disasm_memory.h"
+#include "movie.h"
+#include "input.h"
 #include <stdio.h>
+#include <string.h>
 
 #include "../non_core/joypad.h"
 #include "../non_core/files.h"
@@ -54,7 +64,37 @@ int halted = 0;
 // Debug options
 int debug = 0;
 int step_count = STEPS_OFF;
-int breakpoint = BREAKPOINT_OFF;
+
+// Read the 0x50 byte cartridge header at 0x100 of the ROM file
+static int read_rom_header(const char *file_path, uint8_t rom_header[0x50]) {
+
+    // Only the start of a compressed ROM needs decompressing
+    if (is_rom_archive(file_path)) {
+        uint8_t rom_start[0x150];
+        if (read_archive_header(file_path, rom_start, sizeof(rom_start)) != sizeof(rom_start)) {
+            log_message(LOG_ERROR, "Error reading ROM header info\n");
+            return 0;
+        }
+        memcpy(rom_header, rom_start + 0x100, 0x50);
+        return 1;
+    }
+
+    FILE *file;
+    if (!(file = PB_FOPEN(file_path,"rb"))) {
+        log_message(LOG_ERROR, "Error opening file %s\n", file_path);
+        return 0;
+    }
+
+    if ((PB_FSEEK(file, 0x100, SEEK_SET) != 0) 
+        || (PB_FREAD(rom_header, 1, 0x50, file) != 0x50)) {
+        log_message(LOG_ERROR, "Error reading ROM header info\n");
+        fclose(file);
+        return 0;    
+    };
+    PB_FCLOSE(file);
+    return 1;
+}
+
 
 /* Intialize emulator with given ROM file, and
  * specify whether or not debug mode is active
@@ -70,19 +110,9 @@ int init_emu(const char *file_path, int debugger, int dmg_mode, ClientOrServer c
     set_log_level(LOG_INFO);
     
     log_message(LOG_INFO, "About to open file %s\n", file_path);
-    FILE *file;
-    if (!(file = PB_FOPEN(file_path,"rb"))) {
-        log_message(LOG_ERROR, "Error opening file %s\n", file_path);
+    if (!read_rom_header(file_path, rom_header)) {
         return 0;
     }
-
-    if ((PB_FSEEK(file, 0x100, SEEK_SET) != 0) 
-        || (PB_FREAD(rom_header, 1, sizeof(rom_header), file) != sizeof(rom_header))) {
-        log_message(LOG_ERROR, "Error reading ROM header info\n");
-        fclose(file);
-        return 0;    
-    };
-    PB_FCLOSE(file);
     
 	log_message(LOG_INFO, "ROM Header loaded %s\n", file_path);
     
@@ -140,6 +170,7 @@ int init_emu(const char *file_path, int debugger, int dmg_mode, ClientOrServer c
 static long current_cycles;
 static int skip_bug = 0;
 static long cycles = 0;
+static int resumed = 0; // Returned from the debugger at the current instruction
 
 
 void add_current_cycles(unsigned c) {
@@ -148,11 +179,9 @@ void add_current_cycles(unsigned c) {
 }
 
 
-// Draws one frame then returns
-void run_one_frame() {
-    frame_drawn = 0;
+// Run one instruction, or idle while halted or stopped
+static inline void step_emu() {
 
-    while (!frame_drawn) {
         if (halted || stopped) {
             long current_cycles = cgb_speed ? 2 : 4;
             update_timers(current_cycles*2);
@@ -161,7 +190,7 @@ void run_one_frame() {
 
             // If Key pressed in "stop" mode, then gameboy is "unstopped"
             if (stopped) {
-                if(key_pressed()) {
+                if(input_keys != 0) {
                     stopped = 0;
                 }
             }
@@ -177,32 +206,139 @@ void run_one_frame() {
         }
 
         cycles += current_cycles;
-      
-		#ifdef EFIAPI
-        if (cycles > 3000) {
-		#else
-		if (cycles > 15000) {
-		#endif
-            quit |= update_keys();
+
+        /* Poll once a frame at the poll line, or a frame's worth of
+         * cycles after the last poll while the LCD is off */
+        if (input_poll_pending || (cycles >= INPUT_POLL_CYCLES && !screen_enabled())) {
+            input_poll_pending = 0;
+            quit |= poll_input();
             cycles = 0;
+            if (SRAM_mapped) {
+                sync_SRAM(0);
+            }
         }
         skip_bug = handle_interrupts();
+}
+
 
-        if (debug && step_count > 0 && --step_count == 0) {
-            int flags = get_command();
-            step_count = (flags & STEPS_SET) ? get_steps() : STEPS_OFF;
+/* Same as step_emu, also calling the profiler's and trace's hooks. Kept
+ * out of step_emu so frames run without them don't check for them */
+static void step_instrumented() {
+    if (tracing && !(halted || stopped)) {
+        trace_instruction();
+    }
+    step_emu();
+    if (profiling) {
+        profile_cycles(current_cycles);
+    }
+    if (tracing) {
+        trace_cycles(current_cycles);
+    }
+}
+
+
+// Get debugger commands, until continuing or stepping
+static void enter_debugger() {
+    int flags = get_command();
+    step_count = (flags & STEPS_SET) ? get_steps() : STEPS_OFF;
+
+    // Shut down normally, so saves are still flushed
+    if (flags & QUIT) {
+        quit = 1;
+    }
+
+    // Debuggers which only keep a single breakpoint
+    if ((flags & BREAKPOINT_SET) && get_breakpoint() >= 0) {
+        add_breakpoint(get_breakpoint(), ANY_BANK, NULL);
+        turn_breakpoint_off();
+    }
+}
+
+
+static void report_hit(Break_Hit const *hit) {
+    if (tracing) {
+        trigger_trace(hit->flags == 0 ? "breakpoint" : "watchpoint");
+    }
+    if (hit->flags == 0) {
+        log_message(LOG_INFO, "Breakpoint at %02X:%04X\n", hit->bank < 0 ? 0 : hit->bank, hit->addr);
+    } else {
+        log_message(LOG_INFO, "Watchpoint %s of %04X at PC %04X\n",
+            hit->flags & WATCH_WRITE ? "write" : "read", hit->addr, get_register(REG_PC));
+    }
+}
+
+
+/* Same as run_one_frame, checking breakpoints and steps
+ * before and after each instruction */
+static void run_one_debug_frame() {
+
+    Break_Hit hit;
+    while (!frame_drawn && !quit) {
+        if (!(halted || stopped)) {
+            // Don't break again on the instruction just stopped at
+            if (!resumed && check_breakpoints(get_register(REG_PC), &hit)) {
+                report_hit(&hit);
+                enter_debugger();
+                resumed = 1;
+                continue;
+            }
+            resumed = 0;
+        }
+
+        step_instrumented();
+
+        if (step_count > 0 && --step_count == 0) {
+            enter_debugger();
+            resumed = 1;
         }
     }
+}
+
+
+// Same as run_one_frame, profiling or tracing each instruction
+static void run_one_instrumented_frame() {
+    while (!frame_drawn) {
+        step_instrumented();
+    }
+}
+
+
+// Draws one frame then returns
+void run_one_frame() {
+    frame_drawn = 0;
+
+    if (movie_mode && !movie_frame_start()) {
+        quit = 1;
+        return;
+    }
+
+    if (debug && check_debug_break()) {
+        enter_debugger();
+        resumed = 1;
+    }
 
+    // Debugging checks are kept out of the normal loop
+    if (debug && (step_count > 0 || breakpoints_armed)) {
+        run_one_debug_frame();
+    } else if (profiling || tracing) {
+        run_one_instrumented_frame();
+    } else {
+        while (!frame_drawn) {
+            step_emu();
+        }
+    }
+
+    // Once per VBlank
+    apply_gameshark_codes();
+    instrument_frame();
+    if (movie_mode && !movie_frame_end()) {
+        quit = 1;
+    }
 }
 
 void setup_debug() {
     if (debug) {
-        int flags = get_command();
-        step_count = (flags & STEPS_SET) ?  get_steps() : STEPS_OFF;
-
-        breakpoint =  (flags & BREAKPOINT_SET) ?
-                      get_breakpoint() : BREAKPOINT_OFF;
+        enter_debugger();
     }
 
 
@@ -215,8 +351,12 @@ void run() {
     while(!quit) {
         run_one_frame();
     }
+    flush_SRAM();
 }
 
 void finalize_emu() {
+    clear_cheats();
+    clear_breakpoints();
+    clear_disasm_cache();
     teardown_memory();
 }
@@ -11,10 +11,15 @@
 #include "sprite_priorities.h"
 #include "bits.h"
 #include "rom_info.h"
+#include "render_thread.h"
+#include "instrument.h"
 
 #include "../non_core/graphics_out.h"
 #include "../non_core/framerate.h"
 #include "../non_core/logger.h"
+#include "../non_core/get_time.h"
+#include "../non_core/shm_output.h"
+#include "../non_core/recorder.h"
 
 #ifdef PSVITA
 #define VITA_PIX_X 960
@@ -33,11 +38,31 @@ static uint32_t rendered_sprite_palette[0x20];
 
 static uint8_t row;
 static uint8_t lcd_ctrl;
-static uint8_t *bg_palette;
-static uint8_t *sprite_palette;
+
+// Registers and memory the line currently being rendered is drawn from
+static Line_Regs const *cur_line;
+static Render_Source const *src;
+
+// Source reading straight from Gameboy memory
+static Render_Source live_source;
+static uint8_t live_sprite_order[MAX_SPRITES];
+static unsigned live_sprite_order_version;
 
 int frame_drawn = 0;
 
+/* Frame skipping, a skipped frame still runs through all the LCD
+ * timing (LY, STAT, interrupts, HDMA) but no pixels are generated
+ * and nothing is sent to the screen */
+#define MAX_AUTO_FRAME_SKIP 4
+#define FRAME_TIME_MICRO (10000000 / DEFAULT_FPS_TIMES_10)
+
+static int frame_skip = 0; // Frames to skip after each drawn frame
+static int auto_frame_skip = 0; // Skip frames when behind real time
+static int skip_current_frame = 0;
+static int frames_skipped = 0;
+static uint64_t last_frame_time = 0; // in ms
+static int64_t time_behind = 0; // in micro seconds
+
 static void refresh_gbc_bg_palettes();
 static void refresh_gbc_sprite_palettes();
 
@@ -47,10 +72,14 @@ typedef struct {uint8_t red; uint8_t green; uint8_t blue;} GBC_color;
 int init_gfx() {
    
     start_framerate(DEFAULT_FPS_TIMES_10); 
-    bg_palette = get_bg_palette();
-    sprite_palette = get_sprite_palette();
-    refresh_gbc_bg_palettes();
-    refresh_gbc_sprite_palettes();
+    live_source.vram[0] = get_vram_bank(0);
+    live_source.vram[1] = get_vram_bank(1);
+    live_source.oam = oam_mem_ptr;
+    live_source.bg_palette = get_bg_palette();
+    live_source.sprite_palette = get_sprite_palette();
+    live_source.bg_palette_dirty = &bg_palette_dirty;
+    live_source.sprite_palette_dirty = &sprite_palette_dirty;
+    live_source.sprite_order = live_sprite_order;
 
 #ifdef PSVITA //VITA
 	int result = init_screen(VITA_PIX_X, VITA_PIX_Y, rgb_pixels);
@@ -58,10 +87,16 @@ int init_gfx() {
     int result = init_screen(GB_PIXELS_X, GB_PIXELS_Y, rgb_pixels);
 #endif    
 	init_sprite_prio_list();    
+    get_sprite_prio_order(live_sprite_order);
+    live_sprite_order_version = sprite_prio_version;
         
     return result;
 }
 
+static inline uint8_t read_vram(uint16_t addr, int bank) {
+    return src->vram[bank][addr - 0x8000];
+}
+
 static uint32_t cgb_color_to_rgb(uint16_t c) {
     uint8_t red =   ((c & 0x1F) * 255) / 31;
     uint8_t green = (((c >> 5) & 0x1F) * 255) / 31;  
@@ -72,7 +107,8 @@ static uint32_t cgb_color_to_rgb(uint16_t c) {
 
 static void refresh_gbc_bg_palettes() {
 
-    if (bg_palette_dirty) {
+    if (*src->bg_palette_dirty) {
+        uint8_t const *bg_palette = src->bg_palette;
    
         for (int i = 0; i < 0x20; i++) {
             // Obtain 15 bit gameboy color for background palette
@@ -80,13 +116,14 @@ static void refresh_gbc_bg_palettes() {
             rendered_bg_palette[i] = cgb_color_to_rgb(gb_color);
         }
     
-        bg_palette_dirty = false;
+        *src->bg_palette_dirty = false;
     }
 }
 
 static void refresh_gbc_sprite_palettes() {
 
-    if (sprite_palette_dirty) {
+    if (*src->sprite_palette_dirty) {
+        uint8_t const *sprite_palette = src->sprite_palette;
    
         for (int i = 0; i < 0x20; i++) {
             // Obtain 15 bit gameboy color for sprite palette
@@ -94,13 +131,13 @@ static void refresh_gbc_sprite_palettes() {
             rendered_sprite_palette[i] = cgb_color_to_rgb(gb_color);
         }
     
-        sprite_palette_dirty = false;
+        *src->sprite_palette_dirty = false;
     }
 }
 
 // Convert dot matrix gameboy's 2 bit color into a 15bit color
 static uint32_t get_dmg_sprite_col(int c, int palette_no) {
-    if (cgb) {
+    if (cur_line->cgb) {
         return rendered_sprite_palette[(palette_no * 4) +  c];    
     }
     switch (c) {
@@ -113,7 +150,7 @@ static uint32_t get_dmg_sprite_col(int c, int palette_no) {
 }
 
 static uint32_t get_dmg_bg_col(int c) {
-    if (cgb) {
+    if (cur_line->cgb) {
         return rendered_bg_palette[c];
     }
     switch (c) {
@@ -134,8 +171,8 @@ static void draw_sprite_row() {
     // 8x16 or 8x8
     int height = lcd_ctrl & BIT_2 ? 16 : 8;
 
-    uint8_t obp_0 = io_mem[OBP0_REG]; 
-    uint8_t obp_1 = io_mem[OBP1_REG]; 
+    uint8_t obp_0 = cur_line->obp0; 
+    uint8_t obp_1 = cur_line->obp1; 
     int palletes[2][4];
 
     //Calculate both color palletes
@@ -149,17 +186,17 @@ static void draw_sprite_row() {
     palletes[1][2] = (obp_1 >> 4) & 0x3;
     palletes[1][3] = (obp_1 >> 6) & 0x3;
 
-    Sprite_Iterator si = create_sprite_iterator();
-    int sprite_no;
+    uint8_t const *oam = src->oam;
     int sprite_count = 0;
     int sprite_nos[10];
 
     /*40 Sprites, loop through from least priority to most priority
       limited to 10 a line */
-    while((sprite_no = sprite_iterator_next(&si)) != -1 && sprite_count < 10)  {
+    for (int i = 0; i < MAX_SPRITES && sprite_count < 10; i++)  {
+        int sprite_no = src->sprite_order[i];
         
-        int16_t y_pos = oam_get_mem((sprite_no * 4)) - 16;
-        int16_t x_pos = oam_get_mem((sprite_no * 4) + 1) - 8;
+        int16_t y_pos = oam[(sprite_no * 4)] - 16;
+        int16_t x_pos = oam[(sprite_no * 4) + 1] - 8;
         
         //If sprite doesn't intersect current line, no need to draw
         if (y_pos > row || row >= y_pos + height || x_pos >= 160) {
@@ -173,10 +210,10 @@ static void draw_sprite_row() {
     for (int i = sprite_count - 1; i >= 0; i--) {
          int sprite_no  = sprite_nos[i];
 
-         int16_t y_pos = oam_get_mem((sprite_no * 4)) - 16;
-         int16_t x_pos = oam_get_mem((sprite_no * 4) + 1) - 8;
-         uint8_t tile_no = oam_get_mem((sprite_no * 4) + 2);
-         uint8_t attributes = oam_get_mem((sprite_no * 4) + 3);
+         int16_t y_pos = oam[(sprite_no * 4)] - 16;
+         int16_t x_pos = oam[(sprite_no * 4) + 1] - 8;
+         uint8_t tile_no = oam[(sprite_no * 4) + 2];
+         uint8_t attributes = oam[(sprite_no * 4) + 3];
     
         
          if (height == 16) {
@@ -189,9 +226,9 @@ static void draw_sprite_row() {
         
         int v_bank = 0;
         int cgb_palette_number = 0;
-        if (cgb) {
+        if (cur_line->cgb) {
            
-            if (is_booting || cgb_features) {
+            if (cur_line->cgb_features) {
                 cgb_palette_number = attributes & 0x7;
                 v_bank = !!(attributes & BIT_3);
             }            
@@ -210,8 +247,8 @@ static void draw_sprite_row() {
         // need to obtain row relative to bottom of sprite
         uint8_t line =  (!y_flip) ? row - y_pos  : height + y_pos - row -1;
         uint16_t line_offset = 2 * line;
-        uint8_t high_byte = get_vram(tile_loc + line_offset, v_bank);
-        uint8_t low_byte =  get_vram(tile_loc + line_offset + 1, v_bank);
+        uint8_t high_byte = read_vram(tile_loc + line_offset, v_bank);
+        uint8_t low_byte =  read_vram(tile_loc + line_offset + 1, v_bank);
 
         int pal_no = (attributes & BIT_4) ? 1 : 0;
         
@@ -233,7 +270,7 @@ static void draw_sprite_row() {
             uint8_t final_color_id = palletes[pal_no][color_id]; 
             if (!sprite_prio) {
                 if (color_id != 0 && (!cgb_bg_prio[row][x_pos + x] && !old_buffer[row][x_pos + x])) {
-                    if (!cgb || !(is_booting || cgb_features)) {
+                    if (!cur_line->cgb || !cur_line->cgb_features) {
                        rgb_pixels[(row * GB_PIXELS_X) + x_pos + x] = rendered_sprite_palette[(pal_no * 4) + final_color_id];
                        old_buffer[row][x_pos + x] = color_id;
                    } else {                        
@@ -242,8 +279,8 @@ static void draw_sprite_row() {
                    }
                 }               
             } else  {
-                if (color_id != 0 && (!cgb || (!cgb_bg_prio[row][x_pos + x] || !old_buffer[row][x_pos + x]))) {
-                    if (!cgb || !(is_booting || cgb_features)) {
+                if (color_id != 0 && (!cur_line->cgb || (!cgb_bg_prio[row][x_pos + x] || !old_buffer[row][x_pos + x]))) {
+                    if (!cur_line->cgb || !cur_line->cgb_features) {
                        rgb_pixels[(row * GB_PIXELS_X) + x_pos + x] = get_dmg_sprite_col(final_color_id, pal_no);
                        old_buffer[row][x_pos + x] = color_id;
                    } else {
@@ -262,7 +299,7 @@ static void draw_sprite_row() {
 
 static void draw_tile_window_row(uint16_t tile_mem, uint16_t bg_mem) {
    
-    uint8_t bgp = io_mem[BGP_REF];
+    uint8_t bgp = cur_line->bgp;
     int pallete[4];
     //Calculate color pallete
     pallete[0] =  bgp  & 0x3;
@@ -270,15 +307,15 @@ static void draw_tile_window_row(uint16_t tile_mem, uint16_t bg_mem) {
     pallete[2] = (bgp >> 4) & 0x3;
     pallete[3] = (bgp >> 6) & 0x3;
     
-    uint8_t win_y = io_mem[WY_REG];//window_line;
+    uint8_t win_y = cur_line->wy;//window_line;
     int16_t y_pos = row - win_y; // Get line 0 - 255 being drawn    
     uint16_t tile_row = (y_pos >> 3); // Get row 0 - 31 of tile
     
     /* WX_REG values < 7 are treated as WX_REG = 7, fixes clipping
      * of the podracer in star wars episode 1 - racer */
-    int16_t win_x = io_mem[WX_REG] < 7 ? 0 : io_mem[WX_REG] - 7;
+    int16_t win_x = cur_line->wx < 7 ? 0 : cur_line->wx - 7;
    
-    if (win_x > 159 || io_mem[WY_REG] > 143 || row < win_y) {
+    if (win_x > 159 || cur_line->wy > 143 || row < win_y) {
         return;
     }
     
@@ -302,17 +339,17 @@ static void draw_tile_window_row(uint16_t tile_mem, uint16_t bg_mem) {
      
         int x_pos = start_x - win_x;
         int tile_col = (x_pos) >> 3;
-        int tile_no = get_vram0(bg_mem + (tile_row << 5)  + tile_col);
+        int tile_no = read_vram(bg_mem + (tile_row << 5)  + tile_col, 0);
         
         int tile_attributes = 0;
         int palette_no = 0;
         int tile_vram_bank_no = 0;        
         int bg_prio = 0;
 
-        if (cgb) {
-            tile_attributes = get_vram(bg_mem + (tile_row << 5) + tile_col, 1);
+        if (cur_line->cgb) {
+            tile_attributes = read_vram(bg_mem + (tile_row << 5) + tile_col, 1);
 
-            if (is_booting || cgb_features) {
+            if (cur_line->cgb_features) {
                 palette_no = tile_attributes & 0x7;
                 tile_vram_bank_no = !!(tile_attributes & BIT_3);                
                  bg_prio = tile_attributes & BIT_7;
@@ -335,8 +372,8 @@ static void draw_tile_window_row(uint16_t tile_mem, uint16_t bg_mem) {
         int line_offset = (y_pos % 8) * 2; //Offset into tile of our line
         
 
-        int byte0 = get_vram(tile_loc + line_offset, tile_vram_bank_no);
-        int byte1 = get_vram(tile_loc + line_offset + 1, tile_vram_bank_no);
+        int byte0 = read_vram(tile_loc + line_offset, tile_vram_bank_no);
+        int byte1 = read_vram(tile_loc + line_offset + 1, tile_vram_bank_no);
        
          
         // If Horizontal flip flag set in CGB mode
@@ -350,7 +387,7 @@ static void draw_tile_window_row(uint16_t tile_mem, uint16_t bg_mem) {
                 int bit_0 = (byte0 >> (horiz_flip ? j : (7 - j))) & 0x1;
                 int color_id = (bit_1 << 1) | bit_0;
 
-                if (!cgb || !(is_booting || cgb_features)) {
+                if (!cur_line->cgb || !cur_line->cgb_features) {
                     rgb_pixels[(row * GB_PIXELS_X) + (i + j)] = get_dmg_bg_col(pallete[color_id]); 
                     old_buffer[row][i + j] = color_id;
                 } else {
@@ -366,7 +403,7 @@ static void draw_tile_window_row(uint16_t tile_mem, uint16_t bg_mem) {
 
 //Render the supplied row with background tiles
 static void draw_tile_bg_row(uint16_t tile_mem, uint16_t bg_mem) {
-    uint8_t bgp = io_mem[BGP_REF];
+    uint8_t bgp = cur_line->bgp;
     int pallete[4];
     //Calculate color pallete
     pallete[0] =  bgp  & 0x3;
@@ -374,9 +411,9 @@ static void draw_tile_bg_row(uint16_t tile_mem, uint16_t bg_mem) {
     pallete[2] = (bgp >> 4) & 0x3;
     pallete[3] = (bgp >> 6) & 0x3;
     
-    uint8_t y_pos = row + io_mem[SCROLL_Y_REG];  
+    uint8_t y_pos = row + cur_line->scy;  
     int tile_row = y_pos >> 3; // Get row 0 - 31 of tile
-    uint8_t scroll_x = io_mem[SCROLL_X_REG];
+    uint8_t scroll_x = cur_line->scx;
    
     int skew_left = scroll_x & 0x7;
     int skew_right = (8 - skew_left) & 0x7;
@@ -387,17 +424,17 @@ static void draw_tile_bg_row(uint16_t tile_mem, uint16_t bg_mem) {
 
         uint8_t x_pos = i + scroll_x;
         int tile_col = x_pos >> 3;
-        int tile_no = get_vram0(bg_mem + (tile_row << 5) + tile_col);
+        int tile_no = read_vram(bg_mem + (tile_row << 5) + tile_col, 0);
 
         int tile_attributes = 0;
         int palette_no = 0;
         int tile_vram_bank_no = 0;
         int bg_prio = 0;
 
-        if (cgb) {
-            tile_attributes = get_vram1(bg_mem + (tile_row << 5) + tile_col);
+        if (cur_line->cgb) {
+            tile_attributes = read_vram(bg_mem + (tile_row << 5) + tile_col, 1);
             
-            if (is_booting || cgb_features) {
+            if (cur_line->cgb_features) {
                 palette_no = tile_attributes & 0x7;
                 tile_vram_bank_no = !!(tile_attributes & BIT_3);           
                 bg_prio = tile_attributes & BIT_7;
@@ -422,8 +459,8 @@ static void draw_tile_bg_row(uint16_t tile_mem, uint16_t bg_mem) {
         int tile_loc = tile_mem + (tile_no * 16); //Location of tile in memory
         int line_offset = (vert_flip ? (7 - (y_pos & 0x7)) : (y_pos & 0x7)) << 1; //Offset into tile of our line
             
-        int byte0 = get_vram(tile_loc + line_offset, tile_vram_bank_no);
-        int byte1 = get_vram(tile_loc + line_offset + 1, tile_vram_bank_no);
+        int byte0 = read_vram(tile_loc + line_offset, tile_vram_bank_no);
+        int byte1 = read_vram(tile_loc + line_offset + 1, tile_vram_bank_no);
 
 
         // If Horizontal flip flag set in CGB mode
@@ -438,7 +475,7 @@ static void draw_tile_bg_row(uint16_t tile_mem, uint16_t bg_mem) {
                 int bit_0 = (byte0 >> (horiz_flip ? j : (7 - j))) & 0x1;
                 int color_id = (bit_1 << 1) | bit_0;
 
-                if (!cgb || !(is_booting || cgb_features)) {
+                if (!cur_line->cgb || !cur_line->cgb_features) {
                     rgb_pixels[(GB_PIXELS_X * row) + (i + j)] = get_dmg_bg_col(pallete[color_id]); 
                     old_buffer[row][i + j] = color_id;
                 } else {
@@ -461,7 +498,7 @@ static void draw_tile_bg_row(uint16_t tile_mem, uint16_t bg_mem) {
 
 static void draw_tile_row() {
  
-    uint8_t win_y_pos = io_mem[WY_REG];
+    uint8_t win_y_pos = cur_line->wy;
 
     uint16_t tile_mem; // Either tile set 0 or 1
 
@@ -482,37 +519,160 @@ static void draw_tile_row() {
 }
 
 
+void present_screen() {
+
+    if (shm_output_enabled) {
+        shm_publish_frame(rgb_pixels);
+    }
+    if (recording_av) {
+        record_frame(rgb_pixels);
+    }
+    ZONE_BEGIN(ZONE_DRAW_SCREEN);
+    draw_screen();
+    ZONE_END(ZONE_DRAW_SCREEN);
+}
+
+
 void output_screen() {
     
-    draw_screen();
+    present_screen();
+    ZONE_BEGIN(ZONE_FRAMERATE);
     adjust_to_framerate();
+    ZONE_END(ZONE_FRAMERATE);
 }
 
-//Render the row number stored in the LY register
-void draw_row() {
 
-    lcd_ctrl = io_mem[LCDC_REG];
-    row = io_mem[LY_REG];
+void set_frame_skip(int frames) {
+    frame_skip = frames > 0 ? frames : 0;
+}
 
-    //Render only if screen is on
-    if ((lcd_ctrl & BIT_7)) {
-        uint8_t render_sprites = (lcd_ctrl & BIT_1);
-        uint8_t render_tiles = (lcd_ctrl  & BIT_0);
 
-        if ((cgb && (cgb_features || is_booting)) || render_tiles) {
-            draw_tile_row();
-        
-        }
-        
-        if (render_sprites) { 
-            draw_sprite_row();
+void set_auto_frame_skip(int enabled) {
+    auto_frame_skip = enabled;
+    time_behind = 0;
+    last_frame_time = get_time();
+}
+
+
+/* Decide whether the next frame should be rendered, with auto frame
+ * skip on a frame is only skipped if we've fallen over a frame behind
+ * real time, and at most MAX_AUTO_FRAME_SKIP frames in a row are skipped */
+static void update_frame_skip() {
+
+    if (auto_frame_skip) {
+        uint64_t now = get_time();
+        time_behind += (int64_t)(now - last_frame_time) * 1000 - FRAME_TIME_MICRO;
+        last_frame_time = now;
+
+        // Don't try to catch up on long stalls (e.g. menus or the debugger)
+        if (time_behind < 0) {
+            time_behind = 0;
+        } else if (time_behind > MAX_AUTO_FRAME_SKIP * FRAME_TIME_MICRO) {
+            time_behind = MAX_AUTO_FRAME_SKIP * FRAME_TIME_MICRO;
         }
+    }
 
-   } 
+    if (skip_current_frame) {
+        frames_skipped++;
+    } else {
+        frames_skipped = 0;
+    }
 
-   if (row >= 143) {
-        output_screen();
+    // Recordings have no timestamps, so every frame has to be in them
+    if (recording_av) {
+        skip_current_frame = 0;
+    } else if (frames_skipped < frame_skip) {
+        skip_current_frame = 1;
+    } else if (auto_frame_skip && frames_skipped < MAX_AUTO_FRAME_SKIP
+        && time_behind >= FRAME_TIME_MICRO) {
+        skip_current_frame = 1;
+    } else {
+        skip_current_frame = 0;
+    }
+}
+
+
+void read_line_regs(Line_Regs *regs) {
+    regs->ly = io_mem[LY_REG];
+    regs->lcdc = io_mem[LCDC_REG];
+    regs->scy = io_mem[SCROLL_Y_REG];
+    regs->scx = io_mem[SCROLL_X_REG];
+    regs->wy = io_mem[WY_REG];
+    regs->wx = io_mem[WX_REG];
+    regs->bgp = io_mem[BGP_REF];
+    regs->obp0 = io_mem[OBP0_REG];
+    regs->obp1 = io_mem[OBP1_REG];
+    regs->cgb = cgb;
+    regs->cgb_features = (is_booting || cgb_features);
+}
+
+
+void render_line(Line_Regs const *regs, Render_Source const *source) {
+
+    cur_line = regs;
+    src = source;
+    lcd_ctrl = regs->lcdc;
+    row = regs->ly;
+
+    uint8_t render_sprites = (lcd_ctrl & BIT_1);
+    uint8_t render_tiles = (lcd_ctrl  & BIT_0);
+
+    if ((regs->cgb && regs->cgb_features) || render_tiles) {
+        ZONE_BEGIN(ZONE_DRAW_TILES);
+        draw_tile_row();
+        ZONE_END(ZONE_DRAW_TILES);
+    }
+    
+    if (render_sprites) { 
+        ZONE_BEGIN(ZONE_DRAW_SPRITES);
+        draw_sprite_row();
+        ZONE_END(ZONE_DRAW_SPRITES);
+    }
+}
+
+
+void render_live_line(Line_Regs const *regs) {
+
+    if (live_sprite_order_version != sprite_prio_version) {
+        get_sprite_prio_order(live_sprite_order);
+        live_sprite_order_version = sprite_prio_version;
+    }
+    render_line(regs, &live_source);
+}
+
+
+//Render the row number stored in the LY register
+void draw_row() {
+
+    ZONE_BEGIN(ZONE_DRAW_ROW);
+    Line_Regs regs;
+    read_line_regs(&regs);
+
+#ifdef THREADED_RENDER
+    if (render_threaded) {
+        render_thread_draw_row(&regs, !skip_current_frame);
+    } else
+#endif
+    {
+        //Render only if screen is on and the frame isn't being skipped
+        if ((regs.lcdc & BIT_7) && !skip_current_frame) {
+            render_live_line(&regs);
+        } 
+
+        if (regs.ly >= 143) {
+            if (skip_current_frame) {
+                ZONE_BEGIN(ZONE_FRAMERATE);
+                adjust_to_framerate();
+                ZONE_END(ZONE_FRAMERATE);
+            } else {
+                output_screen();
+            }
+        }
+    }
+
+   if (regs.ly >= 143) {
         frame_drawn = 1;
+        update_frame_skip();
    }  
+   ZONE_END(ZONE_DRAW_ROW);
 }
-
@@ -1,6 +1,39 @@
 #ifndef GRAPHICS_H
 #define GRAPHICS_H
 
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "sprite_priorities.h"
+
+/* Registers which affect how a single line is rendered,
+ * captured when the line is drawn */
+typedef struct {
+    uint8_t ly;
+    uint8_t lcdc;
+    uint8_t scy;
+    uint8_t scx;
+    uint8_t wy;
+    uint8_t wx;
+    uint8_t bgp;
+    uint8_t obp0;
+    uint8_t obp1;
+    uint8_t cgb; // Running on a Gameboy Color
+    uint8_t cgb_features; // CGB only features enabled (or booting)
+} Line_Regs;
+
+/* Video memory lines are rendered from, either the live
+ * Gameboy memory or a copy owned by the render thread */
+typedef struct {
+    uint8_t const *vram[2]; // VRAM banks 0 and 1, from 0x8000
+    uint8_t const *oam;
+    uint8_t const *bg_palette;
+    uint8_t const *sprite_palette;
+    bool *bg_palette_dirty;
+    bool *sprite_palette_dirty;
+    uint8_t const *sprite_order; // MAX_SPRITES sprite numbers, highest priority first
+} Render_Source;
+
 extern int frame_drawn; // Determines if a frame has been drawn
 
 /* Initialize graphics
@@ -12,6 +45,27 @@ void draw_row();
 
 void output_screen();
 
+// Send the drawn frame to the screen and any other outputs enabled
+void present_screen();
+
+// Capture the registers for the line stored in the LY register
+void read_line_regs(Line_Regs *regs);
+
+/* Render a single line into the screen buffer, only one thread
+ * at a time can be rendering */
+void render_line(Line_Regs const *regs, Render_Source const *source);
+
+// Render a single line from live Gameboy memory
+void render_live_line(Line_Regs const *regs);
+
+/* Skip rendering the given number of frames after every
+ * drawn frame, 0 to render every frame */
+void set_frame_skip(int frames);
+
+/* 1 to automatically skip rendering frames whenever emulation
+ * falls behind real time, 0 to disable */
+void set_auto_frame_skip(int enabled);
+
 
 #endif /* GRAPHICS_H */
 
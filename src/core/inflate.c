@@ -0,0 +1,389 @@
+#include "inflate.h"
+
+#include <string.h>
+
+#define INPUT_CHUNK 4096
+
+#define MAX_BITS 15
+#define MAX_LIT_CODES 288
+#define MAX_DIST_CODES 30
+
+// Result of decoding a block
+#define BLOCK_DONE 0
+#define BLOCK_OUT_FULL 1
+#define BLOCK_ERROR -1
+
+typedef struct {
+    uint16_t counts[MAX_BITS + 1]; // Number of codes of each length
+    uint16_t symbols[MAX_LIT_CODES]; // Symbols ordered by code
+} Huffman;
+
+typedef struct {
+    Inflate_Read read;
+    void *ctx;
+    uint8_t in[INPUT_CHUNK];
+    size_t in_pos;
+    size_t in_len;
+
+    uint32_t bits;
+    int bit_count;
+
+    uint8_t *out;
+    size_t out_len;
+    size_t out_size;
+
+    int error;
+} Inflate_State;
+
+static uint16_t const length_base[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+
+static uint8_t const length_extra[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+
+static uint16_t const dist_base[MAX_DIST_CODES] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+    8193, 12289, 16385, 24577
+};
+
+static uint8_t const dist_extra[MAX_DIST_CODES] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+// Order code length code lengths are stored in
+static uint8_t const length_order[19] = {
+    16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
+};
+
+
+static int next_byte(Inflate_State *s) {
+
+    if (s->in_pos == s->in_len) {
+        s->in_len = s->read(s->ctx, s->in, INPUT_CHUNK);
+        s->in_pos = 0;
+        if (s->in_len == 0) {
+            s->error = 1; // Stream ended early
+            return 0;
+        }
+    }
+    return s->in[s->in_pos++];
+}
+
+
+static unsigned get_bits(Inflate_State *s, int count) {
+
+    while (s->bit_count < count) {
+        s->bits |= (uint32_t)next_byte(s) << s->bit_count;
+        s->bit_count += 8;
+    }
+
+    unsigned val = s->bits & ((1u << count) - 1);
+    s->bits >>= count;
+    s->bit_count -= count;
+    return val;
+}
+
+
+/* Build canonical Huffman codes from a list of code lengths.
+ * returns 0 if complete, > 0 if incomplete, < 0 if over subscribed */
+static int build_huffman(Huffman *h, uint8_t const *lengths, int count) {
+
+    uint16_t offsets[MAX_BITS + 1];
+
+    memset(h->counts, 0, sizeof(h->counts));
+    for (int i = 0; i < count; i++) {
+        h->counts[lengths[i]]++;
+    }
+    h->counts[0] = 0;
+
+    int left = 1;
+    for (int len = 1; len <= MAX_BITS; len++) {
+        left = (left << 1) - h->counts[len];
+        if (left < 0) {
+            return left;
+        }
+    }
+
+    offsets[1] = 0;
+    for (int len = 1; len < MAX_BITS; len++) {
+        offsets[len + 1] = offsets[len] + h->counts[len];
+    }
+
+    for (int i = 0; i < count; i++) {
+        if (lengths[i]) {
+            h->symbols[offsets[lengths[i]]++] = i;
+        }
+    }
+    return left;
+}
+
+
+// Read one symbol, a bit at a time from the shortest code upwards
+static int decode_symbol(Inflate_State *s, Huffman const *h) {
+
+    int code = 0;
+    int first = 0;
+    int index = 0;
+
+    for (int len = 1; len <= MAX_BITS; len++) {
+        code |= get_bits(s, 1);
+        int count = h->counts[len];
+        if (code - first < count) {
+            return h->symbols[index + (code - first)];
+        }
+        index += count;
+        first = (first + count) << 1;
+        code <<= 1;
+    }
+
+    s->error = 1;
+    return -1;
+}
+
+
+static int put_byte(Inflate_State *s, uint8_t val) {
+
+    if (s->out_len == s->out_size) {
+        return 0;
+    }
+    s->out[s->out_len++] = val;
+    return 1;
+}
+
+
+static int inflate_stored(Inflate_State *s) {
+
+    // Stored blocks start on a byte boundary
+    s->bits = 0;
+    s->bit_count = 0;
+
+    unsigned len = next_byte(s);
+    len |= next_byte(s) << 8;
+    unsigned nlen = next_byte(s);
+    nlen |= next_byte(s) << 8;
+
+    if (s->error || len != (~nlen & 0xFFFF)) {
+        return BLOCK_ERROR;
+    }
+
+    while (len--) {
+        uint8_t val = next_byte(s);
+        if (s->error) {
+            return BLOCK_ERROR;
+        }
+        if (!put_byte(s, val)) {
+            return BLOCK_OUT_FULL;
+        }
+    }
+    return BLOCK_DONE;
+}
+
+
+static int inflate_codes(Inflate_State *s, Huffman const *lit, Huffman const *dist) {
+
+    for (;;) {
+        int sym = decode_symbol(s, lit);
+        if (s->error || sym < 0) {
+            return BLOCK_ERROR;
+        }
+
+        if (sym < 256) {
+            if (!put_byte(s, sym)) {
+                return BLOCK_OUT_FULL;
+            }
+            continue;
+        }
+
+        if (sym == 256) {
+            return BLOCK_DONE;
+        }
+
+        // Copy a run from earlier in the output
+        sym -= 257;
+        if (sym >= 29) {
+            return BLOCK_ERROR;
+        }
+        unsigned len = length_base[sym] + get_bits(s, length_extra[sym]);
+
+        int dist_sym = decode_symbol(s, dist);
+        if (s->error || dist_sym < 0 || dist_sym >= MAX_DIST_CODES) {
+            return BLOCK_ERROR;
+        }
+        size_t distance = dist_base[dist_sym] + get_bits(s, dist_extra[dist_sym]);
+        if (s->error || distance > s->out_len) {
+            return BLOCK_ERROR;
+        }
+
+        while (len--) {
+            if (!put_byte(s, s->out[s->out_len - distance])) {
+                return BLOCK_OUT_FULL;
+            }
+        }
+    }
+}
+
+
+static int inflate_fixed(Inflate_State *s) {
+
+    static Huffman lit, dist;
+    static int built = 0;
+
+    if (!built) {
+        uint8_t lengths[MAX_LIT_CODES];
+        int i = 0;
+        for (; i < 144; i++) lengths[i] = 8;
+        for (; i < 256; i++) lengths[i] = 9;
+        for (; i < 280; i++) lengths[i] = 7;
+        for (; i < MAX_LIT_CODES; i++) lengths[i] = 8;
+        build_huffman(&lit, lengths, MAX_LIT_CODES);
+
+        for (i = 0; i < MAX_DIST_CODES; i++) lengths[i] = 5;
+        build_huffman(&dist, lengths, MAX_DIST_CODES);
+        built = 1;
+    }
+
+    return inflate_codes(s, &lit, &dist);
+}
+
+
+static int inflate_dynamic(Inflate_State *s) {
+
+    uint8_t lengths[MAX_LIT_CODES + MAX_DIST_CODES];
+    Huffman lencode, lit, dist;
+
+    int lit_count = get_bits(s, 5) + 257;
+    int dist_count = get_bits(s, 5) + 1;
+    int len_count = get_bits(s, 4) + 4;
+    if (lit_count > MAX_LIT_CODES || dist_count > MAX_DIST_CODES) {
+        return BLOCK_ERROR;
+    }
+
+    // Lengths of the codes used to compress the code lengths
+    memset(lengths, 0, 19);
+    for (int i = 0; i < len_count; i++) {
+        lengths[length_order[i]] = get_bits(s, 3);
+    }
+    if (s->error || build_huffman(&lencode, lengths, 19) != 0) {
+        return BLOCK_ERROR;
+    }
+
+    int i = 0;
+    while (i < lit_count + dist_count) {
+        int sym = decode_symbol(s, &lencode);
+        if (s->error || sym < 0) {
+            return BLOCK_ERROR;
+        }
+
+        if (sym < 16) {
+            lengths[i++] = sym;
+            continue;
+        }
+
+        // Repeat the previous length, or zeros
+        uint8_t len = 0;
+        int repeat;
+        if (sym == 16) {
+            if (i == 0) {
+                return BLOCK_ERROR;
+            }
+            len = lengths[i - 1];
+            repeat = 3 + get_bits(s, 2);
+        } else if (sym == 17) {
+            repeat = 3 + get_bits(s, 3);
+        } else {
+            repeat = 11 + get_bits(s, 7);
+        }
+
+        if (i + repeat > lit_count + dist_count) {
+            return BLOCK_ERROR;
+        }
+        while (repeat--) {
+            lengths[i++] = len;
+        }
+    }
+
+    // No end of block code means no way to finish
+    if (lengths[256] == 0) {
+        return BLOCK_ERROR;
+    }
+
+    // Incomplete codes are allowed, as some encoders emit them
+    if (build_huffman(&lit, lengths, lit_count) < 0 ||
+        build_huffman(&dist, lengths + lit_count, dist_count) < 0) {
+        return BLOCK_ERROR;
+    }
+
+    return inflate_codes(s, &lit, &dist);
+}
+
+
+long inflate_stream(Inflate_Read read, void *ctx, uint8_t *out, size_t out_size) {
+
+    static Inflate_State s;
+
+    s.read = read;
+    s.ctx = ctx;
+    s.in_pos = 0;
+    s.in_len = 0;
+    s.bits = 0;
+    s.bit_count = 0;
+    s.out = out;
+    s.out_len = 0;
+    s.out_size = out_size;
+    s.error = 0;
+
+    int last;
+    do {
+        last = get_bits(&s, 1);
+        int type = get_bits(&s, 2);
+        if (s.error) {
+            return -1;
+        }
+
+        int result;
+        switch (type) {
+            case 0: result = inflate_stored(&s); break;
+            case 1: result = inflate_fixed(&s); break;
+            case 2: result = inflate_dynamic(&s); break;
+            default: return -1;
+        }
+
+        if (result == BLOCK_ERROR) {
+            return -1;
+        } else if (result == BLOCK_OUT_FULL) {
+            break;
+        }
+    } while (!last);
+
+    return (long)s.out_len;
+}
+
+
+uint32_t crc32(uint8_t const *data, size_t size) {
+
+    static uint32_t table[256];
+    static int built = 0;
+
+    if (!built) {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++) {
+                c = (c & 1) ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+            }
+            table[i] = c;
+        }
+        built = 1;
+    }
+
+    uint32_t crc = 0xFFFFFFFF;
+    for (size_t i = 0; i < size; i++) {
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return crc ^ 0xFFFFFFFF;
+}
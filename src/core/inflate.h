@@ -0,0 +1,23 @@
+#ifndef INFLATE_H
+#define INFLATE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* Small decompressor for raw deflate streams (RFC 1951), as found in
+ * .gz and .zip files. Output goes straight into a single buffer,
+ * which doubles as the history window. */
+
+/* Reads up to size bytes of compressed input into buf.
+ * returns the number of bytes read, 0 at end of input */
+typedef size_t (*Inflate_Read)(void *ctx, uint8_t *buf, size_t size);
+
+/* Decompress the stream given by read into out, stopping once
+ * out_size bytes have been written even if the stream continues.
+ * returns the number of bytes written, or -1 if the stream is invalid */
+long inflate_stream(Inflate_Read read, void *ctx, uint8_t *out, size_t out_size);
+
+// CRC-32 of the given data, as used by gzip and zip
+uint32_t crc32(uint8_t const *data, size_t size);
+
+#endif /* INFLATE_H */
@@ -0,0 +1,58 @@
+#include "input.h"
+#include "bits.h"
+#include "interrupts.h"
+#include "memory_layout.h"
+#include "movie.h"
+#include "mmu/memory.h"
+
+#include "../non_core/joypad.h"
+#include "../non_core/logger.h"
+
+uint8_t input_keys = 0;
+int input_poll_pending = 0;
+uint8_t input_poll_line = INPUT_POLL_LINE;
+
+
+int set_input_poll_line(unsigned line) {
+
+    if (line > INPUT_MAX_POLL_LINE) {
+        log_message(LOG_ERROR, "Input poll line %u isn't between 0 and %d\n", line, INPUT_MAX_POLL_LINE);
+        return 0;
+    }
+    input_poll_line = line;
+    return 1;
+}
+
+
+/* Set P1 to the latched keys selected by bits 4 and 5, low
+ * for each key held. Raises the joypad interrupt when a key
+ * line goes from high to low */
+static void update_P1(uint8_t select) {
+
+    uint8_t p1 = (select & 0xF0) | 0xF;
+    if (!(select & BIT_4)) {
+        p1 &= ~(input_keys & 0xF);
+    }
+    if (!(select & BIT_5)) {
+        p1 &= ~(input_keys >> 4);
+    }
+
+    if (io_mem[P1_REG] & ~p1 & 0xF) {
+        raise_interrupt(JOYPAD_INT);
+    }
+    io_mem[P1_REG] = p1;
+}
+
+
+int poll_input() {
+
+    int quit = update_keys();
+    input_keys = movie_mode ? movie_keys : joypad_keys();
+    update_P1(io_mem[P1_REG]);
+    return quit;
+}
+
+
+void write_P1(uint8_t val) {
+    update_P1(val);
+}
@@ -0,0 +1,46 @@
+#ifndef INPUT_H
+#define INPUT_H
+
+#include <stdint.h>
+
+/* Joypad input. The keys are polled from the joypad backend, or the
+ * movie being recorded or played, once a frame when LY reaches the
+ * poll line, and latched until the next poll. P1 reads are worked out
+ * from the latched keys, so the backend is only asked once a frame.
+ *
+ * The poll line defaults to the start of V-Blank, just before games
+ * read the keys in their V-Blank handler, keeping latency to a frame.
+ * While the LCD is off the keys are still polled once a frame's worth
+ * of cycles. */
+
+#define INPUT_POLL_LINE 144    // Start of V-Blank
+#define INPUT_MAX_POLL_LINE 153
+#define INPUT_POLL_CYCLES 70224
+
+// Keys latched at the last poll, as a key mask (see joypad.h)
+extern uint8_t input_keys;
+
+// Set when LY reaches the poll line, for the poll to happen after the instruction
+extern int input_poll_pending;
+extern uint8_t input_poll_line;
+
+/* Poll the keys on the given line, from 0 to 153.
+ * returns 1 if successful, 0 otherwise */
+int set_input_poll_line(unsigned line);
+
+// Called by the LCD whenever LY changes
+static inline void check_input_poll(uint8_t ly) {
+    if (ly == input_poll_line) {
+        input_poll_pending = 1;
+    }
+}
+
+/* Update the backend, latch the keys and update P1 from them,
+ * raising the joypad interrupt for any key newly pressed.
+ * returns 1 if the backend is quitting, 0 otherwise */
+int poll_input();
+
+// P1 written to, select the keys read back from it
+void write_P1(uint8_t val);
+
+#endif /* INPUT_H */
@@ -0,0 +1,300 @@
+#define _POSIX_C_SOURCE 200809L // clock_gettime
+#include "instrument.h"
+
+#ifdef INSTRUMENT
+
+#include "../non_core/logger.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define HISTORY_FRAMES 300 // Frames in each periodic report, about 5 seconds
+#define MAX_TRACE_FRAMES (60 * 60 * 10)
+#define MAX_TRACE_EVENTS 0x40000
+#define MAX_THREADS 4
+
+// Only the render thread runs zones besides the emulator's own
+#ifdef THREADED_RENDER
+#include <pthread.h>
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+#define LOCK() pthread_mutex_lock(&lock)
+#define UNLOCK() pthread_mutex_unlock(&lock)
+#define THREAD_LOCAL __thread
+#else
+#define LOCK()
+#define UNLOCK()
+#define THREAD_LOCAL
+#endif
+
+// Running totals, only added to by the thread they belong to
+typedef struct {
+    uint64_t ticks[ZONE_COUNT];
+    uint64_t calls[ZONE_COUNT];
+} Zone_Counters;
+
+typedef struct {
+    uint64_t start;
+    uint64_t ticks;
+    uint8_t zone;
+    uint8_t thread;
+} Trace_Event;
+
+typedef struct {
+    uint64_t start;
+    uint64_t ticks;
+    uint64_t zone_ticks[ZONE_COUNT];
+} Trace_Frame;
+
+static struct {
+    char const *name;
+    int traced; // Recorded each time it's run, not just totalled per frame
+} const zones[ZONE_COUNT] = {
+    {"cpu", 0}, {"timers", 0}, {"lcd", 0}, {"draw_row", 0},
+    {"draw_tiles", 0}, {"draw_sprites", 0}, {"sound", 0}, {"sound_frame", 1},
+    {"serial", 0}, {"mobile", 0}, {"draw_screen", 1}, {"framerate", 1}
+};
+
+static Zone_Counters thread_counters[MAX_THREADS];
+static int thread_count = 0;
+static THREAD_LOCAL Zone_Counters *counters = NULL;
+static THREAD_LOCAL int thread_index = 0;
+
+static int timing = 0;
+static uint64_t start_ticks, start_ns;
+static uint64_t frame_start;
+static uint64_t last_ticks[ZONE_COUNT];
+static uint64_t last_calls[ZONE_COUNT];
+
+// Per frame totals of the current report
+static uint64_t history[HISTORY_FRAMES][ZONE_COUNT];
+static uint64_t history_calls[ZONE_COUNT];
+static uint64_t history_frame_ticks;
+static int history_count = 0;
+
+static char const *trace_file_path = NULL;
+static Trace_Event *trace_events = NULL;
+static unsigned long trace_event_count = 0;
+static Trace_Frame *trace_frames = NULL;
+static unsigned long trace_frame_count = 0;
+
+
+uint64_t instrument_clock() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+
+// Nanoseconds per tick, measured over the time since opening
+static double tick_ns() {
+    uint64_t ticks = instrument_now() - start_ticks;
+    uint64_t ns = instrument_clock() - start_ns;
+    return ticks ? (double)ns / ticks : 1.0;
+}
+
+
+static Zone_Counters *add_thread() {
+    LOCK();
+    int index = thread_count < MAX_THREADS ? thread_count++ : MAX_THREADS - 1;
+    UNLOCK();
+    thread_index = index;
+    return &thread_counters[index];
+}
+
+
+void instrument_add(Zone zone, uint64_t start) {
+
+    uint64_t end = instrument_now();
+    if (counters == NULL) {
+        counters = add_thread();
+    }
+    counters->ticks[zone] += end - start;
+    counters->calls[zone]++;
+
+    if (zones[zone].traced && trace_events) {
+        LOCK();
+        if (trace_event_count < MAX_TRACE_EVENTS) {
+            Trace_Event *event = &trace_events[trace_event_count++];
+            event->start = start;
+            event->ticks = end - start;
+            event->zone = zone;
+            event->thread = thread_index;
+        }
+        UNLOCK();
+    }
+}
+
+
+int instrument_open(char const *trace_path) {
+
+    if (trace_path) {
+        trace_events = malloc(MAX_TRACE_EVENTS * sizeof(Trace_Event));
+        trace_frames = malloc(MAX_TRACE_FRAMES * sizeof(Trace_Frame));
+        if (trace_events == NULL || trace_frames == NULL) {
+            log_message(LOG_ERROR, "Unable to allocate zone trace\n");
+            free(trace_events);
+            free(trace_frames);
+            trace_events = NULL;
+            trace_frames = NULL;
+            return 0;
+        }
+        trace_file_path = trace_path;
+    }
+    trace_event_count = trace_frame_count = 0;
+    history_count = 0;
+
+    // The emulator's thread is the first in the trace
+    if (counters == NULL) {
+        counters = add_thread();
+    }
+
+    start_ns = instrument_clock();
+    start_ticks = frame_start = instrument_now();
+    timing = 1;
+    return 1;
+}
+
+
+static int compare_ticks(void const *a, void const *b) {
+    uint64_t ticks_a = *(uint64_t const *)a;
+    uint64_t ticks_b = *(uint64_t const *)b;
+    return (ticks_a > ticks_b) - (ticks_a < ticks_b);
+}
+
+
+static void log_report() {
+
+    double ms = tick_ns() / 1e6;
+    log_message(LOG_INFO, "Zones over %d frames, %.3fms per frame:\n",
+        history_count, history_frame_ticks * ms / history_count);
+
+    uint64_t sorted[HISTORY_FRAMES];
+    for (int z = 0; z < ZONE_COUNT; z++) {
+        if (history_calls[z] == 0) {
+            continue;
+        }
+        uint64_t total = 0;
+        for (int i = 0; i < history_count; i++) {
+            sorted[i] = history[i][z];
+            total += sorted[i];
+        }
+        qsort(sorted, history_count, sizeof(uint64_t), compare_ticks);
+        log_message(LOG_INFO, "  %-12s avg %7.3fms p50 %7.3fms p99 %7.3fms %9.1f calls\n", zones[z].name,
+            total * ms / history_count,
+            sorted[history_count / 2] * ms,
+            sorted[history_count * 99 / 100] * ms,
+            (double)history_calls[z] / history_count);
+    }
+}
+
+
+void instrument_frame() {
+
+    if (!timing) {
+        return;
+    }
+    uint64_t now = instrument_now();
+
+    uint64_t ticks[ZONE_COUNT] = {0};
+    uint64_t calls[ZONE_COUNT] = {0};
+    LOCK();
+    for (int t = 0; t < thread_count; t++) {
+        for (int z = 0; z < ZONE_COUNT; z++) {
+            ticks[z] += thread_counters[t].ticks[z];
+            calls[z] += thread_counters[t].calls[z];
+        }
+    }
+    UNLOCK();
+
+    Trace_Frame *frame = NULL;
+    if (trace_frames && trace_frame_count < MAX_TRACE_FRAMES) {
+        frame = &trace_frames[trace_frame_count++];
+        frame->start = frame_start;
+        frame->ticks = now - frame_start;
+    }
+
+    if (history_count == 0) {
+        memset(history_calls, 0, sizeof(history_calls));
+        history_frame_ticks = 0;
+    }
+    for (int z = 0; z < ZONE_COUNT; z++) {
+        history[history_count][z] = ticks[z] - last_ticks[z];
+        history_calls[z] += calls[z] - last_calls[z];
+        if (frame) {
+            frame->zone_ticks[z] = ticks[z] - last_ticks[z];
+        }
+        last_ticks[z] = ticks[z];
+        last_calls[z] = calls[z];
+    }
+    history_frame_ticks += now - frame_start;
+    frame_start = now;
+
+    if (++history_count == HISTORY_FRAMES) {
+        log_report();
+        history_count = 0;
+    }
+}
+
+
+static void write_trace() {
+
+    FILE *file;
+    if (!(file = fopen(trace_file_path, "w"))) {
+        log_message(LOG_ERROR, "Error opening zone trace %s\n", trace_file_path);
+        return;
+    }
+
+    double us = tick_ns() / 1e3;
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"emulator\"}}");
+
+    for (unsigned long i = 0; i < trace_frame_count; i++) {
+        Trace_Frame const *frame = &trace_frames[i];
+        double ts = (frame->start - start_ticks) * us;
+        fprintf(file, ",\n{\"name\":\"frame\",\"ph\":\"X\",\"pid\":1,\"tid\":0,\"ts\":%.3f,\"dur\":%.3f}",
+            ts, frame->ticks * us);
+        fprintf(file, ",\n{\"name\":\"zones\",\"ph\":\"C\",\"pid\":1,\"tid\":0,\"ts\":%.3f,\"args\":{", ts);
+        for (int z = 0; z < ZONE_COUNT; z++) {
+            fprintf(file, z ? ",\"%s\":%.3f" : "\"%s\":%.3f", zones[z].name, frame->zone_ticks[z] * us);
+        }
+        fprintf(file, "}}");
+    }
+
+    for (unsigned long i = 0; i < trace_event_count; i++) {
+        Trace_Event const *event = &trace_events[i];
+        fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+            zones[event->zone].name, event->thread,
+            (event->start - start_ticks) * us, event->ticks * us);
+    }
+    fprintf(file, "\n]}\n");
+
+    if (ferror(file) | fclose(file)) {
+        log_message(LOG_ERROR, "Error writing zone trace %s\n", trace_file_path);
+    } else {
+        log_message(LOG_INFO, "Wrote zone trace of %lu frames to %s\n", trace_frame_count, trace_file_path);
+    }
+}
+
+
+void instrument_close() {
+
+    if (!timing) {
+        return;
+    }
+    if (history_count > 0) {
+        log_report();
+    }
+    if (trace_file_path) {
+        write_trace();
+    }
+    free(trace_events);
+    free(trace_frames);
+    trace_events = NULL;
+    trace_frames = NULL;
+    trace_file_path = NULL;
+    timing = 0;
+}
+
+#endif /* INSTRUMENT */
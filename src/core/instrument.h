@@ -0,0 +1,81 @@
+#ifndef INSTRUMENT_H
+#define INSTRUMENT_H
+
+#include <stdint.h>
+
+/* Timing of the emulator's hot paths, built in only with INSTRUMENT
+ * defined (instrument=1 with SCons).
+ *
+ * Code between ZONE_BEGIN(zone) and ZONE_END(zone) in the same block
+ * is timed with the CPU's timestamp counter where there is one, or a
+ * monotonic clock otherwise. Zones nest, so a zone's time includes
+ * any zones inside it. Totals and call counts are kept per frame, with
+ * a breakdown of the last few seconds logged periodically and the
+ * per frame totals, along with the coarser zones as they happened,
+ * written as a Chrome trace (chrome://tracing or Perfetto) on close.
+ *
+ * Without INSTRUMENT the macros and calls compile to nothing. */
+
+typedef enum {
+    ZONE_CPU,          // Instruction execution, exec_opcode
+    ZONE_TIMERS,       // update_timers
+    ZONE_LCD,          // update_lcd, including drawing rows
+    ZONE_DRAW_ROW,     // draw_row
+    ZONE_DRAW_TILES,   // draw_tile_row
+    ZONE_DRAW_SPRITES, // draw_sprite_row
+    ZONE_SOUND,        // sound_add_cycles
+    ZONE_SOUND_FRAME,  // Mixing and queueing a frame of sound, end_frame
+    ZONE_SERIAL,       // inc_serial_cycles
+    ZONE_MOBILE,       // MobileLoop
+    ZONE_DRAW_SCREEN,  // draw_screen
+    ZONE_FRAMERATE,    // adjust_to_framerate
+    ZONE_COUNT
+} Zone;
+
+#ifdef INSTRUMENT
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define instrument_now() __rdtsc()
+#else
+#define instrument_now() instrument_clock()
+#endif
+
+#define ZONE_BEGIN(zone) uint64_t zone##_start = instrument_now()
+#define ZONE_END(zone) instrument_add(zone, zone##_start)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Monotonic time in nanoseconds
+uint64_t instrument_clock();
+
+// Add the time since start to the zone
+void instrument_add(Zone zone, uint64_t start);
+
+/* Start timing, writing a Chrome trace to the given file on close
+ * if not NULL. returns 1 if successful, 0 otherwise */
+int instrument_open(char const *trace_path);
+
+// Total up the zones for the frame just run, called once per frame
+void instrument_frame();
+
+// Stop timing, writing the trace if one was asked for
+void instrument_close();
+
+#ifdef __cplusplus
+}
+#endif
+
+#else
+
+#define ZONE_BEGIN(zone)
+#define ZONE_END(zone)
+#define instrument_open(trace_path) ((void)(trace_path), 1)
+#define instrument_frame()
+#define instrument_close()
+
+#endif /* INSTRUMENT */
+
+#endif /* INSTRUMENT_H */
@@ -7,6 +7,8 @@
 #include "graphics.h"
 #include "bits.h"
 #include "rom_info.h"
+#include "instrument.h"
+#include "input.h"
 #include <stdint.h>
 
 
@@ -126,6 +128,7 @@ static long update_lcd(long cycles) {
                     ly_counter++;
                     io_mem[LY_REG] = ly_counter;
                     check_lcd_coincidence(); 
+                    check_input_poll(ly_counter);
 
                     // Check if HDMA transfer needs to take place in CGB mode
                     if (cgb && (is_booting || cgb_features) && hdma_in_progress && (!halted ||
@@ -189,6 +192,7 @@ static long update_lcd(long cycles) {
                         ly_counter++;
                         io_mem[LY_REG] = ly_counter;
                         check_lcd_coincidence(); 
+                        check_input_poll(ly_counter);
                     }
                 }
                 
@@ -196,6 +200,7 @@ static long update_lcd(long cycles) {
                 if ((current_cycles >= 4104) && (current_aux_cycles >= 4) && (ly_counter == 153)) {
                     ly_counter = 0;
                     io_mem[LY_REG] = ly_counter;
+                    check_input_poll(ly_counter);
                 }
 
                 if (current_cycles >= 4560) {
@@ -293,5 +298,8 @@ static long update_lcd(long cycles) {
  * 0 otherwise. */
 long update_graphics(long cycles) {
   
-    return update_lcd(cycles);
+    ZONE_BEGIN(ZONE_LCD);
+    long updated_cycles = update_lcd(cycles);
+    ZONE_END(ZONE_LCD);
+    return updated_cycles;
 }  
@@ -9,6 +9,7 @@
 #include "../timers.h" 
 #include "../lcd.h"
 #include "../emu.h"
+#include "../code_logger.h"
 
 int hdma_in_progress = 0;
 int gdma_in_progress = 0;
@@ -51,9 +52,15 @@ long perform_hdma() {
     uint16_t source = hdma_source;
     uint16_t dest = hdma_dest | 0x8000;
 
+    if (code_logging) {
+        log_DMA(1);
+    }
     for (int i = 0; i < 0x10; i++) {
         set_mem(dest + i, get_mem(source + i));       
     }
+    if (code_logging) {
+        log_DMA(0);
+    }
 
     hdma_source += 0x10;
     hdma_dest +=  0x10;
@@ -89,9 +96,15 @@ void perform_gdma(uint8_t value) {
     uint16_t source = hdma_source & 0xFFF0;
     uint16_t dest = (hdma_dest & 0x1FF0) | 0x8000;
  
+    if (code_logging) {
+        log_DMA(1);
+    }
     for (int i = 0; i < hdma_bytes; i++) {
         set_mem(dest + i, get_mem(source + i));       
     }
+    if (code_logging) {
+        log_DMA(0);
+    }
 
     memset(io_mem + HDMA1_REG, 0xFF, HDMA5_REG - HDMA1_REG + 1);
 
@@ -12,12 +12,23 @@ static int cur_ROM_bank = 1; // Current RAM bank 0x0 - 0x03
 static int ram_banking = 0;  // 0: RAM banking off, 1: RAM banking on
 static int battery = 0;
 
+// Publish the current banks for reads that skip read_HUC1
+static void update_read_map() {
+    map_MBC_read(0x0000, ROM_BANK_SIZE, ROM_banks);
+    map_MBC_read(0x4000, ROM_BANK_SIZE,
+        ROM_banks + ((cur_ROM_bank % ROM_bank_count) * ROM_BANK_SIZE) - 0x4000);
+    map_MBC_read(0xA000, RAM_BANK_SIZE, RAM_bank_count > 0 ?
+        RAM_banks + ((cur_RAM_bank % RAM_bank_count) * RAM_BANK_SIZE) - 0xA000 : NULL);
+}
+
+
 void setup_HUC1(int flags) {
     battery = (flags & BATTERY) ? 1 : 0;
     // Check for previous saves if Battery active
     if (battery) {
         read_SRAM();
     }
+    update_read_map();
 }
 
 
@@ -60,10 +71,12 @@ void write_HUC1(uint16_t addr, uint8_t val) {
         case 0x2000:
         case 0x3000:/* Set ROM bank, can't be 0 */
                     cur_ROM_bank = val == 0 ? 1 : val;
+                    update_read_map();
                     break;
         case 0x4000: 
         case 0x5000: // Set current RAM bank 0 - 3
                      cur_RAM_bank = val;
+                     update_read_map();
                      break;
         case 0x6000: 
         case 0x7000: //Nothing
@@ -72,6 +85,7 @@ void write_HUC1(uint16_t addr, uint8_t val) {
         case 0xB000: // Write to external RAM bank if RAM banking enabled 
                     if (ram_banking) {
                         RAM_banks[(cur_RAM_bank * RAM_BANK_SIZE) | (addr & 0x1FFF)] = val; 
+                        MARK_SRAM_DIRTY((cur_RAM_bank * RAM_BANK_SIZE) | (addr & 0x1FFF));
                     }
                     break;
     }    
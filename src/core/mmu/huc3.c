@@ -3,7 +3,7 @@
 #include "huc3.h"
 #include "memory.h"
 #include "../bits.h"
-#include "../../non_core/get_time.h"
+#include "rtc.h"
 
 
 /* Hudson Memory Bank Controller 3 (2MB ROM, 128KB RAM, RTC)
@@ -23,54 +23,55 @@ static int huc3_ramflag = 0;
 static int huc3_value = 0;
 static uint64_t clock_register = 0;
 static uint64_t clock_shift = 0;
-static uint64_t clock_time = 0;
+static uint64_t clock_time = 0; // rtc_time() clock_register was last updated
+
+
+/* Publish the current banks for reads that skip read_HUC3,
+ * the IR and clock registers go through read_HUC3 */
+static void update_read_map() {
+    map_MBC_read(0x0000, ROM_BANK_SIZE, ROM_banks);
+    map_MBC_read(0x4000, ROM_BANK_SIZE,
+        ROM_banks + ((cur_ROM_bank % ROM_bank_count) * ROM_BANK_SIZE) - 0x4000);
+
+    int ram_mapped = (huc3_ramflag == 0x0 || huc3_ramflag == 0xA) && ram_banking;
+    map_MBC_read(0xA000, RAM_BANK_SIZE, ram_mapped && RAM_bank_count > 0 ?
+        RAM_banks + (cur_RAM_bank * RAM_BANK_SIZE) - 0xA000 : NULL);
+}
 
 
 void setup_HUC3(int flags) {
     battery = (flags & BATTERY) ? 1 : 0;
+    clock_time = rtc_time();
     // Check for previous saves if Battery active
     if (battery) {
         read_SRAM();
     }
+    update_read_map();
 }
 
 
 
+/* Add the whole minutes since the clock was last updated, the
+ * register holds minutes of the day (12 bits), day of the year
+ * (12 bits) and years (4 bits) */
 void update_clock() {
-	uint64_t now = 0; // get_time();
-    uint64_t elapsed = now - clock_time;
-	
-	// Get Years 4 bits
-	while (elapsed >= 365 * 24 * 60 * 60) {
-		clock_register += (1 << 24);
-		elapsed -= 365 * 24 * 60 * 60;
-	}	
-
-	// Get Days 12 bits
-	while (elapsed >= 24 * 60 * 60) {
-		clock_register += (1 << 12);
-		elapsed -= 24 * 60 * 60;
-	}
 
-	// Minutes 12 bits
-	while (elapsed >= 60) {
-		clock_register += 1;
-		elapsed -= 60;
+	uint64_t now = rtc_time();
+	if (now < clock_time) { // Host clock went backwards
+		clock_time = now;
+		return;
 	}
 
-	if ((clock_register & 0x0000FFF) >= 24 * 60) {
-		clock_register += (1 << 12) - 24 * 60;
-	}
-	
-	if ((clock_register & 0x0FFF000) >= 365 << 12) {
-		clock_register += (1 << 24) - (365 << 12);
-	}
-
-	clock_time = now - elapsed;
-}
-	
+	uint64_t minutes = (now - clock_time) / 60000;
+	clock_time += minutes * 60000;
 
+	uint64_t total = (clock_register & 0x0000FFF) + minutes;
+	uint64_t days = ((clock_register >> 12) & 0xFFF) + total / (24 * 60);
+	uint64_t years = ((clock_register >> 24) & 0xF) + days / 365;
 
+	clock_register = (clock_register & ~0xFFFFFFFULL) | ((years & 0xF) << 24) |
+	                 ((days % 365) << 12) | (total % (24 * 60));
+}
 
 
 uint8_t read_HUC3(uint16_t addr) {
@@ -115,16 +116,18 @@ void write_HUC3(uint16_t addr, uint8_t val) {
         case 0x1000: 
 					ram_banking = val & 0x0A;
                     huc3_ramflag = val;
+                    update_read_map();
                     break;
         case 0x2000:
         case 0x3000:/* Set ROM bank  */
                     val = val & 0x7F;
                     cur_ROM_bank = val ? val : 1;
-					
+                    update_read_map();
                     break;
         case 0x4000: 
         case 0x5000: // Set current RAM bank 0 - 0xF
                      cur_RAM_bank = val & 0xF;
+                     update_read_map();
                      break;
         case 0x6000: 
         case 0x7000: //Nothing
@@ -166,6 +169,7 @@ void write_HUC3(uint16_t addr, uint8_t val) {
 						}	
 					} else if (huc3_ramflag == 0x0A && ram_banking) {
 							RAM_banks[(cur_RAM_bank * RAM_BANK_SIZE) | (addr & 0x1FFF)] = val;					
+							MARK_SRAM_DIRTY((cur_RAM_bank * RAM_BANK_SIZE) | (addr & 0x1FFF));
 					} 
                     break;
     }    
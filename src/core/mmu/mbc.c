@@ -8,10 +8,13 @@
 #include "mmm01.h"
 #include "huc1.h"
 #include "huc3.h"
+#include "sram_writer.h"
+#include "rtc.h"
+#include "rom_map.h"
+#include "../rom_archive.h"
 
 #include "../../non_core/logger.h"
 #include "../../non_core/files.h"
-#include "../../non_core/get_time.h"
 
 #include <string.h>
 #include <stdlib.h>
@@ -30,82 +33,137 @@ uint8_t *ROM_banks; // max 512 * 16KB rom banks (8MB) 0x4000
 
 read_MBC_ptr read_MBC = NULL;
 write_MBC_ptr write_MBC = NULL; 
+uint8_t *MBC_read_map[0x10];
+uint8_t *MBC_page_map[0x10];
 
 #define MAX_SRAM_FNAME_SIZE 256
 
 static char SRAM_filename[MAX_SRAM_FNAME_SIZE + 1];
 unsigned RAM_bank_count = 0;
+unsigned long RAM_size = 0;
 unsigned ROM_bank_count = 0;
 static int mbc3_rtc = 0;
+static unsigned long SRAM_size = 0; // Cartridge RAM, followed by the MBC3 clock
+static int SRAM_map_loaded = 0; // Mapped save file held a full save
+static int SRAM_override = 0; // Save file is neither read nor written
+static uint8_t const *override_data = NULL;
+static unsigned long override_size = 0;
 
-// SRAM cache is where we store any writes to the SRAM, we only write to the SRAM file every SRAM_WRITE_DELAY milliseconds
-// used to improve 3DS performance and avoid taxing I/O writes
-static unsigned char *SRAM_cache; // max 16 * 8KB ram banks (128KB) 0x2000
-static uint64_t time_last_SRAM_write = 0;   // in ms
-static int SRAM_cache_valid = 0;    // 0 = false, 1 = true, is the cache safe to use for loading
+
+void set_SRAM_override(int enabled, uint8_t const *data, unsigned long size) {
+    SRAM_override = enabled;
+    override_data = data;
+    override_size = size;
+}
+
+
+unsigned long SRAM_save_size() {
+    return SRAM_size;
+}
 
 void write_SRAM() {
 
-    log_message(LOG_INFO, "write SRAM called\n");
-    // if sufficent time has passed since last file write, write to the .sav file
-    if(get_time() - time_last_SRAM_write > SRAM_WRITE_DELAY){
-        save_SRAM(SRAM_filename, RAM_banks, RAM_bank_count * 0x2000);
+    if (SRAM_override) {
+        return;
+    }
+    unsigned long ram_size = RAM_size;
+    if (mbc3_rtc) {
+        save_rtc_MBC3(RAM_banks + ram_size);
     }
-    // always save to cache that way any load SRAM calls can use the cache
-    save_SRAM_cached(SRAM_cache, RAM_banks, RAM_bank_count * 0x2000);
 
-    time_last_SRAM_write = get_time();
-    SRAM_cache_valid = 1;   // since we always ensure the cache matches the file, it's always valid except on load up
+    // Mapped saves are already in the file
+    if (!SRAM_mapped) {
+        queue_SRAM_write(RAM_banks);
+    } else if (mbc3_rtc) {
+        mark_SRAM_range_dirty(ram_size, RTC_FOOTER_SIZE);
+    }
 }
 
 
 void flush_SRAM() {
-    save_SRAM(SRAM_filename, RAM_banks, RAM_bank_count * 0x2000);
+    if (SRAM_override) {
+        return;
+    }
+    // The clock keeps going without the game writing to RAM
+    if (mbc3_rtc) {
+        write_SRAM();
+    }
+
+    if (SRAM_mapped) {
+        sync_SRAM(1);
+    } else {
+        flush_SRAM_writer();
+    }
 }
 
 
-void read_SRAM() {
+int read_SRAM() {
 
-    size_t len;
-    if((len = load_SRAM(SRAM_filename, RAM_banks, RAM_bank_count * 0x2000))) {
-    if(SRAM_cache_valid){  // depending on if the cache is loaded, use cache or the file
-        len = load_SRAM_cached(SRAM_cache, RAM_banks, RAM_bank_count * 0x2000);
+    unsigned long ram_size = RAM_size;
+
+    if (SRAM_override) {
+        if (override_data == NULL || override_size != SRAM_size) {
+            return 0;
+        }
+        memcpy(RAM_banks, override_data, SRAM_size);
+        if (mbc3_rtc) {
+            load_rtc_MBC3(RAM_banks + ram_size, RTC_FOOTER_SIZE);
+        }
+        return 1;
     }
-    else{
-        len = load_SRAM(SRAM_filename, RAM_banks, RAM_bank_count * 0x2000);
+
+    if (SRAM_mapped) {
+        // Footers missing from the file were zero filled when mapped
+        if (mbc3_rtc) {
+            load_rtc_MBC3(RAM_banks + ram_size, RTC_FOOTER_SIZE);
+        }
+        return SRAM_map_loaded;
     }
 
-    if(len) {
-        if (len !=( RAM_bank_count * 0x2000)) { // Not enough read in
-            memset(RAM_banks, 0, len); //"Erase" what just got read into memory
+    // A save still waiting to be written is newer than the file
+    if (read_queued_SRAM(RAM_banks)) {
+        if (mbc3_rtc) {
+            load_rtc_MBC3(RAM_banks + ram_size, RTC_FOOTER_SIZE);
         }
+        return 1;
     }
-}
 
+    unsigned long len = load_SRAM(SRAM_filename, RAM_banks, SRAM_size);
+    if (len == 0) {
+        return 0;
+    }
 
+    // Saves from before the clock was kept, or with a 32-bit timestamp
+    int clock_len = mbc3_rtc && (len == ram_size || len == ram_size + RTC_FOOTER_SIZE_32);
+    if (len != SRAM_size && !clock_len) { // Not enough read in
+        memset(RAM_banks, 0, len); //"Erase" what just got read into memory
+        return 0;
+    }
 
-void inc_sec_mbc3() {
-	if (mbc3_rtc) {
-		inc_rtc_second();
-	}
+    if (mbc3_rtc) {
+        load_rtc_MBC3(RAM_banks + ram_size, len - ram_size);
+    }
+    return 1;
 }
 
-//TODO
-rtc_regs_MBC3 read_RTC() {
-  	rtc_regs_MBC3 r;
-
-	r.seconds = 0x0;
-	r.minutes = 0x0;
-	r.hours = 0x0;
-	r.days_low = 0x0;
-	r.flags = 0x0;
-	
-	return r;	
-}
 
-//TODO
-void write_RTC(rtc_regs_MBC3 rtc_regs){
-	return;
+int mapped_rom_bank(uint16_t addr) {
+
+    unsigned page = addr >> MBC_PAGE_SHIFT;
+    uint8_t *base = cheat_page_source(page, MBC_page_map[page]);
+    if (base == NULL || addr >= 0x8000) {
+        return -1;
+    }
+
+    // Pages are offset back to the start of the 16KB region they're in
+    uint8_t *bank = base + (addr & 0x4000);
+    if (ROM_paged) {
+        return rom_cache_bank(bank);
+    }
+    if (bank < ROM_banks || bank >= ROM_banks + (unsigned long)ROM_bank_count * ROM_BANK_SIZE) {
+        return -1;
+    }
+    return (bank - ROM_banks) / ROM_BANK_SIZE;
 }
 
 
@@ -128,49 +186,118 @@ static void create_SRAM_filename(const char *filename) {
 }
 
 
+// Cartridge types with battery backed RAM
+static int has_battery(int MBC_no) {
+    switch (MBC_no) {
+        case 0x3: case 0x6: case 0xD: case 0xF: case 0x10: case 0x13:
+        case 0x1B: case 0x1E: case 0x20: case 0xFE: case 0xFF:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+
+/* MBCs which only read switchable ROM banks through
+ * pointers set on bank switches, which can be paged */
+static int supports_paging(int MBC_no) {
+    return (MBC_no >= 0x1 && MBC_no <= 0x3) ||
+           (MBC_no >= 0xF && MBC_no <= 0x13) ||
+           (MBC_no >= 0x19 && MBC_no <= 0x1E);
+}
+
+
 void teardown_MBC() {
-   free(RAM_banks); 
-   free(ROM_banks); 
-   free(SRAM_cache);
+   memset(MBC_read_map, 0, sizeof(MBC_read_map));
+   memset(MBC_page_map, 0, sizeof(MBC_page_map));
+   teardown_SRAM_writer();
+   if (SRAM_mapped) {
+       unmap_SRAM();
+   } else {
+       free(RAM_banks); 
+   }
+   if (ROM_mapped) {
+       unmap_rom();
+   } else if (ROM_paged) {
+       close_rom_cache();
+   } else {
+       free(ROM_banks); 
+   }
 }
 
 int setup_MBC(int MBC_no, unsigned ram_banks, unsigned rom_banks, const char *filename) {
 
     create_SRAM_filename(filename);
     RAM_bank_count = ram_banks + (MBC_no == 0x20 ? 0x80 : 0x0);
+    RAM_size = RAM_bank_count * RAM_BANK_SIZE;
+    // MBC2 RAM is built in, so headers give no RAM size for it
+    if (MBC_no == 0x5 || MBC_no == 0x6) {
+        RAM_bank_count = 0;
+        RAM_size = MBC2_RAM_SIZE;
+    }
+    mbc3_rtc = MBC_no == 0xF || MBC_no == 0x10;
+    SRAM_size = RAM_size + (mbc3_rtc ? RTC_FOOTER_SIZE : 0);
 
 	RAM_banks = NULL;
-	if (RAM_bank_count > 0) {
-    	RAM_banks = malloc(RAM_bank_count * RAM_BANK_SIZE);
+    if (SRAM_size > 0 && SRAM_mapping_enabled() && !SRAM_override && has_battery(MBC_no)) {
+        RAM_banks = map_SRAM(SRAM_filename, SRAM_size, &SRAM_map_loaded);
+        if (RAM_banks == NULL) {
+            log_message(LOG_WARN, "Falling back to reading and writing the save file\n");
+        }
+    }
+
+	if (SRAM_size > 0 && RAM_banks == NULL) {
+    	RAM_banks = calloc(SRAM_size, 1);
     	if (RAM_banks == NULL) {
         	log_message(LOG_ERROR, "Unable to allocate memory for RAM banks\n");
         	return 0;
     	}
 	}
 
-        SRAM_cache = malloc(ram_banks * RAM_BANK_SIZE);
-    	if (SRAM_cache == NULL) {
-        	log_message(LOG_ERROR, "Unable to allocate memory for SRAM cache\n");
-        	return 0;
-    	}
+    if (!SRAM_mapped && !init_SRAM_writer(SRAM_filename, SRAM_size)) {
+        free(RAM_banks);
+        return 0;
+    }
+
+    ROM_banks = NULL;
+    // Compressed ROMs have to be read in whole
+    int archive = is_rom_archive(filename);
+    if (rom_mapping_enabled() && !archive) {
+        ROM_banks = map_rom(filename);
+        if (ROM_banks == NULL) {
+            log_message(LOG_WARN, "Falling back to reading the ROM file\n");
+        }
+    }
+
+    if (ROM_banks == NULL && rom_paging_banks() && supports_paging(MBC_no) && !archive) {
+        ROM_banks = open_rom_cache(filename, rom_banks);
+        if (ROM_banks == NULL) {
+            log_message(LOG_WARN, "Falling back to reading the whole ROM file\n");
+        }
+    }
 
-    ROM_banks = malloc(rom_banks * ROM_BANK_SIZE);
+    if (ROM_banks == NULL) {
+        ROM_banks = malloc(rom_banks * ROM_BANK_SIZE);
+    }
     if (ROM_banks == NULL) {
         log_message(LOG_ERROR, "Unable to allocate memory for ROM banks\n");
-        if (RAM_banks != NULL) {
+        teardown_SRAM_writer();
+        if (SRAM_mapped) {
+            unmap_SRAM();
+        } else if (RAM_banks != NULL) {
 			free(RAM_banks);
 		}
-        if (SRAM_cache != NULL) {
-			free(SRAM_cache);
-		}
         return 0;
     }
     ROM_bank_count = rom_banks;
+    memset(MBC_read_map, 0, sizeof(MBC_read_map));
+    memset(MBC_page_map, 0, sizeof(MBC_page_map));
 
     int flags = 0;
     // MMBC0
     if (MBC_no == 0) {
 
+        map_MBC_read(0x0000, 0x8000, ROM_banks);
         read_MBC = &read_MBC0;
         write_MBC = &write_MBC0;  
 
@@ -213,8 +340,8 @@ int setup_MBC(int MBC_no, unsigned ram_banks, unsigned rom_banks, const char *fi
    } else if(MBC_no >= 0xF && MBC_no <= 0x13) {
    
         switch (MBC_no) {
-            case 0xF : flags = RTC | BATTERY; mbc3_rtc = 1; break;
-            case 0x10: flags = RTC | BATTERY | SRAM; mbc3_rtc = 1; break;
+            case 0xF : flags = RTC | BATTERY; break;
+            case 0x10: flags = RTC | BATTERY | SRAM; break;
             case 0x11: flags = 0; break;
             case 0x12: flags = SRAM; break;
             case 0x13: flags = BATTERY | SRAM; break;
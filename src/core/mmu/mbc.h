@@ -2,12 +2,18 @@
 #define MBC_H
 
 #include <stdint.h>
+#include <stddef.h>
+
+#include "sram_map.h"
+#include "rom_cache.h"
+#include "../cheats.h"
+#include "../code_logger.h"
 
 #define RAM_BANK_SIZE 0x2000 // 8KB
 #define ROM_BANK_SIZE 0x4000 // 16KB
 
-// used to delay the SRAM_write() to file 
-// write to the SRAM file only if it's been XX seconds since we last wrote to it
+/* Without a writer thread, saves are only written to file if it's been
+ * this long since the last write, anything left is written by flush_SRAM */
 #define SRAM_WRITE_DELAY 60000 // 60 seconds
 
 extern uint8_t *RAM_banks;//[][0x2000];  // max 16 * 8KB ram banks (128KB) 0x2000
@@ -15,6 +21,13 @@ extern uint8_t *ROM_banks;//[][0x4000];// max 512 * 16KB rom banks (8MB) 0x4000
 
 extern unsigned ROM_bank_count;
 extern unsigned RAM_bank_count;
+extern unsigned long RAM_size; // Bytes of cartridge RAM, without the MBC3 clock
+
+/* Start of the given ROM bank, which is read in if the ROM
+ * is being paged. Should only be called on bank switches */
+static inline uint8_t *rom_bank_ptr(unsigned bank) {
+    return ROM_paged ? get_rom_bank(bank) : ROM_banks + (bank * ROM_BANK_SIZE);
+}
 
 typedef enum {SRAM = 0x1, BATTERY = 0x2, RTC = 0x4, RUMBLE = 0x8, ACCELEROMETER = 0x10} features;
 
@@ -43,20 +56,20 @@ void teardown_MBC();
 
 
 /* Writes/Reads ROM SRAM from file, used for
- * save games */
+ * save games. Writes are queued and done in the background,
+ * read_SRAM returns 1 if a save was loaded, 0 otherwise.
+ * MBC3 clocks are saved after the RAM, see rtc.h */
 void write_SRAM();
-void flush_SRAM();	// force write to file
-void read_SRAM();
-
+void flush_SRAM();	// wait for queued writes to reach the file
+int read_SRAM();
 
-//Increments the RTC clock in MBC3
-void inc_sec_mbc3();
+/* Load cartridge RAM and clock from data instead of the save file,
+ * which isn't written either, while enabled. Left cleared if data is
+ * NULL or not a full save. Should be set before the ROM is loaded */
+void set_SRAM_override(int enabled, uint8_t const *data, unsigned long size);
 
-/* Writes/Reads RTC data from file,
-   used to emulate MBC3 cartridge clock battery
-   while the game is turned off */
-rtc_regs_MBC3 read_RTC();
-void write_RTC(rtc_regs_MBC3 rtc_regs);
+// Bytes of cartridge RAM and clock saved, as held in RAM_banks
+unsigned long SRAM_save_size();
 
 
 /*  Placeholders for write/read function ptrs
@@ -68,4 +81,41 @@ extern read_MBC_ptr read_MBC;
 extern write_MBC_ptr write_MBC; 
 
 
+/* What each 4KB page of 0x0000 - 0x7FFF and 0xA000 - 0xBFFF currently
+ * reads from, published by the MBC whenever its registers change.
+ * Pointers are offset back by the page address so they're indexed by the
+ * full address. NULL pages are special (RAM disabled, RTC registers,
+ * MBC2 RAM, MBC6 flash, HuC3 IR/clock) and go through read_MBC */
+#define MBC_PAGE_SHIFT 12
+extern uint8_t *MBC_read_map[0x10];
+
+/* What the MBC last published for each page. MBC_read_map is the same
+ * except while code logging, when it's kept empty so every cartridge
+ * read goes through read_MBC */
+extern uint8_t *MBC_page_map[0x10];
+
+/* Map size bytes from the given address to base, already offset by
+ * start, or NULL to read them through read_MBC. Pages with Game Genie
+ * patches are mapped to a patched copy instead */
+static inline void map_MBC_read(uint16_t start, uint16_t size, uint8_t *base) {
+    for (unsigned page = start >> MBC_PAGE_SHIFT;
+            page < (start + (unsigned)size) >> MBC_PAGE_SHIFT; page++) {
+        uint8_t *mapped = (cheat_pages >> page) & 1 ? shadow_cheat_page(page, base) : base;
+        MBC_page_map[page] = mapped;
+        MBC_read_map[page] = code_logging ? NULL : mapped;
+    }
+}
+
+/* ROM bank currently mapped at addr (0x0000 - 0x7FFF),
+ * or -1 if it can't be told from MBC_page_map */
+int mapped_rom_bank(uint16_t addr);
+
+/* Read from cartridge ROM/RAM, directly if the page is mapped.
+ * addr must be in 0x0000 - 0x7FFF or 0xA000 - 0xBFFF */
+static inline uint8_t read_MBC_mapped(uint16_t addr) {
+    uint8_t const *base = MBC_read_map[addr >> MBC_PAGE_SHIFT];
+    return base ? base[addr] : read_MBC(addr);
+}
+
+
 #endif //MBC_H
@@ -25,6 +25,21 @@ static int ram_banking = 0;  // 0: RAM banking off, 1: RAM banking on
 static int battery = 0;
 
 
+// Publish the current banks for reads that skip read_MBC1
+static void update_read_map()
+{
+    map_MBC_read(0x0000, ROM_BANK_SIZE, cur_ROM_bank_0);
+    map_MBC_read(0x4000, ROM_BANK_SIZE, cur_ROM_bank);
+
+    uint8_t *ram = NULL;
+    if (ram_banking) {
+        int bank = (bank_mode == 0) ? 0 : (cur_RAM_bank_num % RAM_bank_count);
+        ram = RAM_banks + (bank * RAM_BANK_SIZE) - 0xA000;
+    }
+    map_MBC_read(0xA000, RAM_BANK_SIZE, ram);
+}
+
+
 static void set_cur_ROM_bank()
 {
     int full_bank = cur_ROM_bank_num;
@@ -37,10 +52,11 @@ static void set_cur_ROM_bank()
     }
      
     full_bank %= ROM_bank_count;
-    cur_ROM_bank = &ROM_banks[(full_bank * ROM_BANK_SIZE) - 0x4000];
+    cur_ROM_bank = rom_bank_ptr(full_bank) - 0x4000;
 
     full_rom_bank_0 %= ROM_bank_count;
-    cur_ROM_bank_0 = &ROM_banks[full_rom_bank_0 * ROM_BANK_SIZE];
+    cur_ROM_bank_0 = rom_bank_ptr(full_rom_bank_0);
+    update_read_map();
 }
 
 
@@ -98,6 +114,7 @@ void write_MBC1(uint16_t addr, uint8_t val) {
                     
                     if (RAM_bank_count > 0) {
                         ram_banking = ((val & 0xF) == 0xA);
+                        update_read_map();
 		            }
                     break;
         case 0x2000:
@@ -129,6 +146,7 @@ void write_MBC1(uint16_t addr, uint8_t val) {
                     if (ram_banking) {
                         int bank = (bank_mode == 0) ? 0 : (cur_RAM_bank_num % RAM_bank_count) ;
                         RAM_banks[(bank * RAM_BANK_SIZE) | (addr - 0xA000)]= val; 
+                        MARK_SRAM_DIRTY((bank * RAM_BANK_SIZE) | (addr - 0xA000));
                     }
                     break;
     }    
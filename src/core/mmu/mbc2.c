@@ -17,12 +17,23 @@ static int cur_ROM_bank = 1; // Current ROM bank 0x0 - 0x0F
 static int ram_banking = 0;  // 0: RAM banking off, 1: RAM banking on
 static int battery = 0;
 
+
+/* Publish the current ROM banks for reads that skip read_MBC2,
+ * the 4 bit RAM always goes through read_MBC2 */
+static void update_read_map() {
+    map_MBC_read(0x0000, ROM_BANK_SIZE, ROM_banks);
+    map_MBC_read(0x4000, ROM_BANK_SIZE,
+        ROM_banks + ((cur_ROM_bank % ROM_bank_count) * ROM_BANK_SIZE) - 0x4000);
+}
+
+
 void setup_MBC2(int flags) {
     battery = (flags & BATTERY) ? 1 : 0;
     // Check for previous saves if Battery active
     if (battery) {
         read_SRAM();
     }
+    update_read_map();
 }
 
 
@@ -69,12 +80,14 @@ void write_MBC2(uint16_t addr, uint8_t val) {
         case 0x3000:/* Set ROM bank */
                     if ((addr & 0x100) != 0x0) {
                         cur_ROM_bank = (val & 0xF) + ((val & 0xF) == 0);
+                        update_read_map();
                     }
                     break;
         
         case 0xA000: // Write to RAM bank if RAM banking enabled
                     if (ram_banking) {
                         RAM_banks[addr & 0x1FF] = val & 0xF; 
+                        MARK_SRAM_DIRTY(addr & 0x1FF);
                     }
                     break;
     }    
@@ -1,6 +1,8 @@
 #ifndef MBC2_H
 #define MBC2_H
 
+#define MBC2_RAM_SIZE 0x200 // 512 x 4 bits, built in
+
 
 void setup_MBC2(int flags);
 
@@ -2,11 +2,13 @@
 #include "mbc3.h"
 #include "memory.h"
 #include "../bits.h"
+#include "rtc.h"
 
-#include  <time.h>
+#include <string.h>
 
-static int cur_RAM_bank = 0;
+static unsigned cur_RAM_bank = 0;
 static int cur_ROM_bank = 1;
+static uint8_t *cur_ROM_bank_ptr; // Current ROM bank, offset to be indexed from 0x4000
 static int ram_enabled = 0;
 static int last_latch = 0;
 
@@ -14,44 +16,163 @@ static int battery = 0;
 static int rtc_enabled = 0;
 static int sram_modified = 0;
 
+/* rtc_regs holds the clock as of rtc_base_ms, whole seconds since
+ * then are only added when the clock is latched, written or saved */
 static rtc_regs_MBC3 rtc_regs, latch_regs;
+static uint64_t rtc_base_ms = 0;
 
 
-void inc_rtc_second() {
-  if ((rtc_regs.flags & BIT_6) == 0) {
+static uint32_t get_u32(uint8_t const *buf) {
+    return buf[0] | (buf[1] << 8) | (buf[2] << 16) | ((uint32_t)buf[3] << 24);
+}
+
+
+static void put_u32(uint8_t *buf, uint32_t val) {
+    buf[0] = val;
+    buf[1] = val >> 8;
+    buf[2] = val >> 16;
+    buf[3] = val >> 24;
+}
+
+
+static void add_rtc_seconds(uint64_t seconds) {
+
+    if (seconds == 0) {
+        return;
+    }
+
+    uint64_t total = rtc_regs.seconds + seconds;
+    rtc_regs.seconds = total % 60;
+    total = total / 60 + rtc_regs.minutes;
+    rtc_regs.minutes = total % 60;
+    total = total / 60 + rtc_regs.hours;
+    rtc_regs.hours = total % 24;
+    total = total / 24 + (rtc_regs.days_low | ((rtc_regs.flags & BIT_0) << 8));
+
+    // Day counter is 9 bits, the carry stays set until cleared by the game
+    if (total >= 512) {
+        rtc_regs.flags |= BIT_7;
+        total %= 512;
+    }
+    rtc_regs.days_low = total & 0xFF;
+    rtc_regs.flags = (rtc_regs.flags & ~BIT_0) | (total >> 8);
+}
 
-  	if(++rtc_regs.seconds >= 60) {
-      rtc_regs.seconds = 0;
 
-      if(++rtc_regs.minutes >= 60) {
-        rtc_regs.minutes = 0;
+// Bring rtc_regs up to date, keeping any part second in rtc_base_ms
+static void update_rtc() {
 
-        if(++rtc_regs.hours >= 24) {
-          rtc_regs.hours = 0;
+    uint64_t now = rtc_time();
 
-		  if (++rtc_regs.days_low == 0) {
-		  	if (rtc_regs.flags & 0x1) {
-				rtc_regs.flags |= 0x7;
-			} else {
-				rtc_regs.flags |= 0x1;
-			}	
-          }
-        }
-      }
+    // Halted or the host clock went backwards
+    if ((rtc_regs.flags & BIT_6) || now < rtc_base_ms) {
+        rtc_base_ms = now;
+        return;
     }
-  }
+
+    uint64_t elapsed = (now - rtc_base_ms) / 1000;
+    rtc_base_ms += elapsed * 1000;
+    add_rtc_seconds(elapsed);
 }
 
 
+static void write_rtc_reg(uint8_t val) {
+
+    update_rtc();
+    switch (cur_RAM_bank) {
+        case 0x8: rtc_regs.seconds = val & 0x3F;
+                  rtc_base_ms = rtc_time(); // Resets the part second
+                  break;
+        case 0x9: rtc_regs.minutes = val & 0x3F; break;
+        case 0xA: rtc_regs.hours = val & 0x1F; break;
+        case 0xB: rtc_regs.days_low = val; break;
+        case 0xC: rtc_regs.flags = val & (BIT_7 | BIT_6 | BIT_0); break;
+    }
+}
+
+
+static void put_rtc_regs(uint8_t *buf, rtc_regs_MBC3 const *regs) {
+    put_u32(buf, regs->seconds);
+    put_u32(buf + 4, regs->minutes);
+    put_u32(buf + 8, regs->hours);
+    put_u32(buf + 12, regs->days_low);
+    put_u32(buf + 16, regs->flags);
+}
+
+
+static void get_rtc_regs(uint8_t const *buf, rtc_regs_MBC3 *regs) {
+    regs->seconds = get_u32(buf) & 0x3F;
+    regs->minutes = get_u32(buf + 4) & 0x3F;
+    regs->hours = get_u32(buf + 8) & 0x1F;
+    regs->days_low = get_u32(buf + 12);
+    regs->flags = get_u32(buf + 16) & (BIT_7 | BIT_6 | BIT_0);
+}
+
+
+void save_rtc_MBC3(uint8_t *footer) {
+
+    update_rtc();
+    put_rtc_regs(footer, &rtc_regs);
+    put_rtc_regs(footer + 20, &latch_regs);
+
+    uint64_t timestamp = rtc_host_seconds();
+    put_u32(footer + 40, timestamp);
+    put_u32(footer + 44, timestamp >> 32);
+}
+
+
+int load_rtc_MBC3(uint8_t const *footer, unsigned long len) {
+
+    if (len < RTC_FOOTER_SIZE_32) {
+        return 0;
+    }
+
+    uint64_t timestamp = get_u32(footer + 40);
+    if (len >= RTC_FOOTER_SIZE) {
+        timestamp |= (uint64_t)get_u32(footer + 44) << 32;
+    }
+    // Zero filled, never saved
+    if (timestamp == 0) {
+        return 0;
+    }
+
+    get_rtc_regs(footer, &rtc_regs);
+    get_rtc_regs(footer + 20, &latch_regs);
+    rtc_base_ms = rtc_time();
+
+    // Catch up on the time the game was off for
+    uint64_t now = rtc_host_seconds();
+    if (get_rtc_mode() == RTC_HOST_TIME && !(rtc_regs.flags & BIT_6) && now > timestamp) {
+        add_rtc_seconds(now - timestamp);
+    }
+    return 1;
+}
+
+
+/* Publish the current banks for reads that skip read_MBC3,
+ * RTC registers go through read_MBC3 */
+static void update_read_map() {
+    map_MBC_read(0x0000, ROM_BANK_SIZE, ROM_banks);
+    map_MBC_read(0x4000, ROM_BANK_SIZE, cur_ROM_bank_ptr);
+    map_MBC_read(0xA000, RAM_BANK_SIZE, ram_enabled && cur_RAM_bank < RAM_bank_count ?
+        RAM_banks + (cur_RAM_bank * RAM_BANK_SIZE) - 0xA000 : NULL);
+}
 
 
 void setup_MBC3(int flags) {
     battery = (flags & BATTERY) ? 1 : 0;
     rtc_enabled = (flags & RTC) ? 1 : 0;
 
+    memset(&rtc_regs, 0, sizeof(rtc_regs));
+    latch_regs = rtc_regs;
+    rtc_base_ms = rtc_time();
+
+    // Also loads the clock, if one was saved
     if (battery) {
         read_SRAM();
     }
+    cur_ROM_bank_ptr = rom_bank_ptr(cur_ROM_bank % ROM_bank_count) - 0x4000;
+    update_read_map();
 }
 
 uint8_t read_MBC3(uint16_t addr) {
@@ -68,7 +189,7 @@ uint8_t read_MBC3(uint16_t addr) {
      case 0x5000:
      case 0x6000:
      case 0x7000: // Reading from current ROM bank 1 
-                return ROM_banks[(cur_ROM_bank * ROM_BANK_SIZE) | (addr - 0x4000)];
+                return cur_ROM_bank_ptr[addr];
                 break;
         
      case 0xA000:
@@ -104,20 +225,25 @@ void write_MBC3(uint16_t addr, uint8_t val) {
                         sram_modified = 0;
                     }
                     ram_enabled = ((val & 0xF) == 0xA);
+                    update_read_map();
                     break;
         case 0x2000:
         case 0x3000:/* Set ROM bank, if result is 0,
                      * increment the bank as it cannot be used */
                     cur_ROM_bank = (val & 0x7F) + ((val & 0x7F) == 0);
+                    cur_ROM_bank_ptr = rom_bank_ptr(cur_ROM_bank % ROM_bank_count) - 0x4000;
+                    update_read_map();
                     break;
         case 0x4000: 
         case 0x5000: // Set current RAM/RTC mode and banks
                     cur_RAM_bank =  val & 15;
+                    update_read_map();
                     break;
         case 0x6000: 
         case 0x7000: //Latch to RTC reg if 0x0 followed by 0x1 written
                     if (ram_enabled && rtc_enabled) { 
                         if (last_latch == 0x0 && (val == 0x1)) {
+							 update_rtc();
 							 latch_regs = rtc_regs;
                         }   
                         last_latch = val; 
@@ -127,16 +253,12 @@ void write_MBC3(uint16_t addr, uint8_t val) {
         case 0xB000: // Write to external RAM bank if RAM banking enabled 
                     if (ram_enabled && cur_RAM_bank < RAM_bank_count && RAM_banks[(cur_RAM_bank * RAM_BANK_SIZE) | (addr - 0xA000)] != val) {
                         RAM_banks[(cur_RAM_bank * RAM_BANK_SIZE) | (addr - 0xA000)] = val;                       
+                        MARK_SRAM_DIRTY((cur_RAM_bank * RAM_BANK_SIZE) | (addr - 0xA000));
                         sram_modified = 1;
                     // Write to RTC
-                    } else if (ram_enabled && rtc_enabled) {
-                    	switch (cur_RAM_bank) {
-							case 0x8: rtc_regs.seconds = val; break;
-							case 0x9: rtc_regs.minutes = val; break;
-							case 0xA: rtc_regs.hours = val; break;
-							case 0xB: rtc_regs.days_low = val; break;
-							case 0xC: rtc_regs.flags = val; break;	
-						}
+                    } else if (ram_enabled && rtc_enabled && cur_RAM_bank >= 0x8 && cur_RAM_bank <= 0xC) {
+                        write_rtc_reg(val);
+                        sram_modified = 1;
                     }
                     break;
     }    
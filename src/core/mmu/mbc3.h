@@ -1,13 +1,18 @@
 #ifndef MBC3_H
 #define MBC3_H
 
-void set_rtc_MBC3();
-void write_rtc_MBC3();
-
-void inc_rtc_second();
+#include <stdint.h>
 
 void setup_MBC3(int flags);
 uint8_t read_MBC3(uint16_t addr);
 void   write_MBC3(uint16_t addr, uint8_t val);
 
+/* Store the clock in the RTC_FOOTER_SIZE bytes
+ * saved after cartridge RAM */
+void save_rtc_MBC3(uint8_t *footer);
+
+/* Restore the clock from len bytes saved after cartridge RAM.
+ * returns 1 if a clock was loaded, 0 otherwise */
+int load_rtc_MBC3(uint8_t const *footer, unsigned long len);
+
 #endif //MBC3_H
@@ -18,12 +18,23 @@ static int sram_modified = 0;
 static uint8_t *cur_ROM_bank = 0;
 
 
+// Publish the current banks for reads that skip read_MBC5
+static void update_read_map()
+{
+    map_MBC_read(0x0000, ROM_BANK_SIZE, ROM_banks);
+    map_MBC_read(0x4000, ROM_BANK_SIZE, cur_ROM_bank);
+    map_MBC_read(0xA000, RAM_BANK_SIZE, ram_banking && RAM_bank_count > 0 ?
+        RAM_banks + (cur_RAM_bank * RAM_BANK_SIZE) - 0xA000 : NULL);
+}
+
+
 static void set_cur_ROM_bank()
 {
     int full_rom_bank = rom_bank_hi_bit << 8 | rom_bank_low;
      
     full_rom_bank %= ROM_bank_count;
-    cur_ROM_bank = &ROM_banks[(full_rom_bank * ROM_BANK_SIZE) - 0x4000];
+    cur_ROM_bank = rom_bank_ptr(full_rom_bank) - 0x4000;
+    update_read_map();
 }
 
 
@@ -70,6 +81,7 @@ void write_MBC5(uint16_t addr, uint8_t val) {
                         sram_modified = 0;
                     }
                     ram_banking = (val == 0xA);
+                    update_read_map();
                     break;
         case 0x2000: // Set lower 8 bits of ROM bank */
                     rom_bank_low = val;
@@ -82,11 +94,13 @@ void write_MBC5(uint16_t addr, uint8_t val) {
         case 0x4000: 
         case 0x5000: // Set current RAM bank 0 - F
                      cur_RAM_bank = (val & 0xF) & (RAM_bank_count - 1);
+                     update_read_map();
                      break;
         case 0xA000:
         case 0xB000: // Write to external RAM bank if RAM banking enabled 
                     if (ram_banking && RAM_banks[(cur_RAM_bank * RAM_BANK_SIZE) | (addr - 0xA000)] != val) {
                         RAM_banks[(cur_RAM_bank * RAM_BANK_SIZE) | (addr - 0xA000)] = val; 
+                        MARK_SRAM_DIRTY((cur_RAM_bank * RAM_BANK_SIZE) | (addr - 0xA000));
                         sram_modified = 1;
                     }
                     break;
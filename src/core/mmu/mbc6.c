@@ -22,6 +22,20 @@ static int battery = 0;
 static int sram_modified = 0;
 
 static uint8_t *flash_banks;
+static unsigned long flash_offset; // Offset of flash_banks into RAM_banks
+
+/* Publish the current banks for reads that skip read_MBC6,
+ * flash banks go through read_MBC6 for its status reads */
+static void update_read_map() {
+    map_MBC_read(0x0000, ROM_BANK_SIZE, ROM_banks);
+    map_MBC_read(0x4000, 0x2000, (cur_ROM_bankA & 0x80) ? NULL :
+        ROM_banks + (cur_ROM_bankA << 13) - 0x4000);
+    map_MBC_read(0x6000, 0x2000, (cur_ROM_bankB & 0x80) ? NULL :
+        ROM_banks + (cur_ROM_bankB << 13) - 0x6000);
+    map_MBC_read(0xA000, 0x1000, ram_enabled ? RAM_banks + (cur_RAM_bankA << 12) - 0xA000 : NULL);
+    map_MBC_read(0xB000, 0x1000, ram_enabled ? RAM_banks + (cur_RAM_bankB << 12) - 0xB000 : NULL);
+}
+
 
 void write_flash(uint32_t addr, uint8_t val) {
     static uint8_t data[0x80];
@@ -46,6 +60,7 @@ void write_flash(uint32_t addr, uint8_t val) {
                     for (uint32_t i = 0; i < 0x80; ++i) {
                         flash_banks[prog_addr + i] &= data[i];
                     }
+                    mark_SRAM_range_dirty(flash_offset + prog_addr, 0x80);
                     flash_state = 0xF0;
                     prog_addr = -1;
                 }
@@ -79,10 +94,12 @@ void write_flash(uint32_t addr, uint8_t val) {
         }
     } else if (addr == 0x5555 && val == 0x10 && flash_state == -0x55) {
         memset(flash_banks, 0xFF, 0x100000);
+        mark_SRAM_range_dirty(flash_offset, 0x100000);
         flash_erase |= 0x1;
     } else if ((addr & 0x1FFF) == 0) {
         if (val == 0x30 && flash_state == -0x55) {
             memset(flash_banks + addr, 0xFF, 0x2000);
+            mark_SRAM_range_dirty(flash_offset + addr, 0x2000);
             flash_erase |= 0x2;
         } else if (val == 0xF0 && flash_state == 0x55) {
             flash_erase &= 0x1;
@@ -93,10 +110,13 @@ void write_flash(uint32_t addr, uint8_t val) {
 
 void setup_MBC6(int flags) {
     battery = (flags & BATTERY) ? 1 : 0;
-    flash_banks = RAM_banks + (RAM_bank_count - 0x80) * 0x2000;
+    flash_offset = (RAM_bank_count - 0x80) * 0x2000;
+    flash_banks = RAM_banks + flash_offset;
     if (battery && !read_SRAM()) {
         memset(flash_banks, 0xFF, 0x100000);
+        mark_SRAM_range_dirty(flash_offset, 0x100000);
     }
+    update_read_map();
 }
 
 uint8_t read_MBC6(uint16_t addr) {
@@ -145,7 +165,7 @@ uint8_t read_MBC6(uint16_t addr) {
                  return ram_enabled ? RAM_banks[(cur_RAM_bankA << 12) | (addr - 0xA000)] : 0xFF;
         
      case 0xB000: // Read from RAM (B)
-                 return ram_enabled ? RAM_banks[(cur_RAM_bankB << 12) | (addr - 0xA000)] : 0xFF;
+                 return ram_enabled ? RAM_banks[(cur_RAM_bankB << 12) | (addr & 0x0FFF)] : 0xFF;
     };
     // Failed to read
     return 0x0;
@@ -162,12 +182,15 @@ void write_MBC6(uint16_t addr, uint8_t val) {
                         sram_modified = 0;
                     }
                     ram_enabled = (val == 0xA);
+                    update_read_map();
                     break;
         case 0x0400: // Set current RAM bank (A)
                     cur_RAM_bankA = val & (RAM_bank_count * 2 - 0x101);
+                    update_read_map();
                     break;
         case 0x0800: // Set current RAM bank (B)
                     cur_RAM_bankB = val & (RAM_bank_count * 2 - 0x101);
+                    update_read_map();
                     break;
         case 0x0C00: // Enable/Disable flash
                     if (flash_enabled & 0x2) {
@@ -185,18 +208,22 @@ void write_MBC6(uint16_t addr, uint8_t val) {
         case 0x2000:
         case 0x2400: // Set current ROM bank (A)
                     cur_ROM_bankA = (val & 0x7F) | (cur_ROM_bankA & 0x80);
+                    update_read_map();
                     break;
         case 0x2800:
         case 0x2C00: // Switch ROM/flash (A)
                     cur_ROM_bankA = (val == 0x8) << 7 | (cur_ROM_bankA & 0x7F);
+                    update_read_map();
                     break;
         case 0x3000:
         case 0x3400: // Set current ROM bank (B)
                     cur_ROM_bankB = (val & 0x7F) | (cur_ROM_bankB & 0x80);
+                    update_read_map();
                     break;
         case 0x3800:
         case 0x3C00: // Switch ROM/flash (B)
                     cur_ROM_bankB = (val == 0x8) << 7 | (cur_ROM_bankB & 0x7F);
+                    update_read_map();
                     break;
         case 0x4000:
         case 0x4400:
@@ -228,6 +255,7 @@ void write_MBC6(uint16_t addr, uint8_t val) {
         case 0xAC00: // Write to RAM (A)
                     if (ram_enabled && RAM_banks[(cur_RAM_bankA << 12) | (addr & 0x0FFF)] != val) {
                         RAM_banks[(cur_RAM_bankA << 12) | (addr & 0x0FFF)] = val;
+                        MARK_SRAM_DIRTY((cur_RAM_bankA << 12) | (addr & 0x0FFF));
                         sram_modified = 1;
                     }
                     break;
@@ -237,6 +265,7 @@ void write_MBC6(uint16_t addr, uint8_t val) {
         case 0xBC00: // Write to RAM (B)
                     if (ram_enabled && RAM_banks[(cur_RAM_bankB << 12) | (addr & 0x0FFF)] != val) {
                         RAM_banks[(cur_RAM_bankB << 12) | (addr & 0x0FFF)] = val;
+                        MARK_SRAM_DIRTY((cur_RAM_bankB << 12) | (addr & 0x0FFF));
                         sram_modified = 1;
                     }
                     break;
@@ -1,5 +1,7 @@
 #include "memory.h"
 #include "mbc.h"
+#include "mmm01.h"
+#include "rom_map.h"
 #include "hdma.h"
 
 #include <stdio.h>
@@ -9,11 +11,15 @@
 #include "../rom_info.h"
 #include "../graphics.h"
 #include "../sprite_priorities.h"
+#include "../render_thread.h"
 #include "../interrupts.h"
 #include "../bits.h"
 #include "../sound.h"
 #include "../serial_io.h"
 #include "../lcd.h"
+#include "../rom_archive.h"
+#include "../code_logger.h"
+#include "../input.h"
 
 #include "../../non_core/joypad.h"
 #include "../../non_core/logger.h"
@@ -21,14 +27,6 @@
 
 #include <string.h>
 
-// UEFI libc won't link memmove
-#ifdef EFIAPI
-#include "../platforms/UEFI/libs.h"
-#define PB_MEMMOVE uefi_memmove
-#else
-#define PB_MEMMOVE memmove
-#endif
-
 static uint8_t mem[0xE000 - 0x8000];
 
 uint8_t *oam_mem_ptr;
@@ -357,9 +355,10 @@ static uint8_t cgb_boot_rom[] = {
 
 
 
-// Header in MMM01 Roms are placed at the end
-// of the ROM instead of at the beginning
-void check_mmm01_format(unsigned char *file_data, size_t size) {
+/* Header in MMM01 Roms are placed at the end of the ROM
+ * instead of at the beginning, rather than moving the whole
+ * ROM the MMM01 remaps its banks */
+void check_mmm01_format(unsigned char const *file_data, size_t size) {
     if (size < 0x8000) {
         return;
     }
@@ -367,17 +366,12 @@ void check_mmm01_format(unsigned char *file_data, size_t size) {
     unsigned char const *header_data = file_data + (size - 0x8000);
     unsigned char rom_code = header_data[0x147];
     
-    // If Header is at the end place it at the front
     if (header_data[0x104] == 0xCE && header_data[0x105] == 0xED &&
         header_data[0x106] == 0x66 && header_data[0x107] == 0x66 &&
         header_data[0x108] == 0xCC && header_data[0x109] == 0x0D &&
         rom_code >= 0xB && rom_code <= 0xD) {
     
-            unsigned char temp[0x8000];
-            memcpy(temp, header_data, 0x8000);
-            PB_MEMMOVE(file_data + 0x8000, file_data, size - 0x8000);
-            memcpy(file_data, temp, 0x8000); 
-    
+            relocate_MMM01_header(size);
     }
 }
 
@@ -428,12 +422,26 @@ int load_rom(char const *filename, uint8_t header[0x50], int const dmg_mode) {
     
     size_t rom_size = rom_banks * ROM_BANK_SIZE;
     size_t read_size;
-    if (!(read_size = load_rom_from_file(filename, ROM_banks, rom_banks * 0x4000))) {
+    if (ROM_paged) {
+        // Size was checked when the cache was opened
+        read_size = rom_size;
+    } else if (ROM_mapped) {
+        // Any data past the size given in the header is ignored
+        read_size = mapped_rom_size() < rom_size ? mapped_rom_size() : rom_size;
+    } else if (is_rom_archive(filename)) {
+        if (!(read_size = load_rom_from_archive(filename, ROM_banks, rom_size))) {
+            log_message(LOG_ERROR, "failed to load ROM\n");
+            return 0;
+        }
+    } else if (!(read_size = load_rom_from_file(filename, ROM_banks, rom_banks * 0x4000))) {
         log_message(LOG_ERROR, "failed to load ROM\n");
         return 0;
     }
     
-    check_mmm01_format(ROM_banks, read_size);
+    // Only bank 0 is read in when paged, and MMM01s aren't paged
+    if (!ROM_paged) {
+        check_mmm01_format(ROM_banks, read_size);
+    }
 
     // Data read in doesn't match header information
     if (read_size != rom_size) {
@@ -463,6 +471,7 @@ static void oam_set_mem(uint8_t addr, uint8_t val) {
     // Check not unusable RAM (i.e. not 0xFEA0 - 0xFEFF)
     if (addr < 0xA0) {
         oam_mem[addr] = val;
+        LOG_RENDER_WRITE(RENDER_OAM, addr, val);
         /* If Object X position is written to, reorganise
          * sprite priorities for rendering */
         if((addr - 1) % 4 == 0) {
@@ -480,39 +489,16 @@ static void oam_set_mem(uint8_t addr, uint8_t val) {
  * address XX00 */
 static void dma_transfer(uint8_t val) {        
     uint16_t source_addr = val << 8;
+    if (code_logging) {
+        log_DMA(1);
+    }
     for (int i = 0; i < 0xA0; i++) {
         oam_mem[i] = get_mem(source_addr + i);
+        LOG_RENDER_WRITE(RENDER_OAM, i, oam_mem[i]);
     }
-}
-
-
-/* Keypad is written to, update register with state */
-static void joypad_write(uint8_t joypad_state) {
-    
-    joypad_state |= 0xF; // unset all keys
-
-    // Check directional keys
-    if (joypad_state & BIT_5) {
-        joypad_state &= ~(down_pressed() << 3);
-        joypad_state &= ~(up_pressed() << 2);
-        joypad_state &= ~(left_pressed() << 1);
-        joypad_state &= ~(right_pressed());
-    } 
-    // Check other 4 keys
-    else if (joypad_state & BIT_4) {
-        joypad_state &= ~(start_pressed() << 3);
-        joypad_state &= ~(select_pressed() << 2);
-        joypad_state &= ~(b_pressed() << 1);
-        joypad_state &= ~(a_pressed());
-    }
-    
-    /* Raise joypad interrupt if a key
-     * was pressed */
-    if ((joypad_state & 0xF) != 0xF) {
-        raise_interrupt(JOYPAD_INT);
+    if (code_logging) {
+        log_DMA(0);
     }
-
-    io_mem[P1_REG] = joypad_state;
 }
 
 /* Write to IO memory given address 0 - 0xFF */
@@ -527,7 +513,7 @@ void io_write_mem(uint8_t addr, uint8_t val) {
     switch (addr) {
         
         /* Check Joypad values */
-        case P1_REG  : io_mem[addr] = val; joypad_write(val); break;
+        case P1_REG  : write_P1(val); break;
         /*  Attempting to set DIV reg resets it to 0 
          * DIV is also actually 16-bits with the lwoer bits being the timer_counter
          * reset this too 
@@ -718,6 +704,7 @@ void io_write_mem(uint8_t addr, uint8_t val) {
                         int old_palette_mem = bg_palette_mem[bgpi & 0x3F];
                         bg_palette_mem[bgpi & 0x3F] = val;
                         bg_palette_dirty |= (old_palette_mem != val);
+                        LOG_RENDER_WRITE(RENDER_BG_PALETTE, bgpi & 0x3F, val);
 
                         /* Check if Auto Increment bit is set in Background Palette Index,
                            and increment the index if so. Index is between 0x0 and 0x3F */
@@ -753,6 +740,7 @@ void io_write_mem(uint8_t addr, uint8_t val) {
                         uint8_t old_val = sprite_palette_mem[sppi & 0x3F];
                         sprite_palette_mem[sppi & 0x3F] = val;
                         sprite_palette_dirty |= (old_val != val);
+                        LOG_RENDER_WRITE(RENDER_SPRITE_PALETTE, sppi & 0x3F, val);
                         
                         /* Check if Auto Increment bit is set in Sprite Palette Index,
                            and increment the index if so. Index is between 0x0 and 0x3F */
@@ -854,6 +842,7 @@ void set_mem(uint16_t addr, uint8_t const val) {
         // Check if writting to alternative VRAM with Gameboy Color
         if (cgb && cgb_vram_bank && addr >= 0x8000 && addr < 0xA000) {
             vram_bank_1[addr - 0x8000] = val;
+            LOG_RENDER_WRITE(RENDER_VRAM1, addr - 0x8000, val);
             return;
         }
 
@@ -863,6 +852,11 @@ void set_mem(uint16_t addr, uint8_t const val) {
         }
 
         mem[addr - 0x8000] = val;
+#ifdef THREADED_RENDER
+        if (addr < 0xA000) {
+            LOG_RENDER_WRITE(RENDER_VRAM0, addr - 0x8000, val);
+        }
+#endif
         return;
     }
     
@@ -879,10 +873,26 @@ void set_mem(uint16_t addr, uint8_t const val) {
 }
 
 
+// Write to 0xD000 - 0xDFFF of the given WRAM bank, whichever is selected
+void set_wram_bank_mem(unsigned bank, uint16_t addr, uint8_t val) {
+
+    bank &= 0x7;
+    if (cgb && bank > 1) {
+        cgb_ram_banks[bank - 2][addr - 0xD000] = val;
+    } else {
+        mem[addr - 0x8000] = val;
+    }
+}
+
+
 uint8_t get_vram1(uint16_t addr) {
     return vram_bank_1[addr - 0x8000];
 }
 
+uint8_t *get_vram_bank(int bank) {
+    return bank ? vram_bank_1 : mem;
+}
+
 uint8_t get_vram(uint16_t addr, int bank) {
     if (bank) {
         return vram_bank_1[addr - 0x8000];
@@ -919,7 +929,7 @@ uint8_t get_mem(uint16_t addr) {
     } 
     // Check if reading from Memory Bank Controller
     if (addr < 0x8000 || ((uint16_t)(addr - 0xA000) < 0x2000)) {
-        return read_MBC(addr);   
+        return read_MBC_mapped(addr);   
     }
 
     if ((uint16_t)(addr - ECHO_RAM_START) < 0x1DFF) { 
@@ -953,6 +963,20 @@ uint8_t get_mem(uint16_t addr) {
 }
 
 
+uint8_t peek_mem(uint16_t addr) {
+
+    uint8_t const *base = NULL;
+    if (addr < 0x8000 || ((uint16_t)(addr - 0xA000) < 0x2000)) {
+        base = MBC_page_map[addr >> MBC_PAGE_SHIFT];
+    }
+    // Unmapped pages go through the MBC, which doesn't log them
+    if (base == NULL || (is_booting && addr < 0x900)) {
+        return get_mem(addr);
+    }
+    return base[addr];
+}
+
+
 /* Write 16bit value starting at the given memory address 
  * into memory.  Written in little-endian byte order */
 void set_mem_16(uint16_t const loc, uint16_t const val) {
@@ -1012,3 +1036,28 @@ void teardown_memory() {
     teardown_MBC();
 }
 
+
+static uint32_t fnv_hash(uint32_t hash, uint8_t const *data, size_t size) {
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ data[i]) * 16777619u;
+    }
+    return hash;
+}
+
+
+uint32_t hash_memory(uint32_t hash) {
+
+    hash = fnv_hash(hash, mem, sizeof(mem));
+    hash = fnv_hash(hash, &cgb_ram_banks[0][0], sizeof(cgb_ram_banks));
+    hash = fnv_hash(hash, vram_bank_1, sizeof(vram_bank_1));
+    hash = fnv_hash(hash, oam_mem_ptr, sizeof(oam_mem));
+    hash = fnv_hash(hash, io_mem, 0x100);
+    hash = fnv_hash(hash, bg_palette_mem, sizeof(bg_palette_mem));
+    hash = fnv_hash(hash, sprite_palette_mem, sizeof(sprite_palette_mem));
+    // Without the MBC3 clock footer, which holds the time it was saved
+    if (RAM_banks) {
+        hash = fnv_hash(hash, RAM_banks, RAM_size);
+    }
+    return hash;
+}
+
@@ -37,6 +37,9 @@ uint8_t get_vram0(uint16_t addr);
 
 uint8_t get_vram1(uint16_t addr);
 
+// Pointer to the start of the given VRAM bank (0x8000)
+uint8_t *get_vram_bank(int bank);
+
 uint8_t oam_get_mem(uint8_t addr);
 
 void io_write_mem(uint8_t addr, uint8_t val);
@@ -44,9 +47,17 @@ void io_write_mem(uint8_t addr, uint8_t val);
 // Read contents from given 16 bit memory address
 uint8_t get_mem(uint16_t addr);
 
+/* Read for the debugging tools, same as get_mem except cartridge
+ * memory is read through MBC_page_map, so it isn't code logged */
+uint8_t peek_mem(uint16_t addr);
+
 /*  Write an 8 bit value to the given 16 bit address */
 void set_mem(uint16_t addr, uint8_t const val);
 
+/* Write to 0xD000 - 0xDFFF of Gameboy Color WRAM bank 1 - 7,
+ * regardless of the bank currently selected */
+void set_wram_bank_mem(unsigned bank, uint16_t addr, uint8_t val);
+
 /* Write 16bit value starting at the given memory address 
  * into memory.  Written in little-endian byte order */
 void set_mem_16(uint16_t const loc, uint16_t const val);
@@ -63,6 +74,10 @@ int load_rom(char const * filename, uint8_t header[0x50], int const dmg_mode);
 // deallocate all allocated memory
 void teardown_memory();
 
+/* Fold the contents of RAM, VRAM, OAM, IO, palettes and cartridge
+ * RAM into an FNV-1a hash, to check two runs are in the same state */
+uint32_t hash_memory(uint32_t hash);
+
 // read a value from gameboy color background palette RAM
 uint8_t read_bg_color_palette(int addr);
 
@@ -20,29 +20,67 @@ static int ram_select = 0; // Current RAM bank 0x0 - 0x03
 static int ram_banking = 0;  // 0: RAM banking off, 1: RAM banking on
 static int battery = 0;
 static int rom_base = 0;
+static uint32_t header_offset = 0; // Offset of the header banks in ROM_banks
+
+
+/* Translate an offset into the ROM as laid out with the header banks
+ * first, to where it is in ROM_banks */
+static inline uint8_t *rom_ptr(uint32_t offset) {
+    if (header_offset) {
+        offset = offset < 0x8000 ? offset + header_offset : offset - 0x8000;
+    }
+    return ROM_banks + offset;
+}
+
+
+static inline uint8_t read_rom(uint32_t offset) {
+    return *rom_ptr(offset);
+}
+
+
+// Publish the current banks for reads that skip read_MMM01
+static void update_read_map() {
+    if (rom_mode == 0) {
+        map_MBC_read(0x0000, 0x8000, rom_ptr(0));
+    } else {
+        map_MBC_read(0x0000, ROM_BANK_SIZE, rom_ptr((rom_base + 2) * ROM_BANK_SIZE));
+        map_MBC_read(0x4000, ROM_BANK_SIZE,
+            rom_ptr((2 + rom_base + rom_select) * ROM_BANK_SIZE) - 0x4000);
+    }
+    map_MBC_read(0xA000, RAM_BANK_SIZE, ram_banking && RAM_bank_count > 0 ?
+        RAM_banks + (ram_select * RAM_BANK_SIZE) - 0xA000 : NULL);
+}
+
+
+void relocate_MMM01_header(uint32_t rom_size) {
+    header_offset = rom_size - 0x8000;
+    update_read_map();
+}
 
 void setup_MMM01(int flags) {
     battery = (flags & BATTERY) ? 1 : 0;
+    header_offset = 0;
     // Check for previous saves if Battery active
     if (battery) {
         read_SRAM();
     }
+    update_read_map();
 }
 
 
 uint8_t read_MMM01(uint16_t addr) {
     if ((addr & 0x8000) == 0x0000) {
         if (rom_mode == 0) {
-            return ROM_banks[addr];
+            return read_rom(addr);
         }
      }
 
      if ((addr & 0xC000) == 0x0000) {
-        return ROM_banks[((rom_base + 2) * ROM_BANK_SIZE) | addr]; //1st 2 banks used by game menu
+        return read_rom(((rom_base + 2) * ROM_BANK_SIZE) | addr); //1st 2 banks used by game menu
      }
 
      if ((addr & 0xC000) == 0x4000) {
-        return ROM_banks[((1 + rom_base + rom_select) * ROM_BANK_SIZE) + addr];
+        return read_rom(((1 + rom_base + rom_select) * ROM_BANK_SIZE) + addr);
      }
 
      if ((addr & 0xE000) == 0xA000) {
@@ -71,6 +109,7 @@ void write_MMM01(uint16_t addr, uint8_t val) {
                         }
                         ram_banking = ((val & 0xF) == 0xA);
                     }
+                    update_read_map();
                     break;
         case 0x2000:
         case 0x3000:
@@ -79,12 +118,14 @@ void write_MMM01(uint16_t addr, uint8_t val) {
                     } else {
                         rom_select = val;
                     }
+                    update_read_map();
                     break;
         case 0x4000: 
         case 0x5000: // Set current RAM bank
                      if (rom_mode == 1) {
                         ram_select = val;
                      }
+                     update_read_map();
                      break;
         case 0x6000: 
         case 0x7000: //Unknown purpose 
@@ -94,6 +135,7 @@ void write_MMM01(uint16_t addr, uint8_t val) {
         case 0xB000: // Write to RAM bank if RAM banking enabled 
                     if (ram_banking) {
                         RAM_banks[(ram_select * RAM_BANK_SIZE) | (addr - 0xA000)] = val; 
+                        MARK_SRAM_DIRTY((ram_select * RAM_BANK_SIZE) | (addr - 0xA000));
                     }
                     break;
     }    
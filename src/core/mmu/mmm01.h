@@ -6,4 +6,8 @@ void setup_MMM01(int flags);
 uint8_t read_MMM01(uint16_t addr);
 void   write_MMM01(uint16_t addr, uint8_t val);
 
+/* The ROM of rom_size bytes has its header banks at the end
+ * rather than the start, bank numbers are remapped to match */
+void relocate_MMM01_header(uint32_t rom_size);
+
 #endif //MMM01_H
@@ -0,0 +1,198 @@
+#include "rom_cache.h"
+#include "mbc.h"
+
+#include "../../non_core/logger.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef EFIAPI
+#include "../../platforms/UEFI/libs.h"
+typedef void PB_FILE;
+#define PB_FOPEN uefi_fopen
+#define PB_FSEEK uefi_fseek
+#define PB_FREAD uefi_fread
+#define PB_FCLOSE uefi_fclose
+#else
+typedef FILE PB_FILE;
+#define PB_FOPEN fopen
+#define PB_FSEEK fseek
+#define PB_FREAD fread
+#define PB_FCLOSE fclose
+#endif
+
+#define NOT_CACHED 0xFFFF
+
+typedef struct {
+    unsigned bank;
+    unsigned long last_used;
+    uint8_t *data;
+} Cache_Slot;
+
+int ROM_paged = 0;
+unsigned long rom_cache_hits = 0;
+unsigned long rom_cache_misses = 0;
+
+static unsigned cache_size = 0;
+static Cache_Slot *slots = NULL;
+static uint8_t *slot_data = NULL;
+static uint16_t *bank_slot = NULL; // Slot holding each bank, or NOT_CACHED
+static uint8_t *bank_0 = NULL;
+static unsigned rom_bank_count;
+static unsigned long use_count;
+static PB_FILE *rom_file = NULL;
+
+
+int set_rom_paging(unsigned cache_banks) {
+
+    if (cache_banks != 0 && cache_banks < MIN_ROM_CACHE_BANKS) {
+        log_message(LOG_ERROR, "ROM cache needs at least %d banks\n", MIN_ROM_CACHE_BANKS);
+        return 0;
+    }
+    cache_size = cache_banks;
+    return 1;
+}
+
+
+unsigned rom_paging_banks() {
+    return cache_size;
+}
+
+
+static int read_bank(unsigned bank, uint8_t *data) {
+
+    return PB_FSEEK(rom_file, (long)bank * ROM_BANK_SIZE, SEEK_SET) == 0 &&
+        PB_FREAD(data, 1, ROM_BANK_SIZE, rom_file) == ROM_BANK_SIZE;
+}
+
+
+uint8_t *open_rom_cache(char const *file_path, unsigned bank_count) {
+
+    close_rom_cache();
+
+    if (!(rom_file = PB_FOPEN(file_path, "rb"))) {
+        log_message(LOG_ERROR, "Error opening file %s\n", file_path);
+        return NULL;
+    }
+
+    rom_bank_count = bank_count;
+    slots = malloc(cache_size * sizeof(Cache_Slot));
+    slot_data = malloc((size_t)cache_size * ROM_BANK_SIZE);
+    bank_slot = malloc(bank_count * sizeof(uint16_t));
+    bank_0 = malloc(ROM_BANK_SIZE);
+
+    if (!slots || !slot_data || !bank_slot || !bank_0) {
+        log_message(LOG_ERROR, "Unable to allocate memory for ROM cache\n");
+        ROM_paged = 1;
+        close_rom_cache();
+        return NULL;
+    }
+
+    for (unsigned i = 0; i < cache_size; i++) {
+        slots[i].bank = NOT_CACHED;
+        slots[i].last_used = 0;
+        slots[i].data = slot_data + (size_t)i * ROM_BANK_SIZE;
+    }
+    for (unsigned i = 0; i < bank_count; i++) {
+        bank_slot[i] = NOT_CACHED;
+    }
+    use_count = 0;
+    rom_cache_hits = 0;
+    rom_cache_misses = 0;
+    ROM_paged = 1;
+
+    // Make sure the file is as large as the header says before running
+    if (!read_bank(0, bank_0) || !read_bank(bank_count - 1, slots[0].data)) {
+        log_message(LOG_ERROR, "ROM file smaller than the %u banks in its header\n", bank_count);
+        close_rom_cache();
+        return NULL;
+    }
+
+    log_message(LOG_INFO, "Paging ROM through a %u bank cache\n", cache_size);
+    return bank_0;
+}
+
+
+void close_rom_cache() {
+
+    if (!ROM_paged) {
+        return;
+    }
+
+    if (rom_cache_hits || rom_cache_misses) {
+        log_message(LOG_INFO, "ROM cache hits: %lu misses: %lu\n", rom_cache_hits, rom_cache_misses);
+    }
+
+    if (rom_file) {
+        PB_FCLOSE(rom_file);
+        rom_file = NULL;
+    }
+    free(slots);
+    free(slot_data);
+    free(bank_slot);
+    free(bank_0);
+    slots = NULL;
+    slot_data = NULL;
+    bank_slot = NULL;
+    bank_0 = NULL;
+    ROM_paged = 0;
+}
+
+
+uint8_t *get_rom_bank(unsigned bank) {
+
+    bank %= rom_bank_count;
+    if (bank == 0) {
+        return bank_0;
+    }
+
+    if (bank_slot[bank] != NOT_CACHED) {
+        Cache_Slot *slot = &slots[bank_slot[bank]];
+        slot->last_used = ++use_count;
+        rom_cache_hits++;
+        return slot->data;
+    }
+
+    // Replace the least recently used bank
+    unsigned lru = 0;
+    for (unsigned i = 1; i < cache_size; i++) {
+        if (slots[i].last_used < slots[lru].last_used) {
+            lru = i;
+        }
+    }
+
+    Cache_Slot *slot = &slots[lru];
+    if (slot->bank != NOT_CACHED) {
+        bank_slot[slot->bank] = NOT_CACHED;
+    }
+
+    rom_cache_misses++;
+    if (!read_bank(bank, slot->data)) {
+        // Reads as an open bus rather than stopping emulation
+        log_message(LOG_ERROR, "Failed to read ROM bank %u\n", bank);
+        memset(slot->data, 0xFF, ROM_BANK_SIZE);
+        slot->bank = NOT_CACHED;
+        slot->last_used = 0;
+        return slot->data;
+    }
+
+    slot->bank = bank;
+    slot->last_used = ++use_count;
+    bank_slot[bank] = lru;
+    return slot->data;
+}
+
+
+int rom_cache_bank(uint8_t const *data) {
+
+    if (data == bank_0) {
+        return 0;
+    }
+    for (unsigned i = 0; i < cache_size; i++) {
+        if (slots[i].data == data) {
+            return slots[i].bank == NOT_CACHED ? -1 : (int)slots[i].bank;
+        }
+    }
+    return -1;
+}
@@ -0,0 +1,40 @@
+#ifndef ROM_CACHE_H
+#define ROM_CACHE_H
+
+#include <stdint.h>
+
+/* Pages ROM banks in from the ROM file on demand for targets without
+ * the memory to hold large ROMs. Bank 0 is always resident, other
+ * banks are read into a fixed number of slots as the MBC switches to
+ * them, replacing the least recently used. Only MBC1, MBC3 and MBC5
+ * read ROM through the cache. */
+
+#define MIN_ROM_CACHE_BANKS 4
+
+extern int ROM_paged; // 1 if ROM banks are paged in through the cache
+extern unsigned long rom_cache_hits;
+extern unsigned long rom_cache_misses;
+
+/* Page ROMs through a cache of the given number of banks, 0 to read
+ * the whole ROM in. Should be set before the ROM is loaded.
+ * returns 1 if successful, 0 otherwise */
+int set_rom_paging(unsigned cache_banks);
+
+unsigned rom_paging_banks();
+
+/* Open the ROM file of bank_count banks for paging.
+ * returns bank 0, or NULL if unsuccessful */
+uint8_t *open_rom_cache(char const *file_path, unsigned bank_count);
+
+void close_rom_cache();
+
+/* Get the given bank, reading it from file if it isn't cached.
+ * The pointer stays valid until enough other banks are fetched
+ * to fill the cache */
+uint8_t *get_rom_bank(unsigned bank);
+
+/* Which bank the given data returned by get_rom_bank holds,
+ * or -1 if it isn't the start of a cached bank */
+int rom_cache_bank(uint8_t const *data);
+
+#endif /* ROM_CACHE_H */
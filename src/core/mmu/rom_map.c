@@ -0,0 +1,125 @@
+#ifdef ROM_MMAP
+#define _DEFAULT_SOURCE // MAP_POPULATE
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "rom_map.h"
+
+#include "../../non_core/logger.h"
+
+int ROM_mapped = 0;
+
+static int mapping_enabled = 0;
+
+
+int rom_mapping_enabled() {
+    return mapping_enabled;
+}
+
+
+#ifdef ROM_MMAP
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static int populate_mapping = 0;
+static void *mapping = NULL;
+static size_t map_size;
+
+
+int set_rom_mapping(int enabled, int populate) {
+
+#ifndef MAP_POPULATE
+    if (populate) {
+        log_message(LOG_WARN, "Populating mapped ROMs not supported on this platform\n");
+    }
+#endif
+    mapping_enabled = enabled;
+    populate_mapping = populate;
+    return 1;
+}
+
+
+uint8_t *map_rom(char const *file_path) {
+
+    unmap_rom();
+
+    int fd = open(file_path, O_RDONLY);
+    if (fd < 0) {
+        log_message(LOG_ERROR, "Error opening file %s\n", file_path);
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        log_message(LOG_ERROR, "Unable to get size of ROM file %s\n", file_path);
+        close(fd);
+        return NULL;
+    }
+
+    int flags = MAP_PRIVATE;
+#ifdef MAP_POPULATE
+    if (populate_mapping) {
+        flags |= MAP_POPULATE;
+    }
+#endif
+
+    void *mem = mmap(NULL, st.st_size, PROT_READ, flags, fd, 0);
+    close(fd);
+    if (mem == MAP_FAILED) {
+        log_message(LOG_ERROR, "Unable to map ROM file %s\n", file_path);
+        return NULL;
+    }
+
+    mapping = mem;
+    map_size = st.st_size;
+    ROM_mapped = 1;
+
+    log_message(LOG_INFO, "Mapped ROM file with %lu bytes\n", (unsigned long)map_size);
+    return mapping;
+}
+
+
+size_t mapped_rom_size() {
+    return ROM_mapped ? map_size : 0;
+}
+
+
+void unmap_rom() {
+
+    if (!ROM_mapped) {
+        return;
+    }
+
+    munmap(mapping, map_size);
+    mapping = NULL;
+    ROM_mapped = 0;
+}
+
+#else
+
+int set_rom_mapping(int enabled, int populate) {
+    (void)populate;
+
+    if (enabled) {
+        log_message(LOG_WARN, "Mapped ROMs not supported in this build\n");
+        return 0;
+    }
+    return 1;
+}
+
+uint8_t *map_rom(char const *file_path) {
+    (void)file_path;
+    return NULL;
+}
+
+void unmap_rom() {
+}
+
+size_t mapped_rom_size() {
+    return 0;
+}
+
+#endif
@@ -0,0 +1,30 @@
+#ifndef ROM_MAP_H
+#define ROM_MAP_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* Maps ROM files read only into memory rather than reading them
+ * into ROM_banks, so nothing is copied at startup and emulators
+ * running the same ROM share its pages. Only available when built
+ * with ROM_MMAP. */
+
+extern int ROM_mapped; // 1 if ROM_banks is mapped from the ROM file
+
+/* 1 to map ROM files, should be set before the ROM is loaded. If
+ * populate is 1 the whole file is paged in up front (Linux only).
+ * returns 1 if successful, 0 otherwise */
+int set_rom_mapping(int enabled, int populate);
+
+int rom_mapping_enabled();
+
+/* Map the whole ROM file, returns the mapping,
+ * or NULL if unsuccessful */
+uint8_t *map_rom(char const *file_path);
+
+void unmap_rom();
+
+// Size of the mapped ROM file
+size_t mapped_rom_size();
+
+#endif /* ROM_MAP_H */
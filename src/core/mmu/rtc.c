@@ -0,0 +1,25 @@
+#include "rtc.h"
+#include "../timers.h"
+#include "../../non_core/get_time.h"
+
+static RTC_Mode rtc_mode = RTC_HOST_TIME;
+
+
+void set_rtc_mode(RTC_Mode mode) {
+    rtc_mode = mode;
+}
+
+
+RTC_Mode get_rtc_mode() {
+    return rtc_mode;
+}
+
+
+uint64_t rtc_time() {
+    return rtc_mode == RTC_EMULATED_TIME ? get_emulated_time() : get_time();
+}
+
+
+uint64_t rtc_host_seconds() {
+    return get_time() / 1000;
+}
@@ -0,0 +1,32 @@
+#ifndef RTC_H
+#define RTC_H
+
+#include <stdint.h>
+
+/* Time source for cartridge real time clocks. Clocks only store their
+ * value at a base time and work out the current value from rtc_time()
+ * when latched or read, so nothing has to run while the game does.
+ *
+ * In host time the clock follows the wall clock, including the time
+ * between sessions. In emulated time it follows cycles executed, so it
+ * stops while paused and speeds up with the emulator. */
+
+/* MBC3 clocks are saved after cartridge RAM as 5 current registers,
+ * 5 latched registers (32-bit each) and a 64-bit Unix timestamp, all
+ * little endian. Older saves end with a 32-bit timestamp instead */
+#define RTC_FOOTER_SIZE 48
+#define RTC_FOOTER_SIZE_32 44
+
+typedef enum {RTC_HOST_TIME, RTC_EMULATED_TIME} RTC_Mode;
+
+// Should be set before the ROM is loaded, defaults to host time
+void set_rtc_mode(RTC_Mode mode);
+RTC_Mode get_rtc_mode();
+
+// Current time in ms from the selected source
+uint64_t rtc_time();
+
+// Seconds since the Unix epoch, used to timestamp saved clocks
+uint64_t rtc_host_seconds();
+
+#endif /* RTC_H */
@@ -0,0 +1,190 @@
+#ifdef SRAM_MMAP
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "sram_map.h"
+
+#include "../../non_core/logger.h"
+#include "../../non_core/get_time.h"
+
+#include <stdlib.h>
+
+int SRAM_mapped = 0;
+uint8_t *SRAM_dirty = NULL;
+
+static int mapping_enabled = 0;
+
+
+int SRAM_mapping_enabled() {
+    return mapping_enabled;
+}
+
+
+void mark_SRAM_range_dirty(unsigned long offset, unsigned long len) {
+
+    if (!SRAM_mapped || len == 0) {
+        return;
+    }
+
+    for (unsigned long page = offset >> SRAM_PAGE_SHIFT;
+            page <= (offset + len - 1) >> SRAM_PAGE_SHIFT; page++) {
+        SRAM_dirty[page] = 1;
+    }
+}
+
+
+#ifdef SRAM_MMAP
+
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static uint8_t *mapping = NULL;
+static size_t map_size;
+static unsigned long page_count;
+static uintptr_t sys_page_mask;
+static uint64_t time_last_sync = 0;
+
+
+int set_SRAM_mapping(int enabled) {
+    mapping_enabled = enabled;
+    return 1;
+}
+
+
+uint8_t *map_SRAM(char const *file_path, unsigned long size, int *loaded) {
+
+    unmap_SRAM();
+    *loaded = 0;
+
+    int fd = open(file_path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        log_message(LOG_ERROR, "Unable to open save file %s for mapping\n", file_path);
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        log_message(LOG_ERROR, "Unable to stat save file %s\n", file_path);
+        close(fd);
+        return NULL;
+    }
+
+    // Newly created or short saves are zero filled to the full size
+    if ((unsigned long)st.st_size < size && ftruncate(fd, size) != 0) {
+        log_message(LOG_ERROR, "Unable to resize save file %s\n", file_path);
+        close(fd);
+        return NULL;
+    }
+
+    void *mem = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mem == MAP_FAILED) {
+        log_message(LOG_ERROR, "Unable to map save file %s\n", file_path);
+        return NULL;
+    }
+
+    page_count = ((size - 1) >> SRAM_PAGE_SHIFT) + 1;
+    SRAM_dirty = calloc(page_count, 1);
+    if (!SRAM_dirty) {
+        log_message(LOG_ERROR, "Unable to allocate memory for save dirty pages\n");
+        munmap(mem, size);
+        return NULL;
+    }
+
+    mapping = mem;
+    map_size = size;
+    sys_page_mask = ~(uintptr_t)(sysconf(_SC_PAGESIZE) - 1);
+    time_last_sync = get_time();
+    *loaded = (unsigned long)st.st_size >= size;
+    SRAM_mapped = 1;
+
+    log_message(LOG_INFO, "Mapped %lu bytes of save file %s\n", size, file_path);
+    return mapping;
+}
+
+
+void unmap_SRAM() {
+
+    if (!SRAM_mapped) {
+        return;
+    }
+
+    sync_SRAM(1);
+    munmap(mapping, map_size);
+    free(SRAM_dirty);
+    SRAM_dirty = NULL;
+    mapping = NULL;
+    SRAM_mapped = 0;
+}
+
+
+void sync_SRAM(int force) {
+
+    if (!SRAM_mapped) {
+        return;
+    }
+
+    uint64_t now = get_time();
+    if (!force && now - time_last_sync < SRAM_SYNC_INTERVAL) {
+        return;
+    }
+    time_last_sync = now;
+
+    /* Timed syncs just schedule the write so emulation isn't held up,
+     * forced ones wait for the pages to reach the disk */
+    int flags = force ? MS_SYNC : MS_ASYNC;
+
+    // Sync each run of dirty pages, aligned to the system page size
+    unsigned long page = 0;
+    while (page < page_count) {
+        if (!SRAM_dirty[page]) {
+            page++;
+            continue;
+        }
+
+        unsigned long start = page;
+        while (page < page_count && SRAM_dirty[page]) {
+            SRAM_dirty[page++] = 0;
+        }
+
+        uintptr_t begin = (uintptr_t)(mapping + (start << SRAM_PAGE_SHIFT)) & sys_page_mask;
+        uintptr_t end = (uintptr_t)mapping + (page << SRAM_PAGE_SHIFT);
+        if (end > (uintptr_t)mapping + map_size) {
+            end = (uintptr_t)mapping + map_size;
+        }
+
+        if (msync((void *)begin, end - begin, flags) != 0) {
+            log_message(LOG_WARN, "Failed to sync save file\n");
+        }
+    }
+}
+
+#else
+
+int set_SRAM_mapping(int enabled) {
+
+    if (enabled) {
+        log_message(LOG_WARN, "Mapped save files not supported in this build\n");
+        return 0;
+    }
+    return 1;
+}
+
+uint8_t *map_SRAM(char const *file_path, unsigned long size, int *loaded) {
+    (void)file_path;
+    (void)size;
+    *loaded = 0;
+    return NULL;
+}
+
+void unmap_SRAM() {
+}
+
+void sync_SRAM(int force) {
+    (void)force;
+}
+
+#endif
@@ -0,0 +1,42 @@
+#ifndef SRAM_MAP_H
+#define SRAM_MAP_H
+
+#include <stdint.h>
+
+/* Alternative to writing saves with save_SRAM, maps the save file
+ * into memory so cartridge RAM and MBC6 flash live in the file.
+ * Pages written are tracked and periodically msync'd to disk.
+ * Only available when built with SRAM_MMAP. */
+
+#define SRAM_PAGE_SHIFT 12 // Dirty pages are tracked in 4KB
+#define SRAM_SYNC_INTERVAL 1000 // ms between syncing dirty pages
+
+extern int SRAM_mapped; // 1 if RAM_banks is mapped to the save file
+extern uint8_t *SRAM_dirty; // One byte per page of the mapping
+
+/* 1 to map save files rather than read and write them, should be
+ * set before the ROM is loaded. returns 1 if successful, 0 otherwise */
+int set_SRAM_mapping(int enabled);
+
+int SRAM_mapping_enabled();
+
+/* Map size bytes of file_path, creating it if needed. *loaded is
+ * set to 1 if the file already held a full save, 0 otherwise.
+ * returns the mapping, or NULL if unsuccessful */
+uint8_t *map_SRAM(char const *file_path, unsigned long size, int *loaded);
+
+// Sync and unmap the save file
+void unmap_SRAM();
+
+/* Sync dirty pages to disk, if force is 0 this only happens once
+ * SRAM_SYNC_INTERVAL has passed since the last sync */
+void sync_SRAM(int force);
+
+// Record a write of len bytes from the given offset into RAM_banks
+void mark_SRAM_range_dirty(unsigned long offset, unsigned long len);
+
+// Record a write to the given offset into RAM_banks
+#define MARK_SRAM_DIRTY(offset) \
+    do { if (SRAM_mapped) SRAM_dirty[(offset) >> SRAM_PAGE_SHIFT] = 1; } while (0)
+
+#endif /* SRAM_MAP_H */
@@ -0,0 +1,227 @@
+#include "sram_writer.h"
+#include "mbc.h"
+
+#include "../../non_core/files.h"
+#include "../../non_core/logger.h"
+#include "../../non_core/get_time.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef SRAM_THREAD
+#include <pthread.h>
+#endif
+
+static char const *save_path;
+static unsigned long save_size = 0;
+
+static uint8_t *queued = NULL; // Latest save queued
+static int queued_valid = 0; // Something has been queued since loading
+static int dirty = 0; // Queued save not yet handed to save_SRAM
+
+
+#ifdef SRAM_THREAD
+
+static uint8_t *writing = NULL; // Copy being written by the writer thread
+static int busy = 0;
+static int quit = 0;
+static int running = 0;
+
+static pthread_t writer;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cond = PTHREAD_COND_INITIALIZER;
+
+
+static void *SRAM_writer(void *arg) {
+    (void)arg;
+
+    pthread_mutex_lock(&lock);
+    for (;;) {
+        while (!dirty && !quit) {
+            pthread_cond_wait(&cond, &lock);
+        }
+        // Anything still dirty is written before stopping
+        if (!dirty) {
+            break;
+        }
+
+        // Copy so the emulator can queue more saves while this is written
+        memcpy(writing, queued, save_size);
+        dirty = 0;
+        busy = 1;
+        pthread_mutex_unlock(&lock);
+
+        save_SRAM(save_path, writing, save_size);
+
+        pthread_mutex_lock(&lock);
+        busy = 0;
+        pthread_cond_broadcast(&cond);
+    }
+    pthread_mutex_unlock(&lock);
+    return NULL;
+}
+
+
+static int start_writer() {
+
+    writing = malloc(save_size);
+    if (!writing) {
+        log_message(LOG_ERROR, "Unable to allocate memory for SRAM writer\n");
+        return 0;
+    }
+
+    quit = 0;
+    if (pthread_create(&writer, NULL, SRAM_writer, NULL) != 0) {
+        log_message(LOG_ERROR, "Failed to start SRAM writer thread\n");
+        free(writing);
+        writing = NULL;
+        return 0;
+    }
+    running = 1;
+    return 1;
+}
+
+
+static void stop_writer() {
+
+    if (!running) {
+        return;
+    }
+
+    pthread_mutex_lock(&lock);
+    quit = 1;
+    pthread_cond_broadcast(&cond);
+    pthread_mutex_unlock(&lock);
+    pthread_join(writer, NULL);
+
+    free(writing);
+    writing = NULL;
+    running = 0;
+}
+
+
+void queue_SRAM_write(uint8_t const *data) {
+
+    if (!queued) {
+        return;
+    }
+
+    pthread_mutex_lock(&lock);
+    memcpy(queued, data, save_size);
+    queued_valid = 1;
+    dirty = 1;
+    pthread_cond_signal(&cond);
+    pthread_mutex_unlock(&lock);
+}
+
+
+void flush_SRAM_writer() {
+
+    if (!running) {
+        return;
+    }
+
+    pthread_mutex_lock(&lock);
+    while (dirty || busy) {
+        pthread_cond_wait(&cond, &lock);
+    }
+    pthread_mutex_unlock(&lock);
+}
+
+#else
+
+static uint64_t time_last_write = 0; // in ms
+
+
+static int start_writer() {
+    time_last_write = 0;
+    return 1;
+}
+
+
+static void stop_writer() {
+    flush_SRAM_writer();
+}
+
+
+// Keeps file writes down on targets where they are slow e.g. 3DS
+void queue_SRAM_write(uint8_t const *data) {
+
+    if (!queued) {
+        return;
+    }
+
+    memcpy(queued, data, save_size);
+    queued_valid = 1;
+    dirty = 1;
+
+    if (get_time() - time_last_write > SRAM_WRITE_DELAY) {
+        flush_SRAM_writer();
+    }
+}
+
+
+void flush_SRAM_writer() {
+
+    if (dirty) {
+        save_SRAM(save_path, queued, save_size);
+        time_last_write = get_time();
+        dirty = 0;
+    }
+}
+
+#endif
+
+
+int init_SRAM_writer(char const *file_path, unsigned long size) {
+
+    teardown_SRAM_writer();
+
+    // Nothing to save
+    if (size == 0) {
+        return 1;
+    }
+
+    save_path = file_path;
+    save_size = size;
+
+    queued = malloc(size);
+    if (!queued) {
+        log_message(LOG_ERROR, "Unable to allocate memory for SRAM writer\n");
+        return 0;
+    }
+    queued_valid = 0;
+    dirty = 0;
+
+    if (!start_writer()) {
+        free(queued);
+        queued = NULL;
+        return 0;
+    }
+    return 1;
+}
+
+
+void teardown_SRAM_writer() {
+
+    if (!queued) {
+        return;
+    }
+
+    stop_writer();
+    free(queued);
+    queued = NULL;
+    save_size = 0;
+}
+
+
+int read_queued_SRAM(uint8_t *data) {
+
+    if (!queued_valid) {
+        return 0;
+    }
+
+    // Only the emulation thread writes to the queued copy
+    memcpy(data, queued, save_size);
+    return 1;
+}
@@ -0,0 +1,31 @@
+#ifndef SRAM_WRITER_H
+#define SRAM_WRITER_H
+
+#include <stdint.h>
+
+/* Writes battery backed cartridge RAM out to its save file.
+ * When built with SRAM_THREAD saves are written by a background
+ * thread, otherwise they are written at most once every
+ * SRAM_WRITE_DELAY ms. Either way saves queued in quick
+ * succession are coalesced into a single write of the latest. */
+
+/* Prepare to write saves of size bytes to file_path, which must
+ * stay valid until the writer is torn down.
+ * returns 1 if successful, 0 otherwise */
+int init_SRAM_writer(char const *file_path, unsigned long size);
+
+// Finish any pending write and free the writer's buffers
+void teardown_SRAM_writer();
+
+/* Queue a copy of data to be written, replacing any earlier
+ * copy which hasn't been written yet */
+void queue_SRAM_write(uint8_t const *data);
+
+/* Copy the most recently queued save into data.
+ * returns 1 if successful, 0 if nothing has been queued */
+int read_queued_SRAM(uint8_t *data);
+
+// Block until everything queued has been written
+void flush_SRAM_writer();
+
+#endif /* SRAM_WRITER_H */
@@ -0,0 +1,301 @@
+#include "movie.h"
+#include "cpu.h"
+#include "inflate.h"
+#include "mmu/memory.h"
+#include "mmu/mbc.h"
+#include "mmu/rom_cache.h"
+#include "mmu/rtc.h"
+
+#include "../non_core/joypad.h"
+#include "../non_core/logger.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define HASH_SEED 2166136261u
+
+Movie_Mode movie_mode = MOVIE_OFF;
+uint8_t movie_keys = 0;
+
+static Movie_Mode opened_mode = MOVIE_OFF; // Until start_movie
+static char const *movie_path;
+static Movie_Header header;
+static uint64_t frame_count;
+static int differed;
+
+static FILE *record_file = NULL;
+
+// Whole movie being played
+static uint8_t *movie_data = NULL;
+static uint8_t const *frames;
+
+
+static void put_u32(uint8_t *buf, uint32_t val) {
+    buf[0] = val;
+    buf[1] = val >> 8;
+    buf[2] = val >> 16;
+    buf[3] = val >> 24;
+}
+
+static uint32_t get_u32(uint8_t const *buf) {
+    return buf[0] | buf[1] << 8 | buf[2] << 16 | (uint32_t)buf[3] << 24;
+}
+
+
+static void put_header(uint8_t *buf) {
+    memcpy(buf, header.magic, sizeof(header.magic));
+    put_u32(buf + 8, header.version);
+    put_u32(buf + 12, header.flags);
+    put_u32(buf + 16, header.rom_crc);
+    put_u32(buf + 20, header.save_size);
+    put_u32(buf + 24, header.frames);
+    put_u32(buf + 28, header.frames >> 32);
+}
+
+static void get_header(uint8_t const *buf) {
+    memcpy(header.magic, buf, sizeof(header.magic));
+    header.version = get_u32(buf + 8);
+    header.flags = get_u32(buf + 12);
+    header.rom_crc = get_u32(buf + 16);
+    header.save_size = get_u32(buf + 20);
+    header.frames = get_u32(buf + 24) | (uint64_t)get_u32(buf + 28) << 32;
+}
+
+
+static uint8_t *read_movie(char const *file_path, unsigned long *size) {
+
+    FILE *file;
+    if (!(file = fopen(file_path, "rb"))) {
+        log_message(LOG_ERROR, "Error opening movie %s\n", file_path);
+        return NULL;
+    }
+    uint8_t *data = NULL;
+    long length;
+    if (fseek(file, 0, SEEK_END) == 0 && (length = ftell(file)) >= 0 &&
+            fseek(file, 0, SEEK_SET) == 0 && (data = malloc(length + 1))) {
+        if (fread(data, 1, length, file) != (size_t)length) {
+            free(data);
+            data = NULL;
+        }
+        *size = length;
+    }
+    fclose(file);
+    if (data == NULL) {
+        log_message(LOG_ERROR, "Error reading movie %s\n", file_path);
+    }
+    return data;
+}
+
+
+static int open_playback(char const *file_path, int *dmg_mode) {
+
+    unsigned long size;
+    if (!(movie_data = read_movie(file_path, &size))) {
+        return 0;
+    }
+    if (size < MOVIE_HEADER_SIZE) {
+        log_message(LOG_ERROR, "%s isn't a movie\n", file_path);
+        return 0;
+    }
+    get_header(movie_data);
+    if (memcmp(header.magic, MOVIE_MAGIC, sizeof(MOVIE_MAGIC)) || header.version != MOVIE_VERSION) {
+        log_message(LOG_ERROR, "%s isn't a version %d movie\n", file_path, MOVIE_VERSION);
+        return 0;
+    }
+
+    // Frames are only counted in the header once recording has finished
+    unsigned long frame_bytes = size - MOVIE_HEADER_SIZE - header.save_size;
+    if (header.save_size > size - MOVIE_HEADER_SIZE ||
+            (header.frames != 0 && header.frames != frame_bytes / MOVIE_FRAME_SIZE)) {
+        log_message(LOG_ERROR, "Movie %s is cut short\n", file_path);
+        return 0;
+    }
+    if (header.frames == 0) {
+        log_message(LOG_WARN, "Movie %s wasn't finished recording\n", file_path);
+        header.frames = frame_bytes / MOVIE_FRAME_SIZE;
+    }
+
+    uint8_t const *save = movie_data + MOVIE_HEADER_SIZE;
+    frames = save + header.save_size;
+    set_SRAM_override(1, header.save_size ? save : NULL, header.save_size);
+    *dmg_mode = (header.flags & MOVIE_DMG) != 0;
+    return 1;
+}
+
+
+static int open_recording(char const *file_path, int dmg_mode) {
+
+    if (!(record_file = fopen(file_path, "wb"))) {
+        log_message(LOG_ERROR, "Error opening movie %s\n", file_path);
+        return 0;
+    }
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, MOVIE_MAGIC, sizeof(MOVIE_MAGIC));
+    header.version = MOVIE_VERSION;
+    header.flags = dmg_mode ? MOVIE_DMG : 0;
+    return 1;
+}
+
+
+int open_movie(char const *file_path, Movie_Mode mode, int *dmg_mode) {
+
+    int ok = mode == MOVIE_PLAYING ? open_playback(file_path, dmg_mode) :
+             mode == MOVIE_RECORDING && open_recording(file_path, *dmg_mode);
+    if (!ok) {
+        free(movie_data);
+        movie_data = NULL;
+        return 0;
+    }
+    // Clocks must tick the same way every time
+    set_rtc_mode(RTC_EMULATED_TIME);
+    movie_path = file_path;
+    opened_mode = mode;
+    return 1;
+}
+
+
+int start_movie() {
+
+    if (ROM_paged) {
+        log_message(LOG_ERROR, "Movies need the whole ROM loaded, not paged\n");
+        return 0;
+    }
+    uint32_t rom_crc = crc32(ROM_banks, (size_t)ROM_bank_count * ROM_BANK_SIZE);
+
+    if (opened_mode == MOVIE_PLAYING) {
+        if (rom_crc != header.rom_crc) {
+            log_message(LOG_ERROR, "Movie %s was recorded on another ROM\n", movie_path);
+            return 0;
+        }
+        if (header.save_size != SRAM_save_size()) {
+            log_message(LOG_ERROR, "Movie %s has cartridge RAM of the wrong size\n", movie_path);
+            return 0;
+        }
+    } else {
+        header.rom_crc = rom_crc;
+        header.save_size = SRAM_save_size();
+
+        uint8_t buf[MOVIE_HEADER_SIZE];
+        put_header(buf);
+        // Cartridges without RAM have no RAM_banks to write
+        if (fwrite(buf, 1, sizeof(buf), record_file) != sizeof(buf) || (header.save_size &&
+                fwrite(RAM_banks, 1, header.save_size, record_file) != header.save_size)) {
+            log_message(LOG_ERROR, "Error writing movie %s\n", movie_path);
+            return 0;
+        }
+    }
+
+    frame_count = 0;
+    differed = 0;
+    movie_keys = 0;
+    movie_mode = opened_mode;
+    return 1;
+}
+
+
+int movie_frame_start() {
+
+    if (movie_mode == MOVIE_RECORDING) {
+        movie_keys = joypad_keys();
+        return 1;
+    }
+    if (frame_count == header.frames) {
+        return 0;
+    }
+    movie_keys = frames[frame_count * MOVIE_FRAME_SIZE];
+    return 1;
+}
+
+
+static uint32_t frame_hash() {
+
+    uint32_t hash = hash_memory(HASH_SEED);
+    for (CPU_Register r = REG_AF; r <= REG_PC; r++) {
+        uint16_t val = get_register(r);
+        hash = (hash ^ (val & 0xFF)) * 16777619u;
+        hash = (hash ^ (val >> 8)) * 16777619u;
+    }
+    return hash;
+}
+
+
+int movie_frame_end() {
+
+    uint32_t hash = frame_hash();
+    if (movie_mode == MOVIE_RECORDING) {
+        uint8_t buf[MOVIE_FRAME_SIZE] = {movie_keys};
+        put_u32(buf + 1, hash);
+        fwrite(buf, 1, sizeof(buf), record_file);
+        frame_count++;
+        return 1;
+    }
+
+    uint32_t expected = get_u32(frames + frame_count * MOVIE_FRAME_SIZE + 1);
+    if (hash != expected) {
+        log_message(LOG_ERROR, "Movie %s differs at frame %llu, hash %08X instead of %08X\n",
+            movie_path, (unsigned long long)frame_count, hash, expected);
+        differed = 1;
+        return 0;
+    }
+    frame_count++;
+    return 1;
+}
+
+
+uint64_t movie_frame() {
+    return frame_count;
+}
+
+
+static int stop_recording_movie() {
+
+    header.frames = frame_count;
+    uint8_t buf[MOVIE_HEADER_SIZE];
+    put_header(buf);
+    int ok = !ferror(record_file);
+    ok &= fseek(record_file, 0, SEEK_SET) == 0 && fwrite(buf, 1, sizeof(buf), record_file) == sizeof(buf);
+    ok &= fclose(record_file) == 0;
+    record_file = NULL;
+
+    if (ok) {
+        log_message(LOG_INFO, "Recorded %llu frames to movie %s\n",
+            (unsigned long long)frame_count, movie_path);
+    } else {
+        log_message(LOG_ERROR, "Error writing movie %s\n", movie_path);
+    }
+    return ok;
+}
+
+
+static int stop_playing_movie() {
+
+    int ok = !differed && frame_count == header.frames;
+    if (ok) {
+        log_message(LOG_INFO, "Played all %llu frames of movie %s, every frame matched\n",
+            (unsigned long long)frame_count, movie_path);
+    } else if (!differed && movie_mode == MOVIE_PLAYING) {
+        log_message(LOG_ERROR, "Stopped movie %s at frame %llu of %llu\n", movie_path,
+            (unsigned long long)frame_count, (unsigned long long)header.frames);
+    }
+
+    // Still leaving the save file alone, without the movie's copy of it
+    set_SRAM_override(1, NULL, 0);
+    free(movie_data);
+    movie_data = NULL;
+    return ok;
+}
+
+
+int stop_movie() {
+
+    int ok = 1;
+    if (opened_mode == MOVIE_RECORDING && record_file) {
+        ok = stop_recording_movie();
+    } else if (opened_mode == MOVIE_PLAYING) {
+        ok = stop_playing_movie();
+    }
+    movie_mode = MOVIE_OFF;
+    opened_mode = MOVIE_OFF;
+    return ok;
+}
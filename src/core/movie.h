@@ -0,0 +1,73 @@
+#ifndef MOVIE_H
+#define MOVIE_H
+
+#include <stdint.h>
+
+/* Input movies, the keys held each frame from power on, to replay a
+ * session exactly for regression testing.
+ *
+ * While a movie is recorded or played the keys are latched once at the
+ * start of each frame, from the joypad backend or the movie, and the
+ * game sees those from the next input poll, always on the default poll
+ * line (see input.h). Cartridge clocks run off emulated time so no host
+ * time gets in, and a played movie's cartridge RAM comes from the movie
+ * instead of the save file, which is left alone. Cheats and serial
+ * links aren't recorded, so shouldn't be used with movies.
+ *
+ * After each frame a hash of memory and the CPU registers is recorded,
+ * and checked when played back. Playing stops at the first frame that
+ * doesn't match, or the end of the movie.
+ *
+ * Files are little endian: a Movie_Header, the cartridge RAM and clock
+ * as saved at power on, then for each frame a key mask (see joypad.h)
+ * and its 32 bit hash. */
+
+#define MOVIE_MAGIC "PBMOVIE"
+#define MOVIE_VERSION 2
+#define MOVIE_HEADER_SIZE 32
+#define MOVIE_FRAME_SIZE 5
+
+#define MOVIE_DMG 0x1 // Run in DMG mode
+
+typedef enum {MOVIE_OFF, MOVIE_RECORDING, MOVIE_PLAYING} Movie_Mode;
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t flags;
+    uint32_t rom_crc;    // CRC-32 of the ROM the movie was recorded on
+    uint32_t save_size;  // Bytes of cartridge RAM following the header
+    uint64_t frames;
+} Movie_Header;
+
+// Checked before calling movie_frame_start or movie_frame_end
+extern Movie_Mode movie_mode;
+
+// Keys held this frame, the game reads these instead of the backend's
+extern uint8_t movie_keys;
+
+/* Record to, or play from, the given file. Should be called before the
+ * ROM is loaded, when playing dmg_mode is set to the mode to load it in.
+ * returns 1 if successful, 0 otherwise */
+int open_movie(char const *file_path, Movie_Mode mode, int *dmg_mode);
+
+/* Check the loaded ROM is the one a movie was recorded on, or start
+ * recording on it, before anything has run. returns 1 if successful */
+int start_movie();
+
+/* Latch the keys for the frame about to run.
+ * returns 0 if a played movie has finished */
+int movie_frame_start();
+
+/* Record or check the hash of the frame just run.
+ * returns 0 if a played movie no longer matches */
+int movie_frame_end();
+
+// Frames recorded or played so far
+uint64_t movie_frame();
+
+/* Finish writing a recording, or report how a played movie went.
+ * returns 1 if written or played to the end without differing */
+int stop_movie();
+
+#endif /* MOVIE_H */
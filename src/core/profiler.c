@@ -0,0 +1,346 @@
+#include "profiler.h"
+#include "symbols.h"
+#include "cpu.h"
+#include "mmu/mbc.h"
+
+#include "../non_core/logger.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_DEPTH 64
+#define NO_BANK 0xFFFF // Code running from RAM
+#define FRAME_ID(bank, addr) (((uint32_t)(bank) << 16) | (addr))
+#define MAX_NAME_LENGTH 128
+
+typedef struct {
+    uint32_t id; // bank << 16 | address called
+    uint16_t sp; // Where the return address was pushed
+} Frame;
+
+// A distinct call stack which was sampled, its frames are in stack_pool
+typedef struct {
+    uint32_t hash;
+    unsigned length;
+    unsigned long start;
+    unsigned long count; // 0 if the slot is empty
+} Sampled_Stack;
+
+int profiling = 0;
+
+static long interval;
+static long cycles_left;
+
+static Frame frames[MAX_DEPTH];
+static unsigned depth = 0;
+
+static Sampled_Stack *stacks = NULL;
+static unsigned long stacks_size = 0; // Always a power of 2
+static unsigned long stack_count = 0;
+
+static uint32_t *stack_pool = NULL;
+static unsigned long pool_used = 0;
+static unsigned long pool_size = 0;
+
+static unsigned long sample_count = 0;
+static unsigned long dropped_count = 0;
+
+// Default names for the restart and interrupt vectors
+static char const * const vector_names[] = {
+    "RST_00", "RST_08", "RST_10", "RST_18", "RST_20", "RST_28", "RST_30", "RST_38",
+    "VBlank", "LCD_STAT", "Timer", "Serial", "Joypad"
+};
+
+
+static uint32_t frame_id(uint16_t addr) {
+    int bank = mapped_rom_bank(addr);
+    return FRAME_ID(bank < 0 ? NO_BANK : bank, addr);
+}
+
+
+static void free_samples() {
+    free(stacks);
+    free(stack_pool);
+    stacks = NULL;
+    stack_pool = NULL;
+    stacks_size = stack_count = 0;
+    pool_used = pool_size = 0;
+}
+
+
+int start_profiling(unsigned cycles) {
+
+    free_samples();
+    stacks_size = 1024;
+    stacks = calloc(stacks_size, sizeof(Sampled_Stack));
+    if (stacks == NULL) {
+        log_message(LOG_ERROR, "Unable to allocate profiler samples\n");
+        stacks_size = 0;
+        return 0;
+    }
+
+    interval = cycles ? cycles : PROFILE_DEFAULT_INTERVAL;
+    cycles_left = interval;
+    depth = 0;
+    sample_count = dropped_count = 0;
+    profiling = 1;
+    return 1;
+}
+
+
+void profile_call(uint16_t target, uint16_t sp) {
+
+    // Frames pushed below this one have been abandoned
+    while (depth > 0 && frames[depth - 1].sp <= sp) {
+        depth--;
+    }
+    // Calls past the maximum depth are left out, returns from
+    // them won't match anything
+    if (depth < MAX_DEPTH) {
+        frames[depth].id = frame_id(target);
+        frames[depth].sp = sp;
+        depth++;
+    }
+}
+
+
+void profile_return(uint16_t sp) {
+    while (depth > 0 && frames[depth - 1].sp <= sp) {
+        depth--;
+    }
+}
+
+
+static uint32_t hash_ids(uint32_t const *ids, unsigned length) {
+    uint32_t hash = 2166136261u;
+    for (unsigned i = 0; i < length; i++) {
+        hash = (hash ^ ids[i]) * 16777619u;
+    }
+    return hash;
+}
+
+
+static Sampled_Stack *find_stack(Sampled_Stack *table, unsigned long size,
+        uint32_t hash, uint32_t const *ids, unsigned length) {
+
+    unsigned long i = hash & (size - 1);
+    while (table[i].count != 0) {
+        if (table[i].hash == hash && table[i].length == length &&
+                !memcmp(stack_pool + table[i].start, ids, length * sizeof(uint32_t))) {
+            return &table[i];
+        }
+        i = (i + 1) & (size - 1);
+    }
+    return &table[i];
+}
+
+
+// Double the size of the table, keeping it at most half full
+static int grow_stacks() {
+
+    unsigned long new_size = stacks_size * 2;
+    Sampled_Stack *grown = calloc(new_size, sizeof(Sampled_Stack));
+    if (grown == NULL) {
+        return 0;
+    }
+    for (unsigned long i = 0; i < stacks_size; i++) {
+        if (stacks[i].count != 0) {
+            // Entries are distinct, so an empty slot is all that's needed
+            unsigned long j = stacks[i].hash & (new_size - 1);
+            while (grown[j].count != 0) {
+                j = (j + 1) & (new_size - 1);
+            }
+            grown[j] = stacks[i];
+        }
+    }
+    free(stacks);
+    stacks = grown;
+    stacks_size = new_size;
+    return 1;
+}
+
+
+static int add_to_pool(uint32_t const *ids, unsigned length) {
+
+    if (pool_used + length > pool_size) {
+        unsigned long new_size = pool_size ? pool_size * 2 : 4096;
+        uint32_t *grown = realloc(stack_pool, new_size * sizeof(uint32_t));
+        if (grown == NULL) {
+            return 0;
+        }
+        stack_pool = grown;
+        pool_size = new_size;
+    }
+    memcpy(stack_pool + pool_used, ids, length * sizeof(uint32_t));
+    pool_used += length;
+    return 1;
+}
+
+
+static void take_sample() {
+
+    uint32_t ids[MAX_DEPTH + 1];
+    unsigned length = 0;
+    for (unsigned i = 0; i < depth; i++) {
+        ids[length++] = frames[i].id;
+    }
+    ids[length++] = frame_id(get_register(REG_PC));
+
+    uint32_t hash = hash_ids(ids, length);
+    Sampled_Stack *stack = find_stack(stacks, stacks_size, hash, ids, length);
+    if (stack->count != 0) {
+        stack->count++;
+        sample_count++;
+        return;
+    }
+
+    if ((stack_count + 1) * 2 > stacks_size) {
+        if (!grow_stacks()) {
+            dropped_count++;
+            return;
+        }
+        stack = find_stack(stacks, stacks_size, hash, ids, length);
+    }
+    if (!add_to_pool(ids, length)) {
+        dropped_count++;
+        return;
+    }
+    stack->hash = hash;
+    stack->length = length;
+    stack->start = pool_used - length;
+    stack->count = 1;
+    stack_count++;
+    sample_count++;
+}
+
+
+void profile_cycles(long cycles) {
+    cycles_left -= cycles;
+    if (cycles_left <= 0) {
+        cycles_left += interval;
+        take_sample();
+    }
+}
+
+
+/* Name a frame by its label, or its bank and address if it has none.
+ * Calls into the middle of a label are given as an offset from it,
+ * the PC at the top of the stack is just named by the label it's in */
+static void frame_name(uint32_t id, int top, char *name) {
+
+    unsigned bank = id >> 16;
+    uint16_t addr = id & 0xFFFF;
+    uint16_t offset;
+
+    char const *label = find_symbol(bank == NO_BANK ? 0 : (int)bank, addr, &offset);
+    if (label != NULL && (top || offset == 0)) {
+        snprintf(name, MAX_NAME_LENGTH, "%s", label);
+    } else if (label != NULL) {
+        snprintf(name, MAX_NAME_LENGTH, "%s+%X", label, offset);
+    } else if (bank == 0 && addr <= 0x60 && (addr & 0x7) == 0) {
+        snprintf(name, MAX_NAME_LENGTH, "%s", vector_names[addr >> 3]);
+    } else if (bank == NO_BANK) {
+        snprintf(name, MAX_NAME_LENGTH, "%04X", addr);
+    } else {
+        snprintf(name, MAX_NAME_LENGTH, "%02X:%04X", bank, addr);
+    }
+}
+
+
+// A sampled stack with its frames named
+typedef struct {
+    char *frames;
+    unsigned long count;
+} Named_Stack;
+
+
+static int compare_named_stacks(void const *a, void const *b) {
+    return strcmp(((Named_Stack const *)a)->frames, ((Named_Stack const *)b)->frames);
+}
+
+
+/* Write a line for each sampled stack, merging stacks which are named
+ * the same, such as those sampled at different PCs in one label.
+ * returns the number of lines written, or -1 if out of memory */
+static long write_samples(FILE *file) {
+
+    Named_Stack *named = malloc((stack_count ? stack_count : 1) * sizeof(Named_Stack));
+    if (named == NULL) {
+        return -1;
+    }
+
+    char name[MAX_NAME_LENGTH];
+    unsigned long count = 0;
+    int success = 1;
+    for (unsigned long i = 0; i < stacks_size && success; i++) {
+        Sampled_Stack const *stack = &stacks[i];
+        if (stack->count == 0) {
+            continue;
+        }
+        char *frames = malloc(stack->length * (MAX_NAME_LENGTH + 1));
+        if (frames == NULL) {
+            success = 0;
+            break;
+        }
+        size_t used = 0;
+        for (unsigned j = 0; j < stack->length; j++) {
+            frame_name(stack_pool[stack->start + j], j == stack->length - 1, name);
+            used += sprintf(frames + used, j ? ";%s" : "%s", name);
+        }
+        named[count].frames = frames;
+        named[count].count = stack->count;
+        count++;
+    }
+
+    long lines = 0;
+    if (success) {
+        qsort(named, count, sizeof(Named_Stack), compare_named_stacks);
+        for (unsigned long i = 0; i < count; i++) {
+            if (i + 1 < count && !strcmp(named[i].frames, named[i + 1].frames)) {
+                named[i + 1].count += named[i].count;
+                continue;
+            }
+            fprintf(file, "%s %lu\n", named[i].frames, named[i].count);
+            lines++;
+        }
+    }
+
+    for (unsigned long i = 0; i < count; i++) {
+        free(named[i].frames);
+    }
+    free(named);
+    return success ? lines : -1;
+}
+
+
+int stop_profiling(char const *file_path) {
+
+    if (!profiling) {
+        return 0;
+    }
+    profiling = 0;
+
+    FILE *file = NULL;
+    if (file_path != NULL && !(file = fopen(file_path, "w"))) {
+        log_message(LOG_ERROR, "Error opening profile output %s\n", file_path);
+    }
+
+    int success = file != NULL;
+    if (file != NULL) {
+        long lines = write_samples(file);
+        success = lines >= 0 && !ferror(file);
+        success &= fclose(file) == 0;
+        if (success) {
+            log_message(LOG_INFO, "Wrote %lu samples of %ld call stacks to %s\n",
+                sample_count, lines, file_path);
+        } else {
+            log_message(LOG_ERROR, "Error writing profile output %s\n", file_path);
+        }
+    }
+    if (dropped_count) {
+        log_message(LOG_WARN, "%lu samples were dropped, out of memory\n", dropped_count);
+    }
+    free_samples();
+    return success;
+}
@@ -0,0 +1,39 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <stdint.h>
+
+/* Sampling profiler for the game being run.
+ *
+ * Every interval emulated cycles the current ROM bank and PC are
+ * sampled along with a shadow call stack, which follows CALL, RST,
+ * interrupt dispatch and RET/RETI. Frames are matched to returns by
+ * stack pointer, so games which pop return addresses or reset the
+ * stack don't leave it out of step.
+ *
+ * Samples are written in the collapsed stack format flamegraph.pl
+ * takes, named with labels from a .sym file if loaded. */
+
+#define PROFILE_DEFAULT_INTERVAL 4096 // About 1ms of emulated time
+
+// Set while profiling, checked before calling any of the profile_ hooks
+extern int profiling;
+
+/* Start sampling every interval cycles.
+ * returns 1 if successful, 0 otherwise */
+int start_profiling(unsigned interval);
+
+/* Stop sampling and write the samples to the given file, if any.
+ * returns 1 if successful, 0 otherwise */
+int stop_profiling(char const *file_path);
+
+// A call or restart to target has pushed its return address to sp
+void profile_call(uint16_t target, uint16_t sp);
+
+// A return is about to pop its address from sp
+void profile_return(uint16_t sp);
+
+// Count emulated cycles, sampling when the interval has passed
+void profile_cycles(long cycles);
+
+#endif /* PROFILER_H */
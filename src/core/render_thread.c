@@ -0,0 +1,377 @@
+#include "render_thread.h"
+
+#include "../non_core/logger.h"
+
+int render_threaded = 0;
+
+#ifdef THREADED_RENDER
+
+#include <pthread.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "mmu/memory.h"
+#include "memory_layout.h"
+#include "sprite_priorities.h"
+#include "bits.h"
+#include "instrument.h"
+
+#include "../non_core/graphics_out.h"
+#include "../non_core/framerate.h"
+
+#define VRAM_SIZE 0x2000
+#define VRAM_PAGE_SHIFT 8
+#define VRAM_PAGES (VRAM_SIZE >> VRAM_PAGE_SHIFT)
+
+#define MAX_RENDER_CMDS 0x4000
+#define MAX_SPRITE_ORDERS 64
+
+// Commands replayed by the worker, on top of the logged write types
+#define RENDER_LINE 5
+#define RENDER_SPRITE_ORDER 6
+
+typedef struct {
+    uint8_t type;
+    uint8_t val;
+    uint16_t index; // Memory offset, or index into lines/sprite orders
+} Render_Cmd;
+
+typedef struct {
+    /* Copy of video memory as it was at the start of the frame, the
+     * worker applies the logged writes to it as it renders the frame */
+    uint8_t vram[2][VRAM_SIZE];
+    uint8_t oam[0xA0];
+    uint8_t bg_palette[0x40];
+    uint8_t sprite_palette[0x40];
+    uint8_t sprite_order[MAX_SPRITES];
+    bool bg_palette_dirty;
+    bool sprite_palette_dirty;
+
+    // VRAM pages written since the copy was last brought up to date
+    uint8_t vram_dirty[2][VRAM_PAGES];
+
+    Line_Regs lines[GB_PIXELS_Y];
+    uint8_t sprite_orders[MAX_SPRITE_ORDERS][MAX_SPRITES];
+    Render_Cmd cmds[MAX_RENDER_CMDS];
+    int line_count;
+    int sprite_order_count;
+    int cmd_count;
+} Render_Frame;
+
+/* Frames are double buffered, one being recorded by the emulation
+ * thread while the worker renders the other */
+static Render_Frame frames[2];
+static int record_index = 0;
+static Render_Frame *recording = NULL;
+static unsigned recorded_sprite_order_version;
+
+static int frame_started = 0;
+static int rendering_live = 0; // Current frame fell back to rendering on this thread
+static int in_flight = 0; // A frame is with the worker and not yet presented
+
+static pthread_t worker;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cond = PTHREAD_COND_INITIALIZER;
+static Render_Frame *pending = NULL;
+static int busy = 0;
+static int quit = 0;
+
+
+// Apply the recorded commands in order, rendering each line
+static void replay_frame(Render_Frame *frame) {
+
+    Render_Source source;
+    source.vram[0] = frame->vram[0];
+    source.vram[1] = frame->vram[1];
+    source.oam = frame->oam;
+    source.bg_palette = frame->bg_palette;
+    source.sprite_palette = frame->sprite_palette;
+    source.bg_palette_dirty = &frame->bg_palette_dirty;
+    source.sprite_palette_dirty = &frame->sprite_palette_dirty;
+    source.sprite_order = frame->sprite_order;
+
+    // Rendered palettes are shared with whatever rendered last
+    frame->bg_palette_dirty = true;
+    frame->sprite_palette_dirty = true;
+
+    for (int i = 0; i < frame->cmd_count; i++) {
+        Render_Cmd const *cmd = &frame->cmds[i];
+
+        switch (cmd->type) {
+            case RENDER_LINE:
+                render_line(&frame->lines[cmd->index], &source);
+                break;
+            case RENDER_VRAM0: frame->vram[0][cmd->index] = cmd->val; break;
+            case RENDER_VRAM1: frame->vram[1][cmd->index] = cmd->val; break;
+            case RENDER_OAM: frame->oam[cmd->index] = cmd->val; break;
+            case RENDER_BG_PALETTE:
+                frame->bg_palette[cmd->index] = cmd->val;
+                frame->bg_palette_dirty = true;
+                break;
+            case RENDER_SPRITE_PALETTE:
+                frame->sprite_palette[cmd->index] = cmd->val;
+                frame->sprite_palette_dirty = true;
+                break;
+            case RENDER_SPRITE_ORDER:
+                memcpy(frame->sprite_order, frame->sprite_orders[cmd->index], MAX_SPRITES);
+                break;
+        }
+    }
+}
+
+
+static void *render_worker(void *arg) {
+    (void)arg;
+
+    pthread_mutex_lock(&lock);
+    for (;;) {
+        while (!pending && !quit) {
+            pthread_cond_wait(&cond, &lock);
+        }
+        if (quit) {
+            break;
+        }
+
+        Render_Frame *frame = pending;
+        pending = NULL;
+        busy = 1;
+        pthread_mutex_unlock(&lock);
+
+        replay_frame(frame);
+
+        pthread_mutex_lock(&lock);
+        busy = 0;
+        pthread_cond_broadcast(&cond);
+    }
+    pthread_mutex_unlock(&lock);
+    return NULL;
+}
+
+
+static void wait_for_worker() {
+    pthread_mutex_lock(&lock);
+    while (pending || busy) {
+        pthread_cond_wait(&cond, &lock);
+    }
+    pthread_mutex_unlock(&lock);
+}
+
+
+// Once the worker has finished the frame it was given, show it
+static void present_in_flight() {
+    if (in_flight) {
+        wait_for_worker();
+        present_screen();
+        in_flight = 0;
+    }
+}
+
+
+static void mark_all_dirty(Render_Frame *frame) {
+    memset(frame->vram_dirty, 1, sizeof(frame->vram_dirty));
+}
+
+
+// Bring the frame's copy of video memory up to date with the Gameboy's
+static void sync_frame(Render_Frame *frame) {
+
+    for (int bank = 0; bank < 2; bank++) {
+        uint8_t const *vram = get_vram_bank(bank);
+        for (int page = 0; page < VRAM_PAGES; page++) {
+            if (frame->vram_dirty[bank][page]) {
+                int offset = page << VRAM_PAGE_SHIFT;
+                memcpy(frame->vram[bank] + offset, vram + offset, 1 << VRAM_PAGE_SHIFT);
+                frame->vram_dirty[bank][page] = 0;
+            }
+        }
+    }
+    memcpy(frame->oam, oam_mem_ptr, sizeof(frame->oam));
+    memcpy(frame->bg_palette, get_bg_palette(), sizeof(frame->bg_palette));
+    memcpy(frame->sprite_palette, get_sprite_palette(), sizeof(frame->sprite_palette));
+    get_sprite_prio_order(frame->sprite_order);
+    recorded_sprite_order_version = sprite_prio_version;
+
+    frame->line_count = 0;
+    frame->sprite_order_count = 0;
+    frame->cmd_count = 0;
+}
+
+
+/* The frame can't be recorded any further, wait for the worker
+ * and render what has been recorded so far on this thread, then
+ * carry on rendering the rest of the frame from live memory */
+static void fall_back_to_live() {
+
+    Render_Frame *frame = recording;
+    recording = NULL;
+
+    present_in_flight();
+    replay_frame(frame);
+
+    // Writes are no longer logged, copy everything next time
+    mark_all_dirty(frame);
+    bg_palette_dirty = true;
+    sprite_palette_dirty = true;
+    rendering_live = 1;
+}
+
+
+static void push_cmd(uint8_t type, uint16_t index, uint8_t val) {
+
+    if (recording->cmd_count >= MAX_RENDER_CMDS) {
+        fall_back_to_live();
+        return;
+    }
+
+    Render_Cmd *cmd = &recording->cmds[recording->cmd_count++];
+    cmd->type = type;
+    cmd->index = index;
+    cmd->val = val;
+}
+
+
+void render_thread_log(int type, uint16_t index, uint8_t val) {
+
+    // VRAM write types double as the bank number
+    if (type == RENDER_VRAM0 || type == RENDER_VRAM1) {
+        frames[0].vram_dirty[type][index >> VRAM_PAGE_SHIFT] = 1;
+        frames[1].vram_dirty[type][index >> VRAM_PAGE_SHIFT] = 1;
+    }
+
+    if (recording) {
+        push_cmd(type, index, val);
+    }
+}
+
+
+static void record_line(Line_Regs const *regs) {
+
+    if (recorded_sprite_order_version != sprite_prio_version) {
+        if (recording->sprite_order_count < MAX_SPRITE_ORDERS) {
+            int order_index = recording->sprite_order_count++;
+            get_sprite_prio_order(recording->sprite_orders[order_index]);
+            recorded_sprite_order_version = sprite_prio_version;
+            push_cmd(RENDER_SPRITE_ORDER, order_index, 0);
+        } else {
+            fall_back_to_live();
+        }
+    }
+
+    if (recording) {
+        if (recording->line_count < GB_PIXELS_Y) {
+            int line_index = recording->line_count++;
+            recording->lines[line_index] = *regs;
+            push_cmd(RENDER_LINE, line_index, 0);
+        } else {
+            fall_back_to_live();
+        }
+    }
+
+    // Couldn't be recorded, render it now instead
+    if (!recording) {
+        render_live_line(regs);
+    }
+}
+
+
+static void end_frame() {
+
+    frame_started = 0;
+
+    if (recording) {
+        present_in_flight();
+
+        pthread_mutex_lock(&lock);
+        pending = recording;
+        pthread_cond_broadcast(&cond);
+        pthread_mutex_unlock(&lock);
+
+        recording = NULL;
+        record_index ^= 1;
+        in_flight = 1;
+    } else if (rendering_live) {
+        present_screen();
+        rendering_live = 0;
+    } else {
+        // Frame skipped, show the last frame if it's still with the worker
+        present_in_flight();
+    }
+    ZONE_BEGIN(ZONE_FRAMERATE);
+    adjust_to_framerate();
+    ZONE_END(ZONE_FRAMERATE);
+}
+
+
+void render_thread_draw_row(Line_Regs const *regs, int render) {
+
+    // Start recording at the first line of a frame which is to be rendered
+    if (!frame_started) {
+        frame_started = 1;
+        if (render) {
+            recording = &frames[record_index];
+            sync_frame(recording);
+        }
+    }
+
+    if (render && (regs->lcdc & BIT_7)) {
+        if (recording) {
+            record_line(regs);
+        } else if (rendering_live) {
+            render_live_line(regs);
+        }
+    }
+
+    if (regs->ly >= 143) {
+        end_frame();
+    }
+}
+
+
+int set_threaded_render(int enabled) {
+
+    if (enabled == render_threaded) {
+        return 1;
+    }
+
+    if (enabled) {
+        quit = 0;
+        if (pthread_create(&worker, NULL, render_worker, NULL) != 0) {
+            log_message(LOG_ERROR, "Failed to start render thread\n");
+            return 0;
+        }
+        mark_all_dirty(&frames[0]);
+        mark_all_dirty(&frames[1]);
+        frame_started = 0;
+        render_threaded = 1;
+    } else {
+        if (recording) {
+            fall_back_to_live();
+        }
+        present_in_flight();
+
+        pthread_mutex_lock(&lock);
+        quit = 1;
+        pthread_cond_broadcast(&cond);
+        pthread_mutex_unlock(&lock);
+        pthread_join(worker, NULL);
+
+        bg_palette_dirty = true;
+        sprite_palette_dirty = true;
+        rendering_live = 0;
+        render_threaded = 0;
+    }
+    return 1;
+}
+
+#else
+
+int set_threaded_render(int enabled) {
+
+    if (enabled) {
+        log_message(LOG_WARN, "Threaded rendering not supported in this build\n");
+        return 0;
+    }
+    return 1;
+}
+
+#endif
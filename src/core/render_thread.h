@@ -0,0 +1,42 @@
+#ifndef RENDER_THREAD_H
+#define RENDER_THREAD_H
+
+#include <stdint.h>
+
+#include "graphics.h"
+
+/* Rasterises frames on a separate thread, while the emulator runs
+ * frame N+1 the worker renders frame N from a copy of video memory
+ * kept up to date by a log of writes made during the frame.
+ * Only available when built with THREADED_RENDER (pthreads). */
+
+// Types of video memory write logged for the render thread
+#define RENDER_VRAM0 0
+#define RENDER_VRAM1 1
+#define RENDER_OAM 2
+#define RENDER_BG_PALETTE 3
+#define RENDER_SPRITE_PALETTE 4
+
+extern int render_threaded; // 1 if lines are being rendered on the worker
+
+/* 1 to render on a worker thread, 0 to render on the emulation
+ * thread. Should be called between frames.
+ * returns 1 if successful, 0 otherwise */
+int set_threaded_render(int enabled);
+
+/* Record the given line for the worker, render is 0 if the
+ * current frame is being skipped. Presents the previous frame
+ * once the last line has been drawn */
+void render_thread_draw_row(Line_Regs const *regs, int render);
+
+// Log a write to VRAM, OAM or CGB palette memory
+void render_thread_log(int type, uint16_t index, uint8_t val);
+
+#ifdef THREADED_RENDER
+#define LOG_RENDER_WRITE(type, index, val) \
+    do { if (render_threaded) render_thread_log(type, index, val); } while (0)
+#else
+#define LOG_RENDER_WRITE(type, index, val)
+#endif
+
+#endif /* RENDER_THREAD_H */
@@ -0,0 +1,303 @@
+#include "rom_archive.h"
+
+#include "../non_core/logger.h"
+
+#ifndef EFIAPI
+
+#include "inflate.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <ctype.h>
+
+#define METHOD_STORED 0
+#define METHOD_DEFLATE 8
+
+#define ZIP_LOCAL_SIG 0x04034B50
+#define ZIP_CENTRAL_SIG 0x02014B50
+#define ZIP_END_SIG 0x06054B50
+#define ZIP_END_SIZE 22
+#define ZIP_MAX_COMMENT 0xFFFF
+#define MAX_MEMBER_NAME 256
+
+// gzip header flags
+#define GZ_FHCRC 0x2
+#define GZ_FEXTRA 0x4
+#define GZ_FNAME 0x8
+#define GZ_FCOMMENT 0x10
+
+typedef struct {
+    uint32_t offset; // Start of the compressed data
+    uint32_t compressed_size;
+    uint32_t size;
+    uint32_t crc;
+    int method;
+} Archive_Member;
+
+typedef struct {
+    FILE *file;
+    uint32_t remaining;
+} Member_Input;
+
+
+static uint16_t get_u16(uint8_t const *buf) {
+    return buf[0] | (buf[1] << 8);
+}
+
+
+static uint32_t get_u32(uint8_t const *buf) {
+    return get_u16(buf) | ((uint32_t)get_u16(buf + 2) << 16);
+}
+
+
+static int has_extension(char const *file_path, char const *ext) {
+
+    size_t path_len = strlen(file_path);
+    size_t ext_len = strlen(ext);
+    if (path_len < ext_len) {
+        return 0;
+    }
+
+    char const *end = file_path + path_len - ext_len;
+    for (size_t i = 0; i < ext_len; i++) {
+        if (tolower((unsigned char)end[i]) != ext[i]) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+
+int is_rom_archive(char const *file_path) {
+    return has_extension(file_path, ".gz") || has_extension(file_path, ".zip");
+}
+
+
+static size_t read_member(void *ctx, uint8_t *buf, size_t size) {
+
+    Member_Input *input = ctx;
+    if (size > input->remaining) {
+        size = input->remaining;
+    }
+    size = fread(buf, 1, size, input->file);
+    input->remaining -= size;
+    return size;
+}
+
+
+static int read_at(FILE *file, long offset, uint8_t *buf, size_t size) {
+    return fseek(file, offset, SEEK_SET) == 0 && fread(buf, 1, size, file) == size;
+}
+
+
+static int is_rom_name(char const *name) {
+    return has_extension(name, ".gb") || has_extension(name, ".gbc") ||
+           has_extension(name, ".sgb");
+}
+
+
+/* Find the first ROM in the zip's central directory, or the
+ * first file if none look like ROMs. returns 1 if found */
+static int find_zip_member(FILE *file, Archive_Member *member) {
+
+    static uint8_t tail[ZIP_END_SIZE + ZIP_MAX_COMMENT];
+
+    if (fseek(file, 0, SEEK_END) != 0) {
+        return 0;
+    }
+    long file_size = ftell(file);
+    long tail_size = file_size < (long)sizeof(tail) ? file_size : (long)sizeof(tail);
+    if (tail_size < ZIP_END_SIZE || !read_at(file, file_size - tail_size, tail, tail_size)) {
+        return 0;
+    }
+
+    // End of central directory record, followed by a comment
+    long end = tail_size - ZIP_END_SIZE;
+    while (end >= 0 && get_u32(tail + end) != ZIP_END_SIG) {
+        end--;
+    }
+    if (end < 0) {
+        log_message(LOG_ERROR, "Zip end of central directory not found\n");
+        return 0;
+    }
+
+    unsigned entries = get_u16(tail + end + 10);
+    long entry_offset = get_u32(tail + end + 16);
+    int found = 0;
+
+    for (unsigned i = 0; i < entries; i++) {
+        uint8_t entry[46];
+        char name[MAX_MEMBER_NAME];
+
+        if (!read_at(file, entry_offset, entry, sizeof(entry)) ||
+            get_u32(entry) != ZIP_CENTRAL_SIG) {
+            return 0;
+        }
+
+        unsigned name_len = get_u16(entry + 28);
+        size_t read_len = name_len < MAX_MEMBER_NAME ? name_len : MAX_MEMBER_NAME - 1;
+        if (fread(name, 1, read_len, file) != read_len) {
+            return 0;
+        }
+        name[read_len] = '\0';
+
+        int is_rom = is_rom_name(name);
+        if (name_len > 0 && name[read_len - 1] != '/' && (is_rom || !found)) {
+            member->method = get_u16(entry + 10);
+            member->crc = get_u32(entry + 16);
+            member->compressed_size = get_u32(entry + 20);
+            member->size = get_u32(entry + 24);
+            member->offset = get_u32(entry + 42); // Local header, for now
+            found = 1;
+            if (is_rom) {
+                break;
+            }
+        }
+
+        entry_offset += 46 + name_len + get_u16(entry + 30) + get_u16(entry + 32);
+    }
+
+    if (!found) {
+        log_message(LOG_ERROR, "No files found in zip\n");
+        return 0;
+    }
+
+    // Skip over the local header to the data
+    uint8_t local[30];
+    if (!read_at(file, member->offset, local, sizeof(local)) ||
+        get_u32(local) != ZIP_LOCAL_SIG) {
+        return 0;
+    }
+    member->offset += sizeof(local) + get_u16(local + 26) + get_u16(local + 28);
+    return 1;
+}
+
+
+static int find_gzip_member(FILE *file, Archive_Member *member) {
+
+    uint8_t header[10];
+    uint8_t trailer[8];
+
+    if (!read_at(file, 0, header, sizeof(header)) ||
+        header[0] != 0x1F || header[1] != 0x8B || header[2] != METHOD_DEFLATE) {
+        log_message(LOG_ERROR, "Not a gzip file\n");
+        return 0;
+    }
+
+    int flags = header[3];
+    if (flags & GZ_FEXTRA) {
+        uint8_t len[2];
+        if (fread(len, 1, 2, file) != 2 || fseek(file, get_u16(len), SEEK_CUR) != 0) {
+            return 0;
+        }
+    }
+    for (int flag = GZ_FNAME; flag <= GZ_FCOMMENT; flag <<= 1) {
+        if (flags & flag) {
+            int c;
+            while ((c = fgetc(file)) != 0) {
+                if (c == EOF) {
+                    return 0;
+                }
+            }
+        }
+    }
+    if ((flags & GZ_FHCRC) && fseek(file, 2, SEEK_CUR) != 0) {
+        return 0;
+    }
+    member->offset = ftell(file);
+
+    // CRC and size of the uncompressed data come last
+    if (fseek(file, -(long)sizeof(trailer), SEEK_END) != 0 ||
+        fread(trailer, 1, sizeof(trailer), file) != sizeof(trailer)) {
+        return 0;
+    }
+    member->compressed_size = ftell(file) - sizeof(trailer) - member->offset;
+    member->crc = get_u32(trailer);
+    member->size = get_u32(trailer + 4);
+    member->method = METHOD_DEFLATE;
+    return 1;
+}
+
+
+static unsigned long decompress_rom(char const *file_path, unsigned char *data, size_t size) {
+
+    FILE *file;
+    Archive_Member member;
+
+    if (!(file = fopen(file_path, "rb"))) {
+        log_message(LOG_ERROR, "Error opening file %s\n", file_path);
+        return 0;
+    }
+
+    int found = has_extension(file_path, ".zip") ?
+        find_zip_member(file, &member) : find_gzip_member(file, &member);
+    if (!found || fseek(file, member.offset, SEEK_SET) != 0) {
+        log_message(LOG_ERROR, "Unable to find ROM in archive %s\n", file_path);
+        fclose(file);
+        return 0;
+    }
+
+    Member_Input input = {file, member.compressed_size};
+    long count;
+    if (member.method == METHOD_STORED) {
+        count = read_member(&input, data, size < member.size ? size : member.size);
+    } else if (member.method == METHOD_DEFLATE) {
+        count = inflate_stream(read_member, &input, data, size);
+    } else {
+        log_message(LOG_ERROR, "Unsupported compression method %d in %s\n", member.method, file_path);
+        count = -1;
+    }
+    fclose(file);
+
+    if (count <= 0) {
+        log_message(LOG_ERROR, "Failed to decompress %s\n", file_path);
+        return 0;
+    }
+
+    // Only possible to check the whole ROM
+    if ((uint32_t)count == member.size && crc32(data, count) != member.crc) {
+        log_message(LOG_ERROR, "CRC mismatch decompressing %s\n", file_path);
+        return 0;
+    }
+    return count;
+}
+
+
+unsigned long load_rom_from_archive(char const *file_path, unsigned char *data, size_t size) {
+
+    unsigned long count = decompress_rom(file_path, data, size);
+    if (count) {
+        log_message(LOG_INFO, "Loaded %lu bytes from archive\n", count);
+    }
+    return count;
+}
+
+
+unsigned long read_archive_header(char const *file_path, unsigned char *data, size_t size) {
+    return decompress_rom(file_path, data, size);
+}
+
+#else
+
+int is_rom_archive(char const *file_path) {
+    (void)file_path;
+    return 0;
+}
+
+unsigned long load_rom_from_archive(char const *file_path, unsigned char *data, size_t size) {
+    (void)file_path;
+    (void)data;
+    (void)size;
+    log_message(LOG_ERROR, "Compressed ROMs not supported in this build\n");
+    return 0;
+}
+
+unsigned long read_archive_header(char const *file_path, unsigned char *data, size_t size) {
+    (void)file_path;
+    (void)data;
+    (void)size;
+    return 0;
+}
+
+#endif
@@ -0,0 +1,21 @@
+#ifndef ROM_ARCHIVE_H
+#define ROM_ARCHIVE_H
+
+#include <stddef.h>
+
+/* Loading of ROMs compressed with gzip (.gz), or the first
+ * Gameboy ROM in a zip file (.zip), stored or deflated */
+
+// Returns 1 if the file is a .gz or .zip archive, 0 otherwise
+int is_rom_archive(char const *file_path);
+
+/* Decompress up to size bytes from the start of the ROM in the archive
+ * into data, only as much of the archive as is needed is decompressed.
+ * returns the number of bytes loaded, or 0 if unsuccessful */
+unsigned long load_rom_from_archive(char const *file_path, unsigned char *data, size_t size);
+
+/* Same as load_rom_from_archive without logging success, for reading
+ * just the header of many archives */
+unsigned long read_archive_header(char const *file_path, unsigned char *data, size_t size);
+
+#endif /* ROM_ARCHIVE_H */
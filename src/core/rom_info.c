@@ -134,14 +134,53 @@ uint16_t get_rom_size() {
  *  if unknown id in memory*/
 const char *get_cartridge_type() {
 
+    return cartridge_type_name(get_mem(CARTRIDGE_TYPE));
+}  
+
+
+/*  Returns pointer to the name of the given cartridge type id,
+ *  NULL if unknown */
+const char *cartridge_type_name(uint8_t id) {
+
     uint8_t i;
     for (i = 0; i < CARTRIDGE_TYPE_LEN; i++) {
-        if(get_mem(CARTRIDGE_TYPE) == cartridge_types[i].id) {
+        if(id == cartridge_types[i].id) {
             return cartridge_types[i].name;
         }
     }
     return NULL;
-}  
+}
+
+
+/* Parses the first ROM_HEADER_SIZE bytes of a ROM into info,
+ * without needing it loaded. returns 1 if the header checksum
+ * matches, 0 otherwise */
+int parse_rom_header(uint8_t const *header, rom_header_info *info) {
+
+    /* The title runs into the CGB flag on older carts, newer
+     * ones end it early with padding or the flag itself */
+    int len = 0;
+    while (len < ROM_TITLE_LENGTH && header[ROM_NAME_START + len] >= 0x20 &&
+           header[ROM_NAME_START + len] < 0x7F) {
+        info->title[len] = header[ROM_NAME_START + len];
+        len++;
+    }
+    while (len > 0 && info->title[len - 1] == ' ') {
+        len--;
+    }
+    info->title[len] = '\0';
+
+    info->cgb_flag = header[IS_COLOUR_COMPATIBLE];
+    info->cartridge_type = header[CARTRIDGE_TYPE];
+    info->global_checksum = (header[CHECKSUM_MSB] << 8) | header[CHECKSUM_LSB];
+
+    uint8_t checksum = 0;
+    for (unsigned i = ROM_NAME_START; i < COMPLEMENT_CHECKSUM; i++) {
+        checksum = checksum - header[i] - 1;
+    }
+    info->header_checksum_ok = checksum == header[COMPLEMENT_CHECKSUM];
+    return info->header_checksum_ok;
+}
 
 
 /*  Returns ram save size in KB, returns 255
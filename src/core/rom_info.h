@@ -43,8 +43,20 @@ extern int cgb_features;
 
 #define CHECKSUM_MSB 0x14E
 #define CHECKSUM_LSB 0x14F
+
+#define ROM_HEADER_SIZE 0x150
+#define ROM_TITLE_LENGTH 16
 /* -------------------------------- */
 
+/* Header fields of a ROM that isn't loaded, e.g. for listing ROMs */
+typedef struct {
+    char title[ROM_TITLE_LENGTH + 1];
+    uint8_t cgb_flag;
+    uint8_t cartridge_type;
+    uint8_t header_checksum_ok;
+    uint16_t global_checksum;
+} rom_header_info;
+
 
 
 /*  Returns pointer to liscensee,
@@ -63,6 +75,15 @@ uint16_t get_rom_size();
  *  if unknown id in memory*/
 const char *get_cartridge_type();
 
+/*  Returns pointer to the name of the given cartridge type id,
+ *  NULL if unknown */
+const char *cartridge_type_name(uint8_t id);
+
+/* Parses the first ROM_HEADER_SIZE bytes of a ROM into info,
+ * without needing it loaded. returns 1 if the header checksum
+ * matches, 0 otherwise */
+int parse_rom_header(uint8_t const *header, rom_header_info *info);
+
 
 /*  Returns ram save size in KB, returns 255
  *  if unknown id currently in memory */
@@ -5,6 +5,7 @@
 #include "interrupts.h"
 #include "timers.h"
 #include "serial_io.h"
+#include "instrument.h"
 #include "../non_core/serial_io_transfer.h"
 #include "../non_core/mobile.h"
 
@@ -42,7 +43,10 @@ void start_transfer(uint8_t *ctl, uint8_t *data) {
  * used to ensure when using internal clock,
  * data is transfered at the correct clock speed */
 void inc_serial_cycles(unsigned cycles) {
+    ZONE_BEGIN(ZONE_SERIAL);
+    ZONE_BEGIN(ZONE_MOBILE);
     MobileLoop(cycles);
+    ZONE_END(ZONE_MOBILE);
     
     if (transfer_in_progress && internal_clock) {
         cur_cycles += cycles;
@@ -67,5 +71,5 @@ void inc_serial_cycles(unsigned cycles) {
             transfer_in_progress = 0;
         } 
     }
-
+    ZONE_END(ZONE_SERIAL);
 }
@@ -17,6 +17,8 @@ static Node sentinal_deref;
 static Node *sentinal = &sentinal_deref; 
 static Node *head_ptr; //current head of queue
 
+unsigned sprite_prio_version = 0;
+
 void init_sprite_prio_list() {
 
     Node *prev = sentinal;
@@ -32,6 +34,7 @@ void init_sprite_prio_list() {
     sentinal->prev = prio_sprites + MAX_SPRITES - 1;
 
     head_ptr = sentinal->next;
+    sprite_prio_version++;
 }
 
 
@@ -80,6 +83,16 @@ void update_sprite_prios(int sprite_no, uint8_t x_pos) {
     if (current_node != swap_node && swap_node == head_ptr) {
         head_ptr = current_node;
     }
+    sprite_prio_version++;
+}
+
+
+void get_sprite_prio_order(uint8_t order[MAX_SPRITES]) {
+
+    int i = 0;
+    for (Node *node = head_ptr; node != sentinal; node = node->next) {
+        order[i++] = node - prio_sprites;
+    }
 }
 
 
@@ -17,6 +17,12 @@ void init_sprite_prio_list();
  * reorders the given sprite's priority */   
 void update_sprite_prios(int sprite_no, uint8_t x_pos);
 
+/* Incremented whenever the priority order may have changed */
+extern unsigned sprite_prio_version;
+
+// Fill the given array with sprite numbers, highest priority first
+void get_sprite_prio_order(uint8_t order[MAX_SPRITES]);
+
 Sprite_Iterator create_sprite_iterator();
 int sprite_iterator_next(Sprite_Iterator *si);
 #endif //SPRITE_PRIOS_H
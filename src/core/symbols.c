@@ -0,0 +1,126 @@
+#include "symbols.h"
+
+#include "../non_core/logger.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_LINE_LENGTH 512
+#define SYMBOL_KEY(bank, addr) (((uint32_t)(bank) << 16) | (addr))
+
+typedef struct {
+    uint32_t key; // bank << 16 | addr
+    char *name;
+} Symbol;
+
+static Symbol *symbols = NULL;
+static unsigned symbol_count = 0;
+
+
+static int compare_symbols(void const *a, void const *b) {
+    uint32_t key_a = ((Symbol const *)a)->key;
+    uint32_t key_b = ((Symbol const *)b)->key;
+    return (key_a > key_b) - (key_a < key_b);
+}
+
+
+static int add_symbol(unsigned *capacity, unsigned bank, unsigned addr, char const *name) {
+
+    if (symbol_count == *capacity) {
+        unsigned new_capacity = *capacity ? *capacity * 2 : 256;
+        Symbol *grown = realloc(symbols, new_capacity * sizeof(Symbol));
+        if (grown == NULL) {
+            return 0;
+        }
+        symbols = grown;
+        *capacity = new_capacity;
+    }
+
+    char *copy = malloc(strlen(name) + 1);
+    if (copy == NULL) {
+        return 0;
+    }
+    strcpy(copy, name);
+    symbols[symbol_count].key = SYMBOL_KEY(bank, addr);
+    symbols[symbol_count].name = copy;
+    symbol_count++;
+    return 1;
+}
+
+
+int load_symbols(char const *file_path) {
+
+    FILE *file;
+    if (!(file = fopen(file_path, "r"))) {
+        log_message(LOG_ERROR, "Error opening symbol file %s\n", file_path);
+        return 0;
+    }
+    clear_symbols();
+
+    char line[MAX_LINE_LENGTH];
+    char name[MAX_LINE_LENGTH];
+    unsigned capacity = 0;
+    unsigned bank, addr;
+
+    while (fgets(line, sizeof(line), file)) {
+        char *start = line + strspn(line, " \t");
+        if (*start == ';' || sscanf(start, "%x:%x %s", &bank, &addr, name) != 3) {
+            continue;
+        }
+        if (bank > 0xFFFF || addr > 0xFFFF) {
+            continue;
+        }
+        if (!add_symbol(&capacity, bank, addr, name)) {
+            log_message(LOG_ERROR, "Unable to allocate symbols for %s\n", file_path);
+            fclose(file);
+            clear_symbols();
+            return 0;
+        }
+    }
+    fclose(file);
+
+    qsort(symbols, symbol_count, sizeof(Symbol), compare_symbols);
+    log_message(LOG_INFO, "Loaded %u symbols from %s\n", symbol_count, file_path);
+    return 1;
+}
+
+
+void clear_symbols() {
+    for (unsigned i = 0; i < symbol_count; i++) {
+        free(symbols[i].name);
+    }
+    free(symbols);
+    symbols = NULL;
+    symbol_count = 0;
+}
+
+
+char const *find_symbol(int bank, uint16_t addr, uint16_t *offset) {
+
+    if (bank < 0) {
+        bank = 0;
+    }
+    uint32_t key = SYMBOL_KEY(bank, addr);
+
+    // Find the last symbol with a key <= key
+    unsigned low = 0, high = symbol_count;
+    while (low < high) {
+        unsigned mid = low + (high - low) / 2;
+        if (symbols[mid].key <= key) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    if (low == 0) {
+        return NULL;
+    }
+
+    Symbol const *symbol = &symbols[low - 1];
+    if ((symbol->key >> 16) != (uint32_t)bank || ((symbol->key & 0xFFFF) >> 14) != (addr >> 14u)) {
+        return NULL;
+    }
+    *offset = addr - (symbol->key & 0xFFFF);
+    return symbol->name;
+}
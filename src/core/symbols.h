@@ -0,0 +1,20 @@
+#ifndef SYMBOLS_H
+#define SYMBOLS_H
+
+#include <stdint.h>
+
+/* Labels read from RGBDS or no$gmb .sym files, which have one
+ * "bank:addr name" label per line and ';' comments */
+
+/* Load the labels from the given file, replacing any already loaded.
+ * returns 1 if successful, 0 otherwise */
+int load_symbols(char const *file_path);
+
+// Free all loaded labels
+void clear_symbols();
+
+/* Closest label at or before addr in the same bank and 16KB region,
+ * NULL if there's none. offset is set to how far past it addr is */
+char const *find_symbol(int bank, uint16_t addr, uint16_t *offset);
+
+#endif /* SYMBOLS_H */
@@ -0,0 +1,721 @@
+/* Benchmarks of the emulator core, with the results printed as JSON
+ * to compare between commits.
+ *
+ * Micro benchmarks run generated ROMs: instruction mixes, memory reads
+ * and writes by region and MBC, scanline rendering, the timers, the
+ * LCD and sound. Macro benchmarks run whole frames of the ROMs given.
+ *
+ * Built and run on the bundled test ROM by "scons bench" in build/Unix,
+ * which writes bench.json, or run directly with
+ *   plutoboy_bench [-reps=n] [-warmup=n] [-only=prefix] [rom ...]
+ *
+ * Every repetition starts from a freshly loaded ROM, so each one does
+ * exactly the same work. Benchmarks are run warmup times unmeasured
+ * then reps times, and the mean, median, standard deviation and range
+ * of the reps are reported. */
+
+#define _POSIX_C_SOURCE 200809L // clock_gettime, mkstemp
+
+#include "../emu.h"
+#include "../cpu.h"
+#include "../lcd.h"
+#include "../timers.h"
+#include "../graphics.h"
+#include "../sound.h"
+#include "../memory_layout.h"
+#include "../mmu/memory.h"
+#include "../mmu/mbc.h"
+#include "../mmu/rom_cache.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define DEFAULT_REPS 10
+#define DEFAULT_WARMUP 2
+#define MAX_REPS 1000
+#define MAX_BENCHMARKS 64
+#define MAX_NAME_LENGTH 64
+
+#define ROM_BANKS 8
+#define CODE_START 0x150
+#define SUBROUTINE 0x1000
+#define BLOCK_REPEATS 16
+#define ADDRESS_COUNT 4096
+#define CYCLES_PER_FRAME 70224
+#define SPRITE_LINES 16 // Lines covered by the sprites of the rendering benchmarks
+
+#define INSTRUCTIONS_PER_REP 2000000
+#define ACCESSES_PER_REP 8000000
+#define LINES_PER_REP 100000
+#define CALLS_PER_REP 4000000
+#define SOUND_FRAMES_PER_REP 300
+#define FRAMES_PER_REP 300
+
+#define IO(reg) (0xFF00 | (reg))
+
+typedef struct {
+    char name[MAX_NAME_LENGTH];
+    char const *unit;
+    int higher_is_better;
+    int (*setup)(void const *arg);  // Called untimed before each repetition
+    double (*run)(void const *arg); // Times a repetition, returning the result in unit
+    void const *arg;
+} Benchmark;
+
+typedef struct {
+    char const *name;
+    uint8_t const *code;
+    size_t length;
+} Instruction_Mix;
+
+typedef struct {
+    char const *name;
+    uint16_t start;
+    uint16_t length;
+    int write;
+} Memory_Region;
+
+typedef struct {
+    char const *name;
+    uint8_t type; // Cartridge type in the header
+    uint8_t ram_size;
+    unsigned cache_banks; // ROM banks paged in through the cache, 0 to read the whole ROM
+} Cartridge;
+
+typedef struct {
+    char const *name;
+    uint8_t lcdc;
+    int sprites;
+} Line_Kind;
+
+
+static Benchmark benchmarks[MAX_BENCHMARKS];
+static int benchmark_count = 0;
+
+static uint8_t rom[ROM_BANKS * ROM_BANK_SIZE];
+static uint8_t program[0x1000];
+static uint16_t addresses[ADDRESS_COUNT];
+static uint8_t values[ADDRESS_COUNT];
+static int emu_loaded = 0;
+static volatile unsigned sink;
+
+
+static uint8_t const alu_mix[] = {
+    0x3C,       // INC A
+    0x80,       // ADD A,B
+    0xA9,       // XOR C
+    0x05,       // DEC B
+    0x2F,       // CPL
+    0x87,       // ADD A,A
+    0x3E, 0x12, // LD A,$12
+    0xC6, 0x34, // ADD A,$34
+    0x1F,       // RRA
+    0xB8,       // CP B
+};
+
+static uint8_t const load_store_mix[] = {
+    0x22,             // LD (HL+),A
+    0x2B,             // DEC HL
+    0x7E,             // LD A,(HL)
+    0x46,             // LD B,(HL)
+    0x70,             // LD (HL),B
+    0xFA, 0x00, 0xC1, // LD A,($C100)
+    0xEA, 0x01, 0xC1, // LD ($C101),A
+    0xE0, 0x80,       // LDH ($FF80),A
+    0xF0, 0x80,       // LDH A,($FF80)
+};
+
+static uint8_t const branch_mix[] = {
+    0xCD, SUBROUTINE & 0xFF, SUBROUTINE >> 8, // CALL SUBROUTINE
+    0x18, 0x00, // JR +0
+    0xC5,       // PUSH BC
+    0xC1,       // POP BC
+    0xAF,       // XOR A
+    0x28, 0x00, // JR Z,+0 (taken)
+    0x20, 0x00, // JR NZ,+0 (not taken)
+};
+
+static uint8_t const cb_mix[] = {
+    0xCB, 0x37, // SWAP A
+    0xCB, 0x47, // BIT 0,A
+    0xCB, 0x87, // RES 0,A
+    0xCB, 0xC0, // SET 0,B
+    0xCB, 0x1F, // RR A
+    0xCB, 0x26, // SLA (HL)
+};
+
+static Instruction_Mix const mixes[] = {
+    {"alu", alu_mix, sizeof(alu_mix)},
+    {"load_store", load_store_mix, sizeof(load_store_mix)},
+    {"branch", branch_mix, sizeof(branch_mix)},
+    {"cb", cb_mix, sizeof(cb_mix)},
+    {"mixed", NULL, 0}, // All of the above
+};
+
+static Memory_Region const regions[] = {
+    {"rom0", 0x0000, 0x4000, 0},
+    {"romx", 0x4000, 0x4000, 0},
+    {"vram", 0x8000, 0x2000, 0},
+    {"sram", 0xA000, 0x2000, 0},
+    {"wram", 0xC000, 0x2000, 0},
+    {"oam", 0xFE00, 0x00A0, 0},
+    {"io", 0xFF00, 0x0080, 0},
+    {"hram", 0xFF80, 0x007F, 0},
+    {"rom_bank_switch", 0x2000, 0x2000, 1},
+    {"vram", 0x8000, 0x2000, 1},
+    {"sram", 0xA000, 0x2000, 1},
+    {"wram", 0xC000, 0x2000, 1},
+    {"oam", 0xFE00, 0x00A0, 1},
+    {"hram", 0xFF80, 0x007F, 1},
+};
+
+static Cartridge const cartridges[] = {
+    {"rom_only", 0x00, 0x00, 0},
+    {"mbc1", 0x03, 0x03, 0},
+    {"mbc2", 0x06, 0x00, 0},
+    {"mbc3", 0x13, 0x03, 0},
+    {"mbc5", 0x1B, 0x03, 0},
+    {"mbc5_paged", 0x1B, 0x03, MIN_ROM_CACHE_BANKS},
+};
+
+static Line_Kind const line_kinds[] = {
+    {"bg", 0x91, 0},      // LCD and BG on
+    {"window", 0xF1, 0},  // Window over the whole line
+    {"sprites", 0x97, 1}, // 10 8x16 sprites on every line
+};
+
+static Cartridge const default_cartridge = {"rom_only", 0x00, 0x00, 0};
+
+
+static double now_seconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+static uint32_t next_random(uint32_t *seed) {
+    *seed = *seed * 1103515245 + 12345;
+    return *seed >> 8;
+}
+
+
+/* Build a ROM with the given cartridge type and code at CODE_START,
+ * then load it in place of the last one, skipping the boot ROM.
+ * returns 1 if successful, 0 otherwise */
+static int load_generated_rom(Cartridge const *cartridge, uint8_t const *code, size_t length) {
+
+    unsigned banks = cartridge->type == 0x00 ? 2 : ROM_BANKS;
+    size_t size = banks * ROM_BANK_SIZE;
+
+    // Bytes differ between banks, so reads after switching banks differ
+    for (size_t i = 0; i < size; i++) {
+        rom[i] = i * 7 + (i >> 14);
+    }
+    memset(rom + 0x100, 0, 0x50);
+    rom[0x101] = 0xC3; // JP CODE_START
+    rom[0x102] = CODE_START & 0xFF;
+    rom[0x103] = CODE_START >> 8;
+    memcpy(rom + 0x134, "BENCH", 5);
+    rom[0x147] = cartridge->type;
+    rom[0x148] = banks == 2 ? 0 : 2;
+    rom[0x149] = cartridge->ram_size;
+    uint8_t checksum = 0;
+    for (int i = 0x134; i < 0x14D; i++) {
+        checksum = checksum - rom[i] - 1;
+    }
+    rom[0x14D] = checksum;
+    memcpy(rom + CODE_START, code, length);
+    rom[SUBROUTINE] = 0xC9; // RET
+
+    char path[] = "/tmp/plutoboy_benchXXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        fprintf(stderr, "Unable to create a ROM to benchmark\n");
+        return 0;
+    }
+    int written = write(fd, rom, size) == (ssize_t)size;
+    close(fd);
+
+    if (emu_loaded) {
+        finalize_emu();
+    }
+    // The cache keeps the file open, so it can still be removed
+    set_rom_paging(cartridge->cache_banks);
+    emu_loaded = written && init_emu(path, 0, 0, NO_CONNECT);
+    set_rom_paging(0);
+    remove(path);
+    if (!emu_loaded) {
+        fprintf(stderr, "Unable to load a generated ROM\n");
+        return 0;
+    }
+
+    set_mem(IO(BOOT_ROM_DISABLE), 1);
+    set_register(REG_PC, CODE_START);
+    set_register(REG_SP, 0xFFFE);
+    return 1;
+}
+
+
+/* Loops forever over BLOCK_REPEATS copies of the mix,
+ * with interrupts disabled and HL pointing to WRAM */
+static size_t make_program(Instruction_Mix const *mix) {
+
+    static uint8_t const start[] = {
+        0xF3,             // DI
+        0x31, 0xFE, 0xDF, // LD SP,$DFFE
+        0x21, 0x00, 0xC0, // LD HL,$C000
+    };
+    size_t length = 0;
+    memcpy(program, start, sizeof(start));
+    length += sizeof(start);
+    uint16_t loop = CODE_START + length;
+
+    for (int i = 0; i < BLOCK_REPEATS; i++) {
+        if (mix->code) {
+            memcpy(program + length, mix->code, mix->length);
+            length += mix->length;
+        } else {
+            // The mixed block is all the others in turn
+            for (size_t m = 0; mixes[m].code; m++) {
+                memcpy(program + length, mixes[m].code, mixes[m].length);
+                length += mixes[m].length;
+            }
+        }
+    }
+    program[length++] = 0xC3; // JP loop
+    program[length++] = loop & 0xFF;
+    program[length++] = loop >> 8;
+    return length;
+}
+
+
+static int setup_dispatch(void const *arg) {
+    size_t length = make_program(arg);
+    if (!load_generated_rom(&default_cartridge, program, length)) {
+        return 0;
+    }
+    set_mem(IO(LCDC_REG), 0); // Only time the instructions, timers and sound
+    return 1;
+}
+
+
+static double run_dispatch(void const *arg) {
+    (void)arg;
+    long cycles = 0;
+    double start = now_seconds();
+    for (long i = 0; i < INSTRUCTIONS_PER_REP; i++) {
+        cycles += exec_opcode(0);
+    }
+    return cycles / (now_seconds() - start) / 1e6;
+}
+
+
+static int setup_memory(Cartridge const *cartridge) {
+    static uint8_t const halt[] = {0x76};
+    if (!load_generated_rom(cartridge, halt, sizeof(halt))) {
+        return 0;
+    }
+    set_mem(IO(LCDC_REG), 0); // VRAM and OAM are always accessible
+    set_mem(0x0000, 0x0A);    // Enable RAM
+    set_mem(0x2100, 3);       // Switch ROM bank, bit 8 set for MBC2
+    return 1;
+}
+
+
+static int setup_region(void const *arg) {
+
+    Memory_Region const *region = arg;
+    Cartridge const mbc5 = {"mbc5", 0x1B, 0x03, 0};
+    if (!setup_memory(&mbc5)) {
+        return 0;
+    }
+
+    uint32_t seed = 1;
+    for (int i = 0; i < ADDRESS_COUNT; i++) {
+        uint32_t r = next_random(&seed);
+        addresses[i] = region->start + r % region->length;
+        // Only switch between the ROM banks there are
+        values[i] = region->start == 0x2000 ? 1 + (r >> 16) % (ROM_BANKS - 1) : r >> 16;
+    }
+    return 1;
+}
+
+
+static double run_region(void const *arg) {
+
+    Memory_Region const *region = arg;
+    double start = now_seconds();
+    if (region->write) {
+        for (long n = 0; n < ACCESSES_PER_REP; n += ADDRESS_COUNT) {
+            for (int i = 0; i < ADDRESS_COUNT; i++) {
+                set_mem(addresses[i], values[i]);
+            }
+        }
+    } else {
+        unsigned sum = 0;
+        for (long n = 0; n < ACCESSES_PER_REP; n += ADDRESS_COUNT) {
+            for (int i = 0; i < ADDRESS_COUNT; i++) {
+                sum += get_mem(addresses[i]);
+            }
+        }
+        sink = sum;
+    }
+    return (now_seconds() - start) * 1e9 / ACCESSES_PER_REP;
+}
+
+
+/* Mix of bank 0, switchable bank and RAM reads, like a running game,
+ * with a ROM bank switch for every 64 accesses */
+static int setup_cartridge(void const *arg) {
+
+    if (!setup_memory(arg)) {
+        return 0;
+    }
+    uint32_t seed = 1;
+    for (int i = 0; i < ADDRESS_COUNT; i++) {
+        uint32_t r = next_random(&seed);
+        switch (r % 4) {
+            case 0:
+            case 1: addresses[i] = r % 0x4000; break;
+            case 2: addresses[i] = 0x4000 + (r % 0x4000); break;
+            case 3: addresses[i] = 0xA000 + (r % 0x2000); break;
+        }
+        values[i] = 0;
+        if (i % 64 == 63) {
+            addresses[i] = 0x2100;
+            values[i] = 1 + (r >> 16) % (ROM_BANKS - 1);
+        }
+    }
+    return 1;
+}
+
+
+static double run_cartridge(void const *arg) {
+    (void)arg;
+    unsigned sum = 0;
+    double start = now_seconds();
+    for (long n = 0; n < ACCESSES_PER_REP; n += ADDRESS_COUNT) {
+        for (int i = 0; i < ADDRESS_COUNT; i++) {
+            if (values[i]) {
+                set_mem(addresses[i], values[i]);
+            } else {
+                sum += get_mem(addresses[i]);
+            }
+        }
+    }
+    sink = sum;
+    return (now_seconds() - start) * 1e9 / ACCESSES_PER_REP;
+}
+
+
+// Fill VRAM, the palettes and OAM, then turn the LCD on with lcdc
+static int setup_screen(uint8_t lcdc, int sprites) {
+
+    static uint8_t const halt[] = {0x76};
+    if (!load_generated_rom(&default_cartridge, halt, sizeof(halt))) {
+        return 0;
+    }
+    set_mem(IO(LCDC_REG), 0);
+
+    uint32_t seed = 1;
+    for (unsigned addr = 0x8000; addr < 0x9800; addr++) {
+        set_mem(addr, next_random(&seed));
+    }
+    for (unsigned addr = 0x9800; addr < 0xA000; addr++) {
+        set_mem(addr, addr * 5);
+    }
+    for (unsigned i = 0; i < 40; i++) {
+        // Sprites past the first 10 are below the lines drawn
+        int shown = sprites && i < 10;
+        set_mem(0xFE00 + i * 4, shown ? 16 : 160); // Y
+        set_mem(0xFE01 + i * 4, 8 + i * 15);       // X
+        set_mem(0xFE02 + i * 4, i * 2);            // Tile
+        set_mem(0xFE03 + i * 4, (i & 1) << 5);     // Flip every other one
+    }
+    set_mem(IO(BGP_REF), 0xE4);
+    set_mem(IO(OBP0_REG), 0xE4);
+    set_mem(IO(SCROLL_X_REG), 3);
+    set_mem(IO(WY_REG), 0);
+    set_mem(IO(WX_REG), 7);
+    set_mem(IO(LCDC_REG), lcdc);
+    return 1;
+}
+
+
+static int setup_line(void const *arg) {
+    Line_Kind const *kind = arg;
+    return setup_screen(kind->lcdc, kind->sprites);
+}
+
+
+static double run_line(void const *arg) {
+    (void)arg;
+    double start = now_seconds();
+    for (long n = 0; n < LINES_PER_REP; n++) {
+        io_mem[LY_REG] = n % SPRITE_LINES;
+        draw_row();
+    }
+    return (now_seconds() - start) * 1e9 / LINES_PER_REP;
+}
+
+
+// Cycles passed to each call, as if after a mix of instructions
+static long const call_cycles[8] = {4, 8, 12, 16, 4, 8, 20, 24};
+
+
+static int setup_timer(void const *arg) {
+    (void)arg;
+    static uint8_t const halt[] = {0x76};
+    if (!load_generated_rom(&default_cartridge, halt, sizeof(halt))) {
+        return 0;
+    }
+    set_mem(IO(TAC_REG), 0x05); // Timer on at 262144Hz
+    return 1;
+}
+
+
+static double run_timer(void const *arg) {
+    (void)arg;
+    double start = now_seconds();
+    for (long n = 0; n < CALLS_PER_REP; n++) {
+        update_timers(call_cycles[n & 7]);
+    }
+    return (now_seconds() - start) * 1e9 / CALLS_PER_REP;
+}
+
+
+static int setup_lcd(void const *arg) {
+    (void)arg;
+    return setup_screen(0x91, 0);
+}
+
+
+static double run_lcd(void const *arg) {
+    (void)arg;
+    double start = now_seconds();
+    for (long n = 0; n < CALLS_PER_REP; n++) {
+        update_graphics(call_cycles[n & 7]);
+    }
+    return (now_seconds() - start) * 1e9 / CALLS_PER_REP;
+}
+
+
+// All four channels playing
+static int setup_sound(void const *arg) {
+    (void)arg;
+    static uint8_t const halt[] = {0x76};
+    if (!load_generated_rom(&default_cartridge, halt, sizeof(halt))) {
+        return 0;
+    }
+    static uint16_t const regs[][2] = {
+        {0xFF26, 0x80}, {0xFF24, 0x77}, {0xFF25, 0xFF},
+        {0xFF11, 0x80}, {0xFF12, 0xF0}, {0xFF13, 0x00}, {0xFF14, 0x87},
+        {0xFF16, 0x40}, {0xFF17, 0xF0}, {0xFF18, 0x80}, {0xFF19, 0x86},
+        {0xFF1A, 0x80}, {0xFF1C, 0x20}, {0xFF1D, 0x40}, {0xFF1E, 0x87},
+        {0xFF21, 0xF0}, {0xFF22, 0x55}, {0xFF23, 0x80},
+    };
+    for (unsigned i = 0xFF30; i < 0xFF40; i++) {
+        write_apu(i, i * 0x37);
+    }
+    for (size_t i = 0; i < sizeof(regs) / sizeof(regs[0]); i++) {
+        write_apu(regs[i][0], regs[i][1]);
+    }
+    return 1;
+}
+
+
+// A frame's worth of cycles with a frequency change every 16th of it
+static double run_sound(void const *arg) {
+    (void)arg;
+    double start = now_seconds();
+    for (int frame = 0; frame < SOUND_FRAMES_PER_REP; frame++) {
+        for (int i = 0; i < 16; i++) {
+            sound_add_cycles(CYCLES_PER_FRAME / 16);
+            write_apu(0xFF13, frame + i * 8);
+        }
+    }
+    return (now_seconds() - start) * 1e6 / SOUND_FRAMES_PER_REP;
+}
+
+
+static int setup_frames(void const *arg) {
+    if (emu_loaded) {
+        finalize_emu();
+    }
+    emu_loaded = init_emu(arg, 0, 0, NO_CONNECT);
+    return emu_loaded;
+}
+
+
+static double run_frames(void const *arg) {
+    (void)arg;
+    double start = now_seconds();
+    for (int n = 0; n < FRAMES_PER_REP; n++) {
+        run_one_frame();
+    }
+    return FRAMES_PER_REP / (now_seconds() - start);
+}
+
+
+static void add_benchmark(char const *prefix, char const *name, char const *unit, int higher_is_better,
+        int (*setup)(void const *), double (*run)(void const *), void const *arg) {
+
+    if (benchmark_count == MAX_BENCHMARKS) {
+        return;
+    }
+    Benchmark *benchmark = &benchmarks[benchmark_count++];
+    snprintf(benchmark->name, MAX_NAME_LENGTH, "%s%s", prefix, name);
+    benchmark->unit = unit;
+    benchmark->higher_is_better = higher_is_better;
+    benchmark->setup = setup;
+    benchmark->run = run;
+    benchmark->arg = arg;
+}
+
+
+static void add_benchmarks(int rom_count, char **roms) {
+
+    for (size_t i = 0; i < sizeof(mixes) / sizeof(mixes[0]); i++) {
+        add_benchmark("dispatch_", mixes[i].name, "emulated_mhz", 1, setup_dispatch, run_dispatch, &mixes[i]);
+    }
+    for (size_t i = 0; i < sizeof(regions) / sizeof(regions[0]); i++) {
+        add_benchmark(regions[i].write ? "set_mem_" : "get_mem_", regions[i].name,
+            "ns_per_access", 0, setup_region, run_region, &regions[i]);
+    }
+    for (size_t i = 0; i < sizeof(cartridges) / sizeof(cartridges[0]); i++) {
+        add_benchmark("mem_mixed_", cartridges[i].name, "ns_per_access", 0, setup_cartridge, run_cartridge, &cartridges[i]);
+    }
+    for (size_t i = 0; i < sizeof(line_kinds) / sizeof(line_kinds[0]); i++) {
+        add_benchmark("draw_row_", line_kinds[i].name, "ns_per_line", 0, setup_line, run_line, &line_kinds[i]);
+    }
+    add_benchmark("", "update_timers", "ns_per_call", 0, setup_timer, run_timer, NULL);
+    add_benchmark("", "update_lcd", "ns_per_call", 0, setup_lcd, run_lcd, NULL);
+    add_benchmark("", "apu_frame", "us_per_frame", 0, setup_sound, run_sound, NULL);
+
+    for (int i = 0; i < rom_count; i++) {
+        char const *name = strrchr(roms[i], '/');
+        add_benchmark("frames_", name ? name + 1 : roms[i], "fps", 1, setup_frames, run_frames, roms[i]);
+    }
+}
+
+
+static int compare_doubles(void const *a, void const *b) {
+    double da = *(double const *)a;
+    double db = *(double const *)b;
+    return (da > db) - (da < db);
+}
+
+
+typedef struct {
+    double mean;
+    double median;
+    double stddev;
+    double min;
+    double max;
+} Result;
+
+
+/* Run a benchmark reps times after warming up.
+ * returns 1 if successful, 0 otherwise */
+static int run_benchmark(Benchmark const *benchmark, int reps, int warmup, Result *result) {
+
+    double results[MAX_REPS];
+    for (int i = 0; i < warmup + reps; i++) {
+        if (!benchmark->setup(benchmark->arg)) {
+            return 0;
+        }
+        double value = benchmark->run(benchmark->arg);
+        if (i >= warmup) {
+            results[i - warmup] = value;
+        }
+    }
+
+    double mean = 0;
+    for (int i = 0; i < reps; i++) {
+        mean += results[i];
+    }
+    mean /= reps;
+    double variance = 0;
+    for (int i = 0; i < reps; i++) {
+        variance += (results[i] - mean) * (results[i] - mean);
+    }
+    variance = reps > 1 ? variance / (reps - 1) : 0;
+
+    qsort(results, reps, sizeof(double), compare_doubles);
+    result->mean = mean;
+    result->median = reps % 2 ? results[reps / 2] : (results[reps / 2 - 1] + results[reps / 2]) / 2;
+    result->stddev = sqrt(variance);
+    result->min = results[0];
+    result->max = results[reps - 1];
+    return 1;
+}
+
+
+static void print_usage(char const *program_name) {
+    fprintf(stderr, "Usage: %s [-reps=n] [-warmup=n] [-only=prefix] [rom ...]\n", program_name);
+    exit(1);
+}
+
+
+int main(int argc, char **argv) {
+
+    int reps = DEFAULT_REPS;
+    int warmup = DEFAULT_WARMUP;
+    char const *only = "";
+    int first_rom = argc;
+
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "-reps=", strlen("-reps=")) == 0) {
+            if (sscanf(argv[i] + strlen("-reps="), "%d", &reps) != 1 || reps < 1 || reps > MAX_REPS) {
+                print_usage(argv[0]);
+            }
+        } else if (strncmp(argv[i], "-warmup=", strlen("-warmup=")) == 0) {
+            if (sscanf(argv[i] + strlen("-warmup="), "%d", &warmup) != 1 || warmup < 0) {
+                print_usage(argv[0]);
+            }
+        } else if (strncmp(argv[i], "-only=", strlen("-only=")) == 0) {
+            only = argv[i] + strlen("-only=");
+        } else if (argv[i][0] == '-') {
+            print_usage(argv[0]);
+        } else {
+            first_rom = i;
+            break;
+        }
+    }
+    add_benchmarks(argc - first_rom, argv + first_rom);
+
+    printf("{\n  \"version\": 1,\n  \"repetitions\": %d,\n  \"warmup\": %d,\n  \"benchmarks\": [\n", reps, warmup);
+    int printed = 0;
+    int failed = 0;
+    for (int i = 0; i < benchmark_count; i++) {
+        Benchmark const *benchmark = &benchmarks[i];
+        Result result;
+        if (strncmp(benchmark->name, only, strlen(only)) != 0) {
+            continue;
+        }
+        if (!run_benchmark(benchmark, reps, warmup, &result)) {
+            fprintf(stderr, "%s failed\n", benchmark->name);
+            failed = 1;
+            continue;
+        }
+        printf("%s    {\"name\": \"%s\", \"unit\": \"%s\", \"higher_is_better\": %s, "
+               "\"mean\": %.4f, \"median\": %.4f, \"stddev\": %.4f, \"min\": %.4f, \"max\": %.4f}",
+            printed ? ",\n" : "", benchmark->name, benchmark->unit,
+            benchmark->higher_is_better ? "true" : "false",
+            result.mean, result.median, result.stddev, result.min, result.max);
+        fflush(stdout);
+        fprintf(stderr, "%-28s %12.4f %s\n", benchmark->name, result.median, benchmark->unit);
+        printed = 1;
+    }
+    printf("\n  ]\n}\n");
+
+    if (emu_loaded) {
+        finalize_emu();
+    }
+    return failed;
+}
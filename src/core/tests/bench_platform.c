@@ -0,0 +1,108 @@
+/* Headless stand-ins for the frontend functions the core calls, so the
+ * benchmarks run the emulator without a window, input or output */
+
+#define _POSIX_C_SOURCE 200809L // clock_gettime
+
+#include "../../non_core/graphics_out.h"
+#include "../../non_core/framerate.h"
+#include "../../non_core/joypad.h"
+#include "../../non_core/logger.h"
+#include "../../non_core/get_time.h"
+#include "../../non_core/files.h"
+#include "../../non_core/recorder.h"
+#include "../../non_core/shm_output.h"
+#include "../../non_core/serial_io_transfer.h"
+#include "../../non_core/debugger.h"
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <time.h>
+
+int limiter = 0;
+int vsync = 0;
+int recording_av = 0;
+int shm_output_enabled = 0;
+
+static LogLevel log_level = LOG_ERROR;
+
+
+// Only errors are shown, on stderr, to keep the results clean
+void set_log_level(LogLevel ll) {
+    (void)ll;
+}
+
+void log_message(LogLevel ll, const char *fmt, ...) {
+    if (ll >= log_level) {
+        va_list args;
+        va_start(args, fmt);
+        vfprintf(stderr, fmt, args);
+        va_end(args);
+    }
+}
+
+
+uint64_t get_time() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+
+int init_screen(int win_x, int win_y, uint32_t *pixels) { (void)win_x; (void)win_y; (void)pixels; return 1; }
+void draw_screen() {}
+
+void start_framerate(int fps) { (void)fps; }
+void adjust_to_framerate() {}
+
+void init_joypad() {}
+int update_keys() { return 0; }
+uint8_t joypad_keys() { return 0; }
+
+
+unsigned long load_rom_from_file(const char *file_path, unsigned char *data, size_t data_size) {
+
+    FILE *file;
+    if (!(file = fopen(file_path, "rb"))) {
+        log_message(LOG_ERROR, "Error opening file %s\n", file_path);
+        return 0;
+    }
+    size_t count = fread(data, 1, data_size, file);
+    fclose(file);
+    return count;
+}
+
+// Saves are never read or written
+unsigned long load_SRAM(const char *file_path, unsigned char *data, unsigned long size) {
+    (void)file_path; (void)data; (void)size;
+    return 0;
+}
+
+int save_SRAM(const char *file_path, const unsigned char *data, unsigned long size) {
+    (void)file_path; (void)data; (void)size;
+    return 1;
+}
+
+
+void record_frame(uint32_t const *pixels) { (void)pixels; }
+void record_audio(int16_t const *samples, size_t count, unsigned sample_rate) {
+    (void)samples; (void)count; (void)sample_rate;
+}
+void shm_publish_frame(uint32_t const *pixels) { (void)pixels; }
+void shm_publish_audio(int16_t const *samples, size_t count, unsigned sample_rate) {
+    (void)samples; (void)count; (void)sample_rate;
+}
+
+int setup_client(unsigned port) { (void)port; return 0; }
+int setup_server(unsigned port) { (void)port; return 0; }
+uint8_t transfer_int(uint8_t data) { (void)data; return 0xFF; }
+int transfer_ext(uint8_t data, uint8_t *recv) { (void)data; (void)recv; return 0; }
+
+// Nothing is linked up to the serial port
+void MobileLoop(unsigned cycles) { (void)cycles; }
+
+int get_command() { return NONE; }
+long get_steps() { return 0; }
+void turn_steps_off() {}
+long get_breakpoint() { return -1; }
+void turn_breakpoint_off() {}
+int check_debug_break() { return 0; }
@@ -0,0 +1,167 @@
+/* Compares reading cartridge memory through each MBC's read function
+ * against the bank pointers it publishes in MBC_read_map.
+ *
+ * Built against the rest of the core with 'scons mbc_bench', exits
+ * with 1 if the two paths disagree on any address for any MBC.
+ */
+
+#include "../mmu/mbc.h"
+#include "../mmu/mbc0.h"
+#include "../mmu/mbc1.h"
+#include "../mmu/mbc2.h"
+#include "../mmu/mbc3.h"
+#include "../mmu/mbc5.h"
+#include "../mmu/mbc6.h"
+#include "../mmu/mmm01.h"
+#include "../mmu/huc1.h"
+#include "../mmu/huc3.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define ADDRESS_COUNT 4096
+#define REPEATS 20000
+
+static void setup_MBC0(int flags) {
+    (void)flags;
+    map_MBC_read(0x0000, 0x8000, ROM_banks);
+}
+
+
+typedef struct {
+    char const *name;
+    void (*setup)(int flags);
+    read_MBC_ptr read;
+    write_MBC_ptr write;
+    unsigned rom_banks;
+    unsigned ram_banks;
+    uint16_t bank_select; // Register to switch ROM bank
+} Bench_MBC;
+
+static Bench_MBC const mbcs[] = {
+    {"MBC0", setup_MBC0, read_MBC0, write_MBC0, 2, 0, 0x2000},
+    {"MBC1", setup_MBC1, read_MBC1, write_MBC1, 64, 4, 0x2000},
+    {"MBC2", setup_MBC2, read_MBC2, write_MBC2, 16, 1, 0x2100},
+    {"MBC3", setup_MBC3, read_MBC3, write_MBC3, 128, 4, 0x2000},
+    {"MBC5", setup_MBC5, read_MBC5, write_MBC5, 512, 16, 0x2000},
+    {"MBC6", setup_MBC6, read_MBC6, write_MBC6, 64, 0x80 + 4, 0x2000},
+    {"HuC1", setup_HUC1, read_HUC1, write_HUC1, 64, 4, 0x2000},
+    {"HuC3", setup_HUC3, read_HUC3, write_HUC3, 128, 4, 0x2000},
+    {"MMM01", setup_MMM01, read_MMM01, write_MMM01, 64, 4, 0x2000},
+};
+
+static uint16_t addresses[ADDRESS_COUNT];
+static volatile unsigned sink;
+
+
+// Mix of bank 0, switchable bank and RAM reads, like a running game
+static void make_addresses() {
+    uint32_t seed = 1;
+    for (int i = 0; i < ADDRESS_COUNT; i++) {
+        seed = seed * 1103515245 + 12345;
+        unsigned r = seed >> 8;
+        switch (r % 4) {
+            case 0:
+            case 1: addresses[i] = r % 0x4000; break;
+            case 2: addresses[i] = 0x4000 + (r % 0x4000); break;
+            case 3: addresses[i] = 0xA000 + (r % 0x2000); break;
+        }
+    }
+}
+
+
+static double time_callback() {
+    clock_t start = clock();
+    unsigned sum = 0;
+    for (int rep = 0; rep < REPEATS; rep++) {
+        for (int i = 0; i < ADDRESS_COUNT; i++) {
+            sum += read_MBC(addresses[i]);
+        }
+    }
+    sink = sum;
+    return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+
+static double time_mapped() {
+    clock_t start = clock();
+    unsigned sum = 0;
+    for (int rep = 0; rep < REPEATS; rep++) {
+        for (int i = 0; i < ADDRESS_COUNT; i++) {
+            sum += read_MBC_mapped(addresses[i]);
+        }
+    }
+    sink = sum;
+    return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+
+// returns the number of addresses the two paths disagree on
+static int check_paths() {
+    int mismatches = 0;
+    for (unsigned addr = 0; addr < 0xC000; addr++) {
+        if (addr >= 0x8000 && addr < 0xA000) {
+            continue;
+        }
+        if (read_MBC(addr) != read_MBC_mapped(addr)) {
+            mismatches++;
+        }
+    }
+    return mismatches;
+}
+
+
+int main() {
+
+    int failed = 0;
+    make_addresses();
+    printf("%-6s %12s %12s %8s %s\n", "MBC", "callback ns", "mapped ns", "speedup", "mismatches");
+
+    for (unsigned m = 0; m < sizeof(mbcs) / sizeof(mbcs[0]); m++) {
+        Bench_MBC const *mbc = &mbcs[m];
+
+        ROM_bank_count = mbc->rom_banks;
+        RAM_bank_count = mbc->ram_banks;
+        ROM_banks = malloc(ROM_bank_count * ROM_BANK_SIZE);
+        RAM_banks = malloc(RAM_bank_count * RAM_BANK_SIZE);
+        if (ROM_banks == NULL || (RAM_banks == NULL && RAM_bank_count > 0)) {
+            fprintf(stderr, "Unable to allocate banks for %s\n", mbc->name);
+            return 1;
+        }
+        for (unsigned long i = 0; i < ROM_bank_count * ROM_BANK_SIZE; i++) {
+            ROM_banks[i] = i * 7 + (i >> 14);
+        }
+        for (unsigned long i = 0; i < RAM_bank_count * RAM_BANK_SIZE; i++) {
+            RAM_banks[i] = i * 13 + (i >> 13);
+        }
+
+        memset(MBC_read_map, 0, sizeof(MBC_read_map));
+        read_MBC = mbc->read;
+        write_MBC = mbc->write;
+        mbc->setup(SRAM);
+
+        // Enable RAM (MMM01 needs a write to leave its menu mode first)
+        // and switch away from the first ROM bank
+        write_MBC(0x0000, 0x0A);
+        write_MBC(0x0000, 0x0A);
+        write_MBC(mbc->bank_select, 3);
+
+        int mismatches = check_paths();
+        double callback = time_callback();
+        double mapped = time_mapped();
+        double reads = (double)REPEATS * ADDRESS_COUNT;
+
+        printf("%-6s %12.2f %12.2f %7.2fx %d\n", mbc->name,
+            callback * 1e9 / reads, mapped * 1e9 / reads,
+            mapped > 0 ? callback / mapped : 0.0, mismatches);
+        if (mismatches > 0) {
+            failed = 1;
+        }
+
+        free(ROM_banks);
+        free(RAM_banks);
+    }
+    return failed;
+}
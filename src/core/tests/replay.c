@@ -0,0 +1,43 @@
+/* Plays input movies back headless and as fast as possible, checking
+ * every frame matches what was recorded, to run recorded sessions as
+ * regression tests. See core/movie.h.
+ *
+ *   plutoboy_replay movie rom
+ * exits 0 if the whole movie played back the same, 1 if it differed
+ * and 2 on errors. Uses the headless frontend of the benchmarks. */
+
+#include "../emu.h"
+#include "../movie.h"
+#include "../../non_core/get_time.h"
+
+#include <stdio.h>
+
+
+int main(int argc, char *argv[]) {
+
+    if (argc != 3) {
+        fprintf(stderr, "usage %s movie rom\n", argv[0]);
+        return 2;
+    }
+
+    int dmg_mode = 0;
+    if (!open_movie(argv[1], MOVIE_PLAYING, &dmg_mode)) {
+        return 2;
+    }
+    if (!init_emu(argv[2], 0, dmg_mode, NO_CONNECT) || !start_movie()) {
+        stop_movie();
+        return 2;
+    }
+
+    uint64_t start = get_time();
+    run();
+    uint64_t ms = get_time() - start;
+    unsigned long long frames = movie_frame();
+
+    int ok = stop_movie();
+    finalize_emu();
+
+    printf("%s %llu frames in %.2fs, %.0f fps\n", ok ? "Matched" : "Differed after",
+        frames, ms / 1000.0, ms ? frames * 1000.0 / ms : 0.0);
+    return ok ? 0 : 1;
+}
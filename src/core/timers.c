@@ -1,7 +1,7 @@
 #include "timers.h"
 #include "interrupts.h"
 #include "bits.h"
-#include "mmu/mbc.h"
+#include "instrument.h"
 
 //Possible timer increment timer_frequencies in hz
 #define TIMER_FREQUENCIES_LEN sizeof (timer_frequencies) / sizeof (long)
@@ -9,7 +9,7 @@ static const long timer_frequencies[] = {1024, 16, 64, 256};
 static const long timer_frequencies_bits[] = {10, 4, 6, 8};
 static long timer_frequency = -1;
 static long timer_frequency_bits = -1;
-static uint64_t clocks = 0;
+static uint64_t clocks = 0; // Single speed cycles since startup, for emulated time
 
 uint16_t timer_counter = 0;
 uint8_t previous_timer_counter = 0;
@@ -66,16 +66,18 @@ void update_divider_reg(long cycles) {
 }*/
 
 
+uint64_t get_emulated_time() {
+    return (clocks / GB_CLOCK_SPEED_HZ) * 1000 +
+           (clocks % GB_CLOCK_SPEED_HZ) * 1000 / GB_CLOCK_SPEED_HZ;
+}
+
+
 /* Update internal timers given the cycles executed since
 * the last time this function was called. */
 void update_timers(long cycles) {
 
-    clocks += cycles;
-    // Inc MBC3 RTC seconds
-    if (clocks >= 4 * 1024 * 1024) {
-        inc_sec_mbc3();         
-        clocks -= 4 * 1024 * 1024;
-    }
+    ZONE_BEGIN(ZONE_TIMERS);
+    clocks += cgb_speed ? cycles / 2 : cycles;
 
 	uint8_t timer_control = io_mem[TAC_REG];
 
@@ -104,4 +106,5 @@ void update_timers(long cycles) {
             increment_tima();
         }
 	}
+    ZONE_END(ZONE_TIMERS);
 }
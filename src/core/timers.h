@@ -33,6 +33,10 @@ void set_timer_frequency(unsigned int n);
 
 long get_timer_frequency();
 
+/* Time in ms the emulator has run for, going by
+ * the cycles executed rather than the wall clock */
+uint64_t get_emulated_time();
+
 /* Update internal timers given the cycles executed since
 * the last time this function was called. */
 void update_timers(long cycles);
@@ -0,0 +1,395 @@
+#if defined(TRACE_MMAP) || defined(TRACE_THREAD)
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "trace.h"
+#include "cpu.h"
+#include "mmu/memory.h"
+#include "mmu/mbc.h"
+
+#include "../non_core/logger.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CHUNK_RECORDS 0x4000 // Records written at a time when streaming, 384KB
+#define MAX_RING_RECORDS 0x8000000 // 3GB
+
+int tracing = 0;
+
+static char const *trace_path = NULL;
+static uint64_t cycle_count;
+
+// The last instructions, laid out in memory as they are in the file
+static Trace_Header *ring = NULL;
+static Trace_Record *ring_records;
+static uint64_t ring_size;
+static uint64_t ring_next;
+
+static FILE *stream = NULL;
+static Trace_Record *chunk = NULL; // Filled while streaming
+static unsigned chunk_count;
+static uint64_t streamed;
+
+
+static void fill_header(Trace_Header *header, uint64_t count, uint64_t start) {
+    memset(header, 0, sizeof(Trace_Header));
+    memcpy(header->magic, TRACE_MAGIC, sizeof(TRACE_MAGIC));
+    header->version = TRACE_VERSION;
+    header->record_size = sizeof(Trace_Record);
+    header->count = count;
+    header->start = start;
+}
+
+
+#ifdef TRACE_MMAP
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+static size_t ring_bytes;
+
+static Trace_Header *alloc_ring(char const *file_path, size_t size) {
+
+    int fd = open(file_path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        log_message(LOG_ERROR, "Error opening trace file %s\n", file_path);
+        return NULL;
+    }
+    if (ftruncate(fd, size) != 0) {
+        log_message(LOG_ERROR, "Unable to resize trace file %s\n", file_path);
+        close(fd);
+        return NULL;
+    }
+
+    void *mem = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mem == MAP_FAILED) {
+        log_message(LOG_ERROR, "Unable to map trace file %s\n", file_path);
+        return NULL;
+    }
+    ring_bytes = size;
+    return mem;
+}
+
+// The file already holds the ring, it only needs cutting to the records used
+static int write_ring(size_t size) {
+
+    int ok = msync(ring, ring_bytes, MS_SYNC) == 0;
+    munmap(ring, ring_bytes);
+    int fd = open(trace_path, O_WRONLY);
+    ok &= fd >= 0 && ftruncate(fd, size) == 0;
+    if (fd >= 0) {
+        close(fd);
+    }
+    return ok;
+}
+
+#else
+
+static Trace_Header *alloc_ring(char const *file_path, size_t size) {
+
+    Trace_Header *mem = malloc(size);
+    if (mem == NULL) {
+        log_message(LOG_ERROR, "Unable to allocate trace of %s\n", file_path);
+    }
+    return mem;
+}
+
+static int write_ring(size_t size) {
+
+    FILE *file;
+    int ok = 0;
+    if ((file = fopen(trace_path, "wb"))) {
+        ok = fwrite(ring, 1, size, file) == size;
+        ok &= fclose(file) == 0;
+    }
+    free(ring);
+    return ok;
+}
+
+#endif /* TRACE_MMAP */
+
+
+#ifdef TRACE_THREAD
+
+#include <pthread.h>
+
+#define CHUNK_SLOTS 8
+
+/* Chunks waiting to be written, the emulation thread fills the
+ * slot at the tail and the writer empties the one at the head */
+static Trace_Record *slots = NULL;
+static unsigned slot_records[CHUNK_SLOTS];
+static int slot_head;
+static int slot_count;
+
+static pthread_t writer;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t filled = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t emptied = PTHREAD_COND_INITIALIZER;
+static int quit;
+
+
+static void *trace_writer(void *arg) {
+    (void)arg;
+
+    pthread_mutex_lock(&lock);
+    for (;;) {
+        while (slot_count == 0 && !quit) {
+            pthread_cond_wait(&filled, &lock);
+        }
+        // Everything queued is written before stopping
+        if (slot_count == 0) {
+            break;
+        }
+
+        Trace_Record const *records = &slots[slot_head * CHUNK_RECORDS];
+        unsigned count = slot_records[slot_head];
+        pthread_mutex_unlock(&lock);
+
+        fwrite(records, sizeof(Trace_Record), count, stream);
+
+        pthread_mutex_lock(&lock);
+        slot_head = (slot_head + 1) % CHUNK_SLOTS;
+        slot_count--;
+        pthread_cond_signal(&emptied);
+    }
+    pthread_mutex_unlock(&lock);
+    return NULL;
+}
+
+
+/* Hand the filled chunk to the writer. Records are never dropped,
+ * if the writer falls behind emulation waits for it instead */
+static void queue_chunk() {
+
+    pthread_mutex_lock(&lock);
+    slot_records[(slot_head + slot_count) % CHUNK_SLOTS] = chunk_count;
+    slot_count++;
+    pthread_cond_signal(&filled);
+    while (slot_count == CHUNK_SLOTS) {
+        pthread_cond_wait(&emptied, &lock);
+    }
+    chunk = &slots[((slot_head + slot_count) % CHUNK_SLOTS) * CHUNK_RECORDS];
+    pthread_mutex_unlock(&lock);
+
+    streamed += chunk_count;
+    chunk_count = 0;
+}
+
+
+static int start_writer() {
+
+    slots = malloc(CHUNK_SLOTS * CHUNK_RECORDS * sizeof(Trace_Record));
+    if (!slots) {
+        log_message(LOG_ERROR, "Unable to allocate trace queue\n");
+        return 0;
+    }
+    slot_head = 0;
+    slot_count = 0;
+    quit = 0;
+    chunk = slots;
+
+    if (pthread_create(&writer, NULL, trace_writer, NULL) != 0) {
+        log_message(LOG_ERROR, "Failed to start trace thread\n");
+        free(slots);
+        slots = NULL;
+        return 0;
+    }
+    return 1;
+}
+
+
+static void stop_writer() {
+
+    pthread_mutex_lock(&lock);
+    quit = 1;
+    pthread_cond_signal(&filled);
+    pthread_mutex_unlock(&lock);
+    pthread_join(writer, NULL);
+
+    free(slots);
+    slots = NULL;
+}
+
+#else
+
+static void queue_chunk() {
+    fwrite(chunk, sizeof(Trace_Record), chunk_count, stream);
+    streamed += chunk_count;
+    chunk_count = 0;
+}
+
+static int start_writer() {
+    chunk = malloc(CHUNK_RECORDS * sizeof(Trace_Record));
+    if (!chunk) {
+        log_message(LOG_ERROR, "Unable to allocate trace chunk\n");
+        return 0;
+    }
+    return 1;
+}
+
+static void stop_writer() {
+    free(chunk);
+}
+
+#endif /* TRACE_THREAD */
+
+
+static int start_stream(char const *file_path) {
+
+    if (!(stream = fopen(file_path, "wb"))) {
+        log_message(LOG_ERROR, "Error opening trace file %s\n", file_path);
+        return 0;
+    }
+
+    // Count is filled in on stopping
+    Trace_Header header;
+    fill_header(&header, TRACE_COUNT_UNKNOWN, 0);
+    if (fwrite(&header, sizeof(header), 1, stream) != 1 || !start_writer()) {
+        fclose(stream);
+        stream = NULL;
+        return 0;
+    }
+    chunk_count = 0;
+    streamed = 0;
+    return 1;
+}
+
+
+static int start_ring(char const *file_path, unsigned long last) {
+
+    if (last > MAX_RING_RECORDS) {
+        log_message(LOG_ERROR, "Can't trace more than the last %lu instructions\n", (unsigned long)MAX_RING_RECORDS);
+        return 0;
+    }
+
+    size_t size = sizeof(Trace_Header) + (size_t)last * sizeof(Trace_Record);
+    if (!(ring = alloc_ring(file_path, size))) {
+        return 0;
+    }
+    fill_header(ring, 0, 0);
+    ring_records = (Trace_Record *)(ring + 1);
+    ring_size = last;
+    ring_next = 0;
+    return 1;
+}
+
+
+int start_trace(char const *file_path, unsigned long last) {
+
+    stop_trace();
+    if (!(last ? start_ring(file_path, last) : start_stream(file_path))) {
+        return 0;
+    }
+    trace_path = file_path;
+    cycle_count = 0;
+    tracing = 1;
+    return 1;
+}
+
+
+static void stop_ring() {
+
+    uint64_t count = ring->count;
+    size_t size = sizeof(Trace_Header) + count * sizeof(Trace_Record);
+    if (write_ring(size)) {
+        log_message(LOG_INFO, "Wrote trace of the last %llu instructions to %s\n",
+            (unsigned long long)count, trace_path);
+    } else {
+        log_message(LOG_ERROR, "Error writing trace file %s\n", trace_path);
+    }
+    ring = NULL;
+}
+
+
+static void stop_stream() {
+
+    if (chunk_count > 0) {
+        queue_chunk();
+    }
+    stop_writer();
+    chunk = NULL;
+
+    Trace_Header header;
+    fill_header(&header, streamed, 0);
+    int ok = fseek(stream, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(header), 1, stream) == 1;
+    ok &= !ferror(stream);
+    ok &= fclose(stream) == 0;
+    if (ok) {
+        log_message(LOG_INFO, "Wrote trace of %llu instructions to %s\n",
+            (unsigned long long)streamed, trace_path);
+    } else {
+        log_message(LOG_ERROR, "Error writing trace file %s\n", trace_path);
+    }
+    stream = NULL;
+}
+
+
+void stop_trace() {
+
+    if (ring) {
+        stop_ring();
+    } else if (stream) {
+        stop_stream();
+    }
+    tracing = 0;
+}
+
+
+void trigger_trace(char const *reason) {
+
+    if (!tracing || !ring) {
+        return;
+    }
+    log_message(LOG_INFO, "Trace triggered by %s\n", reason);
+    stop_ring();
+    tracing = 0;
+}
+
+
+static inline void fill_record(Trace_Record *record) {
+
+    uint16_t pc = get_register(REG_PC);
+    int bank = mapped_rom_bank(pc);
+
+    record->cycles = cycle_count;
+    record->pc = pc;
+    record->bank = bank < 0 ? TRACE_NO_BANK : bank;
+    record->af = get_register(REG_AF);
+    record->bc = get_register(REG_BC);
+    record->de = get_register(REG_DE);
+    record->hl = get_register(REG_HL);
+    record->sp = get_register(REG_SP);
+    record->opcode = peek_mem(pc);
+    record->operand = peek_mem(pc + 1);
+}
+
+
+void trace_instruction() {
+
+    if (ring) {
+        fill_record(&ring_records[ring_next]);
+        if (++ring_next == ring_size) {
+            ring_next = 0;
+        }
+        // Kept up to date so a mapped ring can be read after a crash
+        if (ring->count < ring_size) {
+            ring->count++;
+        }
+        ring->start = ring->count == ring_size ? ring_next : 0;
+    } else {
+        fill_record(&chunk[chunk_count]);
+        if (++chunk_count == CHUNK_RECORDS) {
+            queue_chunk();
+        }
+    }
+}
+
+
+void trace_cycles(long cycles) {
+    cycle_count += cycles;
+}
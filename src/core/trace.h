@@ -0,0 +1,67 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+
+/* Binary trace of the instructions run, one Trace_Record per
+ * instruction with the machine state just before it ran.
+ *
+ * A trace either streams every instruction to its file, or keeps only
+ * the last n in a ring. Streamed records are written in chunks, by a
+ * separate thread when built with TRACE_THREAD. A ring is written out
+ * once triggered by a breakpoint or watchpoint being hit or an unknown
+ * opcode, after which it stops recording so the file holds what led up
+ * to the trigger. Rings not triggered are written on stop. When built
+ * with TRACE_MMAP the ring is the file itself mapped into memory, so
+ * it's left on disk even if the emulator crashes or is killed.
+ *
+ * Files are a Trace_Header followed by the records, in the host's byte
+ * order. trace_diff compares them with each other or with text logs. */
+
+#define TRACE_MAGIC "PBTRACE"
+#define TRACE_VERSION 1
+#define TRACE_NO_BANK 0xFFFF // Code outside of cartridge ROM
+#define TRACE_COUNT_UNKNOWN UINT64_MAX // Streaming never finished, read to the end
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t record_size;
+    uint64_t count; // Records in the file, or TRACE_COUNT_UNKNOWN
+    uint64_t start; // Index of the oldest record in a ring
+} Trace_Header;
+
+typedef struct {
+    uint64_t cycles; // Emulated cycles since the trace started
+    uint16_t pc;
+    uint16_t bank; // ROM bank of pc, or TRACE_NO_BANK
+    uint16_t af;
+    uint16_t bc;
+    uint16_t de;
+    uint16_t hl;
+    uint16_t sp;
+    uint8_t opcode;
+    uint8_t operand; // Byte after the opcode, the second opcode byte of CB instructions
+} Trace_Record;
+
+// Set while recording, checked before calling trace_instruction or trace_cycles
+extern int tracing;
+
+/* Trace to the given file, every instruction if last is 0, otherwise
+ * the last instructions before a trigger. returns 1 if successful, 0 otherwise */
+int start_trace(char const *file_path, unsigned long last);
+
+// Write out anything still to be written and close the trace
+void stop_trace();
+
+/* Write a ring out and stop recording, reason is logged.
+ * Does nothing when streaming */
+void trigger_trace(char const *reason);
+
+// Record the instruction about to run
+void trace_instruction();
+
+// Count cycles run since the last instruction was recorded
+void trace_cycles(long cycles);
+
+#endif /* TRACE_H */
@@ -1,7 +1,7 @@
 #ifndef DEBUGGER_H
 #define DEBUGGER_H
 
-typedef enum {NONE = 0x0, STEPS_SET = 0x1, BREAKPOINT_SET = 0x2} Command_Flag;
+typedef enum {NONE = 0x0, STEPS_SET = 0x1, BREAKPOINT_SET = 0x2, QUIT = 0x4} Command_Flag;
 
 #define BREAKPOINT_OFF 0x0
 #define STEPS_OFF 0x0
@@ -28,5 +28,10 @@ long get_breakpoint();
 void turn_breakpoint_off();
 
 
+/* Returns 1 if the debugger wants to stop the emulator,
+ * checked between frames while debugging */
+int check_debug_break();
+
+
 
 #endif //DEBUGGER_H
@@ -0,0 +1,45 @@
+#ifndef FILTERS_H
+#define FILTERS_H
+
+#include <stdint.h>
+
+/* Software upscaling filters applied to the screen before it
+ * is output, for targets without GPU scaling */
+
+typedef enum {
+    FILTER_NONE,
+    FILTER_SCALE2X,
+    FILTER_SCALE3X,
+    FILTER_SCALE4X,
+    FILTER_XBR2X, // xBR level 2
+    FILTER_LCD, // Dot matrix grid with ghosting
+    FILTER_SCANLINES,
+    FILTER_COUNT
+} Filter_Type;
+
+#define MAX_FILTER_SCALE 4
+#define MAX_FILTER_THREADS 8
+
+/* Select the filter to apply to the screen, should be set
+ * before init_screen. returns 1 if successful, 0 otherwise */
+int set_filter(Filter_Type type);
+
+Filter_Type get_filter();
+
+/* Look up a filter by name e.g. "scale2x"
+ * returns the filter, or -1 if the name is unknown */
+int filter_from_name(char const *name);
+
+// Amount the current filter scales each dimension of the screen by
+int filter_scale();
+
+/* Split filtering across the given number of threads,
+ * only has an effect if built with FILTER_THREADS */
+void set_filter_threads(int count);
+
+/* Filter the GB_PIXELS_X by GB_PIXELS_Y screen into dst, which must
+ * hold filter_scale() times as many pixels in each dimension.
+ * dst_pitch is the number of pixels per row of dst */
+void apply_filter(uint32_t const *src, uint32_t *dst, int dst_pitch);
+
+#endif
@@ -5,6 +5,10 @@
 
 extern int limiter; // FPS limiter ON or OFF
 
+/* Present frames in sync with the display refresh, set before
+ * the screen is initialised. Cleared if vsync isn't available */
+extern int vsync;
+
 //Set a framerate and start the counter
 void start_framerate(int fps);
 
@@ -0,0 +1,31 @@
+#ifndef GDB_STUB_H
+#define GDB_STUB_H
+
+/* GDB remote serial protocol server, so gdb, lldb or an IDE can debug
+ * the emulator over TCP in place of the command line debugger.
+ *
+ * The connection is only read while stopped, and between frames to see
+ * if the client has asked to interrupt, never while instructions run. */
+
+#define GDB_DEFAULT_PORT 2345
+
+/* Listen on localhost and wait for a client to connect.
+ * returns 1 if connected, 0 otherwise */
+int gdb_stub_open(int port);
+
+void gdb_stub_close();
+
+// 1 if a client is connected
+int gdb_stub_connected();
+
+/* Report why the emulator stopped and serve requests until the
+ * client continues, steps or kills the emulator. Returns debugger
+ * Command_Flags, QUIT if killed, with *steps set to the number of
+ * instructions to step */
+int gdb_stub_command(long *steps);
+
+/* Returns 1 if the client has asked to interrupt the emulator,
+ * doesn't wait for anything to be received */
+int gdb_stub_interrupted();
+
+#endif /* GDB_STUB_H */
@@ -1,6 +1,8 @@
 #ifndef JOYPAD_H
 #define JOYPAD_H
 
+#include <stdint.h>
+
 //Virtual Button Positions for Mobile Devices
 #define SQUARE_SIZE (current.w / 25)
 #define DPAD_SIZE (SQUARE_SIZE * 2)
@@ -56,21 +58,21 @@ void init_joypad();
  * quitting, 0 otherwise */
 int update_keys();
 
-/* Return state of one of the 8 GameBoy keys
- * 0 for unpressed, 1 for pressed */
-int down_pressed();    
-int up_pressed();     
-int left_pressed();  
-int right_pressed(); 
-int a_pressed();       
-int b_pressed();      
-int start_pressed(); 
-int select_pressed();  
-
-
-/* Returns 1 if any of the 8 GameBoy keys 
- * are pressed, 0 otherwise */
-int key_pressed();
+/* Bits of the 8 GameBoy keys in a key mask, directions in
+ * the low nibble and buttons in the high as P1 lays them out */
+#define GB_KEY_RIGHT 0x01
+#define GB_KEY_LEFT 0x02
+#define GB_KEY_UP 0x04
+#define GB_KEY_DOWN 0x08
+#define GB_KEY_A 0x10
+#define GB_KEY_B 0x20
+#define GB_KEY_SELECT 0x40
+#define GB_KEY_START 0x80
+
+/* State of the 8 GameBoy keys as a key mask, a bit set for
+ * each key held down as of the last update_keys. Only read
+ * once per input poll, see core/input.h */
+uint8_t joypad_keys();
 
 #endif //JOYPAD_H
 
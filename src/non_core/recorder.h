@@ -0,0 +1,41 @@
+#ifndef RECORDER_H
+#define RECORDER_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* Lossless recording of the screen and sound output to disk.
+ * Video is written to <name>.raw as raw GB_PIXELS_X by GB_PIXELS_Y
+ * frames of 32 bit little endian ARGB (ffmpeg pixel format bgra),
+ * sound to <name>.wav as 16 bit stereo PCM.
+ *
+ * When built with RECORD_THREAD frames are queued and written by
+ * a separate thread, if it falls behind emulation waits for it, as
+ * nothing can be dropped without video and sound going out of step.
+ * Otherwise they are written as they are recorded. Frame skipping
+ * is off while recording. */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern int recording_av; // 1 if a recording is in progress
+
+/* Start recording to <name>.raw and <name>.wav
+ * returns 1 if successful, 0 otherwise */
+int start_recording(char const *name);
+
+// Write out anything still queued and close the recording
+void stop_recording();
+
+// Record a GB_PIXELS_X by GB_PIXELS_Y frame
+void record_frame(uint32_t const *pixels);
+
+// Record count interleaved stereo samples played at sample_rate
+void record_audio(int16_t const *samples, size_t count, unsigned sample_rate);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RECORDER_H */
@@ -0,0 +1,34 @@
+#ifndef ROM_LIBRARY_H
+#define ROM_LIBRARY_H
+
+#include <stdint.h>
+
+#include "filebrowser.h"
+#include "../core/rom_info.h"
+
+/* Index of ROM header info for the file browser. Directories are scanned
+ * by background threads, with results kept in an index file keyed by
+ * path, size and modification time so unchanged ROMs are never reread. */
+
+typedef enum {LIBRARY_PENDING, LIBRARY_ROM, LIBRARY_NOT_ROM} library_state_t;
+
+/* Loads the index from the given file, which is also where it's saved.
+ * A missing or unreadable index just starts empty.
+ * returns 1 if successful, 0 otherwise */
+int rom_library_open(const char * const index_path);
+
+// Stops any scan, saves the index if changed and frees it
+void rom_library_close(void);
+
+/* Starts scanning the entries of dir in the background, stopping any
+ * previous scan. dir must stay valid until the next scan or close */
+void rom_library_scan(const dir_t * const dir);
+
+/* Gets the state of the given entry of the directory being scanned,
+ * filling in info if it's a ROM */
+library_state_t rom_library_get(uint32_t entry, rom_header_info *info);
+
+// Returns 1 if any entries have been scanned since last called
+int rom_library_changed(void);
+
+#endif // ROM_LIBRARY_H
@@ -0,0 +1,83 @@
+#ifndef SHM_OUTPUT_H
+#define SHM_OUTPUT_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* Publishes each frame and the mixed audio to POSIX shared memory,
+ * so a separate process (recorder, streamer, netplay relay) can
+ * mmap them and read them without any copying through pipes.
+ * Only available when built with SHM_OUTPUT.
+ *
+ * Video is published to /<name>_video as a Shm_Video_Header followed
+ * by SHM_VIDEO_SLOTS frames of GB_PIXELS_X * GB_PIXELS_Y ARGB pixels.
+ * Each slot is guarded by a sequence lock: the writer makes seq odd,
+ * writes the frame then makes seq even again. A reader should load
+ * frame_count, read slot (frame_count - 1) % SHM_VIDEO_SLOTS and
+ * only use the copy if the slot's seq was even and unchanged
+ * before and after reading it.
+ *
+ * Audio is published to /<name>_audio as a Shm_Audio_Header followed
+ * by SHM_AUDIO_SAMPLES interleaved signed 16 bit stereo samples.
+ * write_pos counts every sample ever written, sample n lives at
+ * index n % SHM_AUDIO_SAMPLES. A reader which falls more than
+ * SHM_AUDIO_SAMPLES behind write_pos has been overrun. */
+
+#define SHM_VIDEO_MAGIC 0x56425050 // "PPBV"
+#define SHM_AUDIO_MAGIC 0x41425050 // "PPBA"
+#define SHM_VERSION 1
+
+#define SHM_VIDEO_SLOTS 4
+#define SHM_AUDIO_SAMPLES (1 << 16) // Power of 2, counted per channel sample
+
+typedef struct {
+    uint32_t seq;
+    uint32_t pad;
+    uint64_t frame_no; // Frame number held in the slot
+} Shm_Slot;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t width;
+    uint32_t height;
+    uint32_t slot_count;
+    uint32_t slot_offset; // Offset from the header to the first frame
+    uint64_t frame_count; // Frames published so far
+    Shm_Slot slots[SHM_VIDEO_SLOTS];
+} Shm_Video_Header;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t sample_rate;
+    uint32_t channels;
+    uint32_t capacity; // Samples in the ring
+    uint32_t data_offset; // Offset from the header to the first sample
+    uint64_t write_pos; // Samples published so far
+} Shm_Audio_Header;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern int shm_output_enabled; // 1 if frames are being published
+
+/* Create the shared memory objects with the given name.
+ * returns 1 if successful, 0 otherwise */
+int shm_output_open(char const *name);
+
+// Unmap and unlink the shared memory objects
+void shm_output_close();
+
+// Publish a GB_PIXELS_X by GB_PIXELS_Y frame
+void shm_publish_frame(uint32_t const *pixels);
+
+// Publish count interleaved stereo samples played at sample_rate
+void shm_publish_audio(int16_t const *samples, size_t count, unsigned sample_rate);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SHM_OUTPUT_H */
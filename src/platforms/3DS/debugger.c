@@ -33,4 +33,8 @@ void turn_breakpoint_off() {
 }
 
 
-
+/* Returns 1 if the debugger wants to stop the emulator,
+ * checked between frames while debugging */
+int check_debug_break() {
+    return 0;
+}
@@ -12,19 +12,18 @@ static uint32_t keys_pressed = 0;
 
 void init_joypad() {keys_pressed = 0;}
 	
-int down_pressed()   { return (keys_pressed & KEY_DDOWN) == KEY_DDOWN; }  
-int up_pressed()     { return (keys_pressed & KEY_DUP) == KEY_DUP; }
-int left_pressed()   { return (keys_pressed & KEY_DLEFT) == KEY_DLEFT; }
-int right_pressed()  { return (keys_pressed & KEY_DRIGHT) == KEY_DRIGHT; } 
-int a_pressed()      { return (keys_pressed & KEY_A) == KEY_A; }
-int b_pressed()      { return (keys_pressed & KEY_B) == KEY_B; }
-int start_pressed()  { return (keys_pressed & KEY_START) == KEY_START; }
-int select_pressed() { return (keys_pressed & KEY_SELECT) == KEY_SELECT; }
-
-int key_pressed() {
-
-    return down_pressed() || up_pressed() || left_pressed() || right_pressed()
-    || a_pressed() || b_pressed() || start_pressed() || select_pressed();
+uint8_t joypad_keys() {
+
+    uint8_t mask = 0;
+    if (keys_pressed & KEY_DRIGHT) { mask |= GB_KEY_RIGHT; }
+    if (keys_pressed & KEY_DLEFT)  { mask |= GB_KEY_LEFT; }
+    if (keys_pressed & KEY_DUP)    { mask |= GB_KEY_UP; }
+    if (keys_pressed & KEY_DDOWN)  { mask |= GB_KEY_DOWN; }
+    if (keys_pressed & KEY_A)      { mask |= GB_KEY_A; }
+    if (keys_pressed & KEY_B)      { mask |= GB_KEY_B; }
+    if (keys_pressed & KEY_SELECT) { mask |= GB_KEY_SELECT; }
+    if (keys_pressed & KEY_START)  { mask |= GB_KEY_START; }
+    return mask;
 }
 
 
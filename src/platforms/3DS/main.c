@@ -4,6 +4,7 @@
 #include "SDL/SDL.h"
 
 #include "../../core/emu.h"
+#include "../../core/graphics.h"
 #include "../../core/serial_io.h"
 #include "../../core/mmu/mbc.h"
 #include "../../non_core/logger.h"
@@ -68,6 +69,9 @@ int main(int argc, char **argv) {
         cleanup();
         return 1;
     }
+
+    // Can't always hold full speed, skip rendering frames when behind
+    set_auto_frame_skip(1);
     
     log_message(LOG_INFO, "Running emu\n");
 
@@ -1,6 +1,7 @@
 #include "file_browser/browse.h"
 
 #include "../../core/emu.h"
+#include "../../core/graphics.h"
 #include "../../core/serial_io.h"
 #include "../../non_core/logger.h"
 
@@ -40,6 +41,9 @@ int main(int argc, char* argv[]) {
         return 1;
     }
 
+    // Can't always hold full speed, skip rendering frames when behind
+    set_auto_frame_skip(1);
+
     run();
     return 0;
 }
@@ -64,6 +64,7 @@ int main(int argc, char **argv) {
     run();
 
     write_SRAM();
+    flush_SRAM();
     cleanup();
 	return 0;
 }
@@ -1,7 +1,7 @@
 #include "../../non_core/debugger.h"
 
 #include "../../core/mmu/memory.h"
-#include "../../core/disasm.h"
+#include "../../core/disasm_memory.h"
 #include "../../core/cpu.h"
 
 #include <stdint.h>
@@ -106,4 +106,8 @@ void turn_breakpoint_off() {
 }
 
 
-
+/* Returns 1 if the debugger wants to stop the emulator,
+ * checked between frames while debugging */
+int check_debug_break() {
+    return 0;
+}
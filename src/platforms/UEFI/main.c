@@ -17,6 +17,7 @@
 #include <Protocol/EfiShellParameters.h>
 
 #include "../../non_core/logger.h"
+#include "../../non_core/filters.h"
 #include "../../core/mmu/memory.h"
 #include "../../core/emu.h"
 
@@ -89,7 +90,7 @@ PlutoboyMain (
 	}
 
 	if (argc < 2) {
-		Print(L"Usage: plutoboy.efi rom\n");
+		Print(L"Usage: plutoboy.efi rom [filter]\n");
 		return 1;
 	}
 
@@ -103,6 +104,22 @@ PlutoboyMain (
 	}
 
 	file_name[StrLen(argv[1])] = '\0';
+
+	// Optional screen filter e.g. scale2x, there's no hardware scaling
+	if (argc > 2) {
+		char filter_name[16];
+		UINTN len = StrLen(argv[2]);
+		if (len < sizeof(filter_name)) {
+			for (UINTN i = 0; i < len; i++) {
+				filter_name[i] = (char)(argv[2][i]);
+			}
+			filter_name[len] = '\0';
+			int filter = filter_from_name(filter_name);
+			if (filter >= 0) {
+				set_filter(filter);
+			}
+		}
+	}
  
     int debug = 0;
     int dmg_mode = 0;
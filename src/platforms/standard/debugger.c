@@ -1,13 +1,16 @@
 #include "../../non_core/debugger.h"
+#include "../../non_core/gdb_stub.h"
 
 #include "../../core/mmu/memory.h"
-#include "../../core/disasm.h"
+#include "../../core/disasm_memory.h"
 #include "../../core/cpu.h"
+#include "../../core/breakpoints.h"
 
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 
 #define BREAKPOINT_MIN 0x000
 #define BREAKPOINT_MAX 0xFFFF
@@ -93,28 +96,88 @@ static int help(char *buf) {
                "showregs:    display current contents of registers\n"
                "step [n]:    execute n operations\n"
                "continue:    execute forever\n"
-               "setb [n]:    set a breakpoint for address n\n"
+               "setb [b:]n [r op v]: set a breakpoint for address n, only in ROM bank b\n"
+               "             and only if register r op v holds (op is == != < > <= >=)\n"
+               "delb [b:]n:  remove breakpoints at address n\n"
+               "watch r|w|rw n [m]: break on reads and/or writes of addresses n to m\n"
+               "delw n:      remove watchpoints starting at address n\n"
+               "listb:       list breakpoints and watchpoints\n"
                "showmem [n]: display contents of memory address n\n"
-               "disasm [n]:  disassemble instruction at address n \n");
+               "disasm [b:]n [c]: disassemble c instructions from address n,\n"
+               "             in ROM bank b if given\n");
         return 1;
     }
     return 0;
 }
 
 
+static char const * const reg_names[] = {
+    "A", "F", "B", "C", "D", "E", "H", "L", "AF", "BC", "DE", "HL", "SP", "PC"
+};
+
+static char const * const op_names[] = {"", "==", "!=", "<", ">", "<=", ">="};
+
+
+/* Parse a [bank:]address, returns 1 if valid
+ * setting bank to ANY_BANK if not given */
+static int parse_bank_addr(char const *str, int *bank, int *addr) {
+
+    *bank = ANY_BANK;
+    if (sscanf(str, "%x:%x", bank, addr) == 2) {
+        return *bank >= 0 && *addr >= BREAKPOINT_MIN && *addr <= BREAKPOINT_MAX;
+    }
+    *bank = ANY_BANK;
+    return sscanf(str, "%x", addr) == 1 && *addr >= BREAKPOINT_MIN && *addr <= BREAKPOINT_MAX;
+}
+
+
+/* Parse a condition such as A==3 or HL>=C000,
+ * returns 1 if valid */
+static int parse_condition(char const *str, Break_Condition *condition) {
+
+    char reg[3];
+    char op[3];
+    unsigned value;
+
+    if (sscanf(str, "%2[A-Za-z]%2[=!<>]%x", reg, op, &value) != 3) {
+        return 0;
+    }
+
+    condition->op = COND_NONE;
+    for (unsigned i = 1; i < sizeof(op_names) / sizeof(op_names[0]); i++) {
+        if (!strcmp(op, op_names[i])) {
+            condition->op = i;
+        }
+    }
+    for (unsigned i = 0; i < sizeof(reg_names) / sizeof(reg_names[0]); i++) {
+        if (!strcasecmp(reg, reg_names[i])) {
+            condition->reg = i;
+            condition->value = value;
+            return condition->op != COND_NONE;
+        }
+    }
+    return 0;
+}
+
+
 /* Check if a set breakpoint command has been entered,
- * and set a breakpoint to the given hex memory address if valid.
+ * and add a breakpoint at the given hex memory address if valid.
  * Returns 1 if command was entered, 0 otherwise */
 static int check_breakpoint(char *buf) {
    
-    if (BUFSIZE > 5 && !strncmp(buf,"setb",4)) {
-        int bp = -1;
-        if (sscanf(buf+5, "%x", &bp) && bp >= BREAKPOINT_MIN && bp <= BREAKPOINT_MAX) {
-            breakpoint = bp;
-            flags|=BREAKPOINT_SET;
+    if (BUFSIZE > 5 && !strncmp(buf,"setb ",5)) {
+        char location[32];
+        char cond_str[32];
+        int bank, bp;
+        Break_Condition condition;
+        int fields = sscanf(buf+5, "%31s %31s", location, cond_str);
+
+        if (fields >= 1 && parse_bank_addr(location, &bank, &bp) &&
+            (fields == 1 || parse_condition(cond_str, &condition)) &&
+            add_breakpoint(bp, bank, fields == 2 ? &condition : NULL)) {
             return 1;
         } else {
-            printf("usage: setb [breakpoint]"\
+            printf("usage: setb [bank:]breakpoint [reg op value] "\
             "(where breakpoint is between 0x0000 and 0xFFFF inclusive)\n");
             return 0;
         }
@@ -123,6 +186,104 @@ static int check_breakpoint(char *buf) {
 }
 
 
+/* Check if a delete breakpoint command has been entered,
+ * and remove breakpoints at the given address if valid.
+ * Returns 1 if command was entered, 0 otherwise */
+static int check_delete_breakpoint(char *buf) {
+
+    if (BUFSIZE > 5 && !strncmp(buf,"delb ",5)) {
+        int bank, bp;
+        if (parse_bank_addr(buf+5, &bank, &bp)) {
+            printf("removed %d\n", remove_breakpoints(bp, bank));
+            return 1;
+        } else {
+            printf("usage: delb [bank:]breakpoint\n");
+            return 0;
+        }
+    }
+    return 0;
+}
+
+
+/* Check if a watch command has been entered, and watch
+ * the given range of addresses if valid.
+ * Returns 1 if command was entered, 0 otherwise */
+static int check_watchpoint(char *buf) {
+
+    if (BUFSIZE > 6 && !strncmp(buf,"watch ",6)) {
+        char access[3];
+        int start, end;
+        int fields = sscanf(buf+6, "%2s %x %x", access, &start, &end);
+        int flags = !strcmp(access, "r") ? WATCH_READ :
+                    !strcmp(access, "w") ? WATCH_WRITE :
+                    !strcmp(access, "rw") ? WATCH_READ | WATCH_WRITE : 0;
+        if (fields == 2) {
+            end = start;
+        }
+
+        if (fields >= 2 && flags && start >= 0 && end <= 0xFFFF &&
+            add_watchpoint(start, end, flags)) {
+            return 1;
+        } else {
+            printf("usage: watch r|w|rw start [end]"\
+            "(where addresses are between 0x0000 and 0xFFFF inclusive)\n");
+            return 0;
+        }
+    }
+    return 0;
+}
+
+
+/* Check if a delete watchpoint command has been entered,
+ * and remove watchpoints starting at the given address if valid.
+ * Returns 1 if command was entered, 0 otherwise */
+static int check_delete_watchpoint(char *buf) {
+
+    if (BUFSIZE > 5 && !strncmp(buf,"delw ",5)) {
+        int start;
+        if (sscanf(buf+5, "%x", &start) == 1 && start >= 0 && start <= 0xFFFF) {
+            printf("removed %d\n", remove_watchpoints(start, WATCH_READ | WATCH_WRITE));
+            return 1;
+        } else {
+            printf("usage: delw start\n");
+            return 0;
+        }
+    }
+    return 0;
+}
+
+
+/* Check if a list breakpoints command has been entered, and list
+ * them if it has. Returns 1 if command was entered, 0 otherwise */
+static int list_breakpoints(char *buf) {
+
+    if (!strcmp(buf, "listb\n")) {
+        unsigned count;
+        Breakpoint const *bps = get_breakpoints(&count);
+        for (unsigned i = 0; i < count; i++) {
+            if (bps[i].bank == ANY_BANK) {
+                printf("break %04X", bps[i].addr);
+            } else {
+                printf("break %02X:%04X", bps[i].bank, bps[i].addr);
+            }
+            if (bps[i].condition.op != COND_NONE) {
+                printf(" if %s%s%X", reg_names[bps[i].condition.reg],
+                    op_names[bps[i].condition.op], bps[i].condition.value);
+            }
+            printf("\n");
+        }
+
+        Watchpoint const *wps = get_watchpoints(&count);
+        for (unsigned i = 0; i < count; i++) {
+            printf("watch %s%s %04X-%04X\n", wps[i].flags & WATCH_READ ? "r" : "",
+                wps[i].flags & WATCH_WRITE ? "w" : "", wps[i].start, wps[i].end);
+        }
+        return 1;
+    }
+    return 0;
+}
+
+
 /* Check if a show memory command has been entered,
  * and display the contents of the given hex memory location
  * if valid. Returns 1 if command was entered, 0 otherwise */
@@ -131,7 +292,7 @@ static int check_show_mem(char *buf) {
     if (BUFSIZE > 8 && !strncmp(buf,"showmem",7)) {
         int mem;
         if(sscanf(buf+8, "%x", &mem) == 1 && mem >= 0 && mem <= 0xFFFF) {
-            printf("0x%X\n",get_mem(mem));      
+            printf("0x%X\n",peek_mem(mem));      
             return 1; 
         }
          else {
@@ -144,19 +305,50 @@ static int check_show_mem(char *buf) {
 }
 
 
-/* Check if a dissasemble command has been entered,
- * and disassemble the given hex memory location if valid.
+#define MAX_DISASM_LINES 0x1000
+
+static void print_disasm_line(Disasm_Line const *line) {
+
+    if (line->label) {
+        printf("%s:\n", line->label);
+    }
+    if (line->bank >= 0) {
+        printf("%02X:%04X  ", line->bank, line->addr);
+    } else {
+        printf("   %04X  ", line->addr);
+    }
+    for (unsigned i = 0; i < DISASM_MAX_LENGTH; i++) {
+        printf(i < line->length ? "%02X " : "   ", line->bytes[i]);
+    }
+    char text[64];
+    format_instruction(line, text, sizeof(text));
+    printf(" %s\n", text);
+}
+
+
+/* Check if a dissasemble command has been entered, and disassemble
+ * the given number of instructions from the [bank:]address if valid.
  * Returns 1 if command was entered, 0 otherwise */
 static int check_disasm(char *buf) {
-        
+
     if (BUFSIZE > 7 && !strncmp(buf,"disasm",6)) {
-        int mem;
-        if(sscanf(buf+7, "%x", &mem) == 1 && mem >= 0 && mem <= 0xFFFF) {
-            dasm_instruction(mem, stdout);
-            printf("\n");
+        char location[32];
+        unsigned count = 1;
+        int bank, mem;
+        int fields = sscanf(buf+7, "%31s %u", location, &count);
+        if (fields >= 1 && parse_bank_addr(location, &bank, &mem) &&
+                count >= 1 && count <= MAX_DISASM_LINES) {
+            static Disasm_Line lines[MAX_DISASM_LINES];
+            unsigned done = disassemble(bank == ANY_BANK ? DISASM_CURRENT_BANK : bank, mem, count, lines);
+            for (unsigned i = 0; i < done; i++) {
+                print_disasm_line(&lines[i]);
+            }
+            if (done == 0) {
+                printf("unable to read bank %X\n", bank);
+            }
             return 1;
         } else {
-            printf("usage: disasm [address]"\
+            printf("usage: disasm [bank:]address [count]"\
             "(where address is between 0x0000 and 0xFFFF inclusive)\n");
             return 0;
         }
@@ -172,7 +364,12 @@ int get_command() {
 
     flags = 0;
     char buf[BUFSIZE];
-    
+
+    // Commands come from gdb while it's connected
+    if (gdb_stub_connected()) {
+        return gdb_stub_command(&steps);
+    }
+
     check_first_time();
 
     for(;;) {
@@ -187,6 +384,8 @@ int get_command() {
         
         // If no valid options selected, show error message
         if (!(check_show_mem(buf) || check_breakpoint(buf) || check_disasm(buf)
+            || check_delete_breakpoint(buf) || check_watchpoint(buf)
+            || check_delete_watchpoint(buf) || list_breakpoints(buf)
             || help(buf) || show_regs(buf) || !strcmp(buf, "\n"))) {
             printf("unknown command\n");
         }
@@ -222,4 +421,8 @@ void turn_breakpoint_off() {
 }
 
 
-
+/* Returns 1 if the debugger wants to stop the emulator,
+ * checked between frames while debugging */
+int check_debug_break() {
+    return gdb_stub_interrupted();
+}
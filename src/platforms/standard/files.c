@@ -1,9 +1,40 @@
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L // fileno and fsync
+#endif
+
 #include "../../non_core/files.h"
 #include "../../non_core/logger.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
 
+#ifdef _WIN32
+#include <windows.h>
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#define MAX_TEMP_PATH 1024
+
+// Make sure everything written to the file has reached the disk
+static int sync_file(FILE *file) {
+#ifdef _WIN32
+    return _commit(_fileno(file));
+#else
+    return fsync(fileno(file));
+#endif
+}
+
+// Atomically replace dest with src, returns 1 if successful, 0 otherwise
+static int replace_file(const char *src, const char *dest) {
+#ifdef _WIN32
+    return MoveFileExA(src, dest, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+    return rename(src, dest) == 0;
+#endif
+}
+
 /*  Given a file_path and buffer to store file data in, attempts to
  *  read the file into the buffer. Returns the size of the file if successful,
  *  returns 0 if unsuccessful. Buffer should be at minimum of size "MAX_FILE_SIZE"*/
@@ -67,26 +98,40 @@ unsigned long load_SRAM(const char *file_path, unsigned char *data, unsigned lon
  
 
 /* Given a file_path, save data and the size of save data, attempts to
- * save the data to the given file. Returns 1 if successful, 0 otherwise */
+ * save the data to the given file. The data is written to a temporary
+ * file which replaces the save once it's on disk, so a crash part way
+ * through leaves the previous save intact. Returns 1 if successful, 0 otherwise */
 int save_SRAM(const char *file_path, const unsigned char *data, unsigned long size) {
     
     FILE *file;
+    char temp_path[MAX_TEMP_PATH];
     log_message(LOG_INFO, "Attempting to write SRAM for file: %s\n",file_path);
+
+    if (snprintf(temp_path, MAX_TEMP_PATH, "%s.tmp", file_path) >= MAX_TEMP_PATH) {
+        log_message(LOG_ERROR, "Save file path too long: %s\n", file_path);
+        return 0;
+    }
     
-    if(!(file = fopen(file_path, "wb"))) {
-        log_message(LOG_ERROR, "Error attempting to open file for writing: %s\n", file_path);
+    if(!(file = fopen(temp_path, "wb"))) {
+        log_message(LOG_ERROR, "Error attempting to open file for writing: %s\n", temp_path);
         return 0;  
     }
     
     unsigned long written_count = fwrite(data, sizeof (char), size, file);
-    if (written_count == size) {
+    if (written_count != size || fflush(file) != 0 || sync_file(file) != 0) {
+        log_message(LOG_ERROR, "Only %lu of %lu bytes written\n",written_count, size);
         fclose(file);
-        log_message(LOG_INFO, "%lu bytes successfully written to file\n",size);
+        remove(temp_path);
         return 0;
-    } else {
-        log_message(LOG_ERROR, "Only %lu of %lu bytes written\n",written_count, size);
     }
-        
-    fclose(file);   
+    fclose(file);
+
+    if (!replace_file(temp_path, file_path)) {
+        log_message(LOG_ERROR, "Unable to replace save file %s\n", file_path);
+        remove(temp_path);
+        return 0;
+    }
+
+    log_message(LOG_INFO, "%lu bytes successfully written to file\n",size);
     return 1;
-}                                      
+}
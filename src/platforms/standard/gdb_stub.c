@@ -0,0 +1,570 @@
+#include "../../non_core/gdb_stub.h"
+#include "../../non_core/debugger.h"
+#include "../../non_core/logger.h"
+#include "../../non_core/socket.h"
+
+#include "../../core/cpu.h"
+#include "../../core/breakpoints.h"
+#include "../../core/mmu/memory.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _WIN32
+#define CLOSE_SOCKET closesocket
+#else
+#define CLOSE_SOCKET close
+#endif
+
+#define MAX_PACKET 0x1000 // Advertised to the client as PacketSize
+#define RECV_BUFSIZE 256
+#define INTERRUPT 0x03
+
+// Registers in the order of the target description
+static CPU_Register const gdb_regs[] = {
+    REG_A, REG_F, REG_B, REG_C, REG_D, REG_E, REG_H, REG_L, REG_SP, REG_PC
+};
+#define GDB_REG_COUNT (sizeof(gdb_regs) / sizeof(gdb_regs[0]))
+#define REG_BYTES(n) (gdb_regs[n] >= REG_AF ? 2 : 1)
+
+/* GDB has no SM83 architecture, so only the registers are described,
+ * no disassembly or stack unwinding is available on the client */
+static char const target_xml[] =
+    "<?xml version=\"1.0\"?>\n"
+    "<!DOCTYPE target SYSTEM \"gdb-target.dtd\">\n"
+    "<target version=\"1.0\">\n"
+    "  <feature name=\"org.plutoboy.sm83.core\">\n"
+    "    <reg name=\"a\" bitsize=\"8\" regnum=\"0\"/>\n"
+    "    <reg name=\"f\" bitsize=\"8\"/>\n"
+    "    <reg name=\"b\" bitsize=\"8\"/>\n"
+    "    <reg name=\"c\" bitsize=\"8\"/>\n"
+    "    <reg name=\"d\" bitsize=\"8\"/>\n"
+    "    <reg name=\"e\" bitsize=\"8\"/>\n"
+    "    <reg name=\"h\" bitsize=\"8\"/>\n"
+    "    <reg name=\"l\" bitsize=\"8\"/>\n"
+    "    <reg name=\"sp\" bitsize=\"16\" type=\"data_ptr\"/>\n"
+    "    <reg name=\"pc\" bitsize=\"16\" type=\"code_ptr\"/>\n"
+    "  </feature>\n"
+    "</target>\n";
+
+static int client = -1;
+static int running = 0;           // Client is waiting for a stop reply
+static int interrupt_pending = 0; // Client asked to stop
+
+static uint8_t recv_buf[RECV_BUFSIZE];
+static int recv_len = 0;
+static int recv_pos = 0;
+
+static char packet[MAX_PACKET + 1];
+static char reply[MAX_PACKET + 1];
+
+static char const hex_digits[] = "0123456789abcdef";
+
+
+static void disconnect() {
+
+    if (client >= 0) {
+        CLOSE_SOCKET(client);
+        client = -1;
+    }
+    // Nothing left to stop for
+    clear_breakpoints();
+    running = 0;
+    log_message(LOG_INFO, "gdb disconnected\n");
+}
+
+
+// Next byte from the client, -1 if disconnected
+static int recv_byte() {
+
+    if (recv_pos == recv_len) {
+        int len = recv(client, (char *)recv_buf, RECV_BUFSIZE, 0);
+        if (len <= 0) {
+            return -1;
+        }
+        recv_len = len;
+        recv_pos = 0;
+    }
+    return recv_buf[recv_pos++];
+}
+
+
+static int send_all(char const *data, size_t len) {
+
+    while (len > 0) {
+        int sent = send(client, data, len, 0);
+        if (sent <= 0) {
+            return 0;
+        }
+        data += sent;
+        len -= sent;
+    }
+    return 1;
+}
+
+
+static int hex_value(int c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+
+/* Read a packet into packet, acknowledging it. Interrupts received
+ * while already stopped are ignored. returns its length, or -1 if
+ * disconnected */
+static int read_packet() {
+
+    for (;;) {
+        int c;
+        while ((c = recv_byte()) != '$') {
+            if (c < 0) {
+                return -1;
+            }
+        }
+
+        int len = 0;
+        uint8_t sum = 0;
+        while ((c = recv_byte()) != '#') {
+            if (c < 0) {
+                return -1;
+            }
+            if (len < MAX_PACKET) {
+                packet[len++] = c;
+            }
+            sum += c;
+        }
+        packet[len] = '\0';
+
+        int high = recv_byte();
+        int low = recv_byte();
+        if (high < 0 || low < 0) {
+            return -1;
+        }
+
+        if (hex_value(high) * 16 + hex_value(low) == sum) {
+            return send_all("+", 1) ? len : -1;
+        }
+        if (!send_all("-", 1)) {
+            return -1;
+        }
+    }
+}
+
+
+// Send data as a packet, resending until acknowledged
+static int send_packet(char const *data) {
+
+    static char framed[MAX_PACKET + 5];
+    size_t len = strlen(data);
+    uint8_t sum = 0;
+
+    for (size_t i = 0; i < len; i++) {
+        sum += data[i];
+    }
+    framed[0] = '$';
+    memcpy(framed + 1, data, len);
+    framed[len + 1] = '#';
+    framed[len + 2] = hex_digits[sum >> 4];
+    framed[len + 3] = hex_digits[sum & 0xF];
+
+    for (;;) {
+        if (!send_all(framed, len + 4)) {
+            return 0;
+        }
+        int c;
+        do {
+            c = recv_byte();
+        } while (c != '+' && c != '-' && c >= 0);
+
+        if (c == '+') {
+            return 1;
+        }
+        if (c < 0) {
+            return 0;
+        }
+    }
+}
+
+
+// Append val as little endian hex bytes
+static char *put_hex(char *out, unsigned val, int bytes) {
+    for (int i = 0; i < bytes; i++) {
+        *out++ = hex_digits[(val >> 4) & 0xF];
+        *out++ = hex_digits[val & 0xF];
+        val >>= 8;
+    }
+    *out = '\0';
+    return out;
+}
+
+
+/* Read little endian hex bytes from *in, advancing it.
+ * returns the value, or -1 if invalid */
+static long get_hex(char const **in, int bytes) {
+    long val = 0;
+    for (int i = 0; i < bytes; i++) {
+        int high = hex_value((*in)[0]);
+        int low = high < 0 ? -1 : hex_value((*in)[1]);
+        if (low < 0) {
+            return -1;
+        }
+        val |= (long)(high * 16 + low) << (i * 8);
+        *in += 2;
+    }
+    return val;
+}
+
+
+static void read_registers() {
+    char *out = reply;
+    for (unsigned i = 0; i < GDB_REG_COUNT; i++) {
+        out = put_hex(out, get_register(gdb_regs[i]), REG_BYTES(i));
+    }
+}
+
+
+static void write_registers(char const *in) {
+    for (unsigned i = 0; i < GDB_REG_COUNT; i++) {
+        long val = get_hex(&in, REG_BYTES(i));
+        if (val < 0) {
+            strcpy(reply, "E01");
+            return;
+        }
+        set_register(gdb_regs[i], val);
+    }
+    strcpy(reply, "OK");
+}
+
+
+// p n
+static void read_register(char const *in) {
+    unsigned n;
+    if (sscanf(in, "%x", &n) != 1 || n >= GDB_REG_COUNT) {
+        strcpy(reply, "E01");
+        return;
+    }
+    put_hex(reply, get_register(gdb_regs[n]), REG_BYTES(n));
+}
+
+
+// P n=value
+static void write_register(char const *in) {
+    unsigned n;
+    char const *val_str = strchr(in, '=');
+    if (sscanf(in, "%x", &n) != 1 || n >= GDB_REG_COUNT || val_str == NULL) {
+        strcpy(reply, "E01");
+        return;
+    }
+    val_str++;
+    long val = get_hex(&val_str, REG_BYTES(n));
+    if (val < 0) {
+        strcpy(reply, "E01");
+        return;
+    }
+    set_register(gdb_regs[n], val);
+    strcpy(reply, "OK");
+}
+
+
+// m addr,len
+static void read_memory(char const *in) {
+    unsigned addr, len;
+    if (sscanf(in, "%x,%x", &addr, &len) != 2 || addr > 0xFFFF) {
+        strcpy(reply, "E01");
+        return;
+    }
+    if (len > MAX_PACKET / 2) {
+        len = MAX_PACKET / 2;
+    }
+    char *out = reply;
+    for (unsigned i = 0; i < len; i++) {
+        out = put_hex(out, peek_mem((addr + i) & 0xFFFF), 1);
+    }
+}
+
+
+// M addr,len:data
+static void write_memory(char const *in) {
+    unsigned addr, len;
+    char const *data = strchr(in, ':');
+    if (sscanf(in, "%x,%x", &addr, &len) != 2 || addr > 0xFFFF || data == NULL) {
+        strcpy(reply, "E01");
+        return;
+    }
+    data++;
+    for (unsigned i = 0; i < len; i++) {
+        long val = get_hex(&data, 1);
+        if (val < 0) {
+            strcpy(reply, "E01");
+            return;
+        }
+        set_mem((addr + i) & 0xFFFF, val);
+    }
+    strcpy(reply, "OK");
+}
+
+
+/* Z/z type,addr,kind. Software and hardware breakpoints are the same,
+ * kind is the length watched for watchpoints */
+static void set_breakpoint(char const *in, int insert) {
+
+    unsigned type, addr, kind;
+    if (sscanf(in + 1, "%u,%x,%x", &type, &addr, &kind) != 3 || addr > 0xFFFF) {
+        strcpy(reply, "E01");
+        return;
+    }
+
+    int watch_flags[] = {0, 0, WATCH_WRITE, WATCH_READ, WATCH_READ | WATCH_WRITE};
+    int ok = 1;
+    if (type <= 1) {
+        if (insert) {
+            ok = add_breakpoint(addr, ANY_BANK, NULL);
+        } else {
+            remove_breakpoints(addr, ANY_BANK);
+        }
+    } else if (type <= 4) {
+        unsigned end = addr + (kind ? kind - 1 : 0);
+        if (end > 0xFFFF) {
+            end = 0xFFFF;
+        }
+        // Only the type being removed, a write watch leaves an access watch
+        if (insert) {
+            ok = add_watchpoint(addr, end, watch_flags[type]);
+        } else {
+            remove_watchpoint(addr, end, watch_flags[type]);
+        }
+    } else {
+        reply[0] = '\0'; // Unsupported
+        return;
+    }
+    strcpy(reply, ok ? "OK" : "E02");
+}
+
+
+// qXfer:features:read:target.xml:offset,length
+static void read_features(char const *in) {
+
+    unsigned offset, len;
+    if (sscanf(in, "target.xml:%x,%x", &offset, &len) != 2) {
+        strcpy(reply, "E00");
+        return;
+    }
+
+    size_t total = strlen(target_xml);
+    if (offset >= total) {
+        strcpy(reply, "l");
+        return;
+    }
+    if (len > MAX_PACKET - 1) {
+        len = MAX_PACKET - 1;
+    }
+    size_t remaining = total - offset;
+    size_t count = remaining < len ? remaining : len;
+    reply[0] = count == remaining ? 'l' : 'm';
+    memcpy(reply + 1, target_xml + offset, count);
+    reply[count + 1] = '\0';
+}
+
+
+static void query(char const *in) {
+
+    if (!strncmp(in, "qSupported", strlen("qSupported"))) {
+        snprintf(reply, sizeof(reply), "PacketSize=%x;qXfer:features:read+", MAX_PACKET);
+    } else if (!strncmp(in, "qXfer:features:read:", strlen("qXfer:features:read:"))) {
+        read_features(in + strlen("qXfer:features:read:"));
+    } else if (!strcmp(in, "qAttached")) {
+        strcpy(reply, "1");
+    } else if (!strcmp(in, "qC")) {
+        strcpy(reply, "QC1");
+    } else if (!strcmp(in, "qfThreadInfo")) {
+        strcpy(reply, "m1");
+    } else if (!strcmp(in, "qsThreadInfo")) {
+        strcpy(reply, "l");
+    } else {
+        reply[0] = '\0';
+    }
+}
+
+
+static void stop_reply() {
+
+    Break_Hit hit;
+    int hit_found = take_break_hit(&hit);
+
+    if (interrupt_pending) {
+        strcpy(reply, "T02");
+    } else if (hit_found && hit.flags) {
+        char const *kind = hit.flags == WATCH_WRITE ? "watch" :
+                           hit.flags == WATCH_READ ? "rwatch" : "awatch";
+        snprintf(reply, sizeof(reply), "T05%s:%x;", kind, hit.addr);
+    } else {
+        strcpy(reply, "T05");
+    }
+    interrupt_pending = 0;
+}
+
+
+int gdb_stub_open(int port) {
+
+    SocketInit();
+
+    int server = socket(AF_INET, SOCK_STREAM, 0);
+    if (server < 0) {
+        log_message(LOG_ERROR, "Unable to create gdb socket\n");
+        return 0;
+    }
+
+    int reuse = 1;
+    setsockopt(server, SOL_SOCKET, SO_REUSEADDR, (char const *)&reuse, sizeof(reuse));
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    if (bind(server, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(server, 1) != 0) {
+        log_message(LOG_ERROR, "Unable to listen for gdb on port %d\n", port);
+        CLOSE_SOCKET(server);
+        return 0;
+    }
+
+    log_message(LOG_INFO, "Waiting for gdb to connect on port %d\n", port);
+    client = accept(server, NULL, NULL);
+    CLOSE_SOCKET(server);
+    if (client < 0) {
+        log_message(LOG_ERROR, "Failed to accept gdb connection\n");
+        return 0;
+    }
+
+    int no_delay = 1;
+    setsockopt(client, IPPROTO_TCP, TCP_NODELAY, (char const *)&no_delay, sizeof(no_delay));
+    recv_len = recv_pos = 0;
+    running = 0;
+    log_message(LOG_INFO, "gdb connected\n");
+    return 1;
+}
+
+
+void gdb_stub_close() {
+    if (client >= 0) {
+        disconnect();
+    }
+    SocketDeinit();
+}
+
+
+int gdb_stub_connected() {
+    return client >= 0;
+}
+
+
+// 1 if a byte can be received without blocking
+static int data_waiting() {
+
+    if (recv_pos < recv_len) {
+        return 1;
+    }
+
+    fd_set fds;
+    struct timeval timeout = {0, 0};
+    FD_ZERO(&fds);
+    FD_SET(client, &fds);
+    return select(client + 1, &fds, NULL, NULL, &timeout) > 0;
+}
+
+
+int gdb_stub_interrupted() {
+
+    if (client < 0) {
+        return 0;
+    }
+
+    // Only look at bytes already waiting
+    while (data_waiting()) {
+
+        int c = recv_byte();
+        if (c < 0) {
+            disconnect();
+            return 0;
+        }
+        if (c == INTERRUPT) {
+            interrupt_pending = 1;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+
+int gdb_stub_command(long *steps) {
+
+    if (client < 0) {
+        return NONE;
+    }
+
+    if (running) {
+        stop_reply();
+        running = 0;
+        if (!send_packet(reply)) {
+            disconnect();
+            return NONE;
+        }
+    }
+
+    for (;;) {
+        if (read_packet() < 0) {
+            disconnect();
+            return NONE;
+        }
+
+        reply[0] = '\0';
+        switch (packet[0]) {
+            case '?': stop_reply(); break;
+            case 'g': read_registers(); break;
+            case 'G': write_registers(packet + 1); break;
+            case 'p': read_register(packet + 1); break;
+            case 'P': write_register(packet + 1); break;
+            case 'm': read_memory(packet + 1); break;
+            case 'M': write_memory(packet + 1); break;
+            case 'Z': set_breakpoint(packet, 1); break;
+            case 'z': set_breakpoint(packet, 0); break;
+            case 'q': query(packet); break;
+            case 'H':
+            case 'T': strcpy(reply, "OK"); break;
+
+            case 'c':
+            case 's': {
+                unsigned addr;
+                if (sscanf(packet + 1, "%x", &addr) == 1) {
+                    set_register(REG_PC, addr);
+                }
+                running = 1;
+                *steps = packet[0] == 's' ? 1 : 0;
+                return packet[0] == 's' ? STEPS_SET : NONE;
+            }
+
+            case 'D':
+                send_packet("OK");
+                disconnect();
+                return NONE;
+
+            case 'k':
+                disconnect();
+                return QUIT;
+        }
+
+        if (!send_packet(reply)) {
+            disconnect();
+            return NONE;
+        }
+    }
+}
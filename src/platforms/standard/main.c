@@ -1,7 +1,26 @@
 #include "../../core/emu.h"
+#include "../../core/graphics.h"
+#include "../../core/render_thread.h"
 #include "../../core/serial_io.h"
+#include "../../core/mmu/sram_map.h"
+#include "../../core/mmu/rom_map.h"
+#include "../../core/mmu/rom_cache.h"
+#include "../../core/mmu/rtc.h"
+#include "../../core/cheats.h"
+#include "../../core/profiler.h"
+#include "../../core/symbols.h"
+#include "../../core/instrument.h"
+#include "../../core/trace.h"
+#include "../../core/code_logger.h"
+#include "../../core/movie.h"
+#include "../../core/input.h"
 #include "../../non_core/menu.h"
 #include "../../non_core/logger.h"
+#include "../../non_core/filters.h"
+#include "../../non_core/framerate.h"
+#include "../../non_core/shm_output.h"
+#include "../../non_core/recorder.h"
+#include "../../non_core/gdb_stub.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -23,8 +42,35 @@ ClientOrServer getConnection(char *arg) {
 void print_help(char **argv) {
     printf("Usage: %s [options] rom_file\n", argv[0]);
     printf(" -debug \t\t\t start emulator in debug mode\n");
+    printf(" -gdb[=port] \t\t\t debug with gdb over TCP on localhost, port %d by default\n", GDB_DEFAULT_PORT);
     printf(" -dmg   \t\t\t run emulator in dot matrix mode instead of color mode\n");
     printf(" -connect=client/server  \t run emulator as client or server mode for linking\n");
+    printf(" -frameskip=n \t\t\t only render 1 in every n + 1 frames\n");
+    printf(" -autoskip \t\t\t skip rendering frames when running behind real time\n");
+    printf(" -threaded \t\t\t render frames on a separate thread\n");
+    printf(" -vsync \t\t\t sync the screen to the display refresh\n");
+    printf(" -filter=name \t\t\t scale the screen with scale2x, scale3x, scale4x, xbr, lcd or scanlines\n");
+    printf(" -filterthreads=n \t\t split filtering across n threads\n");
+    printf(" -shm=name \t\t\t publish video and audio to shared memory /name_video and /name_audio\n");
+    printf(" -record=name \t\t\t record video and sound losslessly to name.raw and name.wav\n");
+    printf(" -mmapsave \t\t\t map the save file into memory instead of rewriting it\n");
+    printf(" -mmaprom \t\t\t map the ROM file into memory instead of reading it\n");
+    printf(" -mmaprom=populate \t\t map the ROM file and page it all in up front\n");
+    printf(" -rompaging=n \t\t\t read ROM banks in as needed, keeping at most n in memory\n");
+    printf(" -rtc=host/emulated \t\t run cartridge clocks off the system clock or emulated time\n");
+    printf(" -pollline=n \t\t\t poll the keys when LY reaches line n, %d (start of V-Blank) by default\n", INPUT_POLL_LINE);
+    printf(" -cheat=code \t\t\t apply a Game Genie or GameShark code, can be repeated\n");
+    printf(" -profile=file \t\t\t sample the game's call stacks, writing them for flamegraph.pl on exit\n");
+    printf(" -profileinterval=n \t\t take a profile sample every n cycles, %d by default\n", PROFILE_DEFAULT_INTERVAL);
+    printf(" -sym=file \t\t\t name profiled code with labels from an RGBDS or no$gmb .sym file\n");
+    printf(" -trace=file \t\t\t write a binary trace of every instruction run, see trace_diff\n");
+    printf(" -tracelast=n \t\t\t only trace the last n instructions before a break, unknown opcode or crash\n");
+    printf(" -cdl=name \t\t\t log code and data accesses to ROM and cartridge RAM, writing name.cdl and name.heatmap\n");
+    printf(" -movie=file \t\t\t record the keys pressed each frame to an input movie\n");
+    printf(" -replay=file \t\t\t play back an input movie, checking every frame matches\n");
+#ifdef INSTRUMENT
+    printf(" -zonetrace=file \t\t write a Chrome trace of the timed zones on exit\n");
+#endif
     printf(" -h     \t\t\t display this help and exit\n");
     exit(0);
 }
@@ -34,6 +80,25 @@ int main(int argc, char* argv[]) {
     int debug = 0;
     char *file_name = NULL;
     int dmg_mode = 0;
+    int frame_skip = 0;
+    int auto_frame_skip = 0;
+    int threaded = 0;
+    int filter_threads = 1;
+    char *shm_name = NULL;
+    char *record_name = NULL;
+    int gdb_port = 0;
+    char *cheat_codes[MAX_CHEATS * 2];
+    int cheat_count = 0;
+    char *profile_name = NULL;
+    unsigned profile_interval = PROFILE_DEFAULT_INTERVAL;
+    char *sym_name = NULL;
+    char *zone_trace_name = NULL;
+    char *trace_name = NULL;
+    unsigned long trace_last = 0;
+    char *cdl_name = NULL;
+    char *movie_name = NULL;
+    Movie_Mode movie = MOVIE_OFF;
+    unsigned poll_line = INPUT_POLL_LINE;
     ClientOrServer cs = NO_CONNECT;
     prog_name = argv[0];   
     
@@ -61,6 +126,13 @@ int main(int argc, char* argv[]) {
 
             if (strcmp(argv[i], "-debug") == 0) {debug = 1;}
             else if (strcmp(argv[i], "-dmg") == 0) {dmg_mode = 1;}
+            else if (strcmp(argv[i], "-gdb") == 0) {debug = 1; gdb_port = GDB_DEFAULT_PORT;}
+            else if (strcmp(argv[i], "-autoskip") == 0) {auto_frame_skip = 1;}
+            else if (strcmp(argv[i], "-threaded") == 0) {threaded = 1;}
+            else if (strcmp(argv[i], "-vsync") == 0) {vsync = 1;}
+            else if (strcmp(argv[i], "-mmapsave") == 0) {set_SRAM_mapping(1);}
+            else if (strcmp(argv[i], "-mmaprom") == 0) {set_rom_mapping(1, 0);}
+            else if (strcmp(argv[i], "-mmaprom=populate") == 0) {set_rom_mapping(1, 1);}
             else if (strcmp(argv[i], "-h") == 0) {print_help(argv);}
             else if (strcmp(argv[i], "-help") == 0) {print_help(argv);}
             else if (strncmp(argv[i], "-connect=", strlen("-connect=")) == 0) {
@@ -69,6 +141,118 @@ int main(int argc, char* argv[]) {
                     ARG_ERR;
                 }
             }
+            else if (strncmp(argv[i], "-filter=", strlen("-filter=")) == 0) {
+                int filter = filter_from_name(argv[i] + strlen("-filter="));
+                if (filter < 0) {
+                    ARG_ERR;
+                }
+                set_filter(filter);
+            }
+            else if (strncmp(argv[i], "-filterthreads=", strlen("-filterthreads=")) == 0) {
+                if (sscanf(argv[i] + strlen("-filterthreads="), "%d", &filter_threads) != 1 || filter_threads < 1) {
+                    ARG_ERR;
+                }
+            }
+            else if (strncmp(argv[i], "-shm=", strlen("-shm=")) == 0) {
+                shm_name = argv[i] + strlen("-shm=");
+                if (*shm_name == '\0') {
+                    ARG_ERR;
+                }
+            }
+            else if (strncmp(argv[i], "-record=", strlen("-record=")) == 0) {
+                record_name = argv[i] + strlen("-record=");
+                if (*record_name == '\0') {
+                    ARG_ERR;
+                }
+            }
+            else if (strcmp(argv[i], "-rtc=host") == 0) {set_rtc_mode(RTC_HOST_TIME);}
+            else if (strcmp(argv[i], "-rtc=emulated") == 0) {set_rtc_mode(RTC_EMULATED_TIME);}
+            else if (strncmp(argv[i], "-gdb=", strlen("-gdb=")) == 0) {
+                if (sscanf(argv[i] + strlen("-gdb="), "%d", &gdb_port) != 1 || gdb_port <= 0 || gdb_port > 0xFFFF) {
+                    ARG_ERR;
+                }
+                debug = 1;
+            }
+            else if (strncmp(argv[i], "-cheat=", strlen("-cheat=")) == 0) {
+                if (cheat_count == MAX_CHEATS * 2) {
+                    ARG_ERR;
+                }
+                cheat_codes[cheat_count++] = argv[i] + strlen("-cheat=");
+            }
+            else if (strncmp(argv[i], "-profile=", strlen("-profile=")) == 0) {
+                profile_name = argv[i] + strlen("-profile=");
+                if (*profile_name == '\0') {
+                    ARG_ERR;
+                }
+            }
+            else if (strncmp(argv[i], "-profileinterval=", strlen("-profileinterval=")) == 0) {
+                if (sscanf(argv[i] + strlen("-profileinterval="), "%u", &profile_interval) != 1 || profile_interval == 0) {
+                    ARG_ERR;
+                }
+            }
+            else if (strncmp(argv[i], "-sym=", strlen("-sym=")) == 0) {
+                sym_name = argv[i] + strlen("-sym=");
+                if (*sym_name == '\0') {
+                    ARG_ERR;
+                }
+            }
+            else if (strncmp(argv[i], "-trace=", strlen("-trace=")) == 0) {
+                trace_name = argv[i] + strlen("-trace=");
+                if (*trace_name == '\0') {
+                    ARG_ERR;
+                }
+            }
+            else if (strncmp(argv[i], "-cdl=", strlen("-cdl=")) == 0) {
+                cdl_name = argv[i] + strlen("-cdl=");
+                if (*cdl_name == '\0') {
+                    ARG_ERR;
+                }
+            }
+            else if (strncmp(argv[i], "-movie=", strlen("-movie=")) == 0) {
+                movie_name = argv[i] + strlen("-movie=");
+                if (*movie_name == '\0' || movie != MOVIE_OFF) {
+                    ARG_ERR;
+                }
+                movie = MOVIE_RECORDING;
+            }
+            else if (strncmp(argv[i], "-replay=", strlen("-replay=")) == 0) {
+                movie_name = argv[i] + strlen("-replay=");
+                if (*movie_name == '\0' || movie != MOVIE_OFF) {
+                    ARG_ERR;
+                }
+                movie = MOVIE_PLAYING;
+            }
+            else if (strncmp(argv[i], "-tracelast=", strlen("-tracelast=")) == 0) {
+                if (sscanf(argv[i] + strlen("-tracelast="), "%lu", &trace_last) != 1 || trace_last == 0) {
+                    ARG_ERR;
+                }
+            }
+#ifdef INSTRUMENT
+            else if (strncmp(argv[i], "-zonetrace=", strlen("-zonetrace=")) == 0) {
+                zone_trace_name = argv[i] + strlen("-zonetrace=");
+                if (*zone_trace_name == '\0') {
+                    ARG_ERR;
+                }
+            }
+#endif
+            else if (strncmp(argv[i], "-rompaging=", strlen("-rompaging=")) == 0) {
+                unsigned cache_banks;
+                if (sscanf(argv[i] + strlen("-rompaging="), "%u", &cache_banks) != 1 ||
+                        !set_rom_paging(cache_banks)) {
+                    ARG_ERR;
+                }
+            }
+            else if (strncmp(argv[i], "-pollline=", strlen("-pollline=")) == 0) {
+                if (sscanf(argv[i] + strlen("-pollline="), "%u", &poll_line) != 1 ||
+                        !set_input_poll_line(poll_line)) {
+                    ARG_ERR;
+                }
+            }
+            else if (strncmp(argv[i], "-frameskip=", strlen("-frameskip=")) == 0) {
+                if (sscanf(argv[i] + strlen("-frameskip="), "%d", &frame_skip) != 1 || frame_skip < 0) {
+                    ARG_ERR;
+                }
+            }
             else {ARG_ERR;}
 
         } else if(i != argc - 1) {
@@ -76,13 +260,88 @@ int main(int argc, char* argv[]) {
         }
     }
 
+    // -tracelast only says how much of a trace to keep
+    if (trace_last && !trace_name) {
+        ARG_ERR;
+    }
+    // Neither cheats, links nor the poll line are recorded in movies
+    if (movie != MOVIE_OFF && (cheat_count || cs != NO_CONNECT || poll_line != INPUT_POLL_LINE)) {
+        ARG_ERR;
+    }
+
     file_name = argv[argc - 1];
+    set_filter_threads(filter_threads);
     
+    if (shm_name && !shm_output_open(shm_name)) {
+        return 1;
+    }
+
+    // Movies are played back in the mode they were recorded in
+    if (movie != MOVIE_OFF && !open_movie(movie_name, movie, &dmg_mode)) {
+        shm_output_close();
+        return 1;
+    }
+
     if (!init_emu(file_name, debug, dmg_mode, cs)) {
+        shm_output_close();
+        return 1;
+    }
+
+    if (movie != MOVIE_OFF && !start_movie()) {
+        stop_movie();
+        shm_output_close();
         return 1;
     }
+
+    // Patches are made to the loaded ROM
+    for (int i = 0; i < cheat_count; i++) {
+        add_cheat(cheat_codes[i]);
+    }
+
+    if (gdb_port && !gdb_stub_open(gdb_port)) {
+        shm_output_close();
+        return 1;
+    }
+
+    set_frame_skip(frame_skip);
+    set_auto_frame_skip(auto_frame_skip);
+    if (threaded) {
+        set_threaded_render(1);
+    }
+    if (record_name) {
+        start_recording(record_name);
+    }
+    if (sym_name) {
+        load_symbols(sym_name);
+    }
+    if (profile_name) {
+        start_profiling(profile_interval);
+    }
+    if (!instrument_open(zone_trace_name)) {
+        shm_output_close();
+        return 1;
+    }
+    if (cdl_name && !start_code_logging()) {
+        shm_output_close();
+        return 1;
+    }
+    if (trace_name) {
+        if (!start_trace(trace_name, trace_last)) {
+            shm_output_close();
+            return 1;
+        }
+    }
         
     run();
-    return 0;
+    int movie_ok = stop_movie();
+    stop_trace();
+    stop_code_logging(cdl_name);
+    instrument_close();
+    stop_profiling(profile_name);
+    clear_symbols();
+    gdb_stub_close();
+    stop_recording();
+    shm_output_close();
+    return movie_ok ? 0 : 1;
 }
 
@@ -11,6 +11,7 @@
 #include "../../non_core/logger.h"
 
 int limiter = 1;
+int vsync = 0; // Not supported
 
 #ifndef EMSCRIPTEN
 static uint64_t last_ticks;
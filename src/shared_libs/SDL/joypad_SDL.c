@@ -30,53 +30,37 @@ void init_joypad() {
 }
 
 #ifdef PSP
-int down_pressed()   { return keys[DOWN]; }  
-int up_pressed()     { return keys[UP]; }
-int left_pressed()   { return keys[LEFT]; }
-int right_pressed()  { return keys[RIGHT]; } 
-int a_pressed()      { return keys[CROSS]; }
-int b_pressed()      { return keys[CIRCLE]; }
-int start_pressed()  { return keys[START]; }
-int select_pressed() { return keys[SELECT]; } 
+static int const key_codes[] = {RIGHT, LEFT, UP, DOWN, CROSS, CIRCLE, SELECT, START};
 
 #elif defined(THREE_DS)
-int down_pressed()   { return keys[SDLK_DOWN];  }  
-int up_pressed()     { return keys[SDLK_UP]; }
-int left_pressed()   { return keys[SDLK_LEFT];}
-int right_pressed()  { return keys[SDLK_RIGHT];} 
-int a_pressed()      { return keys[SDLK_a]; }
-int b_pressed()      { return keys[SDLK_b];}
-int start_pressed()  { return keys[SDLK_RETURN]; }
-int select_pressed() { return keys[SDLK_ESCAPE]; } 
+static int const key_codes[] = {SDLK_RIGHT, SDLK_LEFT, SDLK_UP, SDLK_DOWN, SDLK_a, SDLK_b, SDLK_ESCAPE, SDLK_RETURN};
 
 #else 
-/* Check each individual GameBoy key. Returns 1 if
- * the specified key is being held down, 0 otherwise */
-int down_pressed()   { return keys[SDLK_DOWN];  }  
-int up_pressed()     { return keys[SDLK_UP]; }
-int left_pressed()   { return keys[SDLK_LEFT];}
-int right_pressed()  { return keys[SDLK_RIGHT];} 
-int a_pressed()      { return keys[SDLK_a]; }
-int b_pressed()      { return keys[SDLK_s];}
-int start_pressed()  { return keys[SDLK_RETURN]; }
-int select_pressed() { return keys[SDLK_SPACE]; } 
+// Keys for right, left, up, down, A, B, select and start in key mask order
+static int const key_codes[] = {SDLK_RIGHT, SDLK_LEFT, SDLK_UP, SDLK_DOWN, SDLK_a, SDLK_s, SDLK_SPACE, SDLK_RETURN};
 #endif
 
 
-/* Returns 1 if any of the 8 GameBoy keys are being held down,
- * 0 otherwise */
-int key_pressed() {
+/* State of the 8 GameBoy keys as a key mask, a bit
+ * set for each key being held down */
+uint8_t joypad_keys() {
 
-    return down_pressed() || up_pressed() || left_pressed() || right_pressed()
-    || a_pressed() || b_pressed() || start_pressed() || select_pressed();
+    uint8_t mask = 0;
+    for (int i = 0; i < 8; i++) {
+        if (keys[key_codes[i]]) {
+            mask |= 1 << i;
+        }
+    }
+    return mask;
 }
 
 
 /* Update current state of GameBoy keys as well as control
- * other external actions for the emulator */
+ * other external actions for the emulator. Handles every event
+ * queued since the last poll, which happens once a frame */
 int update_keys() {
         SDL_Event event;
-        if (SDL_PollEvent(&event)) {
+        while (SDL_PollEvent(&event)) {
             switch (event.type) {
                     // exit if the window is closed
                 case SDL_QUIT:
@@ -23,12 +23,24 @@
 
 #include "../../../non_core/menu.h"
 #include "../../../non_core/filebrowser.h"
+#include "../../../non_core/rom_library.h"
 #include "../../../non_core/logger.h"
 
 #ifndef PATH_MAX
 #define PATH_MAX 4096
 #endif
 
+#if defined(PSVITA)
+#define ROM_LIBRARY_INDEX "ux0:data/Plutoboy/rom_library.idx"
+#elif defined(__SWITCH__)
+#define ROM_LIBRARY_INDEX "/switch/Plutoboy/rom_library.idx"
+#else
+#define ROM_LIBRARY_INDEX "rom_library.idx"
+#endif
+
+// Minimum time between redraws as ROM headers are scanned
+#define LIBRARY_REFRESH_MS 250
+
 #ifdef __SWITCH__
 #include <switch.h>
 
@@ -94,9 +106,12 @@ typedef struct {
 } platform_config;
 
 
+// Textures are only rendered once their row is visible
 typedef struct {
     SDL_Texture **textures;
+    library_state_t *states; // Library state each texture was rendered with
     uint32_t count;
+    TTF_Font *font;
 } dir_fname_textures_t;
 
 typedef struct {
@@ -448,12 +463,20 @@ void free_dir_fname_textures(dir_fname_textures_t *textures)
 {
     if (textures != NULL)
     {
-        for (uint32_t i = 0; i < textures->count; i++)
+        for (uint32_t i = 0; i < textures->count && textures->textures != NULL; i++)
         {
-            SDL_DestroyTexture(textures->textures[i]);
+            if (textures->textures[i] != NULL)
+            {
+                SDL_DestroyTexture(textures->textures[i]);
+            }
         }
 
         free(textures->textures);
+        free(textures->states);
+        if (textures->font != NULL)
+        {
+            TTF_CloseFont(textures->font);
+        }
     }
 
     free(textures);
@@ -504,42 +527,119 @@ dir_fname_textures_t *get_directory_file_text_textures(SDL_Renderer *renderer, p
     if (fname_textures == NULL)
     {
         log_message(LOG_ERROR, "Failed to allocate fname textures\n");
+        TTF_CloseFont(font);
         return NULL;
     }
+    fname_textures->font = font;
 
-    fname_textures->textures = calloc(dir->entry_count, sizeof(SDL_Texture*));
-    if (fname_textures->textures == NULL) 
+    // Room for every entry, but nothing is rendered until it's on screen
+    uint32_t slots = dir->entry_count ? dir->entry_count : 1;
+    fname_textures->textures = calloc(slots, sizeof(SDL_Texture*));
+    fname_textures->states = calloc(slots, sizeof(library_state_t));
+    if (fname_textures->textures == NULL || fname_textures->states == NULL) 
     {
         log_message(LOG_ERROR, "Failed to allocate texture storage\n");
         goto err;
     }
+    fname_textures->count = dir->entry_count;
+	
+    return fname_textures;
+
+    err:
+        free_dir_fname_textures(fname_textures);
+        return NULL;
+}
+
+
+/* Gets the texture for the given entry, rendering it if this is the first
+ * time it's visible or its ROM header has been scanned since */
+static SDL_Texture *get_fname_texture(context_t *context, uint32_t i)
+{
+    dir_fname_textures_t *fname_textures = context->fname_textures;
+    dir_entry_t *entry = &context->dir->entries[i];
+    rom_header_info info;
+
+    library_state_t state = rom_library_get(i, &info);
+    if (fname_textures->textures[i] != NULL)
+    {
+        if (fname_textures->states[i] == state)
+        {
+            return fname_textures->textures[i];
+        }
+        SDL_DestroyTexture(fname_textures->textures[i]);
+        fname_textures->textures[i] = NULL;
+    }
 
     SDL_Color text_color = {.r=0xFF, .g=0xFF, .b=0xFF, .a=0xff};
     SDL_Color dir_text_color  = {.r=DIR_COLOR_RED, .g=DIR_COLOR_BLUE, .b=DIR_COLOR_GREEN, .a=0xFF};;
+    SDL_Color color = entry->is_dir ? dir_text_color : text_color;
 
-    for (uint32_t i = 0; i < dir->entry_count; i++)
+    // Scanned ROMs also show their internal title
+    char label[PATH_MAX];
+    if (state == LIBRARY_ROM && info.title[0] != '\0')
     {
-       SDL_Color color = dir->entries[i].is_dir ? dir_text_color : text_color;
-       SDL_Surface *text_surface = TTF_RenderText_Solid(font, dir->entries[i].name, color); 
-       log_message(LOG_INFO, "text surface %p, %s\n", text_surface, dir->entries[i].name);
-       fname_textures->textures[i] = SDL_CreateTextureFromSurface(renderer, text_surface);
-       SDL_FreeSurface(text_surface);
-       if (fname_textures->textures[i] == NULL)
-       {
-           log_message(LOG_ERROR, "Failed to get file name texture from surface\n");
-           goto err;
-       }
-       fname_textures->count++;
+        snprintf(label, sizeof(label), "%s  [%s]", entry->name, info.title);
+    }
+    else
+    {
+        snprintf(label, sizeof(label), "%s", entry->name);
     }
-	
-	TTF_CloseFont(font);
-	
-    return fname_textures;
 
-    err:
-		TTF_CloseFont(font);
-        free_dir_fname_textures(fname_textures);
+    SDL_Surface *text_surface = TTF_RenderText_Solid(fname_textures->font, label, color); 
+    if (text_surface == NULL)
+    {
+        log_message(LOG_ERROR, "Failed to render file name %s\n", entry->name);
         return NULL;
+    }
+    fname_textures->textures[i] = SDL_CreateTextureFromSurface(context->renderer, text_surface);
+    fname_textures->states[i] = state;
+    SDL_FreeSurface(text_surface);
+    if (fname_textures->textures[i] == NULL)
+    {
+        log_message(LOG_ERROR, "Failed to get file name texture from surface\n");
+    }
+    return fname_textures->textures[i];
+}
+
+
+// Shows the header info of the highlighted ROM in the bottom banner
+static void draw_rom_details(context_t *context)
+{
+    platform_config *config = context->config;
+    rom_header_info info;
+
+    if (rom_library_get(context->current_highlighted, &info) != LIBRARY_ROM)
+    {
+        return;
+    }
+
+    const char *type = cartridge_type_name(info.cartridge_type);
+    const char *system = info.cgb_flag == 0xC0 ? "CGB only" :
+                         info.cgb_flag == 0x80 ? "CGB" : "DMG";
+    char details[128];
+    snprintf(details, sizeof(details), "%s  %s  %s  %04X%s", info.title,
+        type != NULL ? type : "Unknown cartridge", system, info.global_checksum,
+        info.header_checksum_ok ? "" : "  (bad header checksum)");
+
+    SDL_Color text_color = {.r=0xFF, .g=0xFF, .b=0xFF, .a=0xff};
+    SDL_Surface *text_surface = TTF_RenderText_Solid(context->fname_textures->font, details, text_color);
+    if (text_surface == NULL)
+    {
+        return;
+    }
+
+    SDL_Texture *texture = SDL_CreateTextureFromSurface(context->renderer, text_surface);
+    uint32_t banner_height = config->screen_height / config->banner_height_percentage;
+    SDL_Rect rect = {config->text_x_start,
+        config->screen_height - banner_height + (int)(banner_height - text_surface->h) / 2,
+        text_surface->w, text_surface->h};
+    SDL_FreeSurface(text_surface);
+
+    if (texture != NULL)
+    {
+        SDL_RenderCopy(context->renderer, texture, NULL, &rect);
+        SDL_DestroyTexture(texture);
+    }
 }
 
 
@@ -567,7 +667,12 @@ void redraw_filenames(context_t *context)
         int width = 0;
         int height = 0;
         
-        SDL_QueryTexture(context->fname_textures->textures[i], NULL, NULL, &width, &height);
+        SDL_Texture *texture = get_fname_texture(context, i);
+        if (texture == NULL)
+        {
+            continue;
+        }
+        SDL_QueryTexture(texture, NULL, NULL, &width, &height);
         uint32_t start_tx = config->text_x_start;
         uint32_t start_ty = config->text_y_start + (config->text_y_spacing * (i - context->scroll_offset));
         
@@ -577,7 +682,7 @@ void redraw_filenames(context_t *context)
         }
 
         SDL_Rect rect = {start_tx, start_ty, width, height};
-        SDL_RenderCopy(renderer, context->fname_textures->textures[i], NULL, &rect);
+        SDL_RenderCopy(renderer, texture, NULL, &rect);
     }
 }
 
@@ -600,6 +705,7 @@ void redraw_screen(context_t *context)
     SDL_RenderFillRect(renderer, &highlight); 
       
     redraw_filenames(context);
+    draw_rom_details(context);
         
 
     // Get Boxart of new selected file
@@ -691,6 +797,7 @@ void navigation(context_t *context, navigate_option_t navigate_option)
             context->dir = new_dir;
             context->current_highlighted = 0;
             context->scroll_offset = 0;
+            rom_library_scan(new_dir);
 
             redraw_screen(context);
 
@@ -913,6 +1020,7 @@ int ui_menu(char **selected_path, int *ret_val) {
     draw_bottom_banner(renderer, &config);
 
     log_message(LOG_INFO, "about to draw boxart\n");
+    rom_library_open(ROM_LIBRARY_INDEX);
 #if defined(PSVITA)
     dir_t *dir = get_dir("ux0:data/Plutoboy");
 #elif defined(__SWITCH__)
@@ -941,6 +1049,7 @@ int ui_menu(char **selected_path, int *ret_val) {
     if (dir == NULL)
     {
         log_message(LOG_ERROR, "Failed to get current dir\n");
+        rom_library_close();
         return -1;
     }
 
@@ -949,29 +1058,9 @@ int ui_menu(char **selected_path, int *ret_val) {
     if (fname_textures == NULL)
     {
 		log_message(LOG_ERROR, "Failed to get directiory file textures\n");
+        rom_library_close();
         return -1;
     }
-	
-    Uint32 banner_height = config.screen_height / config.banner_height_percentage;
-    
-    log_message(LOG_INFO, "fnames: %d\n", fname_textures->count);
-    for (uint32_t i = 0; i < fname_textures->count; i++)
-    {
-        int width = 0;
-        int height = 0;
-        
-        SDL_QueryTexture(fname_textures->textures[i], NULL, NULL, &width, &height);
-        uint32_t start_tx = config.text_x_start;
-        uint32_t start_ty = config.text_y_start + (config.text_y_spacing * i);
-        
-        if (start_ty + height >= config.screen_height - banner_height)
-        {
-            break;
-        }
-
-        SDL_Rect rect = {start_tx, start_ty, width, height};
-        SDL_RenderCopy(renderer, fname_textures->textures[i], NULL, &rect);
-    }
     
     SDL_Rect render_rect = {0, 0, config.screen_width, config.screen_height};
 
@@ -985,6 +1074,9 @@ int ui_menu(char **selected_path, int *ret_val) {
     context.scroll_offset = 0;
     context.selected_rom_path = 0;
 
+    rom_library_scan(dir);
+    redraw_filenames(&context);
+
 #if defined(__SWITCH__)    
 	for (int i = 0; i < 2; i++) {
         if (SDL_JoystickOpen(i) == NULL) {
@@ -1015,8 +1107,20 @@ int ui_menu(char **selected_path, int *ret_val) {
 
     int quit = 0;
     SDL_Event e;
+    Uint32 last_refresh = SDL_GetTicks();
     while (!quit && context.selected_rom_path == NULL)
     {
+        // Pick up newly scanned ROM headers
+        Uint32 now = SDL_GetTicks();
+        if (now - last_refresh >= LIBRARY_REFRESH_MS)
+        {
+            last_refresh = now;
+            if (rom_library_changed())
+            {
+                redraw_screen(&context);
+            }
+        }
+
         while(SDL_PollEvent(&e)) {
             switch (e.type)
             {
@@ -1107,6 +1211,7 @@ int ui_menu(char **selected_path, int *ret_val) {
     }
 
 
+    rom_library_close();
     free_dir_fname_textures(context.fname_textures);
     free_dir(context.dir);
     SDL_DestroyTexture(context.screen_texture);
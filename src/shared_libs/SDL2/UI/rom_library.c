@@ -0,0 +1,513 @@
+#if defined(_MSC_VER) || defined(__ANDROID__)
+#include "SDL.h"
+#else
+#include <SDL2/SDL.h>
+#endif
+
+#include "../../../non_core/rom_library.h"
+#include "../../../non_core/logger.h"
+#include "../../../core/rom_archive.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#ifndef PATH_MAX
+#define PATH_MAX 4096
+#endif
+
+#define INDEX_HEADER "PLUTOBOY ROM INDEX 1\n"
+#define INDEX_START_CAPACITY 1024
+#define MAX_SCAN_THREADS 4
+
+typedef struct {
+    char *path;
+    unsigned long long size;
+    long long mtime;
+    int is_rom;
+    rom_header_info info;
+} index_entry_t;
+
+typedef struct {
+    SDL_atomic_t state;
+    rom_header_info info;
+} scan_result_t;
+
+// Open addressed hash table of index entries, keyed by path
+static index_entry_t *index_table = NULL;
+static uint32_t index_capacity = 0;
+static uint32_t index_count = 0;
+static int index_dirty = 0;
+static char *index_file_path = NULL;
+static SDL_mutex *index_lock = NULL;
+
+// Inflating keeps static state, so only one archive can be read at a time
+static SDL_mutex *archive_lock = NULL;
+
+static const dir_t *scan_dir = NULL;
+static scan_result_t *scan_results = NULL;
+static SDL_Thread *scan_threads[MAX_SCAN_THREADS];
+static int scan_thread_count = 0;
+static SDL_atomic_t next_entry;
+static SDL_atomic_t workers_running;
+static SDL_mutex *start_lock = NULL; // Held while scan threads are created and counted
+static SDL_atomic_t cancel_scan;
+static SDL_atomic_t library_changed;
+
+
+static uint32_t hash_path(const char *path)
+{
+    uint32_t hash = 2166136261u;
+    while (*path)
+    {
+        hash = (hash ^ (uint8_t)*path++) * 16777619u;
+    }
+    return hash;
+}
+
+
+// Returns the slot holding path, or the empty slot it would go in
+static index_entry_t *find_slot(index_entry_t *table, uint32_t capacity, const char *path)
+{
+    uint32_t i = hash_path(path) & (capacity - 1);
+    while (table[i].path != NULL && strcmp(table[i].path, path) != 0)
+    {
+        i = (i + 1) & (capacity - 1);
+    }
+    return &table[i];
+}
+
+
+static int grow_index(void)
+{
+    uint32_t capacity = index_capacity ? index_capacity * 2 : INDEX_START_CAPACITY;
+    index_entry_t *table = calloc(capacity, sizeof(index_entry_t));
+    if (table == NULL)
+    {
+        return 0;
+    }
+
+    for (uint32_t i = 0; i < index_capacity; i++)
+    {
+        if (index_table[i].path != NULL)
+        {
+            *find_slot(table, capacity, index_table[i].path) = index_table[i];
+        }
+    }
+
+    free(index_table);
+    index_table = table;
+    index_capacity = capacity;
+    return 1;
+}
+
+
+// Adds or replaces the entry for path, index_lock must be held
+static void put_index_entry(const char *path, unsigned long long size, long long mtime,
+                            int is_rom, const rom_header_info *info)
+{
+    if ((index_count + 1) * 4 >= index_capacity * 3 && !grow_index())
+    {
+        return;
+    }
+
+    index_entry_t *entry = find_slot(index_table, index_capacity, path);
+    if (entry->path == NULL)
+    {
+        entry->path = strdup(path);
+        if (entry->path == NULL)
+        {
+            return;
+        }
+        index_count++;
+    }
+
+    entry->size = size;
+    entry->mtime = mtime;
+    entry->is_rom = is_rom;
+    entry->info = *info;
+}
+
+
+static int load_index(const char * const index_path)
+{
+    FILE *file = fopen(index_path, "r");
+    if (file == NULL)
+    {
+        return 0;
+    }
+
+    static char line[PATH_MAX + 128];
+    if (fgets(line, sizeof(line), file) == NULL || strcmp(line, INDEX_HEADER) != 0)
+    {
+        log_message(LOG_WARN, "Ignoring unrecognised ROM index %s\n", index_path);
+        fclose(file);
+        return 0;
+    }
+
+    // size mtime is_rom cgb_flag type checksum_ok global_checksum title\tpath
+    while (fgets(line, sizeof(line), file) != NULL)
+    {
+        unsigned long long size;
+        long long mtime;
+        int is_rom, checksum_ok, offset;
+        unsigned cgb_flag, type, global_checksum;
+        rom_header_info info;
+
+        if (sscanf(line, "%llu %lld %d %x %x %d %x%n", &size, &mtime, &is_rom,
+                   &cgb_flag, &type, &checksum_ok, &global_checksum, &offset) != 7 ||
+            line[offset] != ' ')
+        {
+            continue;
+        }
+
+        char *title = line + offset + 1;
+        char *path = strchr(title, '\t');
+        if (path == NULL || path - title > ROM_TITLE_LENGTH)
+        {
+            continue;
+        }
+        *path++ = '\0';
+        path[strcspn(path, "\n")] = '\0';
+
+        strcpy(info.title, title);
+        info.cgb_flag = cgb_flag;
+        info.cartridge_type = type;
+        info.header_checksum_ok = checksum_ok;
+        info.global_checksum = global_checksum;
+        put_index_entry(path, size, mtime, is_rom, &info);
+    }
+
+    fclose(file);
+    log_message(LOG_INFO, "Loaded %u entries from ROM index\n", index_count);
+    return 1;
+}
+
+
+// Writes the index out to a temporary file then replaces the old one
+static void save_index(void)
+{
+    SDL_LockMutex(index_lock);
+    if (!index_dirty)
+    {
+        SDL_UnlockMutex(index_lock);
+        return;
+    }
+
+    char tmp_path[PATH_MAX];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", index_file_path);
+    FILE *file = fopen(tmp_path, "w");
+    int ok = file != NULL && fputs(INDEX_HEADER, file) >= 0;
+
+    for (uint32_t i = 0; ok && i < index_capacity; i++)
+    {
+        index_entry_t *entry = &index_table[i];
+        if (entry->path != NULL)
+        {
+            ok = fprintf(file, "%llu %lld %d %02x %02x %d %04x %s\t%s\n",
+                entry->size, entry->mtime, entry->is_rom, entry->info.cgb_flag,
+                entry->info.cartridge_type, entry->info.header_checksum_ok,
+                entry->info.global_checksum, entry->info.title, entry->path) > 0;
+        }
+    }
+
+    if (file != NULL && fclose(file) != 0)
+    {
+        ok = 0;
+    }
+
+#ifdef _WIN32
+    if (ok)
+    {
+        remove(index_file_path);
+    }
+#endif
+    if (ok && rename(tmp_path, index_file_path) == 0)
+    {
+        index_dirty = 0;
+    }
+    else
+    {
+        log_message(LOG_WARN, "Failed to save ROM index %s\n", index_file_path);
+        remove(tmp_path);
+    }
+
+    SDL_UnlockMutex(index_lock);
+}
+
+
+static int has_rom_extension(const char *name)
+{
+    static const char *extensions[] = {".gb", ".gbc", ".sgb", ".gz", ".zip"};
+
+    const char *ext = strrchr(name, '.');
+    if (ext == NULL)
+    {
+        return 0;
+    }
+
+    for (unsigned i = 0; i < sizeof(extensions) / sizeof(extensions[0]); i++)
+    {
+        const char *e = extensions[i];
+        const char *c = ext;
+        while (*c && *e && tolower((unsigned char)*c) == *e)
+        {
+            c++;
+            e++;
+        }
+        if (*c == '\0' && *e == '\0')
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+
+static int read_header(const char *path, uint8_t *header)
+{
+    if (is_rom_archive(path))
+    {
+        SDL_LockMutex(archive_lock);
+        unsigned long count = read_archive_header(path, header, ROM_HEADER_SIZE);
+        SDL_UnlockMutex(archive_lock);
+        return count == ROM_HEADER_SIZE;
+    }
+
+    FILE *file = fopen(path, "rb");
+    if (file == NULL)
+    {
+        return 0;
+    }
+    size_t count = fread(header, 1, ROM_HEADER_SIZE, file);
+    fclose(file);
+    return count == ROM_HEADER_SIZE;
+}
+
+
+// Fills in the result for the given entry, from the index if up to date
+static void scan_entry(uint32_t i)
+{
+    scan_result_t *result = &scan_results[i];
+    dir_entry_t *dir_entry = &scan_dir->entries[i];
+    char path[PATH_MAX];
+    struct stat path_stat;
+
+    if (dir_entry->is_dir || !has_rom_extension(dir_entry->name) ||
+        snprintf(path, sizeof(path), "%s/%s", scan_dir->path, dir_entry->name) >= (int)sizeof(path) ||
+        stat(path, &path_stat) != 0)
+    {
+        SDL_AtomicSet(&result->state, LIBRARY_NOT_ROM);
+        return;
+    }
+
+    unsigned long long size = path_stat.st_size;
+    long long mtime = path_stat.st_mtime;
+    int is_rom = -1;
+
+    SDL_LockMutex(index_lock);
+    index_entry_t *entry = find_slot(index_table, index_capacity, path);
+    if (entry->path != NULL && entry->size == size && entry->mtime == mtime)
+    {
+        is_rom = entry->is_rom;
+        result->info = entry->info;
+    }
+    SDL_UnlockMutex(index_lock);
+
+    if (is_rom < 0)
+    {
+        uint8_t header[ROM_HEADER_SIZE];
+        memset(&result->info, 0, sizeof(result->info));
+        is_rom = read_header(path, header);
+        if (is_rom)
+        {
+            parse_rom_header(header, &result->info);
+        }
+
+        SDL_LockMutex(index_lock);
+        put_index_entry(path, size, mtime, is_rom, &result->info);
+        index_dirty = 1;
+        SDL_UnlockMutex(index_lock);
+    }
+
+    SDL_AtomicSet(&result->state, is_rom ? LIBRARY_ROM : LIBRARY_NOT_ROM);
+    SDL_AtomicSet(&library_changed, 1);
+}
+
+
+static int scan_thread(void *data)
+{
+    (void)data;
+
+    // Wait until workers_running counts every thread that was created
+    SDL_LockMutex(start_lock);
+    SDL_UnlockMutex(start_lock);
+
+    while (!SDL_AtomicGet(&cancel_scan))
+    {
+        uint32_t i = SDL_AtomicAdd(&next_entry, 1);
+        if (i >= scan_dir->entry_count)
+        {
+            break;
+        }
+        scan_entry(i);
+    }
+
+    // Last one out saves what was found
+    if (SDL_AtomicDecRef(&workers_running))
+    {
+        save_index();
+    }
+    return 0;
+}
+
+
+static void stop_scan(void)
+{
+    SDL_AtomicSet(&cancel_scan, 1);
+    for (int i = 0; i < scan_thread_count; i++)
+    {
+        SDL_WaitThread(scan_threads[i], NULL);
+    }
+    scan_thread_count = 0;
+
+    free(scan_results);
+    scan_results = NULL;
+    scan_dir = NULL;
+}
+
+
+int rom_library_open(const char * const index_path)
+{
+    rom_library_close();
+
+    index_file_path = strdup(index_path);
+    index_lock = SDL_CreateMutex();
+    archive_lock = SDL_CreateMutex();
+    start_lock = SDL_CreateMutex();
+    if (index_file_path == NULL || index_lock == NULL || archive_lock == NULL ||
+        start_lock == NULL || !grow_index())
+    {
+        log_message(LOG_ERROR, "Failed to create ROM library\n");
+        rom_library_close();
+        return 0;
+    }
+
+    load_index(index_path);
+    return 1;
+}
+
+
+void rom_library_close(void)
+{
+    if (index_lock == NULL)
+    {
+        free(index_file_path);
+        index_file_path = NULL;
+        return;
+    }
+
+    stop_scan();
+    save_index();
+
+    for (uint32_t i = 0; i < index_capacity; i++)
+    {
+        free(index_table[i].path);
+    }
+    free(index_table);
+    index_table = NULL;
+    index_capacity = 0;
+    index_count = 0;
+
+    free(index_file_path);
+    index_file_path = NULL;
+    SDL_DestroyMutex(index_lock);
+    SDL_DestroyMutex(archive_lock);
+    SDL_DestroyMutex(start_lock);
+    index_lock = NULL;
+    archive_lock = NULL;
+    start_lock = NULL;
+}
+
+
+void rom_library_scan(const dir_t * const dir)
+{
+    if (index_lock == NULL)
+    {
+        return;
+    }
+
+    stop_scan();
+
+    // calloc leaves every entry as LIBRARY_PENDING
+    scan_results = calloc(dir->entry_count ? dir->entry_count : 1, sizeof(scan_result_t));
+    if (scan_results == NULL)
+    {
+        log_message(LOG_ERROR, "Failed to allocate ROM scan results\n");
+        return;
+    }
+    scan_dir = dir;
+
+    int thread_count = SDL_GetCPUCount();
+    if (thread_count > MAX_SCAN_THREADS)
+    {
+        thread_count = MAX_SCAN_THREADS;
+    }
+    else if (thread_count < 1)
+    {
+        thread_count = 1;
+    }
+
+    SDL_AtomicSet(&next_entry, 0);
+    SDL_AtomicSet(&cancel_scan, 0);
+
+    // Threads don't start scanning until they have all been counted
+    SDL_LockMutex(start_lock);
+    for (int i = 0; i < thread_count; i++)
+    {
+        scan_threads[scan_thread_count] = SDL_CreateThread(scan_thread, "rom_scan", NULL);
+        if (scan_threads[scan_thread_count] == NULL)
+        {
+            log_message(LOG_WARN, "Failed to create ROM scan thread\n");
+            continue;
+        }
+        scan_thread_count++;
+    }
+    SDL_AtomicSet(&workers_running, scan_thread_count);
+    SDL_UnlockMutex(start_lock);
+
+    // Without any threads, scanning would never finish
+    if (scan_thread_count == 0)
+    {
+        while ((uint32_t)SDL_AtomicGet(&next_entry) < dir->entry_count)
+        {
+            scan_entry(SDL_AtomicAdd(&next_entry, 1));
+        }
+        save_index();
+    }
+}
+
+
+library_state_t rom_library_get(uint32_t entry, rom_header_info *info)
+{
+    if (scan_results == NULL || entry >= scan_dir->entry_count)
+    {
+        return LIBRARY_NOT_ROM;
+    }
+
+    library_state_t state = SDL_AtomicGet(&scan_results[entry].state);
+    if (state == LIBRARY_ROM)
+    {
+        *info = scan_results[entry].info;
+    }
+    return state;
+}
+
+
+int rom_library_changed(void)
+{
+    return SDL_AtomicSet(&library_changed, 0);
+}
@@ -10,6 +10,8 @@
 #include <stdio.h>
 #include "stdlib.h"
 
+int vsync = 0;
+
 #ifndef EMSCRIPTEN
 static uint64_t last_ticks;
 static int framerate_times_ten;
@@ -108,11 +110,15 @@ void adjust_to_framerate() {
     uint64_t estimated_ticks = last_ticks + (uint64_t)(10000000/framerate_times_ten);
     uint64_t framerate_ticks = (ticks_elapsed * framerate_times_ten) / 10;
     
+    /* With vsync presenting has already waited for the display, only
+     * hold back if it's refreshing much faster than the Gameboy */
+    int vsync_paced = vsync && (framerate_ticks * 4 >= 3000000);
+
     // If too fast we sleep for a certain amount of time
     // sleep might go over the time we want to wait
     // so attempt to come out of sleep early and use 
     // cpu cycles to wait for the rest of the time
-    if (framerate_ticks < 1000000) {        
+    if (framerate_ticks < 1000000 && !vsync_paced) {        
 	    uint64_t delay_time = 10000000/(framerate_times_ten) - ticks_elapsed;
 	    if (delay_time >= 5000) {
 		    //casting uint64_t into uint32_t, not really safe
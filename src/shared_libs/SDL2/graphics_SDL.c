@@ -1,6 +1,10 @@
 #include "../../non_core/graphics_out.h"
 #include "../../non_core/logger.h"
 #include "../../non_core/joypad.h"
+#include "../../non_core/filters.h"
+#include "../../non_core/framerate.h"
+
+#include <stdlib.h>
 
 #ifdef __APPLE__
     #include "TargetConditionals.h"
@@ -22,6 +26,12 @@ static SDL_Renderer *renderer;
 static SDL_Texture *texture; 
 static Uint32 *pixels;
 
+/* Screen after software filtering, NULL if not filtering. Only used
+ * if the texture can't be locked to filter straight into it */
+static Uint32 *filtered_pixels;
+static int filtered_width;
+static int filtered_height;
+
 static SDL_Texture *overlay_t;
 
 static int screen_width;
@@ -79,6 +89,17 @@ int init_screen(int win_x, int win_y, uint32_t *p) {
 
     pixels = p;
 
+    int scale = filter_scale();
+    filtered_width = GB_PIXELS_X * scale;
+    filtered_height = GB_PIXELS_Y * scale;
+    if (get_filter() != FILTER_NONE) {
+        filtered_pixels = malloc(filtered_width * filtered_height * sizeof(Uint32));
+        if (filtered_pixels == NULL) {
+            log_message(LOG_ERROR, "Could not allocate filter buffer\n");
+            return 0;
+        }
+    }
+
     #ifndef PSVITA
 
     if((SDL_Init(SDL_INIT_VIDEO | SDL_INIT_JOYSTICK | SDL_INIT_GAMECONTROLLER/*| SDL_INIT_HAPTIC*/)==-1)) {
@@ -90,7 +111,7 @@ int init_screen(int win_x, int win_y, uint32_t *p) {
     screen = SDL_CreateWindow("Plutoboy", 
                    SDL_WINDOWPOS_UNDEFINED, 
                    SDL_WINDOWPOS_UNDEFINED,
-                   screen_width, screen_height, 
+                   screen_width * scale, screen_height * scale, 
                    0); 
    
     if (screen == NULL) {
@@ -101,18 +122,26 @@ int init_screen(int win_x, int win_y, uint32_t *p) {
     #endif
 
     // Setup Renderer
-    renderer = SDL_CreateRenderer(screen, -1, 0);
+    renderer = SDL_CreateRenderer(screen, -1, vsync ? SDL_RENDERER_PRESENTVSYNC : 0);
     if (renderer == NULL) {
         log_message(LOG_ERROR, "Could not initialize SDL renderer: %s.\n", SDL_GetError());
         return 0;
     } 
 
+    // Leave it to the frame limiter if presenting doesn't wait for vsync
+    SDL_RendererInfo info;
+    if (vsync && (SDL_GetRendererInfo(renderer, &info) != 0 ||
+            !(info.flags & SDL_RENDERER_PRESENTVSYNC))) {
+        log_message(LOG_WARN, "VSync not supported by the SDL renderer\n");
+        vsync = 0;
+    }
+
     SDL_RenderClear(renderer);
     SDL_RenderPresent(renderer);
     
     // Setup texture for blitting the pixels
     texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888,
-                    SDL_TEXTUREACCESS_STREAMING, GB_PIXELS_X, GB_PIXELS_Y);
+                    SDL_TEXTUREACCESS_STREAMING, filtered_width, filtered_height);
 
 
     if (texture == NULL) {
@@ -128,7 +157,19 @@ int init_screen(int win_x, int win_y, uint32_t *p) {
 
 /*  Update the screen output */
 void draw_screen() {
-    SDL_UpdateTexture(texture, NULL, pixels, GB_PIXELS_X * sizeof (Uint32));
+    void *locked;
+    int pitch;
+
+    if (filtered_pixels && SDL_LockTexture(texture, NULL, &locked, &pitch) == 0) {
+        // The filter writes every pixel, so it can go straight into the texture
+        apply_filter(pixels, locked, pitch / sizeof (Uint32));
+        SDL_UnlockTexture(texture);
+    } else if (filtered_pixels) {
+        apply_filter(pixels, filtered_pixels, filtered_width);
+        SDL_UpdateTexture(texture, NULL, filtered_pixels, filtered_width * sizeof (Uint32));
+    } else {
+        SDL_UpdateTexture(texture, NULL, pixels, GB_PIXELS_X * sizeof (Uint32));
+    }
     SDL_RenderClear(renderer);
     SDL_RenderCopy(renderer, texture, NULL, NULL);
    
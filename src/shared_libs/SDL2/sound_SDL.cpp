@@ -1,7 +1,10 @@
 #include "../../core/sound.h"
+#include "../../core/instrument.h"
 #include "../../core/audio/Multi_Buffer.h"
 #include "../../core/audio/Gb_Apu.h"
 #include "../../non_core/logger.h"
+#include "../../non_core/shm_output.h"
+#include "../../non_core/recorder.h"
 
 
 #include <cstdio>
@@ -46,11 +49,15 @@ void init_apu() {
 }
     
 void sound_add_cycles(unsigned c) {
+    ZONE_BEGIN(ZONE_SOUND);
     cycles += c;
     if (cycles >= MAX_CYCLES) {
         cycles -= MAX_CYCLES;
+        ZONE_BEGIN(ZONE_SOUND_FRAME);
         end_frame();
+        ZONE_END(ZONE_SOUND_FRAME);
     }
+    ZONE_END(ZONE_SOUND);
 }
 
 void write_apu(uint16_t addr, uint8_t val) {
@@ -73,6 +80,13 @@ void end_frame() {
 		    
             size_t count = stereo_buf.read_samples(sample_buffer, BUF_SIZE );
             sound.write(sample_buffer, count );
+
+            if (shm_output_enabled) {
+                shm_publish_audio(sample_buffer, count, SAMPLE_RATE);
+            }
+            if (recording_av) {
+                record_audio(sample_buffer, count, SAMPLE_RATE);
+            }
         }
 }                           
 
@@ -1,4 +1,5 @@
 #include "../../non_core/graphics_out.h"
+#include "../../non_core/filters.h"
 
 #include <Uefi.h>
 #include <Library/UefiApplicationEntryPoint.h>
@@ -10,6 +11,10 @@
 #include <Library/UefiRuntimeLib.h>
 
 static EFI_GRAPHICS_OUTPUT_BLT_PIXEL *pixels;
+static uint32_t *src_pixels;
+
+// No scaling in hardware, the screen is scaled by the selected filter
+static uint32_t filtered_pixels[GB_PIXELS_X * GB_PIXELS_Y * MAX_FILTER_SCALE * MAX_FILTER_SCALE];
 static EFI_GRAPHICS_OUTPUT_PROTOCOL  *GraphicsOutput = NULL;
 static int screen_width;
 static int screen_height;
@@ -24,7 +29,11 @@ int init_screen(int win_x, int win_y, uint32_t *p) {
     screen_width = win_x;
     screen_height = win_y;
 
+    src_pixels = p;
     pixels = (EFI_GRAPHICS_OUTPUT_BLT_PIXEL *)p;
+    if (get_filter() != FILTER_NONE) {
+        pixels = (EFI_GRAPHICS_OUTPUT_BLT_PIXEL *)filtered_pixels;
+    }
 
    // Locate all instances of GOP
    EFI_STATUS Status = gBS->LocateHandleBuffer(ByProtocol
@@ -54,6 +63,11 @@ int init_screen(int win_x, int win_y, uint32_t *p) {
 }
 
 void draw_screen() {
-		GraphicsOutput->Blt(GraphicsOutput, pixels, EfiBltBufferToVideo, 0, 0, 0, 0, 160, 144, 0);
+		int scale = filter_scale();
+		if (get_filter() != FILTER_NONE) {
+			apply_filter(src_pixels, filtered_pixels, GB_PIXELS_X * scale);
+		}
+		GraphicsOutput->Blt(GraphicsOutput, pixels, EfiBltBufferToVideo, 0, 0, 0, 0,
+			GB_PIXELS_X * scale, GB_PIXELS_Y * scale, 0);
 
 }
@@ -66,23 +66,14 @@ void init_joypad() {
     buttons[SELECT].scan_code = button_config_scan_codes[SELECT];
 }
 
-/* Check each individual GameBoy key. Returns 1 if
- * the specified key is being held down, 0 otherwise */
-int down_pressed()   { return buttons[DOWN].state;  }  
-int up_pressed()     { return buttons[UP].state; }
-int left_pressed()   { return buttons[LEFT].state;}
-int right_pressed()  { return buttons[RIGHT].state;} 
-int a_pressed()      { return buttons[A].state; }
-int b_pressed()      { return buttons[B].state;}
-int start_pressed()  { return buttons[START].state; }
-int select_pressed() { return buttons[SELECT].state; } 
-
-/* Returns 1 if any of the 8 GameBoy keys are being held down,
- * 0 otherwise */
-int key_pressed() {
-
-    return down_pressed() || up_pressed() || left_pressed() || right_pressed()
-    || a_pressed() || b_pressed() || start_pressed() || select_pressed();
+/* State of the 8 GameBoy keys as a key mask, a bit
+ * set for each key being held down */
+uint8_t joypad_keys() {
+
+    return (buttons[RIGHT].state ? GB_KEY_RIGHT : 0) | (buttons[LEFT].state ? GB_KEY_LEFT : 0)
+        | (buttons[UP].state ? GB_KEY_UP : 0) | (buttons[DOWN].state ? GB_KEY_DOWN : 0)
+        | (buttons[A].state ? GB_KEY_A : 0) | (buttons[B].state ? GB_KEY_B : 0)
+        | (buttons[SELECT].state ? GB_KEY_SELECT : 0) | (buttons[START].state ? GB_KEY_START : 0);
 }
 
 void unset_keys() {
@@ -12,59 +12,14 @@ void init_joypad() {
     
 }
 
-/* Check each individual GameBoy key. Returns 1 if
- * the specified key is being held down, 0 otherwise */
-int down_pressed() {
+/* State of the 8 GameBoy keys as a key mask, a bit
+ * set for each key being held down */
+uint8_t joypad_keys() {
     pthread_rwlock_rdlock(&rwlock);
-    int result = down_state;
-    pthread_rwlock_unlock(&rwlock);
-    return result;
-}
-int up_pressed() {
-    pthread_rwlock_rdlock(&rwlock);
-    int result = up_state;
-    pthread_rwlock_unlock(&rwlock);
-    return result;
-}
-int left_pressed() {
-    pthread_rwlock_rdlock(&rwlock);
-    int result = left_state;
-    pthread_rwlock_unlock(&rwlock);
-    return result;
-}
-
-int right_pressed() {
-    pthread_rwlock_rdlock(&rwlock);
-    int result = right_state;
-    pthread_rwlock_unlock(&rwlock);
-    return result;
-}
-
-int a_pressed() {
-    pthread_rwlock_rdlock(&rwlock);
-    int result = a_state;
-    pthread_rwlock_unlock(&rwlock);
-    return result;
-}
-
-int b_pressed() {
-    pthread_rwlock_rdlock(&rwlock);
-    int result = b_state;
-    pthread_rwlock_unlock(&rwlock);
-    return result;
-}
-
-int start_pressed()  {
-    pthread_rwlock_rdlock(&rwlock);
-    int result = start_state;
-    pthread_rwlock_unlock(&rwlock);
-    return result;
-    
-}
-
-int select_pressed() {
-    pthread_rwlock_rdlock(&rwlock);
-    int result = select_state;
+    uint8_t result = (right_state ? GB_KEY_RIGHT : 0) | (left_state ? GB_KEY_LEFT : 0) |
+            (up_state ? GB_KEY_UP : 0) | (down_state ? GB_KEY_DOWN : 0) |
+            (a_state ? GB_KEY_A : 0) | (b_state ? GB_KEY_B : 0) |
+            (select_state ? GB_KEY_SELECT : 0) | (start_state ? GB_KEY_START : 0);
     pthread_rwlock_unlock(&rwlock);
     return result;
 }
@@ -118,17 +73,6 @@ void set_select_pressed(int state) {
     pthread_rwlock_unlock(&rwlock);
 }
 
-/* Returns 1 if any of the 8 GameBoy keys are being held down,
- * 0 otherwise */
-int key_pressed() {
-    pthread_rwlock_rdlock(&rwlock);
-    int result = down_state || up_state || left_state  || right_state ||
-            a_state    || b_state  || start_state || select_state;
-    pthread_rwlock_unlock(&rwlock);
-    return result;
-}
-
-
 // Given relative screen x and y positions and an on/off state
 // sets any buttons those co-ordinates are in to the given state.
 void check_keys_pressed(float x, float y, int state) {
@@ -0,0 +1,648 @@
+#include "../non_core/filters.h"
+#include "../non_core/graphics_out.h"
+#include "../non_core/logger.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#ifdef FILTER_THREADS
+#include <pthread.h>
+#endif
+
+/* Frames are copied into buffers with a border of replicated edge
+ * pixels so filters can read their neighbours without bounds checks */
+#define PAD 2
+
+#define IN_PITCH (GB_PIXELS_X + (2 * PAD))
+#define IN_ROWS (GB_PIXELS_Y + (2 * PAD))
+
+// Scale4x runs Scale2x twice, through a 2x sized buffer
+#define MID_PITCH ((GB_PIXELS_X * 2) + (2 * PAD))
+#define MID_ROWS ((GB_PIXELS_Y * 2) + (2 * PAD))
+
+static uint32_t padded[IN_ROWS * IN_PITCH];
+static uint32_t padded_yuv[IN_ROWS * IN_PITCH];
+static uint32_t mid[MID_ROWS * MID_PITCH];
+static uint32_t ghost[GB_PIXELS_Y * GB_PIXELS_X];
+static int ghost_valid = 0;
+
+static Filter_Type filter = FILTER_NONE;
+static int filter_threads = 1;
+
+static struct {
+    char const *name;
+    int scale;
+} const filter_info[FILTER_COUNT] = {
+    {"none", 1},
+    {"scale2x", 2},
+    {"scale3x", 3},
+    {"scale4x", 4},
+    {"xbr", 2},
+    {"lcd", 4},
+    {"scanlines", 4},
+};
+
+typedef struct filter_job Filter_Job;
+
+// Filter input rows y0 to y1 - 1
+typedef void (*Filter_Kernel)(Filter_Job const *job, int y0, int y1);
+
+struct filter_job {
+    Filter_Kernel kernel;
+    uint32_t const *in; // First pixel of a padded buffer
+    int in_pitch;
+    int width;
+    uint32_t *out;
+    int out_pitch;
+};
+
+
+static void pad_frame(uint32_t const *src, int src_pitch, int width, int height,
+                        uint32_t *dst, int dst_pitch) {
+
+    for (int y = 0; y < height; y++) {
+        uint32_t const *in = src + (y * src_pitch);
+        uint32_t *out = dst + (y * dst_pitch);
+        if (in != out) {
+            memcpy(out, in, width * sizeof(uint32_t));
+        }
+        for (int x = 1; x <= PAD; x++) {
+            out[-x] = in[0];
+            out[width - 1 + x] = in[width - 1];
+        }
+    }
+
+    uint32_t *top = dst - PAD;
+    uint32_t *bottom = dst + ((height - 1) * dst_pitch) - PAD;
+    for (int y = 1; y <= PAD; y++) {
+        memcpy(top - (y * dst_pitch), top, (width + (2 * PAD)) * sizeof(uint32_t));
+        memcpy(bottom + (y * dst_pitch), bottom, (width + (2 * PAD)) * sizeof(uint32_t));
+    }
+}
+
+
+static void copy_rows(Filter_Job const *job, int y0, int y1) {
+    for (int y = y0; y < y1; y++) {
+        memcpy(job->out + (y * job->out_pitch), job->in + (y * job->in_pitch),
+                job->width * sizeof(uint32_t));
+    }
+}
+
+
+#ifdef __SSE2__
+static inline __m128i select_128(__m128i mask, __m128i a, __m128i b) {
+    return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+#endif
+
+/* Scale2x (AdvMAME2x), each pixel E becomes 4 pixels which copy
+ * a neighbour when E sits on the corner of an edge
+ *   A B C
+ *   D E F  ->  E0 E1
+ *   G H I      E2 E3 */
+static void scale2x_rows(Filter_Job const *job, int y0, int y1) {
+
+    for (int y = y0; y < y1; y++) {
+        uint32_t const *e = job->in + (y * job->in_pitch);
+        uint32_t const *b = e - job->in_pitch;
+        uint32_t const *h = e + job->in_pitch;
+        uint32_t *out0 = job->out + ((y * 2) * job->out_pitch);
+        uint32_t *out1 = out0 + job->out_pitch;
+        int x = 0;
+
+#ifdef __SSE2__
+        __m128i const ones = _mm_set1_epi32(-1);
+        for (; x + 4 <= job->width; x += 4) {
+            __m128i E = _mm_loadu_si128((__m128i const *)(e + x));
+            __m128i B = _mm_loadu_si128((__m128i const *)(b + x));
+            __m128i H = _mm_loadu_si128((__m128i const *)(h + x));
+            __m128i D = _mm_loadu_si128((__m128i const *)(e + x - 1));
+            __m128i F = _mm_loadu_si128((__m128i const *)(e + x + 1));
+
+            // B != H && D != F
+            __m128i edge = _mm_andnot_si128(_mm_cmpeq_epi32(B, H),
+                            _mm_andnot_si128(_mm_cmpeq_epi32(D, F), ones));
+
+            __m128i E0 = select_128(_mm_and_si128(edge, _mm_cmpeq_epi32(D, B)), D, E);
+            __m128i E1 = select_128(_mm_and_si128(edge, _mm_cmpeq_epi32(B, F)), F, E);
+            __m128i E2 = select_128(_mm_and_si128(edge, _mm_cmpeq_epi32(D, H)), D, E);
+            __m128i E3 = select_128(_mm_and_si128(edge, _mm_cmpeq_epi32(H, F)), F, E);
+
+            _mm_storeu_si128((__m128i *)(out0 + (x * 2)), _mm_unpacklo_epi32(E0, E1));
+            _mm_storeu_si128((__m128i *)(out0 + (x * 2) + 4), _mm_unpackhi_epi32(E0, E1));
+            _mm_storeu_si128((__m128i *)(out1 + (x * 2)), _mm_unpacklo_epi32(E2, E3));
+            _mm_storeu_si128((__m128i *)(out1 + (x * 2) + 4), _mm_unpackhi_epi32(E2, E3));
+        }
+#endif
+        for (; x < job->width; x++) {
+            uint32_t E = e[x], B = b[x], H = h[x], D = e[x - 1], F = e[x + 1];
+            int edge = (B != H) && (D != F);
+
+            out0[x * 2]       = (edge && D == B) ? D : E;
+            out0[(x * 2) + 1] = (edge && B == F) ? F : E;
+            out1[x * 2]       = (edge && D == H) ? D : E;
+            out1[(x * 2) + 1] = (edge && H == F) ? F : E;
+        }
+    }
+}
+
+
+/* Scale3x (AdvMAME3x)
+ *   A B C      E0 E1 E2
+ *   D E F  ->  E3 E4 E5
+ *   G H I      E6 E7 E8 */
+static void scale3x_rows(Filter_Job const *job, int y0, int y1) {
+
+    for (int y = y0; y < y1; y++) {
+        uint32_t const *e = job->in + (y * job->in_pitch);
+        uint32_t const *b = e - job->in_pitch;
+        uint32_t const *h = e + job->in_pitch;
+        uint32_t *out0 = job->out + ((y * 3) * job->out_pitch);
+        uint32_t *out1 = out0 + job->out_pitch;
+        uint32_t *out2 = out1 + job->out_pitch;
+
+        for (int x = 0; x < job->width; x++) {
+            uint32_t A = b[x - 1], B = b[x], C = b[x + 1];
+            uint32_t D = e[x - 1], E = e[x], F = e[x + 1];
+            uint32_t G = h[x - 1], H = h[x], I = h[x + 1];
+            uint32_t *o0 = out0 + (x * 3), *o1 = out1 + (x * 3), *o2 = out2 + (x * 3);
+
+            if (B != H && D != F) {
+                o0[0] = D == B ? D : E;
+                o0[1] = ((D == B && E != C) || (B == F && E != A)) ? B : E;
+                o0[2] = B == F ? F : E;
+                o1[0] = ((D == B && E != G) || (D == H && E != A)) ? D : E;
+                o1[1] = E;
+                o1[2] = ((B == F && E != I) || (H == F && E != C)) ? F : E;
+                o2[0] = D == H ? D : E;
+                o2[1] = ((D == H && E != I) || (H == F && E != G)) ? H : E;
+                o2[2] = H == F ? F : E;
+            } else {
+                o0[0] = o0[1] = o0[2] = E;
+                o1[0] = o1[1] = o1[2] = E;
+                o2[0] = o2[1] = o2[2] = E;
+            }
+        }
+    }
+}
+
+
+/* xBR level 2 at 2x (Hyllian), edges are detected by comparing
+ * the weighted YUV differences along both diagonals of each
+ * output corner, and the corner is blended towards the edge */
+
+static uint32_t rgb_to_yuv(uint32_t c) {
+    int r = (c >> 16) & 0xFF;
+    int g = (c >> 8) & 0xFF;
+    int b = c & 0xFF;
+
+    int y = ((299 * r) + (587 * g) + (114 * b)) / 1000;
+    int u = (((-169 * r) - (331 * g) + (500 * b)) / 1000) + 128;
+    int v = (((500 * r) - (419 * g) - (81 * b)) / 1000) + 128;
+    return y | (u << 8) | (v << 16);
+}
+
+static inline int yuv_diff(uint32_t a, uint32_t b) {
+    int dy = abs((int)(a & 0xFF) - (int)(b & 0xFF));
+    int du = abs((int)((a >> 8) & 0xFF) - (int)((b >> 8) & 0xFF));
+    int dv = abs((int)((a >> 16) & 0xFF) - (int)((b >> 16) & 0xFF));
+    return (dy * 48) + (du * 7) + (dv * 6);
+}
+
+// Blend weight / 256 of src into dst
+static inline uint32_t blend(uint32_t dst, uint32_t src, uint32_t weight) {
+    uint32_t inv = 256 - weight;
+    uint32_t rb = ((((src & 0xFF00FF) * weight) + ((dst & 0xFF00FF) * inv)) >> 8) & 0xFF00FF;
+    uint32_t g = ((((src & 0xFF00) * weight) + ((dst & 0xFF00) * inv)) >> 8) & 0xFF00;
+    return 0xFF000000 | rb | g;
+}
+
+/* The 5x5 neighbourhood (without corners) around E
+ *      A1 B1 C1
+ *   A0 A  B  C  C4
+ *   D0 D  E  F  F4
+ *   G0 G  H  I  I4
+ *      G5 H5 I5 */
+enum {
+    N_A1, N_B1, N_C1,
+    N_A0, N_A, N_B, N_C, N_C4,
+    N_D0, N_D, N_E, N_F, N_F4,
+    N_G0, N_G, N_H, N_I, N_I4,
+    N_G5, N_H5, N_I5,
+    NEIGHBOURS
+};
+
+static int const neighbour_x[NEIGHBOURS] = {
+        -1, 0, 1,
+    -2, -1, 0, 1, 2,
+    -2, -1, 0, 1, 2,
+    -2, -1, 0, 1, 2,
+        -1, 0, 1
+};
+
+static int const neighbour_y[NEIGHBOURS] = {
+        -2, -2, -2,
+    -1, -1, -1, -1, -1,
+     0,  0,  0,  0,  0,
+     1,  1,  1,  1,  1,
+         2,  2,  2
+};
+
+// Positions of a corner's kernel, and the output pixels it writes
+enum {
+    K_E, K_I, K_H, K_F, K_G, K_C, K_D, K_B, K_A,
+    K_G5, K_C4, K_G0, K_D0, K_C1, K_B1, K_F4, K_I4, K_H5, K_I5, K_A0, K_A1,
+    K_OUT_UP, K_OUT_LEFT, K_OUT_CORNER,
+    KERNEL_SIZE
+};
+
+/* The bottom right corner's kernel, rotated to each other corner
+ * (output pixels are 0 top left, 1 top right, 2 bottom left, 3 bottom right) */
+static uint8_t const xbr_rotations[4][KERNEL_SIZE] = {
+    {N_E, N_I, N_H, N_F, N_G, N_C, N_D, N_B, N_A,
+     N_G5, N_C4, N_G0, N_D0, N_C1, N_B1, N_F4, N_I4, N_H5, N_I5, N_A0, N_A1, 1, 2, 3},
+    {N_E, N_C, N_F, N_B, N_I, N_A, N_H, N_D, N_G,
+     N_I4, N_A1, N_I5, N_H5, N_A0, N_D0, N_B1, N_C1, N_F4, N_C4, N_G5, N_G0, 0, 3, 1},
+    {N_E, N_A, N_B, N_D, N_C, N_G, N_F, N_H, N_I,
+     N_C1, N_G0, N_C4, N_F4, N_G5, N_H5, N_D0, N_A0, N_B1, N_A1, N_I4, N_I5, 2, 1, 0},
+    {N_E, N_G, N_D, N_H, N_A, N_I, N_B, N_F, N_C,
+     N_A0, N_I5, N_A1, N_B1, N_I4, N_F4, N_H5, N_G5, N_D0, N_G0, N_C1, N_C4, 3, 0, 2},
+};
+
+#define XBR_EQ_THRESHOLD 155
+
+static void xbr_corner(uint32_t const *rgb, uint32_t const *yuv,
+                        uint8_t const *k, uint32_t out[4]) {
+
+#define P(n) rgb[k[K_##n]]
+#define DF(a, b) yuv_diff(yuv[k[K_##a]], yuv[k[K_##b]])
+#define EQ(a, b) (DF(a, b) < XBR_EQ_THRESHOLD)
+
+    if (P(E) == P(H) || P(E) == P(F)) {
+        return;
+    }
+
+    int e = DF(E, C) + DF(E, G) + DF(I, H5) + DF(I, F4) + (DF(H, F) << 2);
+    int i = DF(H, D) + DF(H, I5) + DF(F, I4) + DF(F, B) + (DF(E, I) << 2);
+    uint32_t px = (DF(E, F) <= DF(E, H)) ? P(F) : P(H);
+
+    uint32_t *corner = &out[k[K_OUT_CORNER]];
+    uint32_t *left = &out[k[K_OUT_LEFT]];
+    uint32_t *up = &out[k[K_OUT_UP]];
+
+    if ((e < i) && ((!EQ(F, B) && !EQ(H, D)) || (EQ(E, I) && !EQ(F, I4) && !EQ(H, I5))
+            || EQ(E, G) || EQ(E, C))) {
+
+        int ke = DF(F, G);
+        int ki = DF(H, C);
+        int ex2 = (P(E) != P(C) && P(B) != P(C));
+        int ex3 = (P(E) != P(G) && P(D) != P(G));
+
+        if (((ke << 1) <= ki) && ex3 && (ke >= (ki << 1)) && ex2) {
+            *corner = blend(*corner, px, 224);
+            *left = blend(*left, px, 64);
+            *up = *left;
+        } else if (((ke << 1) <= ki) && ex3) {
+            *corner = blend(*corner, px, 192);
+            *left = blend(*left, px, 64);
+        } else if ((ke >= (ki << 1)) && ex2) {
+            *corner = blend(*corner, px, 192);
+            *up = blend(*up, px, 64);
+        } else {
+            *corner = blend(*corner, px, 128);
+        }
+    } else if (e <= i) {
+        *corner = blend(*corner, px, 128);
+    }
+
+#undef P
+#undef DF
+#undef EQ
+}
+
+static void xbr2x_rows(Filter_Job const *job, int y0, int y1) {
+
+    int offsets[NEIGHBOURS];
+    for (int n = 0; n < NEIGHBOURS; n++) {
+        offsets[n] = (neighbour_y[n] * job->in_pitch) + neighbour_x[n];
+    }
+
+    for (int y = y0; y < y1; y++) {
+        uint32_t *out0 = job->out + ((y * 2) * job->out_pitch);
+        uint32_t *out1 = out0 + job->out_pitch;
+
+        for (int x = 0; x < job->width; x++) {
+            // job->in is always within padded, which has its YUV values in padded_yuv
+            uint32_t const *e = job->in + (y * job->in_pitch) + x;
+            uint32_t const *e_yuv = padded_yuv + (e - padded);
+            uint32_t *o0 = out0 + (x * 2);
+            uint32_t *o1 = out1 + (x * 2);
+
+            /* A corner is only blended when E differs from both of the
+             * pixels beside it, skip the common case of flat areas */
+            int same_b = (e[0] == e[-job->in_pitch]);
+            int same_d = (e[0] == e[-1]);
+            int same_f = (e[0] == e[1]);
+            int same_h = (e[0] == e[job->in_pitch]);
+            if ((same_h || same_f) && (same_f || same_b) && (same_b || same_d) && (same_d || same_h)) {
+                o0[0] = o0[1] = o1[0] = o1[1] = e[0];
+                continue;
+            }
+
+            uint32_t rgb[NEIGHBOURS];
+            uint32_t yuv[NEIGHBOURS];
+            for (int n = 0; n < NEIGHBOURS; n++) {
+                rgb[n] = e[offsets[n]];
+                yuv[n] = e_yuv[offsets[n]];
+            }
+
+            uint32_t out[4] = {rgb[N_E], rgb[N_E], rgb[N_E], rgb[N_E]};
+            for (int r = 0; r < 4; r++) {
+                xbr_corner(rgb, yuv, xbr_rotations[r], out);
+            }
+
+            o0[0] = out[0];
+            o0[1] = out[1];
+            o1[0] = out[2];
+            o1[1] = out[3];
+        }
+    }
+}
+
+
+// Average of 2 colours per channel, without overflowing between channels
+static inline uint32_t average(uint32_t a, uint32_t b) {
+    return (a & b) + (((a ^ b) & 0xFEFEFEFE) >> 1);
+}
+
+// 3/4 brightness for the gaps between LCD dots
+static inline uint32_t grid_colour(uint32_t c) {
+    return c - ((c >> 2) & 0x3F3F3F);
+}
+
+// Half brightness for the gap between scanlines
+static inline uint32_t scanline_colour(uint32_t c) {
+    return 0xFF000000 | ((c >> 1) & 0x7F7F7F);
+}
+
+/* LCD dot matrix, each frame is blended with the previous
+ * output to emulate the slow response of the original LCD,
+ * then every pixel is drawn as a 4x4 dot with a darker gap */
+static void lcd_rows(Filter_Job const *job, int y0, int y1) {
+
+    for (int y = y0; y < y1; y++) {
+        uint32_t const *in = job->in + (y * job->in_pitch);
+        uint32_t *g = ghost + (y * GB_PIXELS_X);
+        int x = 0;
+
+#ifdef __SSE2__
+        __m128i const low_bits = _mm_set1_epi32(0xFEFEFEFE);
+        for (; x + 4 <= job->width; x += 4) {
+            __m128i a = _mm_loadu_si128((__m128i const *)(in + x));
+            __m128i b = _mm_loadu_si128((__m128i const *)(g + x));
+            __m128i avg = _mm_add_epi32(_mm_and_si128(a, b),
+                        _mm_srli_epi32(_mm_and_si128(_mm_xor_si128(a, b), low_bits), 1));
+            _mm_storeu_si128((__m128i *)(g + x), avg);
+        }
+#endif
+        for (; x < job->width; x++) {
+            g[x] = average(in[x], g[x]);
+        }
+
+        uint32_t *out = job->out + ((y * 4) * job->out_pitch);
+        for (x = 0; x < job->width; x++) {
+            uint32_t c = g[x];
+            uint32_t d = grid_colour(c);
+            for (int row = 0; row < 3; row++) {
+                uint32_t *o = out + (row * job->out_pitch) + (x * 4);
+                o[0] = c; o[1] = c; o[2] = c; o[3] = d;
+            }
+            uint32_t *o = out + (3 * job->out_pitch) + (x * 4);
+            o[0] = d; o[1] = d; o[2] = d; o[3] = d;
+        }
+    }
+}
+
+// Each pixel drawn 4x4, with the bottom row of each darkened
+static void scanline_rows(Filter_Job const *job, int y0, int y1) {
+
+    for (int y = y0; y < y1; y++) {
+        uint32_t const *in = job->in + (y * job->in_pitch);
+        uint32_t *out = job->out + ((y * 4) * job->out_pitch);
+
+        for (int x = 0; x < job->width; x++) {
+            uint32_t c = in[x];
+            uint32_t *o = out + (x * 4);
+            o[0] = c; o[1] = c; o[2] = c; o[3] = c;
+        }
+        memcpy(out + job->out_pitch, out, job->width * 4 * sizeof(uint32_t));
+        memcpy(out + (2 * job->out_pitch), out, job->width * 4 * sizeof(uint32_t));
+
+        uint32_t *dark = out + (3 * job->out_pitch);
+        for (int x = 0; x < job->width * 4; x++) {
+            dark[x] = scanline_colour(out[x]);
+        }
+    }
+}
+
+
+#ifdef FILTER_THREADS
+/* Pool of threads each filtering a band of rows, the calling
+ * thread filters the first band itself */
+static pthread_t pool[MAX_FILTER_THREADS];
+static int pool_size = 0;
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t job_ready = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t job_done = PTHREAD_COND_INITIALIZER;
+static Filter_Job const *current_job;
+static int current_rows;
+static int current_bands;
+static int bands_left;
+static unsigned job_no = 0;
+
+static void *filter_worker(void *arg) {
+
+    int band = (int)(intptr_t)arg;
+    unsigned last_job = 0;
+
+    pthread_mutex_lock(&pool_lock);
+    for (;;) {
+        while (job_no == last_job) {
+            pthread_cond_wait(&job_ready, &pool_lock);
+        }
+        last_job = job_no;
+        if (band >= current_bands) {
+            continue;
+        }
+
+        Filter_Job const *job = current_job;
+        int y0 = (current_rows * band) / current_bands;
+        int y1 = (current_rows * (band + 1)) / current_bands;
+        pthread_mutex_unlock(&pool_lock);
+
+        job->kernel(job, y0, y1);
+
+        pthread_mutex_lock(&pool_lock);
+        if (--bands_left == 0) {
+            pthread_cond_signal(&job_done);
+        }
+    }
+    return NULL;
+}
+#endif
+
+
+// Run the job over the given number of input rows
+static void run_job(Filter_Job const *job, int rows) {
+
+#ifdef FILTER_THREADS
+    if (filter_threads > 1) {
+        pthread_mutex_lock(&pool_lock);
+        current_job = job;
+        current_rows = rows;
+        current_bands = filter_threads;
+        bands_left = filter_threads - 1;
+        job_no++;
+        pthread_cond_broadcast(&job_ready);
+        pthread_mutex_unlock(&pool_lock);
+
+        job->kernel(job, 0, rows / filter_threads);
+
+        pthread_mutex_lock(&pool_lock);
+        while (bands_left > 0) {
+            pthread_cond_wait(&job_done, &pool_lock);
+        }
+        pthread_mutex_unlock(&pool_lock);
+        return;
+    }
+#endif
+    job->kernel(job, 0, rows);
+}
+
+
+void set_filter_threads(int count) {
+
+    if (count < 1) {
+        count = 1;
+    } else if (count > MAX_FILTER_THREADS) {
+        count = MAX_FILTER_THREADS;
+    }
+
+#ifdef FILTER_THREADS
+    while (pool_size < count - 1) {
+        if (pthread_create(&pool[pool_size], NULL, filter_worker,
+                    (void *)(intptr_t)(pool_size + 1)) != 0) {
+            log_message(LOG_WARN, "Failed to start filter thread\n");
+            break;
+        }
+        pool_size++;
+    }
+    filter_threads = (count < pool_size + 1) ? count : pool_size + 1;
+#else
+    (void)count;
+    filter_threads = 1;
+#endif
+}
+
+
+int set_filter(Filter_Type type) {
+    if (type < 0 || type >= FILTER_COUNT) {
+        return 0;
+    }
+    filter = type;
+    ghost_valid = 0;
+    return 1;
+}
+
+
+Filter_Type get_filter() {
+    return filter;
+}
+
+
+int filter_from_name(char const *name) {
+    for (int i = 0; i < FILTER_COUNT; i++) {
+        if (strcmp(name, filter_info[i].name) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+
+int filter_scale() {
+    return filter_info[filter].scale;
+}
+
+
+void apply_filter(uint32_t const *src, uint32_t *dst, int dst_pitch) {
+
+    uint32_t *in = padded + (PAD * IN_PITCH) + PAD;
+    Filter_Job job = {NULL, in, IN_PITCH, GB_PIXELS_X, dst, dst_pitch};
+
+    switch (filter) {
+        case FILTER_NONE:
+            job.kernel = copy_rows;
+            job.in = src;
+            job.in_pitch = GB_PIXELS_X;
+            break;
+
+        case FILTER_SCALE2X:
+            job.kernel = scale2x_rows;
+            pad_frame(src, GB_PIXELS_X, GB_PIXELS_X, GB_PIXELS_Y, in, IN_PITCH);
+            break;
+
+        case FILTER_SCALE3X:
+            job.kernel = scale3x_rows;
+            pad_frame(src, GB_PIXELS_X, GB_PIXELS_X, GB_PIXELS_Y, in, IN_PITCH);
+            break;
+
+        case FILTER_SCALE4X: {
+            uint32_t *mid_in = mid + (PAD * MID_PITCH) + PAD;
+            pad_frame(src, GB_PIXELS_X, GB_PIXELS_X, GB_PIXELS_Y, in, IN_PITCH);
+
+            Filter_Job first = {scale2x_rows, in, IN_PITCH, GB_PIXELS_X, mid_in, MID_PITCH};
+            run_job(&first, GB_PIXELS_Y);
+            pad_frame(mid_in, MID_PITCH, GB_PIXELS_X * 2, GB_PIXELS_Y * 2, mid_in, MID_PITCH);
+
+            job.kernel = scale2x_rows;
+            job.in = mid_in;
+            job.in_pitch = MID_PITCH;
+            job.width = GB_PIXELS_X * 2;
+            run_job(&job, GB_PIXELS_Y * 2);
+            return;
+        }
+
+        case FILTER_XBR2X:
+            job.kernel = xbr2x_rows;
+            pad_frame(src, GB_PIXELS_X, GB_PIXELS_X, GB_PIXELS_Y, in, IN_PITCH);
+            for (int i = 0; i < IN_ROWS * IN_PITCH; i++) {
+                padded_yuv[i] = rgb_to_yuv(padded[i]);
+            }
+            break;
+
+        case FILTER_LCD:
+            job.kernel = lcd_rows;
+            job.in = src;
+            job.in_pitch = GB_PIXELS_X;
+            if (!ghost_valid) {
+                memcpy(ghost, src, sizeof(ghost));
+                ghost_valid = 1;
+            }
+            break;
+
+        case FILTER_SCANLINES:
+            job.kernel = scanline_rows;
+            job.in = src;
+            job.in_pitch = GB_PIXELS_X;
+            break;
+
+        default: return;
+    }
+
+    run_job(&job, GB_PIXELS_Y);
+}
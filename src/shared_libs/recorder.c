@@ -0,0 +1,283 @@
+#include "../non_core/recorder.h"
+#include "../non_core/graphics_out.h"
+#include "../non_core/logger.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef RECORD_THREAD
+#include <pthread.h>
+#endif
+
+#define FRAME_BYTES (GB_PIXELS_X * GB_PIXELS_Y * sizeof(uint32_t))
+#define WAV_HEADER_SIZE 44
+#define MAX_RECORD_NAME 512
+
+#define CHUNK_VIDEO 0
+#define CHUNK_AUDIO 1
+
+int recording_av = 0;
+
+static FILE *video_file = NULL;
+static FILE *audio_file = NULL;
+static unsigned audio_rate = 44100;
+static uint32_t audio_bytes;
+static unsigned long frames_written;
+
+
+static void put_u16(uint8_t *buf, uint16_t val) {
+    buf[0] = val & 0xFF;
+    buf[1] = val >> 8;
+}
+
+
+static void put_u32(uint8_t *buf, uint32_t val) {
+    put_u16(buf, val & 0xFFFF);
+    put_u16(buf + 2, val >> 16);
+}
+
+
+static void write_wav_header(FILE *file, unsigned rate, uint32_t data_bytes) {
+
+    uint8_t header[WAV_HEADER_SIZE];
+
+    memcpy(header, "RIFF", 4);
+    put_u32(header + 4, 36 + data_bytes);
+    memcpy(header + 8, "WAVEfmt ", 8);
+    put_u32(header + 16, 16);
+    put_u16(header + 20, 1); // PCM
+    put_u16(header + 22, 2); // Channels
+    put_u32(header + 24, rate);
+    put_u32(header + 28, rate * 2 * sizeof(int16_t));
+    put_u16(header + 32, 2 * sizeof(int16_t));
+    put_u16(header + 34, 16);
+    memcpy(header + 36, "data", 4);
+    put_u32(header + 40, data_bytes);
+
+    fseek(file, 0, SEEK_SET);
+    fwrite(header, 1, WAV_HEADER_SIZE, file);
+    fseek(file, 0, SEEK_END);
+}
+
+
+// Samples are written in host order, WAV expects little endian
+static void write_chunk(int type, void const *data, size_t size) {
+
+    if (type == CHUNK_VIDEO) {
+        fwrite(data, 1, size, video_file);
+        frames_written++;
+    } else {
+        fwrite(data, 1, size, audio_file);
+        audio_bytes += size;
+    }
+}
+
+
+#ifdef RECORD_THREAD
+
+#define QUEUE_SLOTS 64
+
+typedef struct {
+    int type;
+    size_t size;
+    uint8_t data[FRAME_BYTES];
+} Record_Chunk;
+
+/* Chunks waiting to be written, the emulation thread fills the
+ * slot at the tail and the writer empties the one at the head */
+static Record_Chunk *queue = NULL;
+static int queue_head;
+static int queue_count;
+
+static pthread_t writer;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t space = PTHREAD_COND_INITIALIZER; // Signalled when a slot is freed
+static int quit;
+
+
+static void *record_writer(void *arg) {
+    (void)arg;
+
+    pthread_mutex_lock(&lock);
+    for (;;) {
+        while (queue_count == 0 && !quit) {
+            pthread_cond_wait(&cond, &lock);
+        }
+        // Everything queued is written before stopping
+        if (queue_count == 0) {
+            break;
+        }
+
+        Record_Chunk *chunk = &queue[queue_head];
+        pthread_mutex_unlock(&lock);
+
+        write_chunk(chunk->type, chunk->data, chunk->size);
+
+        pthread_mutex_lock(&lock);
+        queue_head = (queue_head + 1) % QUEUE_SLOTS;
+        queue_count--;
+        pthread_cond_signal(&space);
+    }
+    pthread_mutex_unlock(&lock);
+    return NULL;
+}
+
+
+static void queue_chunk(int type, void const *data, size_t size) {
+
+    /* Wait for the writer rather than dropping anything, the files
+     * have no timestamps so video and sound would go out of step */
+    pthread_mutex_lock(&lock);
+    while (queue_count == QUEUE_SLOTS) {
+        pthread_cond_wait(&space, &lock);
+    }
+    int tail = (queue_head + queue_count) % QUEUE_SLOTS;
+    pthread_mutex_unlock(&lock);
+
+    // Slot isn't visible to the writer until the count is increased
+    Record_Chunk *chunk = &queue[tail];
+    chunk->type = type;
+    chunk->size = size;
+    memcpy(chunk->data, data, size);
+
+    pthread_mutex_lock(&lock);
+    queue_count++;
+    pthread_cond_signal(&cond);
+    pthread_mutex_unlock(&lock);
+}
+
+
+static int start_writer() {
+
+    queue = malloc(QUEUE_SLOTS * sizeof(Record_Chunk));
+    if (!queue) {
+        log_message(LOG_ERROR, "Unable to allocate recording queue\n");
+        return 0;
+    }
+    queue_head = 0;
+    queue_count = 0;
+    quit = 0;
+
+    if (pthread_create(&writer, NULL, record_writer, NULL) != 0) {
+        log_message(LOG_ERROR, "Failed to start recording thread\n");
+        free(queue);
+        queue = NULL;
+        return 0;
+    }
+    return 1;
+}
+
+
+static void stop_writer() {
+
+    pthread_mutex_lock(&lock);
+    quit = 1;
+    pthread_cond_signal(&cond);
+    pthread_mutex_unlock(&lock);
+    pthread_join(writer, NULL);
+
+    free(queue);
+    queue = NULL;
+}
+
+#else
+
+static void queue_chunk(int type, void const *data, size_t size) {
+    write_chunk(type, data, size);
+}
+
+static int start_writer() {
+    return 1;
+}
+
+static void stop_writer() {
+}
+
+#endif
+
+
+int start_recording(char const *name) {
+
+    char file_name[MAX_RECORD_NAME];
+
+    if (recording_av) {
+        stop_recording();
+    }
+
+    snprintf(file_name, MAX_RECORD_NAME, "%s.raw", name);
+    video_file = fopen(file_name, "wb");
+    if (!video_file) {
+        log_message(LOG_ERROR, "Unable to open %s for recording\n", file_name);
+        return 0;
+    }
+
+    snprintf(file_name, MAX_RECORD_NAME, "%s.wav", name);
+    audio_file = fopen(file_name, "wb");
+    if (!audio_file) {
+        log_message(LOG_ERROR, "Unable to open %s for recording\n", file_name);
+        fclose(video_file);
+        return 0;
+    }
+
+    audio_bytes = 0;
+    frames_written = 0;
+    // Sizes are filled in once recording stops
+    write_wav_header(audio_file, audio_rate, 0);
+
+    if (!start_writer()) {
+        fclose(video_file);
+        fclose(audio_file);
+        return 0;
+    }
+
+    log_message(LOG_INFO, "Recording to %s.raw (%dx%d bgra) and %s.wav\n",
+            name, GB_PIXELS_X, GB_PIXELS_Y, name);
+    recording_av = 1;
+    return 1;
+}
+
+
+void stop_recording() {
+
+    if (!recording_av) {
+        return;
+    }
+    recording_av = 0;
+
+    stop_writer();
+
+    write_wav_header(audio_file, audio_rate, audio_bytes);
+    fclose(video_file);
+    fclose(audio_file);
+
+    log_message(LOG_INFO, "Recorded %lu frames\n", frames_written);
+}
+
+
+void record_frame(uint32_t const *pixels) {
+
+    if (recording_av) {
+        queue_chunk(CHUNK_VIDEO, pixels, FRAME_BYTES);
+    }
+}
+
+
+void record_audio(int16_t const *samples, size_t count, unsigned sample_rate) {
+
+    if (!recording_av) {
+        return;
+    }
+    audio_rate = sample_rate;
+
+    // Split into chunks which fit in a queue slot
+    size_t max_samples = FRAME_BYTES / sizeof(int16_t);
+    while (count > 0) {
+        size_t n = count < max_samples ? count : max_samples;
+        queue_chunk(CHUNK_AUDIO, samples, n * sizeof(int16_t));
+        samples += n;
+        count -= n;
+    }
+}
+
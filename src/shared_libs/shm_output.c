@@ -0,0 +1,196 @@
+#ifdef SHM_OUTPUT
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "../non_core/shm_output.h"
+#include "../non_core/graphics_out.h"
+#include "../non_core/logger.h"
+
+int shm_output_enabled = 0;
+
+#ifdef SHM_OUTPUT
+
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#define MAX_SHM_NAME 64
+#define FRAME_PIXELS (GB_PIXELS_X * GB_PIXELS_Y)
+
+static char video_name[MAX_SHM_NAME];
+static char audio_name[MAX_SHM_NAME];
+
+static Shm_Video_Header *video = NULL;
+static uint32_t *video_slots;
+static size_t video_size;
+
+static Shm_Audio_Header *audio = NULL;
+static int16_t *audio_samples;
+static size_t audio_size;
+
+
+// Create, size and map a shared memory object, returns NULL on failure
+static void *map_shm(char const *name, size_t size) {
+
+    int fd = shm_open(name, O_CREAT | O_RDWR, 0644);
+    if (fd < 0) {
+        log_message(LOG_ERROR, "Unable to create shared memory %s\n", name);
+        return NULL;
+    }
+
+    if (ftruncate(fd, size) != 0) {
+        log_message(LOG_ERROR, "Unable to size shared memory %s\n", name);
+        close(fd);
+        shm_unlink(name);
+        return NULL;
+    }
+
+    void *mem = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    // The mapping stays valid once the descriptor is closed
+    close(fd);
+
+    if (mem == MAP_FAILED) {
+        log_message(LOG_ERROR, "Unable to map shared memory %s\n", name);
+        shm_unlink(name);
+        return NULL;
+    }
+    memset(mem, 0, size);
+    return mem;
+}
+
+
+int shm_output_open(char const *name) {
+
+    if (shm_output_enabled) {
+        shm_output_close();
+    }
+
+    snprintf(video_name, MAX_SHM_NAME, "/%s_video", name);
+    snprintf(audio_name, MAX_SHM_NAME, "/%s_audio", name);
+
+    video_size = sizeof(Shm_Video_Header) + SHM_VIDEO_SLOTS * FRAME_PIXELS * sizeof(uint32_t);
+    video = map_shm(video_name, video_size);
+    if (!video) {
+        return 0;
+    }
+
+    audio_size = sizeof(Shm_Audio_Header) + SHM_AUDIO_SAMPLES * sizeof(int16_t);
+    audio = map_shm(audio_name, audio_size);
+    if (!audio) {
+        munmap(video, video_size);
+        shm_unlink(video_name);
+        video = NULL;
+        return 0;
+    }
+
+    video->width = GB_PIXELS_X;
+    video->height = GB_PIXELS_Y;
+    video->slot_count = SHM_VIDEO_SLOTS;
+    video->slot_offset = sizeof(Shm_Video_Header);
+    video->version = SHM_VERSION;
+    video_slots = (uint32_t *)((uint8_t *)video + video->slot_offset);
+
+    audio->channels = 2;
+    audio->capacity = SHM_AUDIO_SAMPLES;
+    audio->data_offset = sizeof(Shm_Audio_Header);
+    audio->version = SHM_VERSION;
+    audio_samples = (int16_t *)((uint8_t *)audio + audio->data_offset);
+
+    // Magic is written last so readers never see a half set up header
+    __atomic_store_n(&video->magic, SHM_VIDEO_MAGIC, __ATOMIC_RELEASE);
+    __atomic_store_n(&audio->magic, SHM_AUDIO_MAGIC, __ATOMIC_RELEASE);
+
+    log_message(LOG_INFO, "Publishing output to shared memory %s and %s\n", video_name, audio_name);
+    shm_output_enabled = 1;
+    return 1;
+}
+
+
+void shm_output_close() {
+
+    if (!shm_output_enabled) {
+        return;
+    }
+
+    munmap(video, video_size);
+    munmap(audio, audio_size);
+    shm_unlink(video_name);
+    shm_unlink(audio_name);
+    video = NULL;
+    audio = NULL;
+    shm_output_enabled = 0;
+}
+
+
+void shm_publish_frame(uint32_t const *pixels) {
+
+    if (!video) {
+        return;
+    }
+
+    uint64_t frame_no = video->frame_count;
+    Shm_Slot *slot = &video->slots[frame_no % SHM_VIDEO_SLOTS];
+
+    // Odd sequence marks the slot as being written
+    __atomic_store_n(&slot->seq, slot->seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    memcpy(video_slots + (frame_no % SHM_VIDEO_SLOTS) * FRAME_PIXELS, pixels, FRAME_PIXELS * sizeof(uint32_t));
+    slot->frame_no = frame_no;
+
+    __atomic_store_n(&slot->seq, slot->seq + 1, __ATOMIC_RELEASE);
+    __atomic_store_n(&video->frame_count, frame_no + 1, __ATOMIC_RELEASE);
+}
+
+
+void shm_publish_audio(int16_t const *samples, size_t count, unsigned sample_rate) {
+
+    if (!audio) {
+        return;
+    }
+
+    audio->sample_rate = sample_rate;
+
+    // Only the most recent ring's worth of a large write can be kept
+    if (count > SHM_AUDIO_SAMPLES) {
+        samples += count - SHM_AUDIO_SAMPLES;
+        count = SHM_AUDIO_SAMPLES;
+    }
+
+    uint64_t pos = audio->write_pos;
+    size_t start = pos & (SHM_AUDIO_SAMPLES - 1);
+    size_t first = SHM_AUDIO_SAMPLES - start;
+    if (first > count) {
+        first = count;
+    }
+
+    memcpy(audio_samples + start, samples, first * sizeof(int16_t));
+    memcpy(audio_samples, samples + first, (count - first) * sizeof(int16_t));
+
+    __atomic_store_n(&audio->write_pos, pos + count, __ATOMIC_RELEASE);
+}
+
+#else
+
+int shm_output_open(char const *name) {
+    (void)name;
+    log_message(LOG_WARN, "Shared memory output not supported in this build\n");
+    return 0;
+}
+
+void shm_output_close() {
+}
+
+void shm_publish_frame(uint32_t const *pixels) {
+    (void)pixels;
+}
+
+void shm_publish_audio(int16_t const *samples, size_t count, unsigned sample_rate) {
+    (void)samples;
+    (void)count;
+    (void)sample_rate;
+}
+
+#endif
@@ -0,0 +1,383 @@
+/* Finds where two instruction traces first differ, to chase down
+ * emulation bugs against another emulator or an earlier build.
+ *
+ * Traces are either binary files written by plutoboy -trace, see
+ * core/trace.h, or text logs with a line per instruction in the form
+ * many emulators can log in (that of Gameboy Doctor):
+ *   A:01 F:B0 B:00 C:13 D:00 E:D8 H:01 L:4D SP:FFFE PC:0100 PCMEM:00,C3,50,01
+ * optionally followed by BANK:bank and CYC:cycles. Only what both
+ * traces have is compared, text logs rarely give banks or cycles.
+ * Records are printed with their instruction disassembled, the third
+ * byte of 3 byte instructions isn't traced and shows as ??.
+ *
+ *   trace_diff [-skipa=n] [-skipb=n] [-context=n] [-nocycles] a b
+ * compares a and b, skipping records at the start of either, exits 0
+ * if they match, 1 if not and 2 on errors.
+ *   trace_diff -print trace
+ * prints a binary trace as text. */
+
+#include "../core/trace.h"
+#include "../core/disasm.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DEFAULT_CONTEXT 8
+#define MAX_CONTEXT 256
+#define MAX_LINE 256
+
+enum {
+    FIELD_REGS = 0x1,
+    FIELD_OPCODE = 0x2,
+    FIELD_OPERAND = 0x4,
+    FIELD_BANK = 0x8,
+    FIELD_CYCLES = 0x10
+};
+
+typedef struct {
+    char const *path;
+    FILE *file;
+    int binary;
+    int fields; // Known in every record read so far
+    uint64_t count; // Binary traces
+    uint64_t start;
+    uint64_t index; // Records read
+} Trace_File;
+
+
+static int open_trace(Trace_File *trace, char const *path) {
+
+    memset(trace, 0, sizeof(Trace_File));
+    trace->path = path;
+    if (!(trace->file = fopen(path, "rb"))) {
+        fprintf(stderr, "Error opening %s\n", path);
+        return 0;
+    }
+
+    Trace_Header header;
+    if (fread(&header, sizeof(header), 1, trace->file) != 1 ||
+            memcmp(header.magic, TRACE_MAGIC, sizeof(TRACE_MAGIC)) != 0) {
+        // Anything but a binary trace is taken as a text log
+        rewind(trace->file);
+        trace->fields = FIELD_REGS | FIELD_OPCODE | FIELD_OPERAND | FIELD_BANK | FIELD_CYCLES;
+        return 1;
+    }
+
+    if (header.version != TRACE_VERSION || header.record_size != sizeof(Trace_Record)) {
+        fprintf(stderr, "%s is from an incompatible version or machine\n", path);
+        fclose(trace->file);
+        return 0;
+    }
+    trace->binary = 1;
+    trace->fields = FIELD_REGS | FIELD_OPCODE | FIELD_OPERAND | FIELD_BANK | FIELD_CYCLES;
+    trace->count = header.count;
+    trace->start = header.start;
+
+    // Rings are read from their oldest record, wrapping back round
+    if (trace->start >= trace->count && trace->count != TRACE_COUNT_UNKNOWN && trace->count > 0) {
+        fprintf(stderr, "%s is corrupt\n", path);
+        fclose(trace->file);
+        return 0;
+    }
+    if (trace->start && fseek(trace->file, trace->start * sizeof(Trace_Record), SEEK_CUR) != 0) {
+        fprintf(stderr, "Error reading %s\n", path);
+        fclose(trace->file);
+        return 0;
+    }
+    return 1;
+}
+
+
+static int read_binary(Trace_File *trace, Trace_Record *record) {
+
+    if (trace->index == trace->count) {
+        return 0;
+    }
+    if (trace->start && trace->start + trace->index == trace->count) {
+        fseek(trace->file, sizeof(Trace_Header), SEEK_SET);
+    }
+    if (fread(record, sizeof(Trace_Record), 1, trace->file) != 1) {
+        if (trace->count == TRACE_COUNT_UNKNOWN && feof(trace->file)) {
+            return 0;
+        }
+        fprintf(stderr, "%s ends early\n", trace->path);
+        return -1;
+    }
+    return 1;
+}
+
+
+static int read_text(Trace_File *trace, Trace_Record *record) {
+
+    char line[MAX_LINE];
+    unsigned a, f, b, c, d, e, h, l, sp, pc, opcode, operand;
+    do {
+        if (!fgets(line, MAX_LINE, trace->file)) {
+            return 0;
+        }
+    } while (line[0] == '\n' || line[0] == '\r');
+
+    int n = sscanf(line, "A:%x F:%x B:%x C:%x D:%x E:%x H:%x L:%x SP:%x PC:%x PCMEM:%x,%x",
+        &a, &f, &b, &c, &d, &e, &h, &l, &sp, &pc, &opcode, &operand);
+    if (n < 10) {
+        fprintf(stderr, "%s line %llu isn't a trace line: %s", trace->path,
+            (unsigned long long)trace->index + 1, line);
+        return -1;
+    }
+
+    memset(record, 0, sizeof(Trace_Record));
+    record->af = (a & 0xFF) << 8 | (f & 0xFF);
+    record->bc = (b & 0xFF) << 8 | (c & 0xFF);
+    record->de = (d & 0xFF) << 8 | (e & 0xFF);
+    record->hl = (h & 0xFF) << 8 | (l & 0xFF);
+    record->sp = sp;
+    record->pc = pc;
+
+    int fields = FIELD_REGS;
+    if (n >= 11) {
+        record->opcode = opcode;
+        fields |= FIELD_OPCODE;
+    }
+    if (n >= 12) {
+        record->operand = operand;
+        fields |= FIELD_OPERAND;
+    }
+
+    unsigned bank;
+    unsigned long long cycles;
+    char const *field;
+    if ((field = strstr(line, " BANK:")) && sscanf(field, " BANK:%x", &bank) == 1) {
+        record->bank = bank;
+        fields |= FIELD_BANK;
+    }
+    if ((field = strstr(line, " CYC:")) && sscanf(field, " CYC:%llu", &cycles) == 1) {
+        record->cycles = cycles;
+        fields |= FIELD_CYCLES;
+    }
+    trace->fields &= fields;
+    return 1;
+}
+
+
+// returns 1 if a record was read, 0 at the end of the trace and -1 on errors
+static int read_record(Trace_File *trace, Trace_Record *record) {
+
+    int result = trace->binary ? read_binary(trace, record) : read_text(trace, record);
+    if (result > 0) {
+        trace->index++;
+    }
+    return result;
+}
+
+
+static void print_record(Trace_Record const *record, int fields) {
+
+    printf("A:%02X F:%02X B:%02X C:%02X D:%02X E:%02X H:%02X L:%02X SP:%04X PC:%04X",
+        record->af >> 8, record->af & 0xFF, record->bc >> 8, record->bc & 0xFF,
+        record->de >> 8, record->de & 0xFF, record->hl >> 8, record->hl & 0xFF,
+        record->sp, record->pc);
+    if (fields & FIELD_OPCODE) {
+        printf(" PCMEM:%02X", record->opcode);
+        if (fields & FIELD_OPERAND) {
+            printf(",%02X", record->operand);
+        }
+    }
+    if (fields & FIELD_BANK) {
+        printf(" BANK:%02X", record->bank);
+    }
+    if (fields & FIELD_CYCLES) {
+        printf(" CYC:%llu", (unsigned long long)record->cycles);
+    }
+    if (fields & FIELD_OPCODE) {
+        uint8_t bytes[DISASM_MAX_LENGTH] = {record->opcode, record->operand};
+        Disasm_Line line;
+        char text[64];
+        decode_instruction(record->pc, bytes, fields & FIELD_OPERAND ? 2 : 1, &line);
+        format_instruction(&line, text, sizeof(text));
+        printf(" ; %s", text);
+    }
+    printf("\n");
+}
+
+
+// Names of the fields of a and b which differ, empty if they match
+static void find_differences(Trace_Record const *a, Trace_Record const *b, int fields, char *out) {
+
+    out[0] = '\0';
+    if (fields & FIELD_REGS) {
+        if (a->pc != b->pc) strcat(out, " PC");
+        if (a->sp != b->sp) strcat(out, " SP");
+        if (a->af >> 8 != b->af >> 8) strcat(out, " A");
+        if ((a->af & 0xFF) != (b->af & 0xFF)) strcat(out, " F");
+        if (a->bc != b->bc) strcat(out, " BC");
+        if (a->de != b->de) strcat(out, " DE");
+        if (a->hl != b->hl) strcat(out, " HL");
+    }
+    if ((fields & FIELD_OPCODE) && a->opcode != b->opcode) strcat(out, " opcode");
+    if ((fields & FIELD_OPERAND) && a->operand != b->operand) strcat(out, " operand");
+    if ((fields & FIELD_BANK) && a->bank != b->bank) strcat(out, " bank");
+    if ((fields & FIELD_CYCLES) && a->cycles != b->cycles) strcat(out, " cycles");
+}
+
+
+static int skip_records(Trace_File *trace, unsigned long long skip) {
+
+    Trace_Record record;
+    while (trace->index < skip) {
+        int result = read_record(trace, &record);
+        if (result <= 0) {
+            if (result == 0) {
+                fprintf(stderr, "%s has fewer than %llu records\n", trace->path, skip);
+            }
+            return 0;
+        }
+    }
+    return 1;
+}
+
+
+static int print_trace(char const *path) {
+
+    Trace_File trace;
+    Trace_Record record;
+    int result;
+    if (!open_trace(&trace, path)) {
+        return 2;
+    }
+    while ((result = read_record(&trace, &record)) > 0) {
+        print_record(&record, trace.fields);
+    }
+    fclose(trace.file);
+    return result < 0 ? 2 : 0;
+}
+
+
+static int diff_traces(char const *path_a, char const *path_b, unsigned long long skip_a,
+        unsigned long long skip_b, unsigned context, int compare_cycles) {
+
+    Trace_File a, b;
+    if (!open_trace(&a, path_a)) {
+        return 2;
+    }
+    if (!open_trace(&b, path_b)) {
+        fclose(a.file);
+        return 2;
+    }
+
+    // The last few records of a before any difference
+    static Trace_Record history[MAX_CONTEXT];
+    unsigned long long matched = 0;
+    int status = 2;
+
+    if (!skip_records(&a, skip_a) || !skip_records(&b, skip_b)) {
+        goto done;
+    }
+
+    for (;;) {
+        Trace_Record record_a, record_b;
+        int result_a = read_record(&a, &record_a);
+        int result_b = read_record(&b, &record_b);
+        if (result_a < 0 || result_b < 0) {
+            goto done;
+        }
+        if (result_a == 0 || result_b == 0) {
+            if (result_a == result_b) {
+                printf("Traces match over %llu records\n", matched);
+                status = 0;
+            } else {
+                printf("Traces match over %llu records, then %s ends\n", matched,
+                    result_a == 0 ? path_a : path_b);
+                status = 1;
+            }
+            goto done;
+        }
+
+        // Text logs may only give some fields, so they're rechecked each record
+        int fields = a.fields & b.fields;
+        if (!compare_cycles) {
+            fields &= ~FIELD_CYCLES;
+        }
+
+        char differences[MAX_LINE];
+        find_differences(&record_a, &record_b, fields, differences);
+        if (differences[0] != '\0') {
+            printf("Traces differ after %llu matching records, at record %llu of %s and %llu of %s\n",
+                matched, (unsigned long long)a.index, path_a, (unsigned long long)b.index, path_b);
+            unsigned shown = matched < context ? matched : context;
+            for (unsigned i = shown; i > 0; i--) {
+                printf("   ");
+                print_record(&history[(matched - i) % MAX_CONTEXT], fields);
+            }
+            printf(" a ");
+            print_record(&record_a, fields);
+            printf(" b ");
+            print_record(&record_b, fields);
+            printf("Differs in:%s\n", differences);
+            status = 1;
+            goto done;
+        }
+        history[matched % MAX_CONTEXT] = record_a;
+        matched++;
+    }
+
+done:
+    fclose(a.file);
+    fclose(b.file);
+    return status;
+}
+
+
+static void usage(char const *prog_name) {
+    fprintf(stderr, "usage %s [-skipa=n] [-skipb=n] [-context=n] [-nocycles] trace_a trace_b\n", prog_name);
+    fprintf(stderr, "      %s -print trace\n", prog_name);
+    exit(2);
+}
+
+
+int main(int argc, char *argv[]) {
+
+    unsigned long long skip_a = 0, skip_b = 0;
+    unsigned context = DEFAULT_CONTEXT;
+    int compare_cycles = 1;
+    char const *paths[2];
+    int path_count = 0;
+    int print = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-print") == 0) {print = 1;}
+        else if (strcmp(argv[i], "-nocycles") == 0) {compare_cycles = 0;}
+        else if (strncmp(argv[i], "-skipa=", strlen("-skipa=")) == 0) {
+            if (sscanf(argv[i] + strlen("-skipa="), "%llu", &skip_a) != 1) {
+                usage(argv[0]);
+            }
+        }
+        else if (strncmp(argv[i], "-skipb=", strlen("-skipb=")) == 0) {
+            if (sscanf(argv[i] + strlen("-skipb="), "%llu", &skip_b) != 1) {
+                usage(argv[0]);
+            }
+        }
+        else if (strncmp(argv[i], "-context=", strlen("-context=")) == 0) {
+            if (sscanf(argv[i] + strlen("-context="), "%u", &context) != 1 || context > MAX_CONTEXT) {
+                usage(argv[0]);
+            }
+        }
+        else if (argv[i][0] != '-' && path_count < 2) {
+            paths[path_count++] = argv[i];
+        }
+        else {
+            usage(argv[0]);
+        }
+    }
+
+    if (print) {
+        if (path_count != 1) {
+            usage(argv[0]);
+        }
+        return print_trace(paths[0]);
+    }
+    if (path_count != 2) {
+        usage(argv[0]);
+    }
+    return diff_traces(paths[0], paths[1], skip_a, skip_b, context, compare_cycles);
+}